@@ -27,17 +27,60 @@ static SQLITE_EXTENSION_INIT1
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <io.h>
 #define strcasecmp  _stricmp
 #define strncasecmp _strnicmp
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CSV_SSE2 1
+#endif
+
+#if defined(_WIN32)
+#if defined(_WIN32_WINNT) && (_WIN32_WINNT >= 0x0600)
+#include <process.h>
+#define CSV_THREADS 1
+#endif
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+#define CSV_THREADS 1
 #endif
 
+#define CSV_BUFSIZE	(1024 * 1024)	/**< read buffer size w/o mmap */
+#define CSV_MAXSPC	8		/**< max. special chars for SSE2 */
+
+#define CSV_CHUNK	(4 * 1024 * 1024)	/**< import chunk size */
+#define CSV_BLKSIZE	65536		/**< text block size of batch */
+#define CSV_TXROWS	500000		/**< rows per import transaction */
+#define CSV_MAXTHR	64		/**< max. import worker threads */
+
+#define CSV_IDXROWS	256		/**< rows per block of row index */
+#define CSV_IDXMAGIC	"CSVIDX1"	/**< magic of row index file */
+#define CSV_MAXROWID	((((sqlite_int64) 0x7fffffff) << 32) | 0xffffffff)
+
+#define CSV_SEP		1		/**< class: column separator */
+#define CSV_QUOT	2		/**< class: quote character */
+#define CSV_CTRL	4		/**< class: LF, CR, NUL */
+
 /**
  * @typedef csv_file
  * @struct csv_file
  * Structure to implement CSV file handle.
+ *
+ * The file is memory mapped when possible, otherwise read in
+ * large blocks. Columns of the current row are spans into
+ * the mapped region or read buffer, only columns which need
+ * unescaping are copied into the line buffer.
  */
 
 typedef struct csv_file {
@@ -46,11 +89,26 @@ typedef struct csv_file {
     char *quot;		/**< text quoting characters */
     int isdos;		/**< true, when DOS format detected */
     int maxl;		/**< max. capacity of line buffer */
-    char *line;		/**< line buffer */
+    char *line;		/**< line buffer for unescaped columns */
     long pos0;		/**< file position for rewind */
     int maxc;		/**< max. capacity of column buffer */
     int ncols;		/**< number of columns */
     char **cols;	/**< column buffer */
+    int *lens;		/**< column lengths */
+    char *data;		/**< mapped file or read buffer */
+    long doff;		/**< file position of data[0] */
+    long dlen;		/**< number of valid bytes in data */
+    long dpos;		/**< read position in data */
+    int dmax;		/**< size of read buffer, 0 when mapped */
+    int deof;		/**< true, when data reaches end of file */
+    int eof;		/**< true, when end of file was read */
+    int shared;		/**< true, when FILE and mapping are borrowed */
+#ifdef _WIN32
+    HANDLE hmap;	/**< file mapping handle */
+#endif
+    int nspc;		/**< number of special characters */
+    char spc[CSV_MAXSPC];	/**< special characters for SSE2 search */
+    unsigned char cclass[256];	/**< character classes */
 } csv_file;
 
 /**
@@ -64,6 +122,44 @@ typedef struct csv_guess_fmt {
     int hist[256];
 } csv_guess_fmt;
 
+/**
+ * @typedef csv_index
+ * @struct csv_index
+ * Row index of a CSV virtual table: file position of every
+ * CSV_IDXROWS-th row plus minimum and maximum per block of
+ * rows for columns of numeric type (zone maps).
+ */
+
+typedef struct csv_index {
+    sqlite_int64 nrows;		/**< number of rows */
+    int nblks;			/**< number of blocks */
+    int maxblks;		/**< allocated number of blocks */
+    int nzcols;			/**< number of zone map columns */
+    int *zcols;			/**< column numbers of zone maps */
+    sqlite_int64 *offs;		/**< file position per block */
+    double *zmin;		/**< minimum per block and zone map column */
+    double *zmax;		/**< maximum per block and zone map column */
+} csv_index;
+
+/**
+ * @typedef csv_idxhdr
+ * @struct csv_idxhdr
+ * Header of row index file, followed by block positions,
+ * zone map column numbers, minimum and maximum values.
+ */
+
+typedef struct {
+    char magic[8];		/**< CSV_IDXMAGIC */
+    sqlite_int64 size;		/**< size of CSV file */
+    sqlite_int64 mtime;		/**< modification time of CSV file */
+    sqlite_int64 pos0;		/**< file position of first row */
+    sqlite_int64 nrows;		/**< number of rows */
+    int nblks;			/**< number of blocks */
+    int blkrows;		/**< CSV_IDXROWS */
+    int nzcols;			/**< number of zone map columns */
+    unsigned int key;		/**< hash of layout and column types */
+} csv_idxhdr;
+
 /**
  * @typedef csv_vtab
  * @struct csv_vtab
@@ -74,9 +170,25 @@ typedef struct csv_vtab {
     sqlite3_vtab vtab;	/**< SQLite virtual table */
     csv_file *csv;	/**< CSV file handle */
     int convert;	/**< convert flags */
+    int ncols;		/**< number of columns */
+    char *fname;	/**< name of CSV file */
+    char *idxname;	/**< name of row index file or NULL */
+    csv_index *index;	/**< row index or NULL */
     char coltypes[1];	/**< column types */
 } csv_vtab;
 
+/**
+ * @typedef csv_zone
+ * @struct csv_zone
+ * Constraint on a numeric column checked against zone maps.
+ */
+
+typedef struct {
+    int zcol;		/**< zone map column, index into csv_index.zcols */
+    int op;		/**< SQLITE_INDEX_CONSTRAINT_* */
+    double val;		/**< value to compare with */
+} csv_zone;
+
 /**
  * @typedef csv_cursor
  * @struct csv_cursor
@@ -85,9 +197,65 @@ typedef struct csv_vtab {
 
 typedef struct {
     sqlite3_vtab_cursor cursor;		/**< SQLite virtual table cursor */
+    csv_file *csv;			/**< CSV file handle of cursor */
     long pos;				/**< CSV file position */
+    sqlite_int64 rowid;			/**< number of current row */
+    sqlite_int64 maxrow;		/**< number of last row to return */
+    int eof;				/**< true, when behind maxrow */
+    int nzones;				/**< number of zone constraints */
+    csv_zone *zones;			/**< zone constraints */
 } csv_cursor;
 
+/**
+ * @typedef csv_cell
+ * @struct csv_cell
+ * Converted column value of a row in an import batch.
+ */
+
+typedef struct {
+    int type;		/**< SQLITE_NULL, SQLITE_INTEGER et.al. */
+    int len;		/**< length of text */
+    union {
+	sqlite_int64 i;	/**< integer value */
+	double d;	/**< floating point value */
+	char *s;	/**< text value */
+    } v;
+} csv_cell;
+
+/**
+ * @typedef csv_blk
+ * @struct csv_blk
+ * Block of text storage of an import batch.
+ */
+
+typedef struct csv_blk {
+    struct csv_blk *next;	/**< next block */
+    int size;			/**< size of data */
+    int used;			/**< bytes used in data */
+    char data[1];		/**< text data */
+} csv_blk;
+
+/**
+ * @typedef csv_batch
+ * @struct csv_batch
+ * Rows of a chunk of the CSV file converted by an import worker.
+ * Text values point into the mapped file or into text blocks.
+ */
+
+typedef struct csv_batch {
+    struct csv_batch *next;	/**< next batch in list */
+    int seq;			/**< sequence number of chunk */
+    int rc;			/**< SQLite error code */
+    int ncols;			/**< number of columns per row */
+    int nrows;			/**< number of rows */
+    int maxrows;		/**< capacity of cells in rows */
+    csv_cell *cells;		/**< nrows * ncols cells */
+    csv_cell *row;		/**< cells of current row */
+    char *map;			/**< start of mapped file or NULL */
+    char *mapend;		/**< end of mapped file */
+    csv_blk *blks;		/**< text blocks */
+} csv_batch;
+
 /**
  * Free dynamically allocated string buffer
  * @param in input string pointer
@@ -273,9 +441,51 @@ conv_names(char **names, int ncols)
 }
 
 /**
- * Make result data or parameter binding accoring to type
+ * Store text value in current row of import batch.
+ * @param batch import batch
+ * @param idx column number, 1-based
+ * @param data string data
+ * @param len string length
+ */
+
+static void
+batch_text(csv_batch *batch, int idx, char *data, int len)
+{
+    csv_cell *cell = batch->row + idx - 1;
+    csv_blk *blk;
+
+    if (batch->map && (data >= batch->map) && (data + len <= batch->mapend)) {
+	/* span into mapped file, no copy */
+	cell->v.s = data;
+    } else {
+	blk = batch->blks;
+	if (!blk || (blk->used + len > blk->size)) {
+	    int n = (len > CSV_BLKSIZE) ? len : CSV_BLKSIZE;
+
+	    blk = sqlite3_malloc(sizeof (csv_blk) + n);
+	    if (!blk) {
+		batch->rc = SQLITE_NOMEM;
+		cell->type = SQLITE_NULL;
+		return;
+	    }
+	    blk->size = n;
+	    blk->used = 0;
+	    blk->next = batch->blks;
+	    batch->blks = blk;
+	}
+	cell->v.s = blk->data + blk->used;
+	memcpy(cell->v.s, data, len);
+	blk->used += len;
+    }
+    cell->type = SQLITE_TEXT;
+    cell->len = len;
+}
+
+/**
+ * Make result data, parameter binding, or batch value accoring to type
  * @param ctx SQLite function context or NULL
  * @param stmt SQLite statement or NULL
+ * @param batch import batch or NULL
  * @param idx parameter number, 1-based
  * @param data string data
  * @param len string length
@@ -283,136 +493,161 @@ conv_names(char **names, int ncols)
  */
 
 static void
-result_or_bind(sqlite3_context *ctx, sqlite3_stmt *stmt, int idx,
-	       char *data, int len, int type)
+result_or_bind(sqlite3_context *ctx, sqlite3_stmt *stmt, csv_batch *batch,
+	       int idx, char *data, int len, int type)
 {
-    char *endp;
+    char *endp, *num = 0, numbuf[64];
 
     if (!data) {
 	if (ctx) {
 	    sqlite3_result_null(ctx);
+	} else if (batch) {
+	    batch->row[idx - 1].type = SQLITE_NULL;
 	} else {
 	    sqlite3_bind_null(stmt, idx);
 	}
 	return;
     }
+    if ((type == SQLITE_INTEGER) || (type == SQLITE_FLOAT)) {
+	/* data is a span, number conversion needs a terminated copy */
+	num = (len < (int) sizeof (numbuf)) ? numbuf : sqlite3_malloc(len + 1);
+	if (!num) {
+	    goto puttext;
+	}
+	memcpy(num, data, len);
+	num[len] = '\0';
+    }
     if (type == SQLITE_INTEGER) {
 	sqlite_int64 val;
 #if defined(_WIN32) || defined(_WIN64)
 	char endc;
 
-	if (sscanf(data, "%I64d%c", &val, &endc) == 1) {
-	    if (ctx) {
-		sqlite3_result_int64(ctx, val);
-	    } else {
-		sqlite3_bind_int64(stmt, idx, val);
-	    }
-	    return;
+	if (sscanf(num, "%I64d%c", &val, &endc) == 1) {
+	    goto putint;
 	}
 #else
 	endp = 0;
 #ifdef __osf__
-	val = strtol(data, &endp, 0);
+	val = strtol(num, &endp, 0);
 #else
-	val = strtoll(data, &endp, 0);
+	val = strtoll(num, &endp, 0);
 #endif
-	if (endp && (endp != data) && !*endp) {
-	    if (ctx) {
-		sqlite3_result_int64(ctx, val);
-	    } else {
-		sqlite3_bind_int64(stmt, idx, val);
-	    }
-	    return;
+	if (endp && (endp != num) && !*endp) {
+	    goto putint;
 	}
 #endif
+	goto puttext;
+putint:
+	if (ctx) {
+	    sqlite3_result_int64(ctx, val);
+	} else if (batch) {
+	    batch->row[idx - 1].type = SQLITE_INTEGER;
+	    batch->row[idx - 1].v.i = val;
+	} else {
+	    sqlite3_bind_int64(stmt, idx, val);
+	}
+	goto done;
     } else if (type == SQLITE_FLOAT) {
 	double val;
 
 	endp = 0;
-	val = strtod(data, &endp);
-	if (endp && (endp != data) && !*endp) {
+	val = strtod(num, &endp);
+	if (endp && (endp != num) && !*endp) {
 	    if (ctx) {
 		sqlite3_result_double(ctx, val);
+	    } else if (batch) {
+		batch->row[idx - 1].type = SQLITE_FLOAT;
+		batch->row[idx - 1].v.d = val;
 	    } else {
 		sqlite3_bind_double(stmt, idx, val);
 	    }
-	    return;
+	    goto done;
 	}
     }
+puttext:
     if (ctx) {
 	sqlite3_result_text(ctx, data, len, SQLITE_TRANSIENT);
+    } else if (batch) {
+	batch_text(batch, idx, data, len);
     } else {
 	sqlite3_bind_text(stmt, idx, data, len, SQLITE_TRANSIENT);
     }
+done:
+    if (num && (num != numbuf)) {
+	sqlite3_free(num);
+    }
 }
 
 /**
  * Process one column of the current row
  * @param ctx SQLite function context or NULL
  * @param stmt SQLite statement or NULL
+ * @param batch import batch or NULL
  * @param idx parameter index, 1-based
- * @param data string data
+ * @param data string data (span, not necessarily terminated)
+ * @param len length of string data
  * @param type SQLite type
  * @param conv conversion flags
  */
 
 static int
-process_col(sqlite3_context *ctx, sqlite3_stmt *stmt, int idx,
-	    char *data, int type, int conv)
+process_col(sqlite3_context *ctx, sqlite3_stmt *stmt, csv_batch *batch,
+	    int idx, char *data, int len, int type, int conv)
 {
-    char c, *p;
+    char c, *p, *end, numbuf[64];
     const char flchars[] = "Ee+-.,0123456789";
 
     if (!data) {
 	goto putdata;
     }
+    end = data + len;
 
     /*
      * Floating point number test,
      * converts single comma to dot.
      */
-    c = data[0];
+    c = (len > 0) ? data[0] : '\0';
     if ((c != '\0') && strchr(flchars + 2, c)) {
 	p = data + 1;
-	while (*p && strchr(flchars, *p)) {
+	while ((p < end) && (((*p >= '0') && (*p <= '9')) ||
+			     (*p && strchr(flchars, *p)))) {
 	    ++p;
 	}
-	if (*p == '\0') {
-	    char *first = 0;
-	    int n = 0;
+	if (p >= end) {
+	    p = memchr(data, ',', len);
+	    if (p) {
+		char *num;
 
-	    p = data;
-	    while (p) {
-		p = strchr(p, ',');
-		if (!p) {
-		    break;
+		num = (len < (int) sizeof (numbuf)) ? numbuf : sqlite3_malloc(len);
+		if (!num) {
+		    goto nomem;
 		}
-		if (++n == 1) {
-		    first = p;
+		memcpy(num, data, len);
+		num[p - data] = '.';
+		result_or_bind(ctx, stmt, batch, idx, num, len, type);
+		if (num != numbuf) {
+		    sqlite3_free(num);
 		}
-		++p;
-	    }
-	    if (first) {
-		*first = '.';
-		goto putdata;
+		return SQLITE_OK;
 	    }
 	}
     }
     if (conv) {
-	char *utf = sqlite3_malloc(strlen(data) * 2 + 2);
+	char *utf = sqlite3_malloc(len * 2 + 2);
 
 	if (utf) {
 	    p = utf;
-	    while ((c = *data) != '\0') {
+	    while (data < end) {
+		c = *data;
 		if (((conv & 10) == 10) && (c == '\\')) {
-		    if (data[1] == 'q') {
+		    if ((data + 1 < end) && (data[1] == 'q')) {
 			*p++ = '\'';
 			data += 2;
 			continue;
 		    }
 		}
 		if ((conv & 2) && (c == '\\')) {
-		    char c2 = data[1];
+		    char c2 = (data + 1 < end) ? data[1] : '\0';
 
 		    switch (c2) {
 		    case '\0':
@@ -469,10 +704,11 @@ process_col(sqlite3_context *ctx, sqlite3_stmt *stmt, int idx,
 	    }
 convdone:
 	    *p = '\0';
-	    result_or_bind(ctx, stmt, idx, utf, p - utf, type);
+	    result_or_bind(ctx, stmt, batch, idx, utf, p - utf, type);
 	    sqlite3_free(utf);
 	    return SQLITE_OK;
 	} else {
+nomem:
 	    if (ctx) {
 		sqlite3_result_error(ctx, "out of memory", -1);
 	    }
@@ -480,10 +716,103 @@ convdone:
 	}
     }
 putdata:
-    result_or_bind(ctx, stmt, idx, data, -1, type);
+    result_or_bind(ctx, stmt, batch, idx, data, len, type);
     return SQLITE_OK;
 }
 
+/**
+ * Setup character classes of CSV file handle
+ * from column separator and quote characters.
+ * @param csv CSV file handle
+ */
+
+static void
+csv_chars(csv_file *csv)
+{
+    int i, k;
+    char *p, *sep;
+
+    memset(csv->cclass, 0, sizeof (csv->cclass));
+    csv->cclass['\n'] = csv->cclass['\r'] = csv->cclass['\0'] = CSV_CTRL;
+    sep = csv->sep ? csv->sep : ";";
+    for (p = sep; *p; p++) {
+	csv->cclass[*p & 0xFF] |= CSV_SEP;
+    }
+    for (p = csv->quot; p && *p; p++) {
+	csv->cclass[*p & 0xFF] |= CSV_QUOT;
+    }
+    for (i = k = 0; i < 256; i++) {
+	if (csv->cclass[i]) {
+	    if (k < CSV_MAXSPC) {
+		csv->spc[k] = i;
+	    }
+	    k++;
+	}
+    }
+    csv->nspc = k;
+}
+
+/**
+ * Memory map CSV file.
+ * @param csv CSV file handle
+ * @result 0 on success, EOF on error
+ */
+
+static int
+csv_map(csv_file *csv)
+{
+#ifdef _WIN32
+    HANDLE fh, hmap;
+    DWORD size, sizehi = 0;
+    char *map;
+
+    fh = (HANDLE) _get_osfhandle(_fileno(csv->f));
+    if (fh == INVALID_HANDLE_VALUE) {
+	return EOF;
+    }
+    size = GetFileSize(fh, &sizehi);
+    if ((size == INVALID_FILE_SIZE) || sizehi || (size == 0) ||
+	(size > LONG_MAX)) {
+	return EOF;
+    }
+    hmap = CreateFileMapping(fh, 0, PAGE_READONLY, 0, 0, 0);
+    if (!hmap) {
+	return EOF;
+    }
+    map = MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+    if (!map) {
+	CloseHandle(hmap);
+	return EOF;
+    }
+    csv->hmap = hmap;
+#else
+    struct stat st;
+    size_t size;
+    char *map;
+
+    if (fstat(fileno(csv->f), &st) || !S_ISREG(st.st_mode) ||
+	(st.st_size <= 0) || (st.st_size > LONG_MAX)) {
+	return EOF;
+    }
+    size = st.st_size;
+    if ((off_t) size != st.st_size) {
+	return EOF;
+    }
+    map = mmap(0, size, PROT_READ, MAP_PRIVATE, fileno(csv->f), 0);
+    if (map == MAP_FAILED) {
+	return EOF;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, size, MADV_SEQUENTIAL);
+#endif
+#endif
+    csv->data = map;
+    csv->dlen = size;
+    csv->dmax = 0;
+    csv->deof = 1;
+    return 0;
+}
+
 /**
  * Open CSV file for reading and return handle to it.
  * @param filename name of CSV file
@@ -527,6 +856,7 @@ error1:
     if (quot && quot[0]) {
 	csv->quot = sqlite3_malloc(strlen(quot) + 1);
 	if (!csv->quot) {
+error2:
 	    if (csv->sep) {
 		sqlite3_free(csv->sep);
 	    }
@@ -543,6 +873,22 @@ error1:
     csv->maxc = 0;
     csv->ncols = 0;
     csv->cols = 0;
+    csv->lens = 0;
+    csv->doff = csv->dlen = csv->dpos = 0;
+    csv->deof = csv->eof = 0;
+    csv->shared = 0;
+    if (csv_map(csv) != 0) {
+	/* not mappable (pipe, empty or huge file), use read buffer */
+	csv->dmax = CSV_BUFSIZE;
+	csv->data = sqlite3_malloc(csv->dmax);
+	if (!csv->data) {
+	    if (csv->quot) {
+		sqlite3_free(csv->quot);
+	    }
+	    goto error2;
+	}
+    }
+    csv_chars(csv);
     return csv;
 }
 
@@ -567,24 +913,87 @@ csv_close(csv_file *csv)
 	if (csv->cols) {
 	    sqlite3_free(csv->cols);
 	}
-	if (csv->f) {
+	if (csv->lens) {
+	    sqlite3_free(csv->lens);
+	}
+	if (csv->data && !csv->shared) {
+	    if (csv->dmax) {
+		sqlite3_free(csv->data);
+	    } else {
+#ifdef _WIN32
+		UnmapViewOfFile(csv->data);
+		CloseHandle(csv->hmap);
+#else
+		munmap(csv->data, csv->dlen);
+#endif
+	    }
+	}
+	if (csv->f && !csv->shared) {
 	    fclose(csv->f);
 	}
 	sqlite3_free(csv);
     }
 }
 
+/**
+ * Make another handle of memory mapped CSV file with own
+ * read position and line buffer sharing FILE and mapping.
+ * @param csv CSV file handle
+ * @result new CSV file handle or NULL
+ */
+
+static csv_file *
+csv_dup(csv_file *csv)
+{
+    csv_file *dup;
+
+    if (!csv || csv->dmax) {
+	return 0;
+    }
+    dup = sqlite3_malloc(sizeof (csv_file));
+    if (!dup) {
+	return 0;
+    }
+    memcpy(dup, csv, sizeof (csv_file));
+    dup->sep = dup->quot = 0;
+    dup->maxl = dup->maxc = dup->ncols = 0;
+    dup->line = 0;
+    dup->cols = 0;
+    dup->lens = 0;
+    dup->dpos = 0;
+    dup->eof = 0;
+    dup->shared = 1;
+    if (csv->sep) {
+	dup->sep = sqlite3_malloc(strlen(csv->sep) + 1);
+	if (!dup->sep) {
+	    goto error;
+	}
+	strcpy(dup->sep, csv->sep);
+    }
+    if (csv->quot) {
+	dup->quot = sqlite3_malloc(strlen(csv->quot) + 1);
+	if (!dup->quot) {
+	    goto error;
+	}
+	strcpy(dup->quot, csv->quot);
+    }
+    return dup;
+error:
+    csv_close(dup);
+    return 0;
+}
+
 /**
  * Test EOF on CSV file handle.
  * @param csv CSV file handle
- * @result true when file position is at EOF
+ * @result true when last csv_getline() hit EOF
  */
 
 static int
 csv_eof(csv_file *csv)
 {
     if (csv && csv->f) {
-	return feof(csv->f);
+	return csv->eof;
     }
     return 1;
 }
@@ -600,6 +1009,17 @@ static long
 csv_seek(csv_file *csv, long pos)
 {
     if (csv && csv->f) {
+	csv->eof = 0;
+	if ((pos >= csv->doff) && (pos <= csv->doff + csv->dlen)) {
+	    csv->dpos = pos - csv->doff;
+	    return 0;
+	}
+	if (!csv->dmax || (pos < 0)) {
+	    return EOF;
+	}
+	csv->doff = pos;
+	csv->dlen = csv->dpos = 0;
+	csv->deof = 0;
 	return fseek(csv->f, pos, SEEK_SET);
     }
     return EOF;
@@ -628,229 +1048,409 @@ static long
 csv_tell(csv_file *csv)
 {
     if (csv && csv->f) {
-	return ftell(csv->f);
+	return csv->doff + csv->dpos;
     }
     return EOF;
 }
 
 /**
- * Read and process one line of CSV file handle.
+ * Read more data into read buffer of CSV file handle keeping
+ * the bytes from the current read position on.
  * @param csv CSV file handle
- * @param guess NULL or buffer for guessing file format
- * @result number of columns on success, EOF on error
+ * @result number of bytes read, EOF on error
  */
 
 static int
-csv_getline(csv_file *csv, csv_guess_fmt *guess)
+csv_fill(csv_file *csv)
 {
-    int i, index = 0, inq = 0, c, col;
-    char *p, *sep;
-
-    if (!csv || !csv->f) {
-	return EOF;
-    }
-    while (1) {
-	c = fgetc(csv->f);
-	if (c == EOF) {
-	    if (index > 0) {
-		break;
-	    }
-	    return EOF;
-	}
-	if (c == '\0') {
-	    continue;
-	}
-	if (c == '\r') {
-	    int c2 = fgetc(csv->f);
-	    c = '\n';
-
-	    if (c2 == '\n') {
-		csv->isdos = 1;
-	    } else if (c2 != EOF) {
-		ungetc(c2, csv->f);
-	    }
-	}
-	/* check for DOS EOF (Ctrl-Z) */
-	if (csv->isdos && (c == '\032')) {
-	    int c2 = fgetc(csv->f);
-
-	    if (c2 == EOF) {
-		if (index > 0) {
-		    break;
-		}
-		return EOF;
-	    }
-	    ungetc(c2, csv->f);
-	}
-	if (index >= csv->maxl - 1) {
-	    int n = csv->maxl * 2;
-	    char *line;
+    int n;
 
-	    if (n <= 0) {
-		n = 4096;
-	    }
-	    line = sqlite3_malloc(n);
-	    if (!line) {
-		return EOF;
-	    }
-	    if (csv->line) {
-		memcpy(line, csv->line, index);
-		sqlite3_free(csv->line);
-	    }
-	    csv->maxl = n;
-	    csv->line = line;
-	}
-	csv->line[index++] = c;
-	if (csv->quot && (p = strchr(csv->quot, c))) {
-	    if (inq) {
-		if (*p == inq) {
-		    inq = 0;
-		}
-	    } else {
-		inq = *p;
-	    }
-	}
-	if (!inq && (c == '\n')) {
-	    break;
-	}
-    }
-    if (guess) {
-	for (i = 0; i < index; i++) {
-	    guess->hist[csv->line[i] & 0xFF] += 1;
-	}
-	guess->nlines += 1;
-	csv->ncols = 0;
+    if (!csv->dmax) {
+	csv->deof = 1;
 	return 0;
     }
-
-    for (i = index - 1; i >= 0; i--) {
-	if (csv->line[i] != '\n') {
-	    break;
-	}
+    if (csv->dpos > 0) {
+	csv->dlen -= csv->dpos;
+	memmove(csv->data, csv->data + csv->dpos, csv->dlen);
+	csv->doff += csv->dpos;
+	csv->dpos = 0;
     }
-    index = i + 1;
-    csv->line[index] = '\0';
-    i = inq = col = 0;
-    sep = csv->sep ? csv->sep : ";";
-    if (!csv->cols) {
-	int n = 128;
+    if (csv->dlen >= csv->dmax) {
+	char *data = sqlite3_realloc(csv->data, csv->dmax * 2);
 
-	csv->cols = sqlite3_malloc(sizeof (char *) * n);
-	if (!csv->cols) {
+	if (!data) {
 	    return EOF;
 	}
-	csv->maxc = n;
+	csv->data = data;
+	csv->dmax *= 2;
     }
-    csv->cols[col++] = csv->line;
-    while (i < index) {
-	if (csv->quot && (p = strchr(csv->quot, csv->line[i]))) {
-	    if (inq) {
-		if (*p == inq) {
-		    inq = 0;
-		}
-	    } else {
-		inq = *p;
-	    }
-	}
-	if (!inq && (p = strchr(sep, csv->line[i]))) {
-	    p = csv->line + i;
-	    *p = '\0';
-	    if (col >= csv->maxc) {
-		int n = csv->maxc * 2;
-		char **cols;
-
-		cols = sqlite3_realloc(csv->cols, sizeof (char *) * n);
-		if (!cols) {
-		    return EOF;
-		}
-		csv->cols = cols;
-		csv->maxc = n;
-	    }
-	    csv->cols[col++] = p + 1;
-	}
-	++i;
+    n = fread(csv->data + csv->dlen, 1, csv->dmax - csv->dlen, csv->f);
+    if (n <= 0) {
+	csv->deof = 1;
+	n = 0;
     }
-    csv->ncols = col;
+    csv->dlen += n;
+    return n;
+}
 
-    /* strip off quotes */
-    if (csv->quot) {
-	for (i = 0; i < col; i++) {
-	    if (*csv->cols[i]) {
-		p = strchr(csv->quot, *csv->cols[i]);
-		if (p) {
-		    char *src, *dst;
-
-		    c = *p;
-		    csv->cols[i] += 1;
-		    sep = csv->cols[i] + strlen(csv->cols[i]) - 1;
-		    if ((sep >= csv->cols[i]) && (*sep == c)) {
-			*sep = '\0';
-		    }
-		    /* collapse quote escape sequences */
-		    src = csv->cols[i];
-		    dst = 0;
-		    while (*src) {
-			if ((*src == c) && (src[1] == c)) {
-			    if (!dst) {
-				dst = src;
-			    }
-			    src++;
-			    while (*src) {
-				*dst++ = *src++;
-				if (*src == c) {
-				    --src;
-				    break;
-				}
-			    }
-			}
-			++src;
-		    }
-		    if (dst) {
-			*dst++ = '\0';
-		    }
-		}
+/**
+ * Find next separator, quote, or line end character.
+ * @param csv CSV file handle
+ * @param p start of search
+ * @param end end of search
+ * @result pointer to character found or end
+ */
+
+static char *
+csv_scan(csv_file *csv, char *p, char *end)
+{
+#ifdef CSV_SSE2
+    if ((csv->nspc <= CSV_MAXSPC) && (end - p >= 16)) {
+	__m128i spc[CSV_MAXSPC], b, m;
+	int i, mask;
+
+	for (i = 0; i < csv->nspc; i++) {
+	    spc[i] = _mm_set1_epi8(csv->spc[i]);
+	}
+	do {
+	    b = _mm_loadu_si128((const __m128i *) p);
+	    m = _mm_cmpeq_epi8(b, spc[0]);
+	    for (i = 1; i < csv->nspc; i++) {
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(b, spc[i]));
 	    }
-	}
+	    mask = _mm_movemask_epi8(m);
+	    if (mask) {
+		return p + __builtin_ctz(mask);
+	    }
+	    p += 16;
+	} while (end - p >= 16);
     }
-    return col;
+#endif
+    while ((p < end) && !csv->cclass[*p & 0xFF]) {
+	++p;
+    }
+    return p;
 }
 
 /**
- * Return number of columns of current row in CSV file.
+ * Append column span to current row of CSV file handle.
  * @param csv CSV file handle
- * @result number of columns of current row
+ * @param col column index
+ * @param data start of column
+ * @param len length of column
+ * @result 0 on success, EOF on error
  */
 
 static int
-csv_ncols(csv_file *csv)
+csv_addcol(csv_file *csv, int col, char *data, int len)
 {
-    if (csv && csv->cols) {
-	return csv->ncols;
+    if (col >= csv->maxc) {
+	int n = csv->maxc ? csv->maxc * 2 : 128;
+	char **cols;
+	int *lens;
+
+	cols = sqlite3_realloc(csv->cols, sizeof (char *) * n);
+	if (!cols) {
+	    return EOF;
+	}
+	csv->cols = cols;
+	lens = sqlite3_realloc(csv->lens, sizeof (int) * n);
+	if (!lens) {
+	    return EOF;
+	}
+	csv->lens = lens;
+	csv->maxc = n;
     }
+    csv->cols[col] = data;
+    csv->lens[col] = len;
     return 0;
 }
 
 /**
- * Return nth column of current row in CSV file.
+ * Return line buffer of CSV file handle with given minimum size,
+ * the previous content is discarded.
  * @param csv CSV file handle
- * @param n column number
- * @result string pointer or NULL
+ * @param size minimum size
+ * @result pointer to line buffer or NULL on error
  */
 
 static char *
-csv_coldata(csv_file *csv, int n)
+csv_linebuf(csv_file *csv, long size)
 {
-    if (csv && csv->cols && (n >= 0) && (n < csv->ncols)) {
-	return csv->cols[n];
+    if (size > csv->maxl) {
+	int n = csv->maxl ? csv->maxl : 4096;
+	char *line;
+
+	while (n < size) {
+	    n *= 2;
+	}
+	line = sqlite3_malloc(n);
+	if (!line) {
+	    return 0;
+	}
+	if (csv->line) {
+	    sqlite3_free(csv->line);
+	}
+	csv->line = line;
+	csv->maxl = n;
     }
-    return 0;
+    return csv->line;
 }
 
 /**
- * Guess CSV layout of CSV file handle.
+ * Read and process one line of CSV file handle.
  * @param csv CSV file handle
- * @result 0 on succes, EOF on error
- */
+ * @param guess NULL or buffer for guessing file format
+ * @result number of columns on success, EOF on error
+ *
+ * Columns are left as spans into the mapped region or read
+ * buffer, valid until the next call. Columns containing NUL
+ * or CR characters, and quoted columns with escaped quotes,
+ * are copied to the line buffer for unescaping.
+ */
+
+static int
+csv_getline(csv_file *csv, csv_guess_fmt *guess)
+{
+    int i, k, n, inq, col, dirty, copied;
+    char c, *p, *rec, *end, *next, *fld, *out, *src, *dst;
+
+    if (!csv || !csv->f) {
+	return EOF;
+    }
+rescan:
+    rec = fld = p = csv->data + csv->dpos;
+    end = csv->data + csv->dlen;
+    inq = col = dirty = 0;
+    while (1) {
+	p = csv_scan(csv, p, end);
+	if (p >= end) {
+	    if (!csv->deof) {
+		if (csv_fill(csv) < 0) {
+		    break;
+		}
+		goto rescan;
+	    }
+	    next = p;
+	    while ((p > fld) &&
+		   ((p[-1] == '\n') || (p[-1] == '\r') || (p[-1] == '\0'))) {
+		--p;
+	    }
+	    /* check for DOS EOF (Ctrl-Z) */
+	    if (csv->isdos && (p > fld) && (p[-1] == '\032')) {
+		if (--p == rec) {
+		    next = rec;
+		}
+	    }
+	    if (next == rec) {
+		break;
+	    }
+	    goto done;
+	}
+	c = *p;
+	k = csv->cclass[c & 0xFF];
+	if (k & CSV_QUOT) {
+	    if (inq) {
+		if (c == inq) {
+		    inq = 0;
+		}
+	    } else {
+		inq = c;
+	    }
+	}
+	if ((k & CSV_SEP) && !inq) {
+	    if (csv_addcol(csv, col++, fld, p - fld) != 0) {
+		break;
+	    }
+	    fld = p + 1;
+	} else if ((c == '\n') || (c == '\r')) {
+	    if (!inq) {
+		next = p + 1;
+		if (c == '\r') {
+		    if ((next >= end) && !csv->deof) {
+			if (csv_fill(csv) < 0) {
+			    break;
+			}
+			goto rescan;
+		    }
+		    if ((next < end) && (*next == '\n')) {
+			csv->isdos = 1;
+			++next;
+		    }
+		}
+		goto done;
+	    }
+	    dirty |= (c == '\r');
+	} else if (c == '\0') {
+	    dirty = 1;
+	}
+	++p;
+    }
+    csv->eof = 1;
+    return EOF;
+done:
+    csv->dpos = next - csv->data;
+    if (guess) {
+	for (src = rec; src < p; src++) {
+	    guess->hist[*src & 0xFF] += 1;
+	}
+	guess->nlines += 1;
+	csv->ncols = 0;
+	return 0;
+    }
+    if (csv_addcol(csv, col++, fld, p - fld) != 0) {
+	csv->eof = 1;
+	return EOF;
+    }
+    csv->ncols = col;
+
+    /* unescape columns, copies go to the line buffer */
+    out = 0;
+    for (i = 0; i < col; i++) {
+	src = csv->cols[i];
+	n = csv->lens[i];
+	copied = 0;
+	if (dirty && (memchr(src, '\0', n) || memchr(src, '\r', n))) {
+	    if (!out) {
+		out = csv_linebuf(csv, p - rec + 1);
+		if (!out) {
+		    return EOF;
+		}
+	    }
+	    dst = out;
+	    for (k = 0; k < n; k++) {
+		if (src[k] == '\r') {
+		    *dst++ = '\n';
+		    if ((k + 1 < n) && (src[k + 1] == '\n')) {
+			++k;
+		    }
+		} else if (src[k] != '\0') {
+		    *dst++ = src[k];
+		}
+	    }
+	    src = csv->cols[i] = out;
+	    n = csv->lens[i] = dst - out;
+	    out = dst;
+	    copied = 1;
+	}
+	/* strip off quotes */
+	if (csv->quot && (n > 0) && (csv->cclass[*src & 0xFF] & CSV_QUOT)) {
+	    c = *src++;
+	    --n;
+	    if ((n > 0) && (src[n - 1] == c)) {
+		--n;
+	    }
+	    if (memchr(src, c, n)) {
+		/* collapse quote escape sequences */
+		if (copied) {
+		    /* in place, already in line buffer */
+		    dst = csv->cols[i];
+		} else {
+		    if (!out) {
+			out = csv_linebuf(csv, p - rec + 1);
+			if (!out) {
+			    return EOF;
+			}
+		    }
+		    dst = out;
+		}
+		fld = dst;
+		for (k = 0; k < n; k++) {
+		    *dst++ = src[k];
+		    if ((src[k] == c) && (k + 1 < n) && (src[k + 1] == c)) {
+			++k;
+		    }
+		}
+		src = fld;
+		n = dst - fld;
+		if (!copied) {
+		    out = dst;
+		}
+	    }
+	    csv->cols[i] = src;
+	    csv->lens[i] = n;
+	}
+    }
+    return col;
+}
+
+/**
+ * Return number of columns of current row in CSV file.
+ * @param csv CSV file handle
+ * @result number of columns of current row
+ */
+
+static int
+csv_ncols(csv_file *csv)
+{
+    if (csv && csv->cols) {
+	return csv->ncols;
+    }
+    return 0;
+}
+
+/**
+ * Return nth column of current row in CSV file.
+ * @param csv CSV file handle
+ * @param n column number
+ * @param lenp pointer receiving length of column
+ * @result pointer to column span or NULL
+ */
+
+static char *
+csv_coldata(csv_file *csv, int n, int *lenp)
+{
+    if (csv && csv->cols && (n >= 0) && (n < csv->ncols)) {
+	*lenp = csv->lens[n];
+	return csv->cols[n];
+    }
+    *lenp = 0;
+    return 0;
+}
+
+/**
+ * Copy columns of current row in CSV file to the line buffer
+ * as terminated strings, e.g. for use as column names.
+ * @param csv CSV file handle
+ * @result column vector or NULL on error
+ */
+
+static char **
+csv_colnames(csv_file *csv)
+{
+    int i, n;
+    char *line, *p;
+
+    if (!csv || !csv->cols) {
+	return 0;
+    }
+    for (i = n = 0; i < csv->ncols; i++) {
+	n += csv->lens[i] + 1;
+    }
+    line = sqlite3_malloc(n + 1);
+    if (!line) {
+	return 0;
+    }
+    p = line;
+    for (i = 0; i < csv->ncols; i++) {
+	memcpy(p, csv->cols[i], csv->lens[i]);
+	csv->cols[i] = p;
+	p += csv->lens[i];
+	*p++ = '\0';
+    }
+    if (csv->line) {
+	sqlite3_free(csv->line);
+    }
+    csv->line = line;
+    csv->maxl = n + 1;
+    return csv->cols;
+}
+
+/**
+ * Guess CSV layout of CSV file handle.
+ * @param csv CSV file handle
+ * @result 0 on succes, EOF on error
+ */
 
 static int
 csv_guess(csv_file *csv)
@@ -926,9 +1526,401 @@ csv_guess(csv_file *csv)
 	    return EOF;
 	}
     }
+    csv_chars(csv);
+    return 0;
+}
+
+/**
+ * Free row index.
+ * @param idx row index
+ */
+
+static void
+csv_index_free(csv_index *idx)
+{
+    if (idx) {
+	if (idx->zcols) {
+	    sqlite3_free(idx->zcols);
+	}
+	if (idx->offs) {
+	    sqlite3_free(idx->offs);
+	}
+	if (idx->zmin) {
+	    sqlite3_free(idx->zmin);
+	}
+	if (idx->zmax) {
+	    sqlite3_free(idx->zmax);
+	}
+	sqlite3_free(idx);
+    }
+}
+
+/**
+ * Create empty row index with zone map columns of virtual table.
+ * @param tab CSV virtual table
+ * @result row index or NULL
+ */
+
+static csv_index *
+csv_index_new(csv_vtab *tab)
+{
+    csv_index *idx = sqlite3_malloc(sizeof (csv_index));
+    int i;
+
+    if (!idx) {
+	return 0;
+    }
+    memset(idx, 0, sizeof (*idx));
+    idx->zcols = sqlite3_malloc(sizeof (int) * (tab->ncols + 1));
+    if (!idx->zcols) {
+	sqlite3_free(idx);
+	return 0;
+    }
+    for (i = 0; i < tab->ncols; i++) {
+	if ((tab->coltypes[i] == SQLITE_INTEGER) ||
+	    (tab->coltypes[i] == SQLITE_FLOAT)) {
+	    idx->zcols[idx->nzcols++] = i;
+	}
+    }
+    return idx;
+}
+
+/**
+ * Make room for blocks in row index.
+ * @param idx row index
+ * @param nblks number of blocks
+ * @result SQLite error code
+ */
+
+static int
+csv_index_grow(csv_index *idx, int nblks)
+{
+    int n = idx->maxblks;
+    sqlite_int64 *offs;
+    double *z;
+
+    if (nblks <= n) {
+	return SQLITE_OK;
+    }
+    while (n < nblks) {
+	n = n ? n * 2 : 64;
+    }
+    offs = sqlite3_realloc(idx->offs, sizeof (sqlite_int64) * n);
+    if (!offs) {
+	return SQLITE_NOMEM;
+    }
+    idx->offs = offs;
+    if (idx->nzcols) {
+	z = sqlite3_realloc(idx->zmin, sizeof (double) * n * idx->nzcols);
+	if (!z) {
+	    return SQLITE_NOMEM;
+	}
+	idx->zmin = z;
+	z = sqlite3_realloc(idx->zmax, sizeof (double) * n * idx->nzcols);
+	if (!z) {
+	    return SQLITE_NOMEM;
+	}
+	idx->zmax = z;
+    }
+    idx->maxblks = n;
+    return SQLITE_OK;
+}
+
+/**
+ * Build row index of virtual table by reading the entire CSV file.
+ * Column values are converted like in csv_vtab_column(), text
+ * in a numeric column disables skipping of its block since SQLite
+ * may convert it when comparing, NULLs are ignored.
+ * @param tab CSV virtual table
+ * @result row index or NULL
+ */
+
+static csv_index *
+csv_index_build(csv_vtab *tab)
+{
+    csv_file *csv = tab->csv;
+    csv_index *idx;
+    csv_batch batch;
+    csv_cell *cell;
+    csv_blk *blk;
+    int i, k, len;
+    double val, *zmin = 0, *zmax = 0;
+    char *data;
+    long pos;
+
+    idx = csv_index_new(tab);
+    if (!idx) {
+	return 0;
+    }
+    memset(&batch, 0, sizeof (batch));
+    batch.ncols = tab->ncols;
+    batch.row = sqlite3_malloc(sizeof (csv_cell) * (tab->ncols + 1));
+    if (!batch.row) {
+	goto error;
+    }
+    csv_rewind(csv);
+    while (1) {
+	pos = csv_tell(csv);
+	if (csv_getline(csv, 0) == EOF) {
+	    break;
+	}
+	if ((idx->nrows % CSV_IDXROWS) == 0) {
+	    if (csv_index_grow(idx, idx->nblks + 1) != SQLITE_OK) {
+		goto error;
+	    }
+	    idx->offs[idx->nblks] = pos;
+	    zmin = idx->zmin + idx->nblks * idx->nzcols;
+	    zmax = idx->zmax + idx->nblks * idx->nzcols;
+	    for (k = 0; k < idx->nzcols; k++) {
+		zmin[k] = HUGE_VAL;
+		zmax[k] = -HUGE_VAL;
+	    }
+	    idx->nblks++;
+	}
+	for (k = 0; k < idx->nzcols; k++) {
+	    i = idx->zcols[k];
+	    data = csv_coldata(csv, i, &len);
+	    cell = batch.row + i;
+	    if (process_col(0, 0, &batch, i + 1, data, len, tab->coltypes[i],
+			    tab->convert) != SQLITE_OK) {
+		goto error;
+	    }
+	    switch (cell->type) {
+	    case SQLITE_INTEGER:
+		val = (double) cell->v.i;
+		break;
+	    case SQLITE_FLOAT:
+		val = cell->v.d;
+		if (val != val) {
+		    /* NaN is NULL in SQLite */
+		    continue;
+		}
+		break;
+	    case SQLITE_TEXT:
+		/* may still compare as number due to column affinity */
+		zmin[k] = -HUGE_VAL;
+		zmax[k] = HUGE_VAL;
+		continue;
+	    default:
+		continue;
+	    }
+	    if (val < zmin[k]) {
+		zmin[k] = val;
+	    }
+	    if (val > zmax[k]) {
+		zmax[k] = val;
+	    }
+	}
+	while ((blk = batch.blks)) {
+	    batch.blks = blk->next;
+	    sqlite3_free(blk);
+	}
+	if (batch.rc != SQLITE_OK) {
+	    goto error;
+	}
+	idx->nrows++;
+    }
+    sqlite3_free(batch.row);
+    return idx;
+error:
+    while ((blk = batch.blks)) {
+	batch.blks = blk->next;
+	sqlite3_free(blk);
+    }
+    if (batch.row) {
+	sqlite3_free(batch.row);
+    }
+    csv_index_free(idx);
+    return 0;
+}
+
+/**
+ * Fill in header of row index file for virtual table.
+ * @param tab CSV virtual table
+ * @param hdr header to be filled in
+ * @result 0 on success, EOF on error
+ */
+
+static int
+csv_index_hdr(csv_vtab *tab, csv_idxhdr *hdr)
+{
+    csv_file *csv = tab->csv;
+    unsigned int key = 2166136261U;
+    char *p;
+    int i;
+#ifdef _WIN32
+    struct _stati64 st;
+
+    if (_fstati64(_fileno(csv->f), &st)) {
+	return EOF;
+    }
+#else
+    struct stat st;
+
+    if (fstat(fileno(csv->f), &st) || !S_ISREG(st.st_mode)) {
+	return EOF;
+    }
+#endif
+    memset(hdr, 0, sizeof (*hdr));
+    strcpy(hdr->magic, CSV_IDXMAGIC);
+    hdr->size = st.st_size;
+    hdr->mtime = st.st_mtime;
+    hdr->pos0 = csv->pos0;
+    hdr->blkrows = CSV_IDXROWS;
+    /* FNV-1a over layout, convert flags, and column types */
+    for (p = csv->sep ? csv->sep : ""; *p; p++) {
+	key = (key ^ (*p & 0xFF)) * 16777619U;
+    }
+    key = (key ^ 0x100) * 16777619U;
+    for (p = csv->quot ? csv->quot : ""; *p; p++) {
+	key = (key ^ (*p & 0xFF)) * 16777619U;
+    }
+    key = (key ^ 0x100) * 16777619U;
+    key = (key ^ (csv->isdos ? 1 : 0)) * 16777619U;
+    key = (key ^ (tab->convert & 0xFF)) * 16777619U;
+    for (i = 0; i < tab->ncols; i++) {
+	key = (key ^ (tab->coltypes[i] & 0xFF)) * 16777619U;
+    }
+    hdr->key = key;
+    return 0;
+}
+
+/**
+ * Read row index of virtual table from index file, if it
+ * matches size and modification time of the CSV file.
+ * @param tab CSV virtual table
+ * @result row index or NULL
+ */
+
+static csv_index *
+csv_index_read(csv_vtab *tab)
+{
+    csv_idxhdr want, hdr;
+    csv_index *idx = 0;
+    FILE *f;
+    int i, *zcols = 0;
+    size_t n;
+
+    if (csv_index_hdr(tab, &want) != 0) {
+	return 0;
+    }
+    f = fopen(tab->idxname, "rb");
+    if (!f) {
+	return 0;
+    }
+    if ((fread(&hdr, sizeof (hdr), 1, f) != 1) ||
+	(memcmp(hdr.magic, want.magic, sizeof (hdr.magic)) != 0) ||
+	(hdr.size != want.size) || (hdr.mtime != want.mtime) ||
+	(hdr.pos0 != want.pos0) || (hdr.blkrows != want.blkrows) ||
+	(hdr.key != want.key) || (hdr.nblks < 0) || (hdr.nrows < 0) ||
+	(hdr.nblks != (hdr.nrows + CSV_IDXROWS - 1) / CSV_IDXROWS)) {
+	goto error;
+    }
+    idx = csv_index_new(tab);
+    if (!idx || (hdr.nzcols != idx->nzcols) ||
+	(csv_index_grow(idx, hdr.nblks) != SQLITE_OK)) {
+	goto error;
+    }
+    idx->nrows = hdr.nrows;
+    idx->nblks = hdr.nblks;
+    n = (size_t) hdr.nblks * idx->nzcols;
+    zcols = sqlite3_malloc(sizeof (int) * (idx->nzcols + 1));
+    if (!zcols ||
+	(fread(idx->offs, sizeof (sqlite_int64), hdr.nblks, f) !=
+	 (size_t) hdr.nblks) ||
+	(fread(zcols, sizeof (int), idx->nzcols, f) !=
+	 (size_t) idx->nzcols) ||
+	(n && (fread(idx->zmin, sizeof (double), n, f) != n)) ||
+	(n && (fread(idx->zmax, sizeof (double), n, f) != n))) {
+	goto error;
+    }
+    for (i = 0; i < idx->nzcols; i++) {
+	if (zcols[i] != idx->zcols[i]) {
+	    goto error;
+	}
+    }
+    for (i = 0; i < idx->nblks; i++) {
+	if ((idx->offs[i] < hdr.pos0) || (idx->offs[i] >= hdr.size)) {
+	    goto error;
+	}
+    }
+    sqlite3_free(zcols);
+    fclose(f);
+    return idx;
+error:
+    if (zcols) {
+	sqlite3_free(zcols);
+    }
+    csv_index_free(idx);
+    fclose(f);
     return 0;
 }
 
+/**
+ * Write row index of virtual table to index file.
+ * Errors are ignored, the index file is an optimization only.
+ * @param tab CSV virtual table
+ * @param idx row index
+ */
+
+static void
+csv_index_write(csv_vtab *tab, csv_index *idx)
+{
+    csv_idxhdr hdr;
+    FILE *f;
+    size_t n = (size_t) idx->nblks * idx->nzcols;
+    int ok;
+
+    if (csv_index_hdr(tab, &hdr) != 0) {
+	return;
+    }
+    hdr.nrows = idx->nrows;
+    hdr.nblks = idx->nblks;
+    hdr.nzcols = idx->nzcols;
+    f = fopen(tab->idxname, "wb");
+    if (!f) {
+	return;
+    }
+    ok = (fwrite(&hdr, sizeof (hdr), 1, f) == 1) &&
+	(fwrite(idx->offs, sizeof (sqlite_int64), idx->nblks, f) ==
+	 (size_t) idx->nblks) &&
+	(fwrite(idx->zcols, sizeof (int), idx->nzcols, f) ==
+	 (size_t) idx->nzcols) &&
+	(!n || (fwrite(idx->zmin, sizeof (double), n, f) == n)) &&
+	(!n || (fwrite(idx->zmax, sizeof (double), n, f) == n));
+    if (fclose(f) || !ok) {
+	remove(tab->idxname);
+    }
+}
+
+/**
+ * Return row index of virtual table, reading it from the
+ * index file or building it on first use.
+ * @param tab CSV virtual table
+ * @result row index or NULL
+ */
+
+static csv_index *
+csv_index_get(csv_vtab *tab)
+{
+    if (tab->csv->dmax && (ftell(tab->csv->f) < 0)) {
+	/* not seekable */
+	return 0;
+    }
+    if (!tab->index) {
+	if (tab->idxname) {
+	    tab->index = csv_index_read(tab);
+	}
+	if (!tab->index) {
+	    tab->index = csv_index_build(tab);
+	    if (tab->index && tab->idxname) {
+		csv_index_write(tab, tab->index);
+	    }
+	}
+    }
+    return tab->index;
+}
+
 /**
  * Connect to virtual table
  * @param db SQLite database pointer
@@ -960,6 +1952,7 @@ csv_guess(csv_file *csv)
  * 2  - perform backslash substitution<br>
  * 4  - convert and collapse white-space in column names to underscore<br>
  * 10 - convert \q to single quote, in addition to backslash substitution<br>
+ * 16 - keep row index in file named like the CSV file plus ".idx"<br>
  */
 
 static int
@@ -1015,10 +2008,15 @@ cleanup:
 	    *errp = sqlite3_mprintf("unable to get column names");
 	    goto cleanup;
 	}
-	csv->pos0 = csv_tell(csv);
+	cnames = csv_colnames(csv);
+	if (!cnames) {
+	    csv_close(csv);
+	    *errp = sqlite3_mprintf("out of memory");
+	    goto cleanup;
+	}
+	csv->pos0 = csv_tell(csv);
 	csv_rewind(csv);
 	ncnames = csv_ncols(csv);
-	cnames = csv->cols;
     } else if (argc > 8) {
 	ncnames = argc - 8;
 	cnames = (char **) nargv + 8;
@@ -1055,7 +2053,21 @@ cleanup:
 	    conv_names(cnames, ncnames);
 	}
     }
+    if (vtab->convert & 16) {
+	vtab->convert &= ~16;
+	vtab->idxname = sqlite3_mprintf("%s.idx", nargv[3]);
+    }
+    vtab->fname = sqlite3_mprintf("%s", nargv[3]);
+    if (!vtab->fname) {
+	csv_close(csv);
+	if (vtab->idxname) {
+	    sqlite3_free(vtab->idxname);
+	}
+	*errp = sqlite3_mprintf("out of memory");
+	goto cleanup;
+    }
     vtab->csv = csv;
+    vtab->ncols = ncnames;
     append(&schema, "CREATE TABLE x(", 0);
     for (i = 0; cnames && (i < ncnames); i++) {
 	if (!cnames[i] || (cnames[i][0] == '\0')) {
@@ -1121,6 +2133,10 @@ cleanup:
     rc = sqlite3_declare_vtab(db, schema);
     if (rc != SQLITE_OK) {
 	csv_close(csv);
+	if (vtab->idxname) {
+	    sqlite3_free(vtab->idxname);
+	}
+	sqlite3_free(vtab->fname);
 	*errp = sqlite3_mprintf("table definition failed, error %d, "
 				"schema '%s'", rc, schema);
 	goto cleanup;
@@ -1162,6 +2178,11 @@ csv_vtab_disconnect(sqlite3_vtab *vtab)
     csv_vtab *tab = (csv_vtab *) vtab;
 
     csv_close(tab->csv);
+    csv_index_free(tab->index);
+    if (tab->idxname) {
+	sqlite3_free(tab->idxname);
+    }
+    sqlite3_free(tab->fname);
     sqlite3_free(tab);
     return SQLITE_OK;
 }
@@ -1180,6 +2201,11 @@ csv_vtab_destroy(sqlite3_vtab *vtab)
 
 /**
  * Determines information for filter function according to constraints.
+ * Constraints on the rowid (the row number) are handled completely,
+ * range constraints on numeric columns are used to skip blocks of
+ * rows by zone maps of the row index and are checked again by SQLite,
+ * OFFSET is handled when no other constraints need checking.
+ * The used constraints are passed as "op:column," list in idxStr.
  * @param vtab virtual table
  * @param info index/constraint iinformation
  * @result SQLite error code
@@ -1188,6 +2214,104 @@ csv_vtab_destroy(sqlite3_vtab *vtab)
 static int
 csv_vtab_bestindex(sqlite3_vtab *vtab, sqlite3_index_info *info)
 {
+    csv_vtab *tab = (csv_vtab *) vtab;
+    struct sqlite3_index_constraint *cons;
+    double rows = tab->index ? (double) tab->index->nrows : 1000000.0;
+    int i, nargs = 0, nrowid = 0, nzone = 0, nother = 0, eq = 0;
+    int ioffs = -1, ilimit = -1;
+    char *str, *p;
+
+    str = sqlite3_malloc(info->nConstraint * 32 + 1);
+    if (!str) {
+	return SQLITE_NOMEM;
+    }
+    p = str;
+    *p = '\0';
+    for (i = 0; i < info->nConstraint; i++) {
+	cons = &info->aConstraint[i];
+	if (!cons->usable) {
+	    nother++;
+	    continue;
+	}
+#ifdef SQLITE_INDEX_CONSTRAINT_OFFSET
+	if (cons->op == SQLITE_INDEX_CONSTRAINT_OFFSET) {
+	    ioffs = i;
+	    continue;
+	}
+	if (cons->op == SQLITE_INDEX_CONSTRAINT_LIMIT) {
+	    ilimit = i;
+	    continue;
+	}
+#endif
+	switch (cons->op) {
+	case SQLITE_INDEX_CONSTRAINT_EQ:
+	case SQLITE_INDEX_CONSTRAINT_GT:
+	case SQLITE_INDEX_CONSTRAINT_LE:
+	case SQLITE_INDEX_CONSTRAINT_LT:
+	case SQLITE_INDEX_CONSTRAINT_GE:
+	    break;
+	default:
+	    nother++;
+	    continue;
+	}
+	if (cons->iColumn < 0) {
+	    nrowid++;
+	    if (cons->op == SQLITE_INDEX_CONSTRAINT_EQ) {
+		eq = 1;
+	    }
+	    info->aConstraintUsage[i].omit = 1;
+	} else if ((cons->iColumn < tab->ncols) &&
+		   ((tab->coltypes[cons->iColumn] == SQLITE_INTEGER) ||
+		    (tab->coltypes[cons->iColumn] == SQLITE_FLOAT))) {
+	    nzone++;
+	} else {
+	    nother++;
+	    continue;
+	}
+	info->aConstraintUsage[i].argvIndex = ++nargs;
+	p += sprintf(p, "%d:%d,", cons->op, cons->iColumn);
+    }
+#ifdef SQLITE_INDEX_CONSTRAINT_OFFSET
+    if ((ioffs >= 0) && !nzone && !nother) {
+	/* SQLite wants all other constraints used along with OFFSET */
+	info->aConstraintUsage[ioffs].argvIndex = ++nargs;
+	info->aConstraintUsage[ioffs].omit = 1;
+	p += sprintf(p, "%d:-1,", SQLITE_INDEX_CONSTRAINT_OFFSET);
+	if (ilimit >= 0) {
+	    info->aConstraintUsage[ilimit].argvIndex = ++nargs;
+	    p += sprintf(p, "%d:-1,", SQLITE_INDEX_CONSTRAINT_LIMIT);
+	}
+    }
+#endif
+    if (eq) {
+	rows = 1;
+#if (SQLITE_VERSION_NUMBER >= 3009000)
+	info->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+#endif
+    } else {
+	if (nrowid) {
+	    rows /= 4;
+	}
+	if (nzone) {
+	    rows /= 2;
+	}
+    }
+    info->estimatedCost = rows;
+#if (SQLITE_VERSION_NUMBER >= 3008002)
+    info->estimatedRows = (sqlite3_int64) rows;
+#endif
+    if ((info->nOrderBy == 1) && (info->aOrderBy[0].iColumn < 0) &&
+	!info->aOrderBy[0].desc) {
+	/* rows are delivered in rowid order */
+	info->orderByConsumed = 1;
+    }
+    if (nargs) {
+	info->idxNum = 1;
+	info->idxStr = str;
+	info->needToFreeIdxStr = 1;
+    } else {
+	sqlite3_free(str);
+    }
     return SQLITE_OK;
 }
 
@@ -1203,167 +2327,1028 @@ csv_vtab_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursorp)
 {
     csv_cursor *cur = sqlite3_malloc(sizeof (*cur));
     csv_vtab *tab = (csv_vtab *) vtab;
+    csv_file *csv = tab->csv;
 
     if (!cur) {
 	return SQLITE_ERROR;
     }
+    memset(cur, 0, sizeof (*cur));
     cur->cursor.pVtab = vtab;
-    csv_rewind(tab->csv);
-    cur->pos = csv_tell(tab->csv);
+    /* own read position per cursor for self-joins and subqueries */
+    if (!csv->dmax) {
+	cur->csv = csv_dup(csv);
+    } else if (ftell(csv->f) >= 0) {
+	cur->csv = csv_open(tab->fname, csv->sep, csv->quot);
+	if (cur->csv) {
+	    cur->csv->isdos = csv->isdos;
+	    cur->csv->pos0 = csv->pos0;
+	}
+    } else {
+	/* pipe, can be read only once anyway */
+	cur->csv = csv;
+    }
+    if (!cur->csv) {
+	sqlite3_free(cur);
+	return SQLITE_NOMEM;
+    }
+    csv_rewind(cur->csv);
+    cur->pos = csv_tell(cur->csv);
+    cur->maxrow = CSV_MAXROWID;
     *cursorp = &cur->cursor;
     return SQLITE_OK;
 }
 
 /**
- * Close virtual table cursor.
- * @param cursor cursor pointer
- * @result SQLite error code
+ * Close virtual table cursor.
+ * @param cursor cursor pointer
+ * @result SQLite error code
+ */
+
+static int
+csv_vtab_close(sqlite3_vtab_cursor *cursor)
+{
+    csv_cursor *cur = (csv_cursor *) cursor;
+    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+
+    if (cur->csv != tab->csv) {
+	csv_close(cur->csv);
+    }
+    if (cur->zones) {
+	sqlite3_free(cur->zones);
+    }
+    sqlite3_free(cursor);
+    return SQLITE_OK;
+}
+
+/**
+ * Test if block of rows can be skipped by zone constraints.
+ * @param cur virtual table cursor
+ * @param idx row index
+ * @param blk block number
+ * @result true when no row of block can satisfy the constraints
+ */
+
+static int
+csv_zone_skip(csv_cursor *cur, csv_index *idx, sqlite_int64 blk)
+{
+    int i;
+    double min, max;
+    csv_zone *zone;
+
+    for (i = 0; i < cur->nzones; i++) {
+	zone = &cur->zones[i];
+	min = idx->zmin[blk * idx->nzcols + zone->zcol];
+	max = idx->zmax[blk * idx->nzcols + zone->zcol];
+	/* conservative on equality for precision of large integers */
+	switch (zone->op) {
+	case SQLITE_INDEX_CONSTRAINT_EQ:
+	    if ((zone->val < min) || (zone->val > max)) {
+		return 1;
+	    }
+	    break;
+	case SQLITE_INDEX_CONSTRAINT_GT:
+	case SQLITE_INDEX_CONSTRAINT_GE:
+	    if (max < zone->val) {
+		return 1;
+	    }
+	    break;
+	case SQLITE_INDEX_CONSTRAINT_LT:
+	case SQLITE_INDEX_CONSTRAINT_LE:
+	    if (min > zone->val) {
+		return 1;
+	    }
+	    break;
+	}
+    }
+    return 0;
+}
+
+/**
+ * Retrieve next row from virtual table cursor
+ * @param cursor virtual table cursor
+ * @result SQLite error code
+ */
+
+static int
+csv_vtab_next(sqlite3_vtab_cursor *cursor)
+{
+    csv_cursor *cur = (csv_cursor *) cursor;
+    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+    csv_index *idx = tab->index;
+
+    if (cur->rowid >= cur->maxrow) {
+	cur->eof = 1;
+	return SQLITE_OK;
+    }
+    if (cur->nzones && idx && ((cur->rowid % CSV_IDXROWS) == 0)) {
+	sqlite_int64 blk = cur->rowid / CSV_IDXROWS, blk0 = blk;
+
+	while ((blk < idx->nblks) && csv_zone_skip(cur, idx, blk)) {
+	    blk++;
+	}
+	if (blk >= idx->nblks) {
+	    cur->eof = 1;
+	    return SQLITE_OK;
+	}
+	if (blk != blk0) {
+	    cur->rowid = blk * CSV_IDXROWS;
+	    if ((cur->rowid >= cur->maxrow) ||
+		(csv_seek(cur->csv, (long) idx->offs[blk]) != 0)) {
+		cur->eof = 1;
+		return SQLITE_OK;
+	    }
+	}
+    }
+    cur->pos = csv_tell(cur->csv);
+    if (csv_getline(cur->csv, 0) != EOF) {
+	cur->rowid++;
+    }
+    return SQLITE_OK;
+}
+
+/**
+ * Filter function for virtual table.
+ * @param cursor virtual table cursor
+ * @param idxNum 0 for full scan, 1 when idxStr lists constraints
+ * @param idxStr constraints as "op:column," list, see csv_vtab_bestindex()
+ * @param argc number arguments
+ * @param argv constraint values
+ * @result SQLite error code
+ */
+
+static int
+csv_vtab_filter(sqlite3_vtab_cursor *cursor, int idxNum,
+		const char *idxStr, int argc, sqlite3_value **argv)
+{
+    csv_cursor *cur = (csv_cursor *) cursor;
+    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+    csv_index *idx = 0;
+    sqlite_int64 lo = 1, hi = CSV_MAXROWID, offs = 0, val, start;
+    int i, k, op, col, type;
+    char *p = (char *) idxStr;
+    double d;
+
+    cur->eof = 0;
+    cur->nzones = 0;
+    cur->rowid = 0;
+    if (idxNum && (argc > 0)) {
+	csv_zone *zones = sqlite3_realloc(cur->zones,
+					  sizeof (csv_zone) * argc);
+
+	if (!zones) {
+	    return SQLITE_NOMEM;
+	}
+	cur->zones = zones;
+    }
+    for (i = 0; idxNum && p && *p && (i < argc); i++) {
+	op = strtol(p, &p, 10);
+	col = strtol(p + 1, &p, 10);
+	p++;
+	type = sqlite3_value_numeric_type(argv[i]);
+#ifdef SQLITE_INDEX_CONSTRAINT_OFFSET
+	if (op == SQLITE_INDEX_CONSTRAINT_LIMIT) {
+	    continue;
+	}
+	if (op == SQLITE_INDEX_CONSTRAINT_OFFSET) {
+	    if (type == SQLITE_INTEGER) {
+		offs = sqlite3_value_int64(argv[i]);
+	    }
+	    continue;
+	}
+#endif
+	if (type == SQLITE_NULL) {
+	    /* comparison with NULL is never true */
+	    goto empty;
+	}
+	if (col >= 0) {
+	    if ((type == SQLITE_INTEGER) || (type == SQLITE_FLOAT)) {
+		cur->zones[cur->nzones].zcol = col;
+		cur->zones[cur->nzones].op = op;
+		cur->zones[cur->nzones].val = sqlite3_value_double(argv[i]);
+		cur->nzones++;
+	    }
+	    continue;
+	}
+	if ((type != SQLITE_INTEGER) && (type != SQLITE_FLOAT)) {
+	    /* text and blobs sort after all numbers */
+	    if ((op == SQLITE_INDEX_CONSTRAINT_LT) ||
+		(op == SQLITE_INDEX_CONSTRAINT_LE)) {
+		continue;
+	    }
+	    goto empty;
+	}
+	if (type == SQLITE_INTEGER) {
+	    val = sqlite3_value_int64(argv[i]);
+	    if (val < 0) {
+		val = -1;
+	    } else if ((val == CSV_MAXROWID) &&
+		       (op == SQLITE_INDEX_CONSTRAINT_GT)) {
+		goto empty;
+	    }
+	} else {
+	    /* round to integer rowid range depending on operator */
+	    d = sqlite3_value_double(argv[i]);
+	    if (d < 0) {
+		d = -1;
+	    } else if (d > 1e18) {
+		d = 1e18;
+	    }
+	    if ((op == SQLITE_INDEX_CONSTRAINT_EQ) && (floor(d) != d)) {
+		goto empty;
+	    }
+	    if ((op == SQLITE_INDEX_CONSTRAINT_GE) ||
+		(op == SQLITE_INDEX_CONSTRAINT_LT)) {
+		d = ceil(d);
+	    } else {
+		d = floor(d);
+	    }
+	    val = (sqlite_int64) d;
+	}
+	switch (op) {
+	case SQLITE_INDEX_CONSTRAINT_EQ:
+	    if (val > lo) {
+		lo = val;
+	    }
+	    if (val < hi) {
+		hi = val;
+	    }
+	    break;
+	case SQLITE_INDEX_CONSTRAINT_GT:
+	    if (val + 1 > lo) {
+		lo = val + 1;
+	    }
+	    break;
+	case SQLITE_INDEX_CONSTRAINT_GE:
+	    if (val > lo) {
+		lo = val;
+	    }
+	    break;
+	case SQLITE_INDEX_CONSTRAINT_LT:
+	    if (val - 1 < hi) {
+		hi = val - 1;
+	    }
+	    break;
+	case SQLITE_INDEX_CONSTRAINT_LE:
+	    if (val < hi) {
+		hi = val;
+	    }
+	    break;
+	}
+    }
+    if ((lo > hi) || (offs > hi - lo)) {
+	goto empty;
+    }
+    start = lo - 1 + ((offs > 0) ? offs : 0);
+    cur->maxrow = hi;
+    if ((start >= CSV_IDXROWS) || cur->nzones) {
+	idx = csv_index_get(tab);
+    }
+    /* map columns of zone constraints to zone map columns */
+    for (i = k = 0; idx && (i < cur->nzones); i++) {
+	for (col = 0; col < idx->nzcols; col++) {
+	    if (idx->zcols[col] == cur->zones[i].zcol) {
+		cur->zones[k] = cur->zones[i];
+		cur->zones[k++].zcol = col;
+		break;
+	    }
+	}
+    }
+    cur->nzones = k;
+    if (idx && (start >= CSV_IDXROWS)) {
+	sqlite_int64 blk = start / CSV_IDXROWS;
+
+	if (blk >= idx->nblks) {
+	    goto empty;
+	}
+	if (csv_seek(cur->csv, (long) idx->offs[blk]) == 0) {
+	    cur->rowid = blk * CSV_IDXROWS;
+	} else {
+	    csv_rewind(cur->csv);
+	}
+    } else {
+	csv_rewind(cur->csv);
+    }
+    while (cur->rowid < start) {
+	if (csv_getline(cur->csv, 0) == EOF) {
+	    goto empty;
+	}
+	cur->rowid++;
+    }
+    return csv_vtab_next(cursor);
+empty:
+    cur->eof = 1;
+    return SQLITE_OK;
+}
+
+/**
+ * Return end of table state of virtual table cursor
+ * @param cursor virtual table cursor
+ * @result true/false
+ */
+
+static int
+csv_vtab_eof(sqlite3_vtab_cursor *cursor)
+{
+    csv_cursor *cur = (csv_cursor *) cursor;
+
+    return cur->eof || csv_eof(cur->csv);
+}
+
+/**
+ * Return column data of virtual table.
+ * @param cursor virtual table cursor
+ * @param ctx SQLite function context
+ * @param n column index
+ * @result SQLite error code
+ */
+
+static int
+csv_vtab_column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int n)
+{
+    csv_cursor *cur = (csv_cursor *) cursor;
+    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+    int len;
+    char *data = csv_coldata(cur->csv, n, &len);
+
+    return process_col(ctx, 0, 0, 0, data, len, tab->coltypes[n],
+		       tab->convert);
+}
+
+/**
+ * Return current rowid of virtual table cursor
+ * @param cursor virtual table cursor
+ * @param rowidp value buffer to receive current rowid
+ * @result SQLite error code
+ */
+
+static int
+csv_vtab_rowid(sqlite3_vtab_cursor *cursor, sqlite_int64 *rowidp)
+{
+    csv_cursor *cur = (csv_cursor *) cursor;
+
+    *rowidp = cur->rowid;
+    return SQLITE_OK;
+}
+
+#if (SQLITE_VERSION_NUMBER > 3004000)
+
+/**
+ * Rename virtual table.
+ * @param newname new name for table
+ * @result SQLite error code
+ */
+
+static int
+csv_vtab_rename(sqlite3_vtab *vtab, const char *newname)
+{
+    return SQLITE_OK;
+}
+
+#endif
+
+/**
+ * SQLite module descriptor.
+ */
+
+static const sqlite3_module csv_vtab_mod = {
+    1,                   /* iVersion */
+    csv_vtab_create,     /* xCreate */
+    csv_vtab_connect,    /* xConnect */
+    csv_vtab_bestindex,  /* xBestIndex */
+    csv_vtab_disconnect, /* xDisconnect */
+    csv_vtab_destroy,    /* xDestroy */
+    csv_vtab_open,       /* xOpen */
+    csv_vtab_close,      /* xClose */
+    csv_vtab_filter,     /* xFilter */
+    csv_vtab_next,       /* xNext */
+    csv_vtab_eof,        /* xEof */
+    csv_vtab_column,     /* xColumn */
+    csv_vtab_rowid,      /* xRowid */
+    0,                   /* xUpdate */
+    0,                   /* xBegin */
+    0,                   /* xSync */
+    0,                   /* xCommit */
+    0,                   /* xRollback */
+    0,                   /* xFindFunction */
+#if (SQLITE_VERSION_NUMBER > 3004000)
+    csv_vtab_rename,     /* xRename */
+#endif
+};
+
+/**
+ * @typedef csv_import
+ * @struct csv_import
+ * State of CSV import, the thread related members are used by
+ * the parallel import, where worker threads convert chunks of
+ * the CSV file into batches and the calling thread inserts
+ * the batches in file order.
+ */
+
+typedef struct csv_import {
+    sqlite3 *db;		/**< SQLite database */
+    sqlite3_stmt *stmt;		/**< INSERT statement */
+    char *coltypes;		/**< column types */
+    int ncols;			/**< number of columns */
+    int convert;		/**< convert flags */
+    int intx;			/**< true, when own transaction is open */
+    int nrows;			/**< number of rows inserted */
+    int txrows;			/**< number of rows in current transaction */
+#ifdef CSV_THREADS
+    csv_file *csv;		/**< CSV file handle for splitting */
+    long next;			/**< file position of next chunk */
+    int seq;			/**< sequence number of next chunk */
+    int wseq;			/**< sequence number of next batch to write */
+    int maxbatch;		/**< max. number of batches in flight */
+    int nrun;			/**< number of running workers */
+    int eof;			/**< true, when file completely split */
+    int stop;			/**< true, when workers shall stop */
+    csv_batch *done;		/**< converted batches */
+#ifdef _WIN32
+    CRITICAL_SECTION mutex;	/**< lock for members above */
+    CONDITION_VARIABLE cond;	/**< signalled on state change */
+#else
+    pthread_mutex_t mutex;	/**< lock for members above */
+    pthread_cond_t cond;	/**< signalled on state change */
+#endif
+#endif
+} csv_import;
+
+/**
+ * Commit import transaction after CSV_TXROWS rows or at end
+ * and start a new one.
+ * @param imp import state
+ * @param final true, when import is finished
+ * @result SQLite error code
+ */
+
+static int
+csv_import_tx(csv_import *imp, int final)
+{
+    int rc;
+
+    if (!imp->intx) {
+	return SQLITE_OK;
+    }
+    if (!final && (++imp->txrows < CSV_TXROWS)) {
+	return SQLITE_OK;
+    }
+    imp->txrows = 0;
+    rc = sqlite3_exec(imp->db, "COMMIT", 0, 0, 0);
+    if ((rc != SQLITE_OK) || final) {
+	imp->intx = 0;
+	return rc;
+    }
+    if (sqlite3_exec(imp->db, "BEGIN", 0, 0, 0) != SQLITE_OK) {
+	imp->intx = 0;
+    }
+    return SQLITE_OK;
+}
+
+/**
+ * Drop non-unique indexes of table to be imported.
+ * @param db SQLite database
+ * @param tname table name
+ * @param sqlp pointer receiving SQL to recreate the indexes
+ * @result SQLite error code
+ */
+
+static int
+csv_drop_indexes(sqlite3 *db, char *tname, char **sqlp)
+{
+    sqlite3_stmt *stmt = 0;
+    char *drop = 0;
+    int rc;
+
+    rc = sqlite3_prepare_v2(db,
+			    "SELECT name, sql FROM sqlite_master "
+			    "WHERE type = 'index' AND sql IS NOT NULL "
+			    "AND tbl_name = ?1 COLLATE NOCASE "
+			    "AND sql NOT LIKE 'CREATE UNIQUE%' "
+			    "UNION ALL SELECT name, sql FROM sqlite_temp_master "
+			    "WHERE type = 'index' AND sql IS NOT NULL "
+			    "AND tbl_name = ?1 COLLATE NOCASE "
+			    "AND sql NOT LIKE 'CREATE UNIQUE%'", -1, &stmt, 0);
+    if (rc != SQLITE_OK) {
+	return rc;
+    }
+    sqlite3_bind_text(stmt, 1, tname, -1, SQLITE_STATIC);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+	append(&drop, "DROP INDEX ", 0);
+	append(&drop, (char *) sqlite3_column_text(stmt, 0), '"');
+	append(&drop, ";", 0);
+	append(sqlp, (char *) sqlite3_column_text(stmt, 1), 0);
+	append(sqlp, ";", 0);
+    }
+    sqlite3_finalize(stmt);
+    if (rc == SQLITE_DONE) {
+	rc = drop ? sqlite3_exec(db, drop, 0, 0, 0) : SQLITE_OK;
+    }
+    append_free(&drop);
+    if (rc != SQLITE_OK) {
+	append_free(sqlp);
+    }
+    return rc;
+}
+
+#ifdef CSV_THREADS
+
+/**
+ * Insert rows of import batch.
+ * @param imp import state
+ * @param batch import batch
+ * @result SQLite error code
+ */
+
+static int
+csv_write_batch(csv_import *imp, csv_batch *batch)
+{
+    int i, k, rc;
+    csv_cell *cell = batch->cells;
+
+    for (k = 0; k < batch->nrows; k++) {
+	for (i = 0; i < batch->ncols; i++, cell++) {
+	    switch (cell->type) {
+	    case SQLITE_INTEGER:
+		sqlite3_bind_int64(imp->stmt, i + 1, cell->v.i);
+		break;
+	    case SQLITE_FLOAT:
+		sqlite3_bind_double(imp->stmt, i + 1, cell->v.d);
+		break;
+	    case SQLITE_TEXT:
+		sqlite3_bind_text(imp->stmt, i + 1, cell->v.s, cell->len,
+				  SQLITE_STATIC);
+		break;
+	    default:
+		sqlite3_bind_null(imp->stmt, i + 1);
+		break;
+	    }
+	}
+	rc = sqlite3_step(imp->stmt);
+	sqlite3_reset(imp->stmt);
+	if ((rc != SQLITE_DONE) && (rc != SQLITE_OK)) {
+	    if ((rc != SQLITE_MISMATCH) && (rc != SQLITE_CONSTRAINT)) {
+		return rc;
+	    }
+	} else {
+	    imp->nrows++;
+	    rc = csv_import_tx(imp, 0);
+	    if (rc != SQLITE_OK) {
+		return rc;
+	    }
+	}
+    }
+    return SQLITE_OK;
+}
+
+/**
+ * @typedef csv_worker
+ * @struct csv_worker
+ * Worker thread of parallel CSV import.
+ */
+
+typedef struct {
+    csv_import *imp;	/**< import state */
+    csv_file *csv;	/**< own CSV file handle */
+#ifdef _WIN32
+    HANDLE thr;		/**< thread handle */
+#else
+    pthread_t thr;	/**< thread identifier */
+#endif
+} csv_worker;
+
+/**
+ * Lock import state.
+ * @param imp import state
+ */
+
+static void
+imp_lock(csv_import *imp)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&imp->mutex);
+#else
+    pthread_mutex_lock(&imp->mutex);
+#endif
+}
+
+/**
+ * Unlock import state.
+ * @param imp import state
+ */
+
+static void
+imp_unlock(csv_import *imp)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&imp->mutex);
+#else
+    pthread_mutex_unlock(&imp->mutex);
+#endif
+}
+
+/**
+ * Wait for state change of locked import state.
+ * @param imp import state
+ */
+
+static void
+imp_wait(csv_import *imp)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(&imp->cond, &imp->mutex, INFINITE);
+#else
+    pthread_cond_wait(&imp->cond, &imp->mutex);
+#endif
+}
+
+/**
+ * Signal state change of locked import state to all waiters.
+ * @param imp import state
  */
 
-static int
-csv_vtab_close(sqlite3_vtab_cursor *cursor)
+static void
+imp_signal(csv_import *imp)
 {
-    sqlite3_free(cursor);
-    return SQLITE_OK;
+#ifdef _WIN32
+    WakeAllConditionVariable(&imp->cond);
+#else
+    pthread_cond_broadcast(&imp->cond);
+#endif
 }
 
 /**
- * Retrieve next row from virtual table cursor
- * @param cursor virtual table cursor
- * @result SQLite error code
+ * Return number of CPUs.
+ * @result number of CPUs
  */
 
 static int
-csv_vtab_next(sqlite3_vtab_cursor *cursor)
+csv_ncpus(void)
 {
-    csv_cursor *cur = (csv_cursor *) cursor;
-    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+#ifdef _WIN32
+    SYSTEM_INFO si;
 
-    cur->pos = csv_tell(tab->csv);
-    csv_getline(tab->csv, 0);
-    return SQLITE_OK;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    return 2;
+#endif
 }
 
 /**
- * Filter function for virtual table.
- * @param cursor virtual table cursor
- * @param idxNum unused (always 0)
- * @param idxStr unused
- * @param argc number arguments (unused, 0)
- * @param argv argument (nothing)
- * @result SQLite error code
+ * Create empty import batch.
+ * @param csv CSV file handle
+ * @param ncols number of columns per row
+ * @result import batch or NULL
  */
 
-static int
-csv_vtab_filter(sqlite3_vtab_cursor *cursor, int idxNum,
-		const char *idxStr, int argc, sqlite3_value **argv)
+static csv_batch *
+batch_new(csv_file *csv, int ncols)
 {
-    csv_cursor *cur = (csv_cursor *) cursor;
-    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+    csv_batch *batch = sqlite3_malloc(sizeof (csv_batch));
 
-    csv_rewind(tab->csv);
-    return csv_vtab_next(cursor);
+    if (batch) {
+	memset(batch, 0, sizeof (*batch));
+	batch->ncols = ncols;
+	if (!csv->dmax) {
+	    batch->map = csv->data;
+	    batch->mapend = csv->data + csv->dlen;
+	}
+    }
+    return batch;
 }
 
 /**
- * Return end of table state of virtual table cursor
- * @param cursor virtual table cursor
- * @result true/false
+ * Free import batch.
+ * @param batch import batch
  */
 
-static int
-csv_vtab_eof(sqlite3_vtab_cursor *cursor)
+static void
+batch_free(csv_batch *batch)
 {
-    csv_cursor *cur = (csv_cursor *) cursor;
-    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
+    csv_blk *blk;
 
-    return csv_eof(tab->csv);
+    while ((blk = batch->blks)) {
+	batch->blks = blk->next;
+	sqlite3_free(blk);
+    }
+    if (batch->cells) {
+	sqlite3_free(batch->cells);
+    }
+    sqlite3_free(batch);
 }
 
 /**
- * Return column data of virtual table.
- * @param cursor virtual table cursor
- * @param ctx SQLite function context
- * @param n column index
- * @result SQLite error code
+ * Append row to import batch.
+ * @param batch import batch
+ * @result pointer to cells of new row or NULL
  */
 
-static int
-csv_vtab_column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int n)
+static csv_cell *
+batch_addrow(csv_batch *batch)
 {
-    csv_cursor *cur = (csv_cursor *) cursor;
-    csv_vtab *tab = (csv_vtab *) cur->cursor.pVtab;
-    char *data = csv_coldata(tab->csv, n);
+    if (batch->nrows >= batch->maxrows) {
+	int n = batch->maxrows ? batch->maxrows * 2 : 1024;
+	double size = (double) sizeof (csv_cell) * n * batch->ncols;
+	csv_cell *cells;
 
-    return process_col(ctx, 0, 0, data, tab->coltypes[n], tab->convert);
+	if (size > INT_MAX) {
+	    return 0;
+	}
+	cells = sqlite3_realloc(batch->cells, (int) size);
+	if (!cells) {
+	    return 0;
+	}
+	batch->cells = cells;
+	batch->maxrows = n;
+    }
+    batch->row = batch->cells + batch->nrows * batch->ncols;
+    batch->nrows++;
+    return batch->row;
 }
 
 /**
- * Return current rowid of virtual table cursor
- * @param cursor virtual table cursor
- * @param rowidp value buffer to receive current rowid
- * @result SQLite error code
+ * Find end of chunk of memory mapped CSV file for parallel import.
+ * @param csv CSV file handle
+ * @param pos start of chunk, start of a row
+ * @param size minimum size of chunk
+ * @result file position of end of chunk, start of a row
  */
 
-static int
-csv_vtab_rowid(sqlite3_vtab_cursor *cursor, sqlite_int64 *rowidp)
+static long
+csv_split(csv_file *csv, long pos, long size)
 {
-    csv_cursor *cur = (csv_cursor *) cursor;
+    int inq = 0;
+    char c, *p, *lim, *end = csv->data + csv->dlen;
 
-    *rowidp = cur->pos;
-    return SQLITE_OK;
+    if (pos >= csv->dlen) {
+	return csv->dlen;
+    }
+    p = csv->data + pos;
+    lim = (size < end - p) ? p + size : end;
+    if (!csv->quot) {
+	/* no quoting, next line end after limit */
+	p = lim;
+    }
+    while (1) {
+	p = csv_scan(csv, p, end);
+	if (p >= end) {
+	    return csv->dlen;
+	}
+	c = *p;
+	if (csv->cclass[c & 0xFF] & CSV_QUOT) {
+	    if (inq) {
+		if (c == inq) {
+		    inq = 0;
+		}
+	    } else {
+		inq = c;
+	    }
+	} else if (((c == '\n') || (c == '\r')) && !inq && (p >= lim)) {
+	    if ((c == '\r') && (p + 1 < end) && (p[1] == '\n')) {
+		++p;
+	    }
+	    return p + 1 - csv->data;
+	}
+	++p;
+    }
 }
 
-#if (SQLITE_VERSION_NUMBER > 3004000)
-
 /**
- * Rename virtual table.
- * @param newname new name for table
+ * Convert rows of a chunk of CSV file into import batch.
+ * @param csv CSV file handle positioned at start of chunk
+ * @param batch import batch
+ * @param end file position of end of chunk
+ * @param coltypes column types
+ * @param convert convert flags
  * @result SQLite error code
  */
 
 static int
-csv_vtab_rename(sqlite3_vtab *vtab, const char *newname)
+csv_convert_chunk(csv_file *csv, csv_batch *batch, long end,
+		  char *coltypes, int convert)
 {
+    int i, len, rc;
+    char *data;
+
+    while ((csv_tell(csv) < end) && (csv_getline(csv, 0) != EOF)) {
+	if (!batch_addrow(batch)) {
+	    return SQLITE_NOMEM;
+	}
+	for (i = 0; i < batch->ncols; i++) {
+	    data = csv_coldata(csv, i, &len);
+	    rc = process_col(0, 0, batch, i + 1, data, len, coltypes[i],
+			     convert);
+	    if (rc != SQLITE_OK) {
+		return rc;
+	    }
+	}
+	if (batch->rc != SQLITE_OK) {
+	    return batch->rc;
+	}
+    }
     return SQLITE_OK;
 }
 
+/**
+ * Worker thread of parallel import: takes the next chunk
+ * of the CSV file, converts it into a batch, and hands
+ * the batch over to the inserting thread.
+ * @param arg worker
+ */
+
+#ifdef _WIN32
+static unsigned __stdcall
+#else
+static void *
 #endif
+csv_worker_run(void *arg)
+{
+    csv_worker *w = (csv_worker *) arg;
+    csv_import *imp = w->imp;
+    csv_batch *batch;
+    long start, end;
+
+    while (1) {
+	batch = batch_new(w->csv, imp->ncols);
+	imp_lock(imp);
+	while (batch && !imp->stop && !imp->eof &&
+	       (imp->seq - imp->wseq >= imp->maxbatch)) {
+	    imp_wait(imp);
+	}
+	if (!batch || imp->stop || imp->eof) {
+	    imp->nrun--;
+	    imp_signal(imp);
+	    imp_unlock(imp);
+	    if (batch) {
+		batch_free(batch);
+	    }
+	    break;
+	}
+	start = imp->next;
+	end = csv_split(imp->csv, start, CSV_CHUNK);
+	imp->next = end;
+	imp->eof = end >= imp->csv->dlen;
+	batch->seq = imp->seq++;
+	imp_unlock(imp);
+	csv_seek(w->csv, start);
+	batch->rc = csv_convert_chunk(w->csv, batch, end, imp->coltypes,
+				      imp->convert);
+	imp_lock(imp);
+	batch->next = imp->done;
+	imp->done = batch;
+	imp_signal(imp);
+	imp_unlock(imp);
+    }
+    return 0;
+}
 
 /**
- * SQLite module descriptor.
+ * Parallel import of memory mapped CSV file.
+ * @param imp import state
+ * @param csv CSV file handle, positioned after column names
+ * @param fname file name for opening worker's CSV file handles
+ * @param nthr number of worker threads
+ * @result SQLite error code or -1 when no worker could be started
  */
 
-static const sqlite3_module csv_vtab_mod = {
-    1,                   /* iVersion */
-    csv_vtab_create,     /* xCreate */
-    csv_vtab_connect,    /* xConnect */
-    csv_vtab_bestindex,  /* xBestIndex */
-    csv_vtab_disconnect, /* xDisconnect */
-    csv_vtab_destroy,    /* xDestroy */
-    csv_vtab_open,       /* xOpen */
-    csv_vtab_close,      /* xClose */
-    csv_vtab_filter,     /* xFilter */
-    csv_vtab_next,       /* xNext */
-    csv_vtab_eof,        /* xEof */
-    csv_vtab_column,     /* xColumn */
-    csv_vtab_rowid,      /* xRowid */
-    0,                   /* xUpdate */
-    0,                   /* xBegin */
-    0,                   /* xSync */
-    0,                   /* xCommit */
-    0,                   /* xRollback */
-    0,                   /* xFindFunction */
-#if (SQLITE_VERSION_NUMBER > 3004000)
-    csv_vtab_rename,     /* xRename */
+static int
+csv_import_mt(csv_import *imp, csv_file *csv, char *fname, int nthr)
+{
+    csv_worker *w;
+    csv_batch *batch, **bp;
+    int i, n, rc = SQLITE_OK;
+
+    w = sqlite3_malloc(sizeof (csv_worker) * nthr);
+    if (!w) {
+	return -1;
+    }
+    memset(w, 0, sizeof (csv_worker) * nthr);
+    imp->csv = csv;
+    imp->next = csv->pos0;
+    imp->seq = imp->wseq = 0;
+    imp->maxbatch = 2 * nthr + 2;
+    imp->nrun = 0;
+    imp->eof = imp->next >= csv->dlen;
+    imp->stop = 0;
+    imp->done = 0;
+#ifdef _WIN32
+    InitializeCriticalSection(&imp->mutex);
+    InitializeConditionVariable(&imp->cond);
+#else
+    pthread_mutex_init(&imp->mutex, 0);
+    pthread_cond_init(&imp->cond, 0);
+#endif
+    for (n = 0; n < nthr; n++) {
+	w[n].imp = imp;
+	w[n].csv = csv_open(fname, csv->sep, csv->quot);
+	if (w[n].csv && w[n].csv->dmax) {
+	    /* file changed, not mappable anymore */
+	    csv_close(w[n].csv);
+	    w[n].csv = 0;
+	}
+	if (!w[n].csv) {
+	    break;
+	}
+	w[n].csv->isdos = csv->isdos;
+	imp_lock(imp);
+	imp->nrun++;
+	imp_unlock(imp);
+#ifdef _WIN32
+	w[n].thr = (HANDLE) _beginthreadex(0, 0, csv_worker_run, &w[n], 0, 0);
+	if (!w[n].thr) {
+#else
+	if (pthread_create(&w[n].thr, 0, csv_worker_run, &w[n]) != 0) {
+#endif
+	    imp_lock(imp);
+	    imp->nrun--;
+	    imp_unlock(imp);
+	    csv_close(w[n].csv);
+	    w[n].csv = 0;
+	    break;
+	}
+    }
+    if (n == 0) {
+	rc = -1;
+	goto done;
+    }
+    /* insert batches in file order */
+    while (1) {
+	imp_lock(imp);
+	while (1) {
+	    for (bp = &imp->done; (batch = *bp); bp = &batch->next) {
+		if (batch->seq == imp->wseq) {
+		    *bp = batch->next;
+		    break;
+		}
+	    }
+	    if (batch || !imp->nrun || (imp->eof && (imp->wseq == imp->seq))) {
+		break;
+	    }
+	    imp_wait(imp);
+	}
+	if (batch) {
+	    imp->wseq++;
+	    imp_signal(imp);
+	} else if (!imp->eof || (imp->wseq != imp->seq)) {
+	    /* workers gone early */
+	    rc = SQLITE_NOMEM;
+	}
+	imp_unlock(imp);
+	if (!batch) {
+	    break;
+	}
+	rc = batch->rc;
+	if (rc == SQLITE_OK) {
+	    rc = csv_write_batch(imp, batch);
+	}
+	batch_free(batch);
+	if (rc != SQLITE_OK) {
+	    break;
+	}
+    }
+    imp_lock(imp);
+    imp->stop = 1;
+    imp_signal(imp);
+    imp_unlock(imp);
+    for (i = 0; i < n; i++) {
+#ifdef _WIN32
+	WaitForSingleObject(w[i].thr, INFINITE);
+	CloseHandle(w[i].thr);
+#else
+	pthread_join(w[i].thr, 0);
+#endif
+    }
+done:
+    while ((batch = imp->done)) {
+	imp->done = batch->next;
+	batch_free(batch);
+    }
+    for (i = 0; i < nthr; i++) {
+	if (w[i].csv) {
+	    csv_close(w[i].csv);
+	}
+    }
+#ifdef _WIN32
+    DeleteCriticalSection(&imp->mutex);
+#else
+    pthread_cond_destroy(&imp->cond);
+    pthread_mutex_destroy(&imp->mutex);
+#endif
+    sqlite3_free(w);
+    return rc;
+}
+
 #endif
-};
 
 /**
  * Import CSV file as table into database
  * @param ctx SQLite function context
  * @param argc number of arguments
  * @param argv argument vector
+ * @param nthr number of worker threads, 0 for plain sequential import
+ * @param flags import flags, 1 to drop and rebuild non-unique indexes
  *
  * Argument vector contains:
  *
@@ -1387,14 +3372,18 @@ static const sqlite3_module csv_vtab_mod = {
  */
 
 static void
-csv_import_func(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+csv_do_import(sqlite3_context *ctx, int argc, sqlite3_value **argv,
+	      int nthr, int flags)
 {
-    csv_file *csv;
+    csv_file *csv = 0;
     int rc, i, k, ncnames, row1, convert = 0, useargs = 0, *colmap = 0;
-    char *tname, *fname, *sql = 0, **cnames, *coltypes = 0;
+    char *tname, *fname, *sql = 0, *isql = 0, **cnames, *coltypes = 0;
     sqlite3 *db = (sqlite3 *) sqlite3_user_data(ctx);
     sqlite3_stmt *stmt = 0;
+    csv_import imp;
 
+    memset(&imp, 0, sizeof (imp));
+    imp.db = db;
     if (argc < 2) {
 	sqlite3_result_error(ctx, "need at least 2 arguments", -1);
 	return;
@@ -1418,9 +3407,20 @@ cleanup:
 	if (stmt) {
 	    sqlite3_finalize(stmt);
 	}
+	if (csv_import_tx(&imp, 1) != SQLITE_OK) {
+	    sqlite3_result_error(ctx, "commit failed", -1);
+	}
+	if (isql) {
+	    if (sqlite3_exec(db, isql, 0, 0, 0) != SQLITE_OK) {
+		sqlite3_result_error(ctx, "rebuild of indexes failed", -1);
+	    }
+	    append_free(&isql);
+	}
 	append_free(&sql);
 	if (colmap) {
 	    sqlite3_free(colmap);
+	} else if (coltypes) {
+	    sqlite3_free(coltypes);
 	}
 	if (csv) {
 	    csv_close(csv);
@@ -1442,10 +3442,13 @@ cleanup:
 	    sqlite3_result_error(ctx, "unable to get column names", -1);
 	    goto cleanup;
 	}
+	cnames = csv_colnames(csv);
+	if (!cnames) {
+	    goto oom;
+	}
 	csv->pos0 = csv_tell(csv);
 	csv_rewind(csv);
 	ncnames = csv_ncols(csv);
-	cnames = csv->cols;
     } else if (argc > 6) {
 	ncnames = argc - 6;
 	cnames = 0;
@@ -1606,6 +3609,20 @@ defcol:
     }
     sqlite3_finalize(stmt);
     stmt = 0;
+    if (nthr > 0) {
+	/* bulk import in own transactions, optionally without indexes */
+	if (sqlite3_get_autocommit(db)) {
+	    if (sqlite3_exec(db, "BEGIN", 0, 0, 0) != SQLITE_OK) {
+		sqlite3_result_error(ctx, "begin failed", -1);
+		goto cleanup;
+	    }
+	    imp.intx = 1;
+	}
+	if ((flags & 1) && (csv_drop_indexes(db, tname, &isql) != SQLITE_OK)) {
+	    sqlite3_result_error(ctx, "drop of indexes failed", -1);
+	    goto cleanup;
+	}
+    }
     /* make INSERT statement */
     append(&sql, "INSERT INTO ", 0);
     append(&sql, tname, '"');
@@ -1618,18 +3635,36 @@ defcol:
 	goto prepfail;
     }
     append_free(&sql);
+    imp.stmt = stmt;
+    imp.coltypes = coltypes;
+    imp.ncols = ncnames;
+    imp.convert = convert;
+#ifdef CSV_THREADS
+    if ((nthr > 0) && !csv->dmax) {
+	/* memory mapped file, convert chunks in worker threads */
+	rc = csv_import_mt(&imp, csv, fname, nthr);
+	if (rc >= 0) {
+	    if (rc != SQLITE_OK) {
+		goto inserr;
+	    }
+	    sqlite3_result_int(ctx, imp.nrows);
+	    goto cleanup;
+	}
+    }
+#endif
     /* import the CSV file */
-    row1 = 0;
     while (csv_getline(csv, 0) != EOF) {
 	for (i = 0; i < ncnames; i++) {
-	    char *data = csv_coldata(csv, i);
+	    int len;
+	    char *data = csv_coldata(csv, i, &len);
 
-	    rc = process_col(0, stmt, i + 1, data, coltypes[i], convert);
+	    rc = process_col(0, stmt, 0, i + 1, data, len, coltypes[i], convert);
 	    if (rc != SQLITE_OK) {
 		goto inserr;
 	    }
 	}
 	rc = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
 	if ((rc != SQLITE_DONE) && (rc != SQLITE_OK)) {
 	    if ((rc != SQLITE_MISMATCH) && (rc != SQLITE_CONSTRAINT)) {
 inserr:
@@ -1637,14 +3672,93 @@ inserr:
 		goto cleanup;
 	    }
 	} else {
-	    row1++;
+	    imp.nrows++;
+	    if (csv_import_tx(&imp, 0) != SQLITE_OK) {
+		goto inserr;
+	    }
 	}
-	sqlite3_reset(stmt);
     }
-    sqlite3_result_int(ctx, row1);
+    sqlite3_result_int(ctx, imp.nrows);
     goto cleanup;
 }
 
+/**
+ * Import CSV file as table into database
+ * @param ctx SQLite function context
+ * @param argc number of arguments
+ * @param argv argument vector
+ *
+ * Argument vector contains:
+ *
+ * argv[0] - name of table to create (required)<br>
+ * argv[1] - filename (required)<br>
+ * argv[2] - number, when non-zero use first line as column names,
+ *           when negative use given type names (optional)<br>
+ * argv[3] - number, when non-zero, translate data (optional, see below)<br>
+ * argv[4] - column separator characters (optional)<br>
+ * argv[5] - string quoting characters (optional)<br>
+ * argv[6] - column/type name for first column (optional)<br>
+ *   ..<br>
+ * argv[X] - column/type name for last column (optional)<br><br>
+ *
+ * Translation flags:
+ *
+ * 1  - convert ISO-8859-1 to UTF-8<br>
+ * 2  - perform backslash substitution<br>
+ * 4  - convert and collapse white-space in column names to underscore<br>
+ * 10 - convert \q to single quote, in addition to backslash substitution<br>
+ */
+
+static void
+csv_import_func(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    csv_do_import(ctx, argc, argv, 0, 0);
+}
+
+/**
+ * Bulk import CSV file as table into database
+ * @param ctx SQLite function context
+ * @param argc number of arguments
+ * @param argv argument vector
+ *
+ * Argument vector contains:
+ *
+ * argv[0] - number of worker threads, 0 or negative for
+ *           number of CPUs minus one (required)<br>
+ * argv[1] - flags, 1 to drop non-unique indexes of the table
+ *           during the import and to rebuild them afterwards (required)<br>
+ * argv[2] ... argv[X] - same as argv[0] ... argv[X - 2]
+ *           of import_csv()<br><br>
+ *
+ * The rows are inserted in a transaction which is committed every
+ * 500000 rows, unless a transaction is already open. When the file
+ * can be memory mapped, chunks of it are converted to rows in worker
+ * threads, while the calling thread inserts the rows in file order.
+ */
+
+static void
+csv_import_parallel_func(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    int nthr;
+
+    if (argc < 4) {
+	sqlite3_result_error(ctx, "need at least 4 arguments", -1);
+	return;
+    }
+    nthr = sqlite3_value_int(argv[0]);
+#ifdef CSV_THREADS
+    if (nthr <= 0) {
+	nthr = csv_ncpus() - 1;
+    }
+#endif
+    if (nthr < 1) {
+	nthr = 1;
+    } else if (nthr > CSV_MAXTHR) {
+	nthr = CSV_MAXTHR;
+    }
+    csv_do_import(ctx, argc - 2, argv + 2, nthr, sqlite3_value_int(argv[1]));
+}
+
 /**
  * Module initializer creating SQLite functions and modules
  * @param db database pointer
@@ -1659,6 +3773,8 @@ csv_vtab_init(sqlite3 *db)
 {
     sqlite3_create_function(db, "import_csv", -1, SQLITE_UTF8,
 			    (void *) db, csv_import_func, 0, 0);
+    sqlite3_create_function(db, "import_csv_parallel", -1, SQLITE_UTF8,
+			    (void *) db, csv_import_parallel_func, 0, 0);
     return sqlite3_create_module(db, "csvtable", &csv_vtab_mod, 0);
 }
 
@@ -174,6 +174,18 @@
  *       "impexp_export_json" has a signature compatible
  *       with fputc(3).
  *
+ *  C function:
+ *       int impexp_export_json_write(sqlite3 *db, char *sql,
+ *                                    impexp_write wfunc, void *warg);
+ *
+ *       Same as "impexp_export_json" but the output function
+ *       receives spans of up to 1 MB instead of characters.
+ *
+ *
+ * All output is collected in a 1 MB buffer and written in large
+ * chunks. CSV and XML rows are formatted directly from the typed
+ * column values of the table's SELECT statement.
+ *
  *
  * On Win32 the filename argument may be specified as NULL in order
  * to open a system file dialog for interactive filename selection.
@@ -204,15 +216,190 @@ static SQLITE_EXTENSION_INIT1
 #include "impexp.h"
 
 /**
- * @typedef struct json_pfs
- * @struct json_pfs
- * JSON output helper structure
+ * Size of output buffer
+ */
+
+#define OBUF_SIZE	(1024 * 1024)
+
+/**
+ * @typedef struct obuf
+ * @struct obuf
+ * Buffered output, flushed in spans to a FILE pointer,
+ * a span output function, or a function like fputc()
  */
 
 typedef struct {
-    impexp_putc pfunc;	/**< function like fputc() */
-    void *parg;		/**< argument to function */
-} json_pfs;
+    FILE *out;		/**< output file pointer or NULL */
+    impexp_write wfunc;	/**< span output function or NULL */
+    impexp_putc pfunc;	/**< function like fputc() or NULL */
+    void *parg;		/**< argument to wfunc/pfunc */
+    char *buf;		/**< output buffer */
+    int nbuf;		/**< number of bytes in buffer */
+    int maxbuf;		/**< size of buffer */
+    int error;		/**< true after write error */
+    char sbuf[256];	/**< fallback buffer when out of memory */
+} obuf;
+
+/**
+ * Initialize output buffer, exactly one of out, wfunc, pfunc is non-NULL
+ * @param ob output buffer
+ * @param out output file pointer
+ * @param wfunc span output function
+ * @param pfunc function like fputc()
+ * @param parg argument to wfunc/pfunc
+ */
+
+static void
+obuf_init(obuf *ob, FILE *out, impexp_write wfunc, impexp_putc pfunc,
+	  void *parg)
+{
+    ob->out = out;
+    ob->wfunc = wfunc;
+    ob->pfunc = pfunc;
+    ob->parg = parg;
+    ob->nbuf = 0;
+    ob->error = 0;
+    ob->buf = sqlite3_malloc(OBUF_SIZE);
+    if (ob->buf) {
+	ob->maxbuf = OBUF_SIZE;
+    } else {
+	ob->buf = ob->sbuf;
+	ob->maxbuf = sizeof (ob->sbuf);
+    }
+}
+
+/**
+ * Write a span to the destination of output buffer
+ * @param ob output buffer
+ * @param data pointer to data
+ * @param len length of data
+ */
+
+static void
+obuf_span(obuf *ob, const char *data, int len)
+{
+    int i;
+
+    if ((len <= 0) || ob->error) {
+	return;
+    }
+    if (ob->out) {
+	if (fwrite(data, 1, len, ob->out) != (size_t) len) {
+	    ob->error = 1;
+	}
+    } else if (ob->wfunc) {
+	if (ob->wfunc(data, len, ob->parg) < 0) {
+	    ob->error = 1;
+	}
+    } else if (ob->pfunc) {
+	for (i = 0; i < len; i++) {
+	    ob->pfunc(data[i], ob->parg);
+	}
+    }
+}
+
+/**
+ * Flush output buffer
+ * @param ob output buffer
+ */
+
+static void
+obuf_flush(obuf *ob)
+{
+    obuf_span(ob, ob->buf, ob->nbuf);
+    ob->nbuf = 0;
+}
+
+/**
+ * Flush and release output buffer
+ * @param ob output buffer
+ * @result true when all output was written
+ */
+
+static int
+obuf_end(obuf *ob)
+{
+    obuf_flush(ob);
+    if (ob->buf != ob->sbuf) {
+	sqlite3_free(ob->buf);
+    }
+    ob->buf = 0;
+    ob->maxbuf = 0;
+    return !ob->error;
+}
+
+/**
+ * Append data to output buffer
+ * @param ob output buffer
+ * @param data pointer to data
+ * @param len length of data
+ */
+
+static void
+obuf_write(obuf *ob, const char *data, int len)
+{
+    if (len > ob->maxbuf - ob->nbuf) {
+	obuf_flush(ob);
+	if (len >= ob->maxbuf) {
+	    obuf_span(ob, data, len);
+	    return;
+	}
+    }
+    memcpy(ob->buf + ob->nbuf, data, len);
+    ob->nbuf += len;
+}
+
+/**
+ * Append string to output buffer
+ * @param ob output buffer
+ * @param str string
+ */
+
+static void
+obuf_puts(obuf *ob, const char *str)
+{
+    obuf_write(ob, str, strlen(str));
+}
+
+/**
+ * Append character to output buffer
+ * @param ob output buffer
+ * @param c character
+ */
+
+static void
+obuf_putc(obuf *ob, int c)
+{
+    if (ob->nbuf >= ob->maxbuf) {
+	obuf_flush(ob);
+    }
+    ob->buf[ob->nbuf++] = c;
+}
+
+/**
+ * Append decimal representation of integer to output buffer
+ * @param ob output buffer
+ * @param val integer value
+ */
+
+static void
+obuf_int64(obuf *ob, sqlite_int64 val)
+{
+    char buf[32], *p = buf + sizeof (buf);
+    sqlite_uint64 uval = val;
+
+    if (val < 0) {
+	uval = -uval;
+    }
+    do {
+	*--p = '0' + (int) (uval % 10);
+	uval /= 10;
+    } while (uval);
+    if (val < 0) {
+	*--p = '-';
+    }
+    obuf_write(ob, p, buf + sizeof (buf) - p);
+}
 
 static const char space_chars[] = " \f\n\r\t\v";
 
@@ -921,6 +1108,7 @@ typedef struct {
     int nlines;		/**< counter for output lines */
     int indent;		/**< current indent level */
     FILE *out;		/**< output file pointer */
+    obuf ob;		/**< buffered output to out */
 } DUMP_DATA;
 
 /**
@@ -934,7 +1122,7 @@ indent(DUMP_DATA *dd)
     int i;
 
     for (i = 0; i < dd->indent; i++) {
-	fputc(' ', dd->out);
+	obuf_putc(&dd->ob, ' ');
     }
 }
 
@@ -981,17 +1169,17 @@ table_dump(DUMP_DATA *dd, char **errp, int fmt, const char *query, ...)
     }
     rc = sqlite3_step(select);
     while (rc == SQLITE_ROW) {
-	if (fputs((char *) sqlite3_column_text(select, 0), dd->out) > 0) {
-	    dd->nlines++;
-	}
+	obuf_write(&dd->ob, (char *) sqlite3_column_text(select, 0),
+		   sqlite3_column_bytes(select, 0));
+	dd->nlines++;
 	if (dd->quote_mode >= 0) {
-	    fputc(';', dd->out);
+	    obuf_putc(&dd->ob, ';');
 	}
 	if (dd->quote_mode == -1) {
-	    fputc('\r', dd->out);
+	    obuf_putc(&dd->ob, '\r');
 	}
 	if (dd->quote_mode >= -1) {
-	    fputc('\n', dd->out);
+	    obuf_putc(&dd->ob, '\n');
 	}
 	rc = sqlite3_step(select);
     }
@@ -1111,15 +1299,15 @@ quote_xml_str(DUMP_DATA *dd, char *str)
     }
     for (i = 0; str[i]; i++) {
 	if (str[i] == '"') {
-	    fputs("&quot;", dd->out);
+	    obuf_puts(&dd->ob, "&quot;");
 	} else if (str[i] == '\'') {
-	    fputs("&apos;", dd->out);
+	    obuf_puts(&dd->ob, "&apos;");
 	} else if (str[i] == '<') {
-	    fputs("&lt;", dd->out);
+	    obuf_puts(&dd->ob, "&lt;");
 	} else if (str[i] == '>') {
-	    fputs("&gt;", dd->out);
+	    obuf_puts(&dd->ob, "&gt;");
 	} else if (str[i] == '&') {
-	    fputs("&amp;", dd->out);
+	    obuf_puts(&dd->ob, "&amp;");
 	} else if ((unsigned char) str[i] <= ' ') {
 	    char buf[8];
 
@@ -1131,13 +1319,339 @@ quote_xml_str(DUMP_DATA *dd, char *str)
 	    buf[5] = xdigits[str[i] & 0x0F];
 	    buf[6] = ';';
 	    buf[7] = '\0';
-	    fputs(buf, dd->out);
+	    obuf_puts(&dd->ob, buf);
+	} else {
+	    obuf_putc(&dd->ob, str[i]);
+	}
+    }
+}
+
+/**
+ * Write column value quoted for CSV, same format as quote_csv()
+ * @param ob output buffer
+ * @param stmt statement with current row
+ * @param col column number
+ */
+
+static void
+obuf_csv_value(obuf *ob, sqlite3_stmt *stmt, int col)
+{
+    static const char xdigits[] = "0123456789ABCDEF";
+
+    switch (sqlite3_column_type(stmt, col)) {
+    case SQLITE_INTEGER:
+	obuf_int64(ob, sqlite3_column_int64(stmt, col));
+	break;
+    case SQLITE_FLOAT:
+	obuf_puts(ob, (char *) sqlite3_column_text(stmt, col));
+	break;
+    case SQLITE_BLOB: {
+	const unsigned char *blob = sqlite3_column_blob(stmt, col);
+	int i, nblob = sqlite3_column_bytes(stmt, col);
+
+	obuf_putc(ob, '"');
+	for (i = 0; i < nblob; i++) {
+	    obuf_putc(ob, xdigits[(blob[i] >> 4) & 0x0F]);
+	    obuf_putc(ob, xdigits[blob[i] & 0x0F]);
+	}
+	obuf_putc(ob, '"');
+	break;
+    }
+    case SQLITE_TEXT: {
+	const char *p = (const char *) sqlite3_column_text(stmt, col);
+	const char *q;
+
+	if (!p) {
+	    break;
+	}
+	obuf_putc(ob, '"');
+	while (*p) {
+	    for (q = p; *q && (*q != '"'); q++) {
+		/* empty loop body */
+	    }
+	    obuf_write(ob, p, q - p);
+	    if (!*q) {
+		break;
+	    }
+	    obuf_write(ob, "\"\"", 2);
+	    p = q + 1;
+	}
+	obuf_putc(ob, '"');
+	break;
+    }
+    }
+}
+
+/**
+ * Write string quoted for XML, same format as quote_xml()
+ * @param ob output buffer
+ * @param str string to be written
+ * @param addtype when negative, blanks are quoted, too
+ */
+
+static void
+obuf_xml_text(obuf *ob, const unsigned char *str, int addtype)
+{
+    static const char xdigits[] = "0123456789ABCDEF";
+    const unsigned char *q;
+    char buf[8];
+
+    if (!str) {
+	return;
+    }
+    while (*str) {
+	for (q = str; *q; q++) {
+	    if ((*q == '"') || (*q == '\'') || (*q == '<') || (*q == '>') ||
+		(*q == '&') || (*q < ' ') || ((addtype < 0) && (*q == ' '))) {
+		break;
+	    }
+	}
+	obuf_write(ob, (const char *) str, q - str);
+	if (!*q) {
+	    break;
+	}
+	if (*q == '"') {
+	    obuf_write(ob, "&quot;", 6);
+	} else if (*q == '\'') {
+	    obuf_write(ob, "&apos;", 6);
+	} else if (*q == '<') {
+	    obuf_write(ob, "&lt;", 4);
+	} else if (*q == '>') {
+	    obuf_write(ob, "&gt;", 4);
+	} else if (*q == '&') {
+	    obuf_write(ob, "&amp;", 5);
 	} else {
-	    fputc(str[i], dd->out);
+	    buf[0] = '&';
+	    buf[1] = '#';
+	    buf[2] = 'x';
+	    buf[3] = xdigits[(*q >> 4) & 0x0F];
+	    buf[4] = xdigits[*q & 0x0F];
+	    buf[5] = ';';
+	    obuf_write(ob, buf, 6);
 	}
+	str = q + 1;
     }
 }
 
+/**
+ * Write column value quoted for XML, same format as quote_xml()
+ * @param ob output buffer
+ * @param stmt statement with current row
+ * @param col column number
+ * @param addtype when positive, prefix value with TYPE attribute
+ */
+
+static void
+obuf_xml_value(obuf *ob, sqlite3_stmt *stmt, int col, int addtype)
+{
+    static const char xdigits[] = "0123456789ABCDEF";
+
+    switch (sqlite3_column_type(stmt, col)) {
+    case SQLITE_NULL:
+	if (addtype > 0) {
+	    obuf_puts(ob, " TYPE=\"NULL\">");
+	}
+	break;
+    case SQLITE_INTEGER:
+	if (addtype > 0) {
+	    obuf_puts(ob, " TYPE=\"INTEGER\">");
+	}
+	obuf_int64(ob, sqlite3_column_int64(stmt, col));
+	break;
+    case SQLITE_FLOAT:
+	if (addtype > 0) {
+	    obuf_puts(ob, " TYPE=\"REAL\">");
+	}
+	obuf_puts(ob, (char *) sqlite3_column_text(stmt, col));
+	break;
+    case SQLITE_BLOB: {
+	const unsigned char *blob = sqlite3_column_blob(stmt, col);
+	int i, nblob = sqlite3_column_bytes(stmt, col);
+	char buf[8];
+
+	if (addtype > 0) {
+	    obuf_puts(ob, " TYPE=\"BLOB\">");
+	}
+	buf[0] = '&';
+	buf[1] = '#';
+	buf[2] = 'x';
+	buf[5] = ';';
+	for (i = 0; i < nblob; i++) {
+	    buf[3] = xdigits[(blob[i] >> 4) & 0x0F];
+	    buf[4] = xdigits[blob[i] & 0x0F];
+	    obuf_write(ob, buf, 6);
+	}
+	break;
+    }
+    case SQLITE_TEXT:
+	if (addtype > 0) {
+	    obuf_puts(ob, " TYPE=\"TEXT\">");
+	}
+	obuf_xml_text(ob, sqlite3_column_text(stmt, col), addtype);
+	break;
+    }
+}
+
+/**
+ * Execute SQL selecting the columns of one table and write
+ * the rows as CSV or XML formatted from the typed column values
+ * @param dd information structure for dump
+ * @param query SQL text selecting the columns
+ * @param names column names for XML tags
+ * @param item if true, first column is the XML item tag or CSV prefix
+ * @result SQLite error code
+ */
+
+static int
+table_dump_rows(DUMP_DATA *dd, const char *query, char **names, int item)
+{
+    static const char spaces[] = "                                ";
+    obuf *ob = &dd->ob;
+    sqlite3_stmt *select = 0;
+    int i, ncols, rc, ind0, ind1;
+
+#if defined(HAVE_SQLITE3PREPAREV2) && HAVE_SQLITE3PREPAREV2
+    rc = sqlite3_prepare_v2(dd->db, query, -1, &select, 0);
+#else
+    rc = sqlite3_prepare(dd->db, query, -1, &select, 0);
+#endif
+    if ((rc != SQLITE_OK) || !select) {
+	return rc;
+    }
+    ncols = sqlite3_column_count(select);
+    ind0 = dd->indent;
+    if (ind0 > 32) {
+	ind0 = 32;
+    }
+    ind1 = (ind0 < 32) ? ind0 + 1 : 32;
+    rc = sqlite3_step(select);
+    while (rc == SQLITE_ROW) {
+	if (dd->quote_mode < -1) {
+	    if (item) {
+		obuf_write(ob, spaces, ind0);
+		obuf_putc(ob, '<');
+		obuf_xml_value(ob, select, 0, -1);
+		obuf_write(ob, ">\n", 2);
+	    }
+	    for (i = item; i < ncols; i++) {
+		obuf_write(ob, spaces, ind1);
+		obuf_putc(ob, '<');
+		obuf_xml_text(ob, (unsigned char *) names[i - item], -1);
+		obuf_xml_value(ob, select, i, 1);
+		obuf_write(ob, "</", 2);
+		obuf_xml_text(ob, (unsigned char *) names[i - item], -1);
+		obuf_write(ob, ">\n", 2);
+	    }
+	    if (item) {
+		obuf_write(ob, spaces, ind0);
+		obuf_write(ob, "</", 2);
+		obuf_xml_value(ob, select, 0, -1);
+		obuf_write(ob, ">\n", 2);
+	    }
+	} else {
+	    for (i = 0; i < ncols; i++) {
+		if (i > 0) {
+		    obuf_putc(ob, ',');
+		}
+		obuf_csv_value(ob, select, i);
+	    }
+	    obuf_write(ob, "\r\n", 2);
+	}
+	dd->nlines++;
+	rc = sqlite3_step(select);
+    }
+    return sqlite3_finalize(select);
+}
+
+/**
+ * Dump header and rows of one table or view as CSV or XML
+ * @param dd information structure for dump
+ * @param table name of table or view
+ * @param stmt prepared PRAGMA table_info() of table
+ * @result 0 to continue, 1 to abort
+ */
+
+static int
+dump_typed(DUMP_DATA *dd, const char *table, sqlite3_stmt *stmt)
+{
+    char *select = 0, *hdr = 0, **names = 0, **tmp;
+    int rc, ret = 1, ncols = 0, nhdr = 0, i;
+
+    append(&select, "SELECT ", 0);
+    if (dd->where) {
+	append(&select, dd->where, '"');
+	append(&select, ",", 0);
+    }
+    if ((dd->quote_mode == -1) && dd->indent) {
+	append(&hdr, select, 0);
+    }
+    rc = sqlite3_step(stmt);
+    while (rc == SQLITE_ROW) {
+	const char *text = (const char *) sqlite3_column_text(stmt, 1);
+	const char *type = (const char *) sqlite3_column_text(stmt, 2);
+	int tlen = strlen(type ? type : "");
+
+	if (hdr) {
+	    if (nhdr++) {
+		append(&hdr, ",", 0);
+	    }
+	    append(&hdr, text, '"');
+	}
+	/* leave out BLOB columns in CSV */
+	if ((dd->quote_mode == -1) &&
+	    (((tlen >= 4) && (strncasecmp(type, "BLOB", 4) == 0)) ||
+	     ((tlen >= 6) && (strncasecmp(type, "BINARY", 6) == 0)))) {
+	    rc = sqlite3_step(stmt);
+	    continue;
+	}
+	if (ncols) {
+	    append(&select, ",", 0);
+	}
+	append(&select, text, '"');
+	if (dd->quote_mode < -1) {
+	    tmp = sqlite3_realloc(names, (ncols + 1) * sizeof (char *));
+	    if (!tmp) {
+		goto done;
+	    }
+	    names = tmp;
+	    names[ncols] = sqlite3_mprintf("%s", text ? text : "");
+	    if (!names[ncols]) {
+		goto done;
+	    }
+	}
+	ncols++;
+	rc = sqlite3_step(stmt);
+    }
+    if (rc != SQLITE_DONE) {
+	goto done;
+    }
+    ret = 0;
+    append(&select, " FROM ", 0);
+    append(&select, table, '"');
+    if (hdr && nhdr) {
+	table_dump_rows(dd, hdr, 0, 0);
+    }
+    if (select && ncols) {
+	rc = table_dump_rows(dd, select, names, dd->where != 0);
+	if (rc == SQLITE_CORRUPT) {
+	    append(&select, " ORDER BY rowid DESC", 0);
+	    if (select) {
+		table_dump_rows(dd, select, names, dd->where != 0);
+	    }
+	}
+    }
+done:
+    if (names) {
+	for (i = 0; i < ncols; i++) {
+	    sqlite3_free(names[i]);
+	}
+	sqlite3_free(names);
+    }
+    append_free(&hdr);
+    append_free(&select);
+    return ret;
+}
+
 /**
  * Callback for sqlite3_exec() to dump one data row
  * @param udata information structure for dump
@@ -1162,15 +1676,13 @@ dump_cb(void *udata, int nargs, char **args, char **cols)
     sql = args[2];
     if (strcmp(table, "sqlite_sequence") == 0) {
 	if (dd->with_schema) {
-	    if (fputs("DELETE FROM sqlite_sequence;\n", dd->out) >= 0) {
-		dd->nlines++;
-	    }
+	    obuf_puts(&dd->ob, "DELETE FROM sqlite_sequence;\n");
+	    dd->nlines++;
 	}
     } else if (strcmp(table, "sqlite_stat1") == 0) {
 	if (dd->with_schema) {
-	    if (fputs("ANALYZE sqlite_master;\n", dd->out) >= 0) {
-		dd->nlines++;
-	    }
+	    obuf_puts(&dd->ob, "ANALYZE sqlite_master;\n");
+	    dd->nlines++;
 	}
     } else if (strncmp(table, "sqlite_", 7) == 0) {
 	return 0;
@@ -1230,23 +1742,25 @@ bailout0:
 	    }
 	    sqlite3_finalize(stmt);
 	    append(&creat, ")", 0);
-	    if (creat && fprintf(dd->out, "CREATE TABLE %s;\n", creat) > 0) {
+	    if (creat) {
+		obuf_puts(&dd->ob, "CREATE TABLE ");
+		obuf_puts(&dd->ob, creat);
+		obuf_puts(&dd->ob, ";\n");
 		dd->nlines++;
 	    }
 	    append_free(&creat);
 	}
     } else {
 	if (dd->with_schema) {
-	    if (fprintf(dd->out, "%s;\n", sql) > 0) {
-		dd->nlines++;
-	    }
+	    obuf_puts(&dd->ob, sql);
+	    obuf_puts(&dd->ob, ";\n");
+	    dd->nlines++;
 	}
     }
     if ((strcmp(type, "table") == 0) ||
 	((dd->quote_mode < 0) && (strcmp(type, "view") == 0))) {
 	sqlite3_stmt *stmt = 0;
-	char *select = 0, *hdr = 0, *table_info = 0;
-	char buffer[256];
+	char *select = 0, *table_info = 0, *tmp = 0;
 
 	append(&table_info, "PRAGMA table_info(", 0);
 	append(&table_info, table, '"');
@@ -1262,49 +1776,25 @@ bailout1:
 	    if (stmt) {
 		sqlite3_finalize(stmt);
 	    }
-	    append_free(&hdr);
 	    append_free(&select);
 	    return 1;
 	}
-	if (dd->quote_mode < -1) {
-	    if (dd->where) {
-		append(&select, "SELECT ", 0);
-		sprintf(buffer, "indent_xml(%d)", dd->indent);
-		append(&select, buffer, 0);
-		append(&select, " || '<' || quote_xml(", 0);
-		append(&select, dd->where, '"');
-		append(&select, ",-1) || '>\n' || ", 0);
-	    } else {
-		append(&select, "SELECT ", 0);
-	    }
-	} else if (dd->quote_mode < 0) {
-	    if (dd->where) {
-		append(&select, "SELECT quote_csv(", 0);
-		append(&select, dd->where, '"');
-		append(&select, ") || ',' || ", 0);
-	    } else {
-		append(&select, "SELECT ", 0);
-	    }
-	    if (dd->indent) {
-		append(&hdr, select, 0);
-	    }
+	if (dd->quote_mode < 0) {
+	    rc = dump_typed(dd, table, stmt);
+	    sqlite3_finalize(stmt);
+	    return rc;
+	}
+	if (dd->with_schema) {
+	    append(&select, "SELECT 'INSERT INTO ' || ", 0);
 	} else {
-	    char *tmp = 0;
-
-	    if (dd->with_schema) {
-		append(&select, "SELECT 'INSERT INTO ' || ", 0);
-	    } else {
-		append(&select, "SELECT 'INSERT OR REPLACE INTO ' || ", 0);
-	    }
-	    append(&tmp, table, '"');
-	    if (tmp) {
-		append(&select, tmp, '\'');
-		append_free(&tmp);
-	    }
+	    append(&select, "SELECT 'INSERT OR REPLACE INTO ' || ", 0);
 	}
-	if ((dd->quote_mode >= 0) && !dd->with_schema) {
-	    char *tmp = 0;
-
+	append(&tmp, table, '"');
+	if (tmp) {
+	    append(&select, tmp, '\'');
+	    append_free(&tmp);
+	}
+	if (!dd->with_schema) {
 	    append(&select, " || ' (' || ", 0);
 	    rc = sqlite3_step(stmt);
 	    while (rc == SQLITE_ROW) {
@@ -1326,82 +1816,24 @@ bailout1:
 	    sqlite3_reset(stmt);
 	    append(&select, "|| ')'", 0);
 	}
-	if ((dd->quote_mode == -1) && dd->indent) {
-	    rc = sqlite3_step(stmt);
-	    while (rc == SQLITE_ROW) {
-		const char *text = (const char *) sqlite3_column_text(stmt, 1);
-
-		append(&hdr, "quote_csv(", 0);
-		append(&hdr, text, '"');
-		rc = sqlite3_step(stmt);
-		if (rc == SQLITE_ROW) {
-		    append(&hdr, ") || ',' || ", 0);
-		} else {
-		    append(&hdr, ")", 0);
-		}
-	    }
-	    if (rc != SQLITE_DONE) {
-		goto bailout1;
-	    }
-	    sqlite3_reset(stmt);
-	}
-	if (dd->quote_mode >= 0) {
-	    append(&select, " || ' VALUES(' || ", 0);
-	}
+	append(&select, " || ' VALUES(' || ", 0);
 	rc = sqlite3_step(stmt);
 	while (rc == SQLITE_ROW) {
 	    const char *text = (const char *) sqlite3_column_text(stmt, 1);
-	    const char *type = (const char *) sqlite3_column_text(stmt, 2);
-	    int tlen = strlen(type ? type : "");
-
-	    if (dd->quote_mode < -1) {
-		sprintf(buffer, "indent_xml(%d)", dd->indent + 1);
-		append(&select, buffer, 0);
-		append(&select, "|| '<' || quote_xml(", 0);
-		append(&select, text, '\'');
-		append(&select, ",-1) || quote_xml(", 0);
-		append(&select, text, '"');
-		append(&select, ",1) || '</' || quote_xml(", 0);
-		append(&select, text, '\'');
-		append(&select, ",-1) || '>\n'", 0);
-	    } else if (dd->quote_mode < 0) {
-		/* leave out BLOB columns */
-		if (((tlen >= 4) && (strncasecmp(type, "BLOB", 4) == 0)) ||
-		    ((tlen >= 6) && (strncasecmp(type, "BINARY", 6) == 0))) {
-		    rc = sqlite3_step(stmt);
-		    if (rc != SQLITE_ROW) {
-			tlen = strlen(select);
-			if (tlen > 10) {
-			    select[tlen - 10] = '\0';
-			}
-		    }
-		    continue;
-		}
-		append(&select, "quote_csv(", 0);
-		append(&select, text, '"');
-	    } else {
-		append(&select, "quote_sql(", 0);
-		append(&select, text, '"');
-		if (dd->quote_mode) {
-		    char mbuf[32];
 
-		    sprintf(mbuf, ",%d", dd->quote_mode);
-		    append(&select, mbuf, 0);
-		}
+	    append(&select, "quote_sql(", 0);
+	    append(&select, text, '"');
+	    if (dd->quote_mode) {
+		char mbuf[32];
+
+		sprintf(mbuf, ",%d", dd->quote_mode);
+		append(&select, mbuf, 0);
 	    }
 	    rc = sqlite3_step(stmt);
 	    if (rc == SQLITE_ROW) {
-		if (dd->quote_mode >= -1) {
-		    append(&select, ") || ',' || ", 0);
-		} else {
-		    append(&select, " || ", 0);
-		}
+		append(&select, ") || ',' || ", 0);
 	    } else {
-		if (dd->quote_mode >= -1) {
-		    append(&select, ") ", 0);
-		} else {
-		    append(&select, " ", 0);
-		}
+		append(&select, ") ", 0);
 	    }
 	}
 	if (rc != SQLITE_DONE) {
@@ -1409,29 +1841,12 @@ bailout1:
 	}
 	sqlite3_finalize(stmt);
 	stmt = 0;
-	if (dd->quote_mode >= 0) {
-	    append(&select, "|| ')' FROM ", 0);
-	} else {
-	    if ((dd->quote_mode < -1) && dd->where) {
-		sprintf(buffer, " || indent_xml(%d)", dd->indent);
-		append(&select, buffer, 0);
-		append(&select, " || '</' || quote_xml(", 0);
-		append(&select, dd->where, '"');
-		append(&select, ",-1) || '>\n' FROM ", 0);
-	    } else {
-		append(&select, "FROM ", 0);
-	    }
-	}
+	append(&select, "|| ')' FROM ", 0);
 	append(&select, table, '"');
-	if ((dd->quote_mode >= 0) && dd->where) {
+	if (dd->where) {
 	    append(&select, " ", 0);
 	    append(&select, dd->where, 0);
 	}
-	if (hdr) {
-	    rc = table_dump(dd, 0, 0, hdr);
-	    append_free(&hdr);
-	    hdr = 0;
-	}
 	rc = table_dump(dd, 0, 0, select);
 	if (rc == SQLITE_CORRUPT) {
 	    append(&select, " ORDER BY rowid DESC", 0);
@@ -1538,15 +1953,15 @@ export_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
     if (!dd->out) {
 	goto done;
     }
+    obuf_init(&dd->ob, dd->out, 0, 0, 0);
     if (nargs > 1) {
 	mode = sqlite3_value_int(args[1]);
     }
     dd->with_schema = !(mode & 1);
     dd->quote_mode = (mode >> 8) & 3;
     dd->nlines = 0;
-    if (fputs("BEGIN TRANSACTION;\n", dd->out) >= 0) {
-	dd->nlines++;
-    }
+    obuf_puts(&dd->ob, "BEGIN TRANSACTION;\n");
+    dd->nlines++;
     if (nargs <= 2) {
 	schema_dump(dd, 0,
 		    "SELECT name, type, sql FROM sqlite_master"
@@ -1577,9 +1992,9 @@ export_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
 	    }
 	}
     }
-    if (fputs("COMMIT;\n", dd->out) >= 0) {
-	dd->nlines++;
-    }
+    obuf_puts(&dd->ob, "COMMIT;\n");
+    dd->nlines++;
+    obuf_end(&dd->ob);
     fclose(dd->out);
 done:
     sqlite3_result_int(ctx, dd->nlines);
@@ -1641,6 +2056,7 @@ export_csv_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
     if (!dd->out) {
 	goto done;
     }
+    obuf_init(&dd->ob, dd->out, 0, 0, 0);
     dd->nlines = 0;
     if (nargs > 1) {
 	if (sqlite3_value_type(args[1]) != SQLITE_NULL) {
@@ -1674,6 +2090,7 @@ export_csv_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
 	    sqlite3_free(sql);
 	}
     }
+    obuf_end(&dd->ob);
     fclose(dd->out);
 done:
     sqlite3_result_int(ctx, dd->nlines);
@@ -1747,6 +2164,7 @@ export_xml_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
     if (!dd->out) {
 	goto done;
     }
+    obuf_init(&dd->ob, dd->out, 0, 0, 0);
     dd->nlines = 0;
     for (i = 3; i <= nargs - 4; i += 4) {
 	char *root = 0, *schema = 0, *sql;
@@ -1767,9 +2185,9 @@ export_xml_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
 	if (root) {
 	    indent(dd);
 	    dd->indent++;
-	    fputs("<", dd->out);
+	    obuf_puts(&dd->ob, "<");
 	    quote_xml_str(dd, root);
-	    fputs(">\n", dd->out);
+	    obuf_puts(&dd->ob, ">\n");
 	}
 	if (sqlite3_value_type(args[i + 3]) != SQLITE_NULL) {
 	    schema = (char *) sqlite3_value_text(args[i + 3]);
@@ -1788,11 +2206,12 @@ export_xml_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
 	if (root) {
 	    dd->indent--;
 	    indent(dd);
-	    fputs("</", dd->out);
+	    obuf_puts(&dd->ob, "</");
 	    quote_xml_str(dd, root);
-	    fputs(">\n", dd->out);
+	    obuf_puts(&dd->ob, ">\n");
 	}
     }
+    obuf_end(&dd->ob);
     fclose(dd->out);
 done:
     sqlite3_result_int(ctx, dd->nlines);
@@ -1839,11 +2258,13 @@ impexp_export_sql(sqlite3 *db, char *filename, int mode, ...)
     if (!dd->out) {
 	goto done;
     }
+    obuf_init(&dd->ob, dd->out, 0, 0, 0);
     dd->with_schema = !(mode & 1);
+    dd->quote_mode = (mode >> 8) & 3;
+    dd->indent = 0;
     dd->nlines = 0;
-    if (fputs("BEGIN TRANSACTION;\n", dd->out) >= 0) {
-	dd->nlines++;
-    }
+    obuf_puts(&dd->ob, "BEGIN TRANSACTION;\n");
+    dd->nlines++;
     va_start(ap, mode);
     table = va_arg(ap, char *);
     if (!table) {
@@ -1876,9 +2297,9 @@ impexp_export_sql(sqlite3 *db, char *filename, int mode, ...)
 	}
     }
     va_end(ap);
-    if (fputs("COMMIT;\n", dd->out) >= 0) {
-	dd->nlines++;
-    }
+    obuf_puts(&dd->ob, "COMMIT;\n");
+    dd->nlines++;
+    obuf_end(&dd->ob);
     fclose(dd->out);
 done:
     return dd->nlines;
@@ -1938,6 +2359,7 @@ impexp_export_csv(sqlite3 *db, char *filename, int hdr, ...)
     if (!dd->out) {
 	goto done;
     }
+    obuf_init(&dd->ob, dd->out, 0, 0, 0);
     dd->nlines = 0;
     va_start(ap, hdr);
     prefix = va_arg(ap, char *);
@@ -1963,6 +2385,7 @@ impexp_export_csv(sqlite3 *db, char *filename, int hdr, ...)
 	schema = va_arg(ap, char *);
     }
     va_end(ap);
+    obuf_end(&dd->ob);
     fclose(dd->out);
 done:
     return dd->nlines;
@@ -2012,13 +2435,14 @@ impexp_export_xml(sqlite3 *db, char *filename, int append, int indnt,
     if (!dd->out) {
 	goto done;
     }
+    obuf_init(&dd->ob, dd->out, 0, 0, 0);
     dd->nlines = 0;
     if (root) {
 	indent(dd);
 	dd->indent++;
-	fputs("<", dd->out);
+	obuf_puts(&dd->ob, "<");
 	quote_xml_str(dd, root);
-	fputs(">\n", dd->out);
+	obuf_puts(&dd->ob, ">\n");
     }
     if (!schema || (schema[0] == '\0')) {
 	schema = "sqlite_master";
@@ -2034,79 +2458,88 @@ impexp_export_xml(sqlite3 *db, char *filename, int append, int indnt,
     if (root) {
 	dd->indent--;
 	indent(dd);
-	fputs("</", dd->out);
+	obuf_puts(&dd->ob, "</");
 	quote_xml_str(dd, root);
-	fputs(">\n", dd->out);
+	obuf_puts(&dd->ob, ">\n");
     }
+    obuf_end(&dd->ob);
     fclose(dd->out);
 done:
     return dd->nlines;
 }
 
 /**
- * Write string using JSON output function
+ * Write string to JSON output
  * @param string string to be written
- * @param pfs JSON output function
+ * @param ob output buffer
  */
 
 static void
-json_pstr(const char *string, json_pfs *pfs)
+json_pstr(const char *string, obuf *ob)
 {
-    while (*string) {
-	pfs->pfunc(*string, pfs->parg);
-	string++;
-    }
+    obuf_puts(ob, string);
 }
 
 /**
- * Quote and write string using JSON output function
+ * Quote and write string to JSON output
  * @param string string to be written
- * @param pfs JSON output function
+ * @param ob output buffer
  */
 
 static void
-json_pstrq(const char *string, json_pfs *pfs)
+json_pstrq(const char *string, obuf *ob)
 {
-    impexp_putc pfunc = pfs->pfunc;
-    void *parg = pfs->parg;
+    const char *p;
     char buf[64];
 
     if (!string) {
-	json_pstr("null", pfs);
+	json_pstr("null", ob);
 	return;
     }
-    pfunc('"', parg);
+    obuf_putc(ob, '"');
     while (*string) {
+	for (p = string;
+	     (*p >= ' ') && (*p != '"') && (*p != '\\') && (*p != 0x7f);
+	     p++) {
+	    /* empty loop body */
+	}
+	if (p > string) {
+	    obuf_write(ob, string, p - string);
+	    string = p;
+	    if (!*string) {
+		break;
+	    }
+	}
 	switch (*string) {
 	case '"':
 	case '\\':
-	    pfunc('\\', parg);
-	    pfunc(*string, parg);
+	    obuf_putc(ob, '\\');
+	    obuf_putc(ob, *string);
 	    break;
 	case '\b':
-	    pfunc('\\', parg);
-	    pfunc('b', parg);
+	    obuf_putc(ob, '\\');
+	    obuf_putc(ob, 'b');
 	    break;
 	case '\f':
-	    pfunc('\\', parg);
-	    pfunc('f', parg);
+	    obuf_putc(ob, '\\');
+	    obuf_putc(ob, 'f');
 	    break;
 	case '\n':
-	    pfunc('\\', parg);
-	    pfunc('n', parg);
+	    obuf_putc(ob, '\\');
+	    obuf_putc(ob, 'n');
 	    break;
 	case '\r':
-	    pfunc('\\', parg);
-	    pfunc('r', parg);
+	    obuf_putc(ob, '\\');
+	    obuf_putc(ob, 'r');
 	    break;
 	case '\t':
-	    pfunc('\\', parg);
-	    pfunc('t', parg);
+	    obuf_putc(ob, '\\');
+	    obuf_putc(ob, 't');
 	    break;
 	default:
 	    if (((*string < ' ') && (*string > 0)) || (*string == 0x7f)) {
 		sprintf(buf, "\\u%04x", *string);
-		json_pstr(buf, pfs);
+		json_pstr(buf, ob);
 	    } else if (*string < 0) {
 		unsigned char c = string[0];
 		unsigned long uc = 0;
@@ -2165,61 +2598,59 @@ json_pstrq(const char *string, json_pfs *pfs)
 		    uc -= 0x10000;
 
 		    sprintf(buf, "\\u%04lx", 0xd800 | ((uc >> 10) & 0x3ff));
-		    json_pstr(buf, pfs);
+		    json_pstr(buf, ob);
 		    sprintf(buf, "\\u%04lx", 0xdc00 | (uc & 0x3ff));
 		} else {
 		    strcpy(buf, "\\ufffd");
 		}
-		json_pstr(buf, pfs);
+		json_pstr(buf, ob);
 	    } else {
-		pfunc(*string, parg);
+		obuf_putc(ob, *string);
 	    }
 	    break;
 	}
 	++string;
     }
-    pfunc('"', parg);
+    obuf_putc(ob, '"');
 }
 
 /**
- * Conditionally quote and write string using JSON output function
+ * Conditionally quote and write string to JSON output
  * @param string string to be written
- * @param pfs JSON output function
+ * @param ob output buffer
  */
 
 static void
-json_pstrc(const char *string, json_pfs *pfs)
+json_pstrc(const char *string, obuf *ob)
 {
     if (*string && strchr(".0123456789-+", *string)) {
-	json_pstr(string, pfs);
+	json_pstr(string, ob);
     } else {
-	json_pstrq(string, pfs);
+	json_pstrq(string, ob);
     }
 }
 
 /**
- * Write a blob as base64 string using JSON output function
+ * Write a blob as base64 string to JSON output
  * @param blk pointer to blob
  * @param len length of blob
- * @param pfs JSON output function
+ * @param ob output buffer
  */
 
 static void
-json_pb64(const unsigned char *blk, int len, json_pfs *pfs)
+json_pb64(const unsigned char *blk, int len, obuf *ob)
 {
-    impexp_putc pfunc = pfs->pfunc;
-    void *parg = pfs->parg;
     int i, reg[5];
     char buf[16];
     static const char *b64 =
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
 
     if (!blk) {
-	json_pstr("null", pfs);
+	json_pstr("null", ob);
 	return;
     }
     buf[4] = '\0';
-    pfunc('"', parg);
+    obuf_putc(ob, '"');
     for (i = 0; i < len; i += 3) {
 	reg[1] = reg[2] = reg[3] = reg[4] = 0;
 	reg[0] = blk[i];
@@ -2243,49 +2674,45 @@ json_pb64(const unsigned char *blk, int len, json_pfs *pfs)
 	} else {
 	    buf[3] = '=';
 	}
-	json_pstr(buf, pfs);
+	obuf_write(ob, buf, 4);
     }
-    pfunc('"', parg);
+    obuf_putc(ob, '"');
 }
 
 /**
  * Execute SQL and write output as JSON
  * @param db SQLite database pointer
  * @param sql SQL text
- * @param pfunc JSON output function
- * @param parg argument for output function
+ * @param ob output buffer
  * @result SQLite error code
  */
 
 static int
-json_output(sqlite3 *db, char *sql, impexp_putc pfunc, void *parg)
+json_output(sqlite3 *db, char *sql, obuf *ob)
 {
-    json_pfs pfs0, *pfs = &pfs0;
     const char *tail = sql;
     int i, nresults = 0, result = SQLITE_ERROR;
 
-    pfs->pfunc = pfunc;
-    pfs->parg = parg;
-    json_pstr("{\"sql\":", pfs);
-    json_pstrq(sql, pfs);
-    json_pstr(",\"results\":[", pfs);
+    json_pstr("{\"sql\":", ob);
+    json_pstrq(sql, ob);
+    json_pstr(",\"results\":[", ob);
     do {
 	sqlite3_stmt *stmt;
 	int firstrow = 1, nrows = 0;
 	char buf[256];
 
 	++nresults;
-	json_pstr((nresults == 1) ? "{" : ",{", pfs);
+	json_pstr((nresults == 1) ? "{" : ",{", ob);
 	result = sqlite3_prepare(db, tail, -1, &stmt, &tail);
 	if (result != SQLITE_OK) {
 doerr:
 	    if (nrows == 0) {
 		json_pstr("\"columns\":null,\"rows\":null,\"changes\":0,"
-			  "\"last_insert_rowid\":null,", pfs);
+			  "\"last_insert_rowid\":null,", ob);
 	    }
-	    json_pstr("\"error:\"", pfs);
-	    json_pstrq(sqlite3_errmsg(db), pfs);
-	    pfunc('}', parg);
+	    json_pstr("\"error:\"", ob);
+	    json_pstrq(sqlite3_errmsg(db), ob);
+	    obuf_putc(ob, '}');
 	    break;
 	}
 	result = sqlite3_step(stmt);
@@ -2294,12 +2721,12 @@ doerr:
 		for (i = 0; i < sqlite3_column_count(stmt); i++) {
 		    char *type;
 
-		    json_pstr((i == 0) ? "\"columns\":[" : ",", pfs);
-		    json_pstr("{\"name\":", pfs);
-		    json_pstrq(sqlite3_column_name(stmt, i), pfs);
-		    json_pstr(",\"decltype\":", pfs);
-		    json_pstrq(sqlite3_column_decltype(stmt, i), pfs);
-		    json_pstr(",\"type\":", pfs);
+		    json_pstr((i == 0) ? "\"columns\":[" : ",", ob);
+		    json_pstr("{\"name\":", ob);
+		    json_pstrq(sqlite3_column_name(stmt, i), ob);
+		    json_pstr(",\"decltype\":", ob);
+		    json_pstrq(sqlite3_column_decltype(stmt, i), ob);
+		    json_pstr(",\"type\":", ob);
 		    switch (sqlite3_column_type(stmt, i)) {
 		    case SQLITE_INTEGER:
 			type = "integer";
@@ -2320,11 +2747,11 @@ doerr:
 			type = "unknown";
 			break;
 		    }
-		    json_pstrq(type, pfs);
-		    pfunc('}', parg);
+		    json_pstrq(type, ob);
+		    obuf_putc(ob, '}');
 		}
 		if (i) {
-		    pfunc(']', parg);
+		    obuf_putc(ob, ']');
 		}
 		firstrow = 0;
 	    }
@@ -2332,34 +2759,34 @@ doerr:
 		break;
 	    }
 	    ++nrows;
-	    json_pstr((nrows == 1) ? ",\"rows\":[" : ",", pfs);
+	    json_pstr((nrows == 1) ? ",\"rows\":[" : ",", ob);
 	    for (i = 0; i < sqlite3_column_count(stmt); i++) {
-		pfunc((i == 0) ? '[' : ',', parg);
+		obuf_putc(ob, (i == 0) ? '[' : ',');
 		switch (sqlite3_column_type(stmt, i)) {
 		case SQLITE_INTEGER:
-		    json_pstr((char *) sqlite3_column_text(stmt, i), pfs);
+		    obuf_int64(ob, sqlite3_column_int64(stmt, i));
 		    break;
 		case SQLITE_FLOAT:
-		    json_pstrc((char *) sqlite3_column_text(stmt, i), pfs);
+		    json_pstrc((char *) sqlite3_column_text(stmt, i), ob);
 		    break;
 		case SQLITE_BLOB:
 		    json_pb64((unsigned char *) sqlite3_column_blob(stmt, i),
-			      sqlite3_column_bytes(stmt, i), pfs);
+			      sqlite3_column_bytes(stmt, i), ob);
 		    break;
 		case SQLITE_TEXT:
-		    json_pstrq((char *) sqlite3_column_text(stmt, i), pfs);
+		    json_pstrq((char *) sqlite3_column_text(stmt, i), ob);
 		    break;
 		case SQLITE_NULL:
 		default:
-		    json_pstr("null", pfs);
+		    json_pstr("null", ob);
 		    break;
 		}
 	    }
-	    json_pstr((i == 0) ? "null]" : "]", pfs);
+	    json_pstr((i == 0) ? "null]" : "]", ob);
 	    result = sqlite3_step(stmt);
 	}
 	if (nrows > 0) {
-	    pfunc(']', parg);
+	    obuf_putc(ob, ']');
 	}
 	result = sqlite3_finalize(stmt);
 	if (result != SQLITE_OK) {
@@ -2372,12 +2799,12 @@ doerr:
 #endif
 			sqlite3_changes(db),
 			sqlite3_last_insert_rowid(db));
-		json_pstr(buf, pfs);
+		json_pstr(buf, ob);
 	    }
 	    goto doerr;
 	}
 	if (nrows == 0) {
-	    json_pstr("\"columns\":null,\"rows\":null", pfs);
+	    json_pstr("\"columns\":null,\"rows\":null", ob);
 	}
 	sprintf(buf,
 #ifdef _WIN32
@@ -2387,10 +2814,10 @@ doerr:
 #endif
 		sqlite3_changes(db),
 		sqlite3_last_insert_rowid(db));
-	json_pstr(buf, pfs);
-	json_pstr(",\"error\":null}", pfs);
+	json_pstr(buf, ob);
+	json_pstr(",\"error\":null}", ob);
     } while (tail && *tail);
-    json_pstr("]}", pfs);
+    json_pstr("]}", ob);
     return result;
 }
 
@@ -2445,7 +2872,13 @@ export_json_func(sqlite3_context *ctx, int nargs, sqlite3_value **args)
 	sql = (char *) sqlite3_value_text(args[1]);
     }
     if (sql) {
-	result = json_output(db, sql, (impexp_putc) fputc, out);
+	obuf ob;
+
+	obuf_init(&ob, out, 0, 0, 0);
+	result = json_output(db, sql, &ob);
+	if (!obuf_end(&ob) && (result == SQLITE_OK)) {
+	    result = SQLITE_IOERR;
+	}
     }
     fclose(out);
 done:
@@ -2458,7 +2891,30 @@ int
 impexp_export_json(sqlite3 *db, char *sql, impexp_putc pfunc,
 		   void *parg)
 {
-    return json_output(db, sql, pfunc, parg);
+    obuf ob;
+    int result;
+
+    obuf_init(&ob, 0, 0, pfunc, parg);
+    result = json_output(db, sql, &ob);
+    obuf_end(&ob);
+    return result;
+}
+
+/* see doc in impexp.h */
+
+int
+impexp_export_json_write(sqlite3 *db, char *sql, impexp_write wfunc,
+			 void *warg)
+{
+    obuf ob;
+    int result;
+
+    obuf_init(&ob, 0, wfunc, 0, warg);
+    result = json_output(db, sql, &ob);
+    if (!obuf_end(&ob) && (result == SQLITE_OK)) {
+	result = SQLITE_IOERR;
+    }
+    return result;
 }
 
 /**
@@ -206,6 +206,29 @@ typedef void (*impexp_putc)(int c, void *arg);
 int impexp_export_json(sqlite3 *db, char *sql, impexp_putc pfunc,
 		       void *parg);
 
+/**
+ * @typedef impexp_write
+ * The function pointer for the output function to
+ * "impexp_export_json_write" receives spans of output
+ * of up to 1 MB, it returns a negative value to signal
+ * a write error.
+ */
+
+typedef int (*impexp_write)(const char *data, int len, void *arg);
+
+/**
+ * Same as "impexp_export_json" but delivers the output
+ * in spans instead of single characters.
+ * @param db SQLite database pointer
+ * @param sql SQL to be executed
+ * @param wfunc pointer to output function
+ * @param warg argument for output function
+ * @result SQLite error code
+ */
+
+int impexp_export_json_write(sqlite3 *db, char *sql, impexp_write wfunc,
+			     void *warg);
+
 /**
  * Registers the SQLite functions
  * @param db SQLite database pointer
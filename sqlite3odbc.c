@@ -45,8 +45,16 @@ static struct dl_sqlite3_funcs {
     int (*bind_int64)(sqlite3_stmt *p0, int p1, sqlite_int64 p2);
     int (*bind_null)(sqlite3_stmt *p0, int p1);
     int (*bind_parameter_count)(sqlite3_stmt *p0);
+    int (*bind_zeroblob)(sqlite3_stmt *p0, int p1, int p2);
     int (*bind_text)(sqlite3_stmt *p0, int p1, const char *p2, int p3,
 		     void (*p4)(void *));
+    int (*blob_bytes)(sqlite3_blob *p0);
+    int (*blob_close)(sqlite3_blob *p0);
+    int (*blob_open)(sqlite3 *p0, const char *p1, const char *p2,
+		     const char *p3, sqlite_int64 p4, int p5,
+		     sqlite3_blob **p6);
+    int (*blob_read)(sqlite3_blob *p0, void *p1, int p2, int p3);
+    int (*blob_write)(sqlite3_blob *p0, const void *p1, int p2, int p3);
     int (*busy_handler)(sqlite3 *p0, int (*p2)(void *, int), void *p3);
     int (*changes)(sqlite3 *p0);
     int (*close)(sqlite3 *p0);
@@ -56,6 +64,7 @@ static struct dl_sqlite3_funcs {
     const char * (*column_database_name)(sqlite3_stmt *p0, int p1);
     const char * (*column_decltype)(sqlite3_stmt *p0, int p1);
     double (*column_double)(sqlite3_stmt *p0, int p1);
+    sqlite_int64 (*column_int64)(sqlite3_stmt *p0, int p1);
     const char * (*column_name)(sqlite3_stmt *p0, int p1);
     const char * (*column_origin_name)(sqlite3_stmt *p0, int p1);
     const char * (*column_table_name)(sqlite3_stmt *p0, int p1);
@@ -66,6 +75,10 @@ static struct dl_sqlite3_funcs {
 			   void (*p5)(sqlite3_context *, int, sqlite3_value **),
 			   void (*p6)(sqlite3_context *, int, sqlite3_value **),
 			   void (*p7)(sqlite3_context *));
+    int (*create_module_v2)(sqlite3 *p0, const char *p1,
+			    const sqlite3_module *p2, void *p3,
+			    void (*p4)(void *));
+    int (*declare_vtab)(sqlite3 *p0, const char *p1);
     int (*enable_load_extension)(sqlite3 *p0, int p1);
     int (*errcode)(sqlite3 *p0);
     const char * (*errmsg)(sqlite3 *p0);
@@ -75,6 +88,7 @@ static struct dl_sqlite3_funcs {
     int (*finalize)(sqlite3_stmt *p0);
     void (*free)(void *p0);
     void (*free_table)(char **p0);
+    int (*get_autocommit)(sqlite3 *p0);
     int (*get_table)(sqlite3 *p0, const char *p1, char ***p2,
 		     int *p3, int *p4, char **p5);
     void (*interrupt)(sqlite3 *p0);
@@ -102,8 +116,12 @@ static struct dl_sqlite3_funcs {
 			int p2, void (*p3)(void *));
     void (*result_error)(sqlite3_context *p0, const char *p1, int p2);
     void (*result_int)(sqlite3_context *p0, int p1);
+    void (*result_int64)(sqlite3_context *p0, sqlite_int64 p1);
     void (*result_null)(sqlite3_context *p0);
+    void (*result_text)(sqlite3_context *p0, const char *p1, int p2,
+			void (*p3)(void *));
     int (*step)(sqlite3_stmt *p0);
+    char * (*xsnprintf)(int p0, char *p1, const char *p2, ...);
     int (*xstrnicmp)(const char *p0, const char *p1, int p2);
     int (*table_column_metadata)(sqlite3 *p0, const char *p1,
 				 const char *p2, const char *p3,
@@ -125,6 +143,12 @@ static struct dl_sqlite3_funcs {
 #define sqlite3_bind_null             dls_funcs.bind_null
 #define sqlite3_bind_parameter_count  dls_funcs.bind_parameter_count
 #define sqlite3_bind_text             dls_funcs.bind_text
+#define sqlite3_bind_zeroblob         dls_funcs.bind_zeroblob
+#define sqlite3_blob_bytes            dls_funcs.blob_bytes
+#define sqlite3_blob_close            dls_funcs.blob_close
+#define sqlite3_blob_open             dls_funcs.blob_open
+#define sqlite3_blob_read             dls_funcs.blob_read
+#define sqlite3_blob_write            dls_funcs.blob_write
 #define sqlite3_busy_handler          dls_funcs.busy_handler
 #define sqlite3_changes               dls_funcs.changes
 #define sqlite3_close                 dls_funcs.close
@@ -134,12 +158,15 @@ static struct dl_sqlite3_funcs {
 #define sqlite3_column_database_name  dls_funcs.column_database_name
 #define sqlite3_column_decltype       dls_funcs.column_decltype
 #define sqlite3_column_double         dls_funcs.column_double
+#define sqlite3_column_int64          dls_funcs.column_int64
 #define sqlite3_column_name           dls_funcs.column_name
 #define sqlite3_column_origin_name    dls_funcs.column_origin_name
 #define sqlite3_column_table_name     dls_funcs.column_table_name
 #define sqlite3_column_text           dls_funcs.column_text
 #define sqlite3_column_type           dls_funcs.column_type
 #define sqlite3_create_function       dls_funcs.create_function
+#define sqlite3_create_module_v2      dls_funcs.create_module_v2
+#define sqlite3_declare_vtab          dls_funcs.declare_vtab
 #define sqlite3_enable_load_extension dls_funcs.enable_load_extension
 #define sqlite3_errcode               dls_funcs.errcode
 #define sqlite3_errmsg                dls_funcs.errmsg
@@ -147,6 +174,7 @@ static struct dl_sqlite3_funcs {
 #define sqlite3_finalize              dls_funcs.finalize
 #define sqlite3_free                  dls_funcs.free
 #define sqlite3_free_table            dls_funcs.free_table
+#define sqlite3_get_autocommit        dls_funcs.get_autocommit
 #define sqlite3_get_table             dls_funcs.get_table
 #define sqlite3_interrupt             dls_funcs.interrupt
 #define sqlite3_key                   dls_funcs.key
@@ -167,8 +195,11 @@ static struct dl_sqlite3_funcs {
 #define sqlite3_result_blob           dls_funcs.result_blob
 #define sqlite3_result_error          dls_funcs.result_error
 #define sqlite3_result_int            dls_funcs.result_int
+#define sqlite3_result_int64          dls_funcs.result_int64
 #define sqlite3_result_null           dls_funcs.result_null
+#define sqlite3_result_text           dls_funcs.result_text
 #define sqlite3_step                  dls_funcs.step
+#define sqlite3_snprintf              dls_funcs.xsnprintf
 #define sqlite3_strnicmp              dls_funcs.xstrnicmp
 #define sqlite3_table_column_metadata dls_funcs.table_column_metadata
 #define sqlite3_trace                 dls_funcs.trace
@@ -249,6 +280,22 @@ static struct dl_sqlite3_funcs {
 #endif
 #endif
 
+/* Incremental blob I/O support */
+#undef USE_LOBSTREAM
+#if defined(HAVE_SQLITE3BLOBOPEN) && (HAVE_SQLITE3BLOBOPEN)
+#define USE_LOBSTREAM 1
+#endif
+
+/* SSE2 for ASCII runs in UTF8/UNICODE conversions */
+#undef USE_SSE2
+#if defined(WCHARSUPPORT) && !defined(WITHOUT_SSE2)
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define USE_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
 /* Column types for static string column descriptions (SQLTables etc.) */
 
 #if defined(WINTERFACE) && !defined(_WIN32) && !defined(_WIN64)
@@ -505,6 +552,85 @@ static int strcasecmp_(const char *a, const char *b)
 	}					\
     }
 
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+
+/*
+ * SQLHENV, SQLHDBC, and SQLHSTMT synchronization
+ * is done using a recursive pthread mutex in ENV and
+ * DBC structures. The owner of the DBC mutex is recorded
+ * for SQLCancel() like with the Win32 critical section.
+ */
+
+#define HDBC_LOCK(hdbc)				\
+{						\
+    DBC *d;					\
+						\
+    if ((hdbc) == SQL_NULL_HDBC) {		\
+	return SQL_INVALID_HANDLE;		\
+    }						\
+    d = (DBC *) (hdbc);				\
+    if (d->magic != DBC_MAGIC) {		\
+	return SQL_INVALID_HANDLE;		\
+    }						\
+    pthread_mutex_lock(&d->mutex);		\
+    d->owner = pthread_self();			\
+    d->nlock++;					\
+}
+
+#define HDBC_UNLOCK(hdbc)			\
+    if ((hdbc) != SQL_NULL_HDBC) {		\
+	DBC *d;					\
+						\
+	d = (DBC *) (hdbc);			\
+	if (d->magic == DBC_MAGIC) {		\
+	    d->nlock--;				\
+	    pthread_mutex_unlock(&d->mutex);	\
+	}					\
+    }
+
+#define HSTMT_LOCK(hstmt)			\
+{						\
+    DBC *d;					\
+						\
+    if ((hstmt) == SQL_NULL_HSTMT) {		\
+	return SQL_INVALID_HANDLE;		\
+    }						\
+    d = (DBC *) ((STMT *) (hstmt))->dbc;	\
+    if (d->magic != DBC_MAGIC) {		\
+	return SQL_INVALID_HANDLE;		\
+    }						\
+    pthread_mutex_lock(&d->mutex);		\
+    d->owner = pthread_self();			\
+    d->nlock++;					\
+}
+
+#define HSTMT_UNLOCK(hstmt)			\
+    if ((hstmt) != SQL_NULL_HSTMT) {		\
+	DBC *d;					\
+						\
+	d = (DBC *) ((STMT *) (hstmt))->dbc;	\
+	if (d->magic == DBC_MAGIC) {		\
+	    d->nlock--;				\
+	    pthread_mutex_unlock(&d->mutex);	\
+	}					\
+    }
+
+/**
+ * Initialize recursive mutex of ENV or DBC.
+ * @param m pointer to mutex
+ */
+
+static void
+initmutex(pthread_mutex_t *m)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
 #else
 
 /*
@@ -583,15 +709,28 @@ static const char space_chars[] = " \f\n\r\t\v";
  */
 
 static void dbtraceapi(DBC *d, char *fn, const char *sql);
+static void trcparam(DBC *d, int n, BINDPARM *p);
 static void freedyncols(STMT *s);
+static void getdynmeta(STMT *s, int col);
 static void freeresult(STMT *s, int clrcols);
 static void freerows(char **rowp);
 static void unbindcols(STMT *s);
 static void s3stmt_drop(STMT *s);
+static sqlite3_stmt *s3cache_get(DBC *d, const char *sql);
+static void s3cache_put(DBC *d, const char *sql, sqlite3_stmt *stmt);
+static void s3cache_flush(DBC *d);
+static int sccache_get_table(DBC *d, const char *sql, char ***rowpp,
+			     int *nrowp, int *ncolp, char **errp);
+static void sccache_free_table(DBC *d, char **rowp);
+static void sccache_check(DBC *d);
+static void sccache_flush(DBC *d);
+static void s3stmt_unstream(STMT *s);
+static void s3stmt_spillall(DBC *d);
 
 static SQLRETURN drvexecute(SQLHSTMT stmt, int initial);
 static SQLRETURN freestmt(HSTMT stmt);
 static SQLRETURN mkbindcols(STMT *s, int ncols);
+static void mkbindconv(STMT *s, int col);
 static SQLRETURN setupdyncols(STMT *s, sqlite3_stmt *s3stmt, int *ncolsp);
 static SQLRETURN setupparbuf(STMT *s, BINDPARM *p);
 static SQLRETURN starttran(STMT *s);
@@ -788,6 +927,146 @@ dsfree(dstr *dsp)
     }
 }
 
+/* Initial and maximum size of blocks of an arena */
+
+#define ARENA_MINBLK 16384
+#define ARENA_MAXBLK (1024 * 1024)
+
+/**
+ * Allocate memory from arena.
+ * @param a arena pointer
+ * @param n number of bytes to allocate
+ * @result pointer to memory, aligned for any scalar type, or NULL
+ *
+ * Requests larger than half of the current block size are
+ * satisfied from a dedicated block, which is chained behind
+ * the current block in order to keep its free space usable.
+ */
+
+static void *
+arena_alloc(ARENA *a, int n)
+{
+    ARENABLK *blk = a->blk;
+    int size;
+
+    n = (n + sizeof (double) - 1) & ~(sizeof (double) - 1);
+    a->inuse += n;
+    if (a->inuse > a->hiwater) {
+	a->hiwater = a->inuse;
+    }
+    if (blk && blk->used + n <= blk->size) {
+	void *p = (char *) blk->data + blk->used;
+
+	blk->used += n;
+	return p;
+    }
+    size = blk ? blk->size * 2 : ARENA_MINBLK;
+    if (size > ARENA_MAXBLK) {
+	size = ARENA_MAXBLK;
+    }
+    if (blk && n > size / 2) {
+	ARENABLK *big = xmalloc(offsetof(ARENABLK, data) + n);
+
+	if (!big) {
+	    a->inuse -= n;
+	    return NULL;
+	}
+	big->size = big->used = n;
+	big->next = blk->next;
+	blk->next = big;
+	a->reserved += n;
+	return big->data;
+    }
+    if (size < n) {
+	size = n;
+    }
+    blk = xmalloc(offsetof(ARENABLK, data) + size);
+    if (!blk) {
+	a->inuse -= n;
+	return NULL;
+    }
+    blk->size = size;
+    blk->used = n;
+    blk->next = a->blk;
+    a->blk = blk;
+    a->reserved += size;
+    return blk->data;
+}
+
+/**
+ * Duplicate string into arena.
+ * @param a arena pointer
+ * @param str string to be duplicated
+ * @result pointer to new string or NULL
+ */
+
+static char *
+arena_strdup(ARENA *a, const char *str)
+{
+    char *p = NULL;
+
+    if (str) {
+	int n = strlen(str) + 1;
+
+	p = arena_alloc(a, n);
+	if (p) {
+	    memcpy(p, str, n);
+	}
+    }
+    return p;
+}
+
+/**
+ * Release all memory of arena except its current block.
+ * @param a arena pointer
+ *
+ * The current block is the largest regular block, keeping it
+ * lets a result set of similar size be built without any call
+ * into the general purpose allocator.
+ */
+
+static void
+arena_reset(ARENA *a)
+{
+    ARENABLK *blk = a->blk;
+
+    a->inuse = 0;
+    if (!blk) {
+	return;
+    }
+    while (blk->next) {
+	ARENABLK *next = blk->next;
+
+	blk->next = next->next;
+	xfree(next);
+    }
+    if (blk->size > ARENA_MAXBLK) {
+	xfree(blk);
+	a->blk = NULL;
+	a->reserved = 0;
+    } else {
+	blk->used = 0;
+	a->reserved = blk->size;
+    }
+}
+
+/**
+ * Release all memory of arena.
+ * @param a arena pointer
+ */
+
+static void
+arena_free(ARENA *a)
+{
+    while (a->blk) {
+	ARENABLK *next = a->blk->next;
+
+	xfree(a->blk);
+	a->blk = next;
+    }
+    a->reserved = a->inuse = 0;
+}
+
 #ifdef WCHARSUPPORT
 
 /**
@@ -836,10 +1115,228 @@ uc_strncpy(SQLWCHAR *dest, SQLWCHAR *src, int len)
     return dest;
 }
 
+/**
+ * Widen leading run of ASCII characters of UTF8 string to UNICODE.
+ * @param str UTF8 string
+ * @param len length of str in bytes
+ * @param uc destination area
+ * @param ucLen length of destination area in characters
+ * @result number of characters converted, the run ends
+ * before the first NUL or non-ASCII byte
+ */
+
+static int
+utf_ascii(unsigned char *str, int len, SQLWCHAR *uc, int ucLen)
+{
+    int n = 0;
+
+    if (len > ucLen) {
+	len = ucLen;
+    }
+#ifdef USE_SSE2
+    while (n + 16 <= len) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_loadu_si128((__m128i *) (str + n));
+
+	if (_mm_movemask_epi8(v) |
+	    _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))) {
+	    break;
+	}
+	if (sizeof (SQLWCHAR) == 2) {
+	    _mm_storeu_si128((__m128i *) (uc + n),
+			     _mm_unpacklo_epi8(v, zero));
+	    _mm_storeu_si128((__m128i *) (uc + n + 8),
+			     _mm_unpackhi_epi8(v, zero));
+	} else if (sizeof (SQLWCHAR) == 4) {
+	    __m128i lo = _mm_unpacklo_epi8(v, zero);
+	    __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+	    _mm_storeu_si128((__m128i *) (uc + n),
+			     _mm_unpacklo_epi16(lo, zero));
+	    _mm_storeu_si128((__m128i *) (uc + n + 4),
+			     _mm_unpackhi_epi16(lo, zero));
+	    _mm_storeu_si128((__m128i *) (uc + n + 8),
+			     _mm_unpacklo_epi16(hi, zero));
+	    _mm_storeu_si128((__m128i *) (uc + n + 12),
+			     _mm_unpackhi_epi16(hi, zero));
+	} else {
+	    break;
+	}
+	n += 16;
+    }
+#else
+    while (n + 4 <= len) {
+	unsigned int w;
+
+	memcpy(&w, str + n, 4);
+	/* any byte NUL or >= 0x80 */
+	if (((w - 0x01010101) | w) & 0x80808080) {
+	    break;
+	}
+	uc[n] = str[n];
+	uc[n + 1] = str[n + 1];
+	uc[n + 2] = str[n + 2];
+	uc[n + 3] = str[n + 3];
+	n += 4;
+    }
+#endif
+    while (n < len && str[n] && str[n] < 0x80) {
+	uc[n] = str[n];
+	++n;
+    }
+    return n;
+}
+
+/**
+ * Narrow leading run of ASCII characters of UNICODE string to UTF8.
+ * @param str UNICODE string
+ * @param len length of str in characters
+ * @param cp destination area
+ * @result number of characters converted, the run ends
+ * before the first character above 0x7F
+ */
+
+static int
+uc_ascii(SQLWCHAR *str, int len, char *cp)
+{
+    int n = 0;
+
+#ifdef USE_SSE2
+    if (sizeof (SQLWCHAR) == 2) {
+	__m128i mask = _mm_set1_epi16((short) 0xff80);
+	__m128i zero = _mm_setzero_si128();
+
+	while (n + 8 <= len) {
+	    __m128i v = _mm_loadu_si128((__m128i *) (str + n));
+
+	    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask),
+						  zero)) != 0xffff) {
+		break;
+	    }
+	    _mm_storel_epi64((__m128i *) (cp + n), _mm_packus_epi16(v, v));
+	    n += 8;
+	}
+    } else if (sizeof (SQLWCHAR) == 4) {
+	__m128i mask = _mm_set1_epi32((int) 0xffffff80);
+	__m128i zero = _mm_setzero_si128();
+
+	while (n + 8 <= len) {
+	    __m128i v1 = _mm_loadu_si128((__m128i *) (str + n));
+	    __m128i v2 = _mm_loadu_si128((__m128i *) (str + n + 4));
+	    __m128i hi = _mm_and_si128(_mm_or_si128(v1, v2), mask);
+
+	    if (_mm_movemask_epi8(_mm_cmpeq_epi32(hi, zero)) != 0xffff) {
+		break;
+	    }
+	    v1 = _mm_packs_epi32(v1, v2);
+	    _mm_storel_epi64((__m128i *) (cp + n), _mm_packus_epi16(v1, v1));
+	    n += 8;
+	}
+    }
+#endif
+    while (n < len) {
+	unsigned long c = str[n];
+
+	if (sizeof (SQLWCHAR) == 2 * sizeof (char)) {
+	    c &= 0xffff;
+	}
+	if (c >= 0x80) {
+	    break;
+	}
+	cp[n] = c;
+	++n;
+    }
+    return n;
+}
+
+/**
+ * Make UNICODE string from UTF8 string into buffer, no terminator.
+ * @param str UTF8 string to be converted
+ * @param len length in bytes of str
+ * @param uc destination area to receive UNICODE string
+ * @param ucLen length of destination area in characters
+ * @param usedp receives number of bytes of str converted, or NULL
+ * @result number of characters stored
+ *
+ * Conversion stops at the first NUL byte, after len bytes, or
+ * when the destination area is full.
+ */
+
+static int
+uc_from_utf_len(unsigned char *str, int len, SQLWCHAR *uc, int ucLen,
+		int *usedp)
+{
+    unsigned char *end = str + len, *start = str;
+    int i = 0;
+
+    while (i < ucLen && str < end && *str) {
+	unsigned char c = str[0];
+
+	if (c < 0x80) {
+	    int n = utf_ascii(str, end - str, uc + i, ucLen - i);
+
+	    i += n;
+	    str += n;
+	} else if (c <= 0xc1 || c >= 0xf5) {
+	    /* illegal, ignored */
+	    ++str;
+	} else if (c < 0xe0) {
+	    if (str + 1 < end && (str[1] & 0xc0) == 0x80) {
+		unsigned long t = ((c & 0x1f) << 6) | (str[1] & 0x3f);
+
+		uc[i++] = t;
+		str += 2;
+	    } else {
+		uc[i++] = c;
+		++str;
+	    }
+	} else if (c < 0xf0) {
+	    if (str + 2 < end &&
+		(str[1] & 0xc0) == 0x80 && (str[2] & 0xc0) == 0x80) {
+		unsigned long t = ((c & 0x0f) << 12) |
+		    ((str[1] & 0x3f) << 6) | (str[2] & 0x3f);
+
+		uc[i++] = t;
+		str += 3;
+	    } else {
+		uc[i++] = c;
+		++str;
+	    }
+	} else {
+	    if (str + 3 < end &&
+		(str[1] & 0xc0) == 0x80 && (str[2] & 0xc0) == 0x80 &&
+		(str[3] & 0xc0) == 0x80) {
+		unsigned long t = ((c & 0x07) << 18) |
+		    ((str[1] & 0x3f) << 12) | ((str[2] & 0x3f) << 6) |
+		    (str[3] & 0x3f);
+
+		if (sizeof (SQLWCHAR) == 2 * sizeof (char) &&
+		    t >= 0x10000) {
+		    t -= 0x10000;
+		    uc[i++] = 0xd800 | ((t >> 10) & 0x3ff);
+		    if (i >= ucLen) {
+			break;
+		    }
+		    t = 0xdc00 | (t & 0x3ff);
+		}
+		uc[i++] = t;
+		str += 4;
+	    } else {
+		uc[i++] = c;
+		++str;
+	    }
+	}
+    }
+    if (usedp) {
+	*usedp = str - start;
+    }
+    return i;
+}
+
 /**
  * Make UNICODE string from UTF8 string into buffer.
  * @param str UTF8 string to be converted
- * @param len length in characters of str or -1
+ * @param len length in bytes of str or -1
  * @param uc destination area to receive UNICODE string
  * @param ucLen byte length of destination area
  */
@@ -851,70 +1348,14 @@ uc_from_utf_buf(unsigned char *str, int len, SQLWCHAR *uc, int ucLen)
     if (!uc || ucLen < 0) {
 	return;
     }
-    if (len < 0) {
-	len = ucLen * 5;
-    }
     uc[0] = 0;
     if (str) {
-	int i = 0;
-
-	while (i < len && *str && i < ucLen) {
-	    unsigned char c = str[0];
-
-	    if (c < 0x80) {
-		uc[i++] = c;
-		++str;
-	    } else if (c <= 0xc1 || c >= 0xf5) {
-		/* illegal, ignored */
-		++str;
-	    } else if (c < 0xe0) {
-		if ((str[1] & 0xc0) == 0x80) {
-		    unsigned long t = ((c & 0x1f) << 6) | (str[1] & 0x3f);
-
-		    uc[i++] = t;
-		    str += 2;
-		} else {
-		    uc[i++] = c;
-		    ++str;
-		}
-	    } else if (c < 0xf0) {
-		if ((str[1] & 0xc0) == 0x80 && (str[2] & 0xc0) == 0x80) {
-		    unsigned long t = ((c & 0x0f) << 12) |
-			((str[1] & 0x3f) << 6) | (str[2] & 0x3f);
+	int i;
 
-		    uc[i++] = t;
-		    str += 3;
-		} else {
-		    uc[i++] = c;
-		    ++str;
-		}
-	    } else if (c < 0xf8) {
-		if ((str[1] & 0xc0) == 0x80 && (str[2] & 0xc0) == 0x80 &&
-		    (str[3] & 0xc0) == 0x80) {
-		    unsigned long t = ((c & 0x03) << 18) |
-			((str[1] & 0x3f) << 12) | ((str[2] & 0x3f) << 6) |
-			(str[3] & 0x3f);
-
-		    if (sizeof (SQLWCHAR) == 2 * sizeof (char) &&
-			t >= 0x10000) {
-			t -= 0x10000;
-			uc[i++] = 0xd800 | ((t >> 10) & 0x3ff);
-			if (i >= ucLen) {
-			    break;
-			}
-			t = 0xdc00 | (t & 0x3ff);
-		    }
-		    uc[i++] = t;
-		    str += 4;
-		} else {
-		    uc[i++] = c;
-		    ++str;
-		}
-	    } else {
-		/* ignore */
-		++str;
-	    }
+	if (len < 0) {
+	    len = strlen((char *) str);
 	}
+	i = uc_from_utf_len(str, len, uc, ucLen, NULL);
 	if (i < ucLen) {
 	    uc[i] = 0;
 	}
@@ -932,16 +1373,14 @@ static SQLWCHAR *
 uc_from_utf(unsigned char *str, int len)
 {
     SQLWCHAR *uc = NULL;
-    int ucLen;
 
     if (str) {
 	if (len == SQL_NTS) {
 	    len = strlen((char *) str);
 	}
-	ucLen = sizeof (SQLWCHAR) * (len + 1);
-	uc = xmalloc(ucLen);
+	uc = xmalloc(sizeof (SQLWCHAR) * (len + 1));
 	if (uc) {
-	    uc_from_utf_buf(str, len, uc, ucLen);
+	    uc[uc_from_utf_len(str, len, uc, len, NULL)] = 0;
 	}
     }
     return uc;
@@ -980,7 +1419,10 @@ uc_to_utf(SQLWCHAR *str, int len)
 	    c &= 0xffff;
 	}
 	if (c < 0x80) {
-	    *cp++ = c;
+	    int n = uc_ascii(str + i, len - i, cp);
+
+	    cp += n;
+	    i += n - 1;
 	} else if (c < 0x800) {
 	    *cp++ = 0xc0 | ((c >> 6) & 0x1f);
 	    *cp++ = 0x80 | (c & 0x3f);
@@ -1293,11 +1735,13 @@ drvgpps(DBC *d, char *sect, char *ent, char *def, char *buf,
 #endif
 
 /*
- * Internal function to bind SQLite3 parameters.
+ * Internal function to bind SQLite3 parameters. Text and blob
+ * values are copied by SQLite when "copy" is true, i.e. when the
+ * statement outlives the parameter buffers.
  */
 
 static void
-s3bind(DBC *d, sqlite3_stmt *stmt, int nparams, BINDPARM *p)
+s3bind(DBC *d, sqlite3_stmt *stmt, int nparams, BINDPARM *p, int copy)
 {
     int i;
 
@@ -1314,7 +1758,7 @@ s3bind(DBC *d, sqlite3_stmt *stmt, int nparams, BINDPARM *p)
 		break;
 	    case SQLITE_TEXT:
 		sqlite3_bind_text(stmt, i + 1, p->s3val, p->s3size,
-				  SQLITE_STATIC);
+				  copy ? SQLITE_TRANSIENT : SQLITE_STATIC);
 		if (d->trace) {
 		    fprintf(d->trace, "-- parameter %d: '%*s'\n", i + 1,
 			    p->s3size, (char *) p->s3val);
@@ -1322,8 +1766,19 @@ s3bind(DBC *d, sqlite3_stmt *stmt, int nparams, BINDPARM *p)
 		}
 		break;
 	    case SQLITE_BLOB:
+#ifdef USE_LOBSTREAM
+		if (p->lobzero) {
+		    sqlite3_bind_zeroblob(stmt, i + 1, p->s3size);
+		    if (d->trace) {
+			fprintf(d->trace, "-- parameter %d: [ZEROBLOB]\n",
+				i + 1);
+			fflush(d->trace);
+		    }
+		    break;
+		}
+#endif
 		sqlite3_bind_blob(stmt, i + 1, p->s3val, p->s3size,
-				  SQLITE_STATIC);
+				  copy ? SQLITE_TRANSIENT : SQLITE_STATIC);
 		if (d->trace) {
 		    fprintf(d->trace, "-- parameter %d: [BLOB]'\n", i + 1);
 		    fflush(d->trace);
@@ -1360,75 +1815,514 @@ s3bind(DBC *d, sqlite3_stmt *stmt, int nparams, BINDPARM *p)
 		}
 		break;
 	    }
+	    if (d->trcbuf) {
+		trcparam(d, i + 1, p);
+	    }
 	}
     }
 }
 
+#ifdef USE_LOBSTREAM
+
 /**
- * @typedef TBLRES
- * @struct tblres
- * Internal structure for managing driver's
- * sqlite3_get_table() implementation.
+ * Decide if large blobs of a result set can be left in the
+ * database and read later using sqlite3_blob_read().
+ * @param s statement pointer
+ * @param ncols number of columns
+ *
+ * This requires a single table SELECT whose result contains
+ * the ROWID. On success s->lobmin is set to the blob size from
+ * which on blobs are deferred, otherwise to -1.
  */
 
-typedef struct tblres {
-    char **resarr;	/**< result array */
+static void
+lobsetup(STMT *s, int ncols)
+{
+    DBC *d = (DBC *) s->dbc;
+    char **names;
+    int i;
+
+    s->lobmin = -1;
+    s->lobcols = NULL;
+#ifdef FULL_METADATA
+    if (d->lobstream <= 0 || s->isselect != 1 ||
+	!s->dyncols || s->dcols != ncols) {
+	return;
+    }
+    getdynmeta(s, -1);
+    if (s->one_tbl <= 0 || s->has_rowid < 0) {
+	return;
+    }
+    names = arena_alloc(&s->dynarena, ncols * sizeof (char *));
+    if (!names) {
+	return;
+    }
+    for (i = 0; i < ncols; i++) {
+	names[i] = NULL;
+	if (i != s->has_rowid && s->dyncols[i].table[0]) {
+	    names[i] = s->dyncols[i].origin;
+	}
+    }
+    s->lobcols = names;
+    s->lobmin = d->lobstream;
+#endif
+}
+
+#endif
+
+/**
+ * Store values of current row of SQLite statement as typed cells.
+ * @param s statement pointer, its arena receives text/blob data
+ * @param stmt SQLite statement pointer
+ * @param c pointer to cell of first column
+ * @param stride distance between cells of adjacent columns
+ * @param ncols number of columns
+ * @result SQLite error code
+ *
+ * Integers and floats are kept in binary form. Text and blobs
+ * are copied as-is into the arena, blobs are converted to their
+ * X'..' hex literal form only on demand, see blob2hex().
+ * Blobs of at least s->lobmin bytes are deferred, i.e. stored
+ * with NULL data pointer but their length, see lobsetup().
+ */
+
+static int
+storecells(STMT *s, sqlite3_stmt *stmt, CELL *c, int stride, int ncols)
+{
+    int i;
+
+    for (i = 0; i < ncols; i++, c += stride) {
+	int nbytes;
+	char *qp;
+	unsigned const char *bp;
+
+	c->type = sqlite3_column_type(stmt, i);
+	c->len = 0;
+	switch (c->type) {
+	case SQLITE_INTEGER:
+	    c->v.i = sqlite3_column_int64(stmt, i);
+	    break;
+	case SQLITE_FLOAT:
+	    c->v.f = sqlite3_column_double(stmt, i);
+	    break;
+	case SQLITE_BLOB:
+#ifdef USE_LOBSTREAM
+	    if (!s->lobmin) {
+		lobsetup(s, ncols);
+	    }
+	    if (s->lobmin > 0 && s->lobcols[i] &&
+		sqlite3_column_bytes(stmt, i) >= s->lobmin) {
+		/* deferred, see lobopen() */
+		c->v.p = NULL;
+		c->len = sqlite3_column_bytes(stmt, i);
+		break;
+	    }
+#endif
+	    bp = sqlite3_column_blob(stmt, i);
+	    nbytes = sqlite3_column_bytes(stmt, i);
+	    qp = arena_alloc(&s->arena, nbytes + 1);
+	    if (!qp) {
+		return SQLITE_NOMEM;
+	    }
+	    if (nbytes > 0) {
+		memcpy(qp, bp, nbytes);
+	    }
+	    qp[nbytes] = '\0';
+	    c->v.p = qp;
+	    c->len = nbytes;
+	    break;
+	case SQLITE_NULL:
+	    c->v.p = NULL;
+	    break;
+	default:
+	    c->type = SQLITE_TEXT;
+	    bp = sqlite3_column_text(stmt, i);
+	    if (!bp) {
+		return SQLITE_NOMEM;
+	    }
+	    nbytes = sqlite3_column_bytes(stmt, i);
+	    qp = arena_alloc(&s->arena, nbytes + 1);
+	    if (!qp) {
+		return SQLITE_NOMEM;
+	    }
+	    memcpy(qp, bp, nbytes);
+	    qp[nbytes] = '\0';
+	    c->v.p = qp;
+	    c->len = nbytes;
+	    break;
+	}
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * Locale neutral shortest round trip formatting of doubles
+ * using the Grisu2 algorithm by Florian Loitsch, "Printing
+ * Floating-Point Numbers Quickly and Accurately with Integers".
+ * The produced digits always read back to the identical double,
+ * and are the shortest such digit string for all but very few
+ * inputs where Grisu2 emits one extra digit.
+ */
+
+/**
+ * @typedef DIYFP
+ * @struct DIYFP
+ * Internal "do it yourself" floating point number f * 2^e.
+ */
+
+typedef struct {
+    sqlite_uint64 f;	/**< Significand */
+    int e;		/**< Binary exponent */
+} DIYFP;
+
+/**
+ * Normalized powers 10^-348, 10^-340 ... 10^340 for Grisu2.
+ */
+
+static const DIYFP diyfp_pow10[] = {
+    { 0xfa8fd5a0081c0288ULL, -1220 }, { 0xbaaee17fa23ebf76ULL, -1193 },
+    { 0x8b16fb203055ac76ULL, -1166 }, { 0xcf42894a5dce35eaULL, -1140 },
+    { 0x9a6bb0aa55653b2dULL, -1113 }, { 0xe61acf033d1a45dfULL, -1087 },
+    { 0xab70fe17c79ac6caULL, -1060 }, { 0xff77b1fcbebcdc4fULL, -1034 },
+    { 0xbe5691ef416bd60cULL, -1007 }, { 0x8dd01fad907ffc3cULL, -980 },
+    { 0xd3515c2831559a83ULL, -954 }, { 0x9d71ac8fada6c9b5ULL, -927 },
+    { 0xea9c227723ee8bcbULL, -901 }, { 0xaecc49914078536dULL, -874 },
+    { 0x823c12795db6ce57ULL, -847 }, { 0xc21094364dfb5637ULL, -821 },
+    { 0x9096ea6f3848984fULL, -794 }, { 0xd77485cb25823ac7ULL, -768 },
+    { 0xa086cfcd97bf97f4ULL, -741 }, { 0xef340a98172aace5ULL, -715 },
+    { 0xb23867fb2a35b28eULL, -688 }, { 0x84c8d4dfd2c63f3bULL, -661 },
+    { 0xc5dd44271ad3cdbaULL, -635 }, { 0x936b9fcebb25c996ULL, -608 },
+    { 0xdbac6c247d62a584ULL, -582 }, { 0xa3ab66580d5fdaf6ULL, -555 },
+    { 0xf3e2f893dec3f126ULL, -529 }, { 0xb5b5ada8aaff80b8ULL, -502 },
+    { 0x87625f056c7c4a8bULL, -475 }, { 0xc9bcff6034c13053ULL, -449 },
+    { 0x964e858c91ba2655ULL, -422 }, { 0xdff9772470297ebdULL, -396 },
+    { 0xa6dfbd9fb8e5b88fULL, -369 }, { 0xf8a95fcf88747d94ULL, -343 },
+    { 0xb94470938fa89bcfULL, -316 }, { 0x8a08f0f8bf0f156bULL, -289 },
+    { 0xcdb02555653131b6ULL, -263 }, { 0x993fe2c6d07b7facULL, -236 },
+    { 0xe45c10c42a2b3b06ULL, -210 }, { 0xaa242499697392d3ULL, -183 },
+    { 0xfd87b5f28300ca0eULL, -157 }, { 0xbce5086492111aebULL, -130 },
+    { 0x8cbccc096f5088ccULL, -103 }, { 0xd1b71758e219652cULL, -77 },
+    { 0x9c40000000000000ULL, -50 }, { 0xe8d4a51000000000ULL, -24 },
+    { 0xad78ebc5ac620000ULL, 3 }, { 0x813f3978f8940984ULL, 30 },
+    { 0xc097ce7bc90715b3ULL, 56 }, { 0x8f7e32ce7bea5c70ULL, 83 },
+    { 0xd5d238a4abe98068ULL, 109 }, { 0x9f4f2726179a2245ULL, 136 },
+    { 0xed63a231d4c4fb27ULL, 162 }, { 0xb0de65388cc8ada8ULL, 189 },
+    { 0x83c7088e1aab65dbULL, 216 }, { 0xc45d1df942711d9aULL, 242 },
+    { 0x924d692ca61be758ULL, 269 }, { 0xda01ee641a708deaULL, 295 },
+    { 0xa26da3999aef774aULL, 322 }, { 0xf209787bb47d6b85ULL, 348 },
+    { 0xb454e4a179dd1877ULL, 375 }, { 0x865b86925b9bc5c2ULL, 402 },
+    { 0xc83553c5c8965d3dULL, 428 }, { 0x952ab45cfa97a0b3ULL, 455 },
+    { 0xde469fbd99a05fe3ULL, 481 }, { 0xa59bc234db398c25ULL, 508 },
+    { 0xf6c69a72a3989f5cULL, 534 }, { 0xb7dcbf5354e9beceULL, 561 },
+    { 0x88fcf317f22241e2ULL, 588 }, { 0xcc20ce9bd35c78a5ULL, 614 },
+    { 0x98165af37b2153dfULL, 641 }, { 0xe2a0b5dc971f303aULL, 667 },
+    { 0xa8d9d1535ce3b396ULL, 694 }, { 0xfb9b7cd9a4a7443cULL, 720 },
+    { 0xbb764c4ca7a44410ULL, 747 }, { 0x8bab8eefb6409c1aULL, 774 },
+    { 0xd01fef10a657842cULL, 800 }, { 0x9b10a4e5e9913129ULL, 827 },
+    { 0xe7109bfba19c0c9dULL, 853 }, { 0xac2820d9623bf429ULL, 880 },
+    { 0x80444b5e7aa7cf85ULL, 907 }, { 0xbf21e44003acdd2dULL, 933 },
+    { 0x8e679c2f5e44ff8fULL, 960 }, { 0xd433179d9c8cb841ULL, 986 },
+    { 0x9e19db92b4e31ba9ULL, 1013 }, { 0xeb96bf6ebadf77d9ULL, 1039 },
+    { 0xaf87023b9bf0ee6bULL, 1066 }
+};
+
+/**
+ * Powers of ten for Grisu2 digit generation.
+ */
+
+static const sqlite_uint64 diyfp_exp10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+/**
+ * Multiply two DIYFP numbers, upper 64 bits of product, rounded.
+ * @param x first factor
+ * @param y second factor
+ * @result product
+ */
+
+static DIYFP
+diyfp_mul(DIYFP x, DIYFP y)
+{
+    sqlite_uint64 a = x.f >> 32, b = x.f & 0xFFFFFFFF;
+    sqlite_uint64 c = y.f >> 32, d = y.f & 0xFFFFFFFF;
+    sqlite_uint64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    sqlite_uint64 tmp;
+    DIYFP r;
+
+    tmp = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+    tmp += 1U << 31;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+/**
+ * Grisu2 rounding of last generated digit towards the exact value.
+ */
+
+static void
+grisu_round(char *buf, int len, sqlite_uint64 delta, sqlite_uint64 rest,
+	    sqlite_uint64 ten_kappa, sqlite_uint64 wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+	   (rest + ten_kappa < wp_w ||
+	    wp_w - rest > rest + ten_kappa - wp_w)) {
+	buf[len - 1]--;
+	rest += ten_kappa;
+    }
+}
+
+/**
+ * Produce shortest digits of positive finite double.
+ * @param v value, greater than zero
+ * @param buf buffer receiving at least 18 digits (no terminator)
+ * @param kp pointer to decimal exponent, v = digits * 10^*kp
+ * @result number of digits
+ */
+
+static int
+grisu2(double v, char *buf, int *kp)
+{
+    DIYFP w, wp, wm, c;
+    sqlite_uint64 bits, one, p2, delta, wp_w, tmp;
+    unsigned int p1, d;
+    int len = 0, kappa, k, idx;
+    double dk;
+
+    memcpy(&bits, &v, sizeof (bits));
+    w.f = bits & 0x000FFFFFFFFFFFFFULL;
+    w.e = (int) ((bits >> 52) & 0x7FF);
+    if (w.e) {
+	w.f += 0x0010000000000000ULL;
+	w.e -= 1075;
+    } else {
+	w.e = -1074;
+    }
+    /* boundaries m+ and m-, both with exponent of normalized m+ */
+    wp.f = (w.f << 1) + 1;
+    wp.e = w.e - 1;
+    while (!(wp.f & (0x0010000000000000ULL << 1))) {
+	wp.f <<= 1;
+	wp.e--;
+    }
+    wp.f <<= 10;
+    wp.e -= 10;
+    if (w.f == 0x0010000000000000ULL) {
+	wm.f = (w.f << 2) - 1;
+	wm.e = w.e - 2;
+    } else {
+	wm.f = (w.f << 1) - 1;
+	wm.e = w.e - 1;
+    }
+    wm.f <<= wm.e - wp.e;
+    wm.e = wp.e;
+    while (!(w.f & 0x8000000000000000ULL)) {
+	w.f <<= 1;
+	w.e--;
+    }
+    /* cached power c = 10^-k bringing exponents into [-60, -32] */
+    dk = (-61 - wp.e) * 0.30102999566398114 + 347;
+    k = (int) dk;
+    if (dk - k > 0.0) {
+	k++;
+    }
+    idx = (k >> 3) + 1;
+    *kp = -(-348 + idx * 8);
+    c = diyfp_pow10[idx];
+    w = diyfp_mul(w, c);
+    wp = diyfp_mul(wp, c);
+    wm = diyfp_mul(wm, c);
+    wm.f++;
+    wp.f--;
+    /* digit generation */
+    delta = wp.f - wm.f;
+    wp_w = wp.f - w.f;
+    one = ((sqlite_uint64) 1) << -wp.e;
+    p1 = (unsigned int) (wp.f >> -wp.e);
+    p2 = wp.f & (one - 1);
+    for (kappa = 1; kappa < 10 && p1 >= diyfp_exp10[kappa]; kappa++) {
+	/* empty */
+    }
+    while (kappa > 0) {
+	d = p1 / (unsigned int) diyfp_exp10[kappa - 1];
+	p1 %= (unsigned int) diyfp_exp10[kappa - 1];
+	if (d || len) {
+	    buf[len++] = '0' + d;
+	}
+	kappa--;
+	tmp = (((sqlite_uint64) p1) << -wp.e) + p2;
+	if (tmp <= delta) {
+	    *kp += kappa;
+	    grisu_round(buf, len, delta, tmp,
+			diyfp_exp10[kappa] << -wp.e, wp_w);
+	    return len;
+	}
+    }
+    for (;;) {
+	p2 *= 10;
+	delta *= 10;
+	d = (unsigned int) (p2 >> -wp.e);
+	if (d || len) {
+	    buf[len++] = '0' + d;
+	}
+	p2 &= one - 1;
+	kappa--;
+	if (p2 < delta) {
+	    *kp += kappa;
+	    grisu_round(buf, len, delta, p2, one,
+			(-kappa < 20) ? wp_w * diyfp_exp10[-kappa] : 0);
+	    return len;
+	}
+    }
+}
+
+/**
+ * Locale neutral shortest round trip formatting of double.
+ * @param v value
+ * @param buf output buffer, at least 32 bytes
+ * @result pointer to buf
+ *
+ * The layout follows SQLite's "%!.15g" format, i.e. a decimal point
+ * is always present and exponents have at least two digits, but
+ * as many significant digits as needed for an exact round trip
+ * are emitted.
+ */
+
+static char *
+ln_dtoa(double v, char *buf)
+{
+    char dig[24], *p = buf;
+    int n, k, x, i;
+
+    if (v != v) {
+	strcpy(buf, "NaN");
+	return buf;
+    }
+    if (v == 0) {
+	strcpy(p, "0.0");
+	return buf;
+    }
+    if (v < 0) {
+	*p++ = '-';
+	v = -v;
+    }
+    if (v > 1.7976931348623157e308) {
+	strcpy(p, "Inf");
+	return buf;
+    }
+    n = grisu2(v, dig, &k);
+    x = n + k - 1;
+    if (x < -4 || x >= 15) {
+	*p++ = dig[0];
+	*p++ = '.';
+	if (n > 1) {
+	    memcpy(p, dig + 1, n - 1);
+	    p += n - 1;
+	} else {
+	    *p++ = '0';
+	}
+	*p++ = 'e';
+	*p++ = (x < 0) ? '-' : '+';
+	if (x < 0) {
+	    x = -x;
+	}
+	if (x >= 100) {
+	    *p++ = '0' + x / 100;
+	}
+	*p++ = '0' + (x / 10) % 10;
+	*p++ = '0' + x % 10;
+    } else if (x < 0) {
+	*p++ = '0';
+	*p++ = '.';
+	for (i = x + 1; i < 0; i++) {
+	    *p++ = '0';
+	}
+	memcpy(p, dig, n);
+	p += n;
+    } else if (k >= 0) {
+	memcpy(p, dig, n);
+	p += n;
+	for (i = 0; i < k; i++) {
+	    *p++ = '0';
+	}
+	*p++ = '.';
+	*p++ = '0';
+    } else {
+	memcpy(p, dig, x + 1);
+	p += x + 1;
+	*p++ = '.';
+	memcpy(p, dig + x + 1, n - x - 1);
+	p += n - x - 1;
+    }
+    *p = '\0';
+    return buf;
+}
+
+/**
+ * Return text representation of typed cell.
+ * @param c cell pointer
+ * @param buf buffer for formatting numbers
+ * @param buflen size of buffer, at least 32
+ * @result pointer to text or NULL for SQL NULL
+ *
+ * Numbers are formatted like sqlite3_column_text() would do it,
+ * i.e. floats always contain a decimal point, but floats carry
+ * the shortest digits which read back to the same value.
+ * For blobs the raw data is returned, see blob2hex().
+ */
+
+static char *
+cell2str(CELL *c, char *buf, int buflen)
+{
+    switch (c->type) {
+    case SQLITE_INTEGER:
+	sqlite3_snprintf(buflen, buf, "%lld", c->v.i);
+	return buf;
+    case SQLITE_FLOAT:
+	return ln_dtoa(c->v.f, buf);
+    case SQLITE_NULL:
+	return NULL;
+    }
+    return c->v.p;
+}
+
+/**
+ * @typedef TBLRES
+ * @struct tblres
+ * Internal structure for managing driver's
+ * sqlite3_get_table() implementation.
+ */
+
+typedef struct tblres {
+    CELL *cells;	/**< result cells, column major */
     char *errmsg;	/**< error message or NULL */
     sqlite3_stmt *stmt;	/**< SQLite3 statement pointer */
     STMT *s;		/**< Driver statement pointer */
-    int nalloc;		/**< alloc'ed size of result array */
-    int nrow;		/**< number of rows in result array */
-    int ncol;		/**< number of columns in result array */
-    PTRDIFF_T ndata;	/**< index into result array */
+    int nalloc;		/**< alloc'ed rows per column of result cells */
+    int nrow;		/**< number of rows in result cells */
+    int ncol;		/**< number of columns in result cells */
     int rc;		/**< SQLite return code */
 } TBLRES;
 
 /*
  * Driver's version of sqlite3_get_table() and friends which are
- * capable of dealing with blobs.
+ * capable of dealing with blobs and keep values typed.
  */
 
 static int
 drvgettable_row(TBLRES *t, int ncol, int rc)
 {
-    int need;
     int i;
-    char *p;
-
-    if (t->nrow == 0 && rc == SQLITE_ROW) {
-	need = ncol * 2;
-    } else {
-	need = ncol;
-    }
-    if (t->ndata + need >= t->nalloc) {
-	char **resnew;
-	int nalloc = t->nalloc * 2 + need + 1;
 
-	resnew = xrealloc(t->resarr, sizeof (char *) * nalloc);
-	if (!resnew) {
-nomem:
-	    t->rc = SQLITE_NOMEM;
-	    return 1;
-	}
-	t->nalloc = nalloc;
-	t->resarr = resnew;
-    }
-    /* column names when first row */
+    /* column information when first row */
     if (t->nrow == 0) {
 	t->ncol = ncol;
-	for (i = 0; i < ncol; i++) {
-	    p = (char *) sqlite3_column_name(t->stmt, i);
-	    if (p) {
-		char *q = xmalloc(strlen(p) + 1);
-
-		if (!q) {
-		    goto nomem;
-		}
-		strcpy(q, p);
-		p = q;
-	    }
-	    t->resarr[t->ndata++] = p;
-	}
 	if (t->s && t->s->guessed_types) {
 	    int ncol2 = ncol;
 
@@ -1442,102 +2336,62 @@ nomem:
 	t->rc = SQLITE_ERROR;
 	return 1;
     }
-    /* copy row data */
-    if (rc == SQLITE_ROW) {
-	for (i = 0; i < ncol; i++) {
-	    int coltype = sqlite3_column_type(t->stmt, i);
-
-	    p = NULL;
-	    if (coltype == SQLITE_BLOB) {
-		int k, nbytes = sqlite3_column_bytes(t->stmt, i);
-		char *qp;
-		unsigned const char *bp;
-
-		bp = sqlite3_column_blob(t->stmt, i);
-		qp = xmalloc(nbytes * 2 + 4);
-		if (!qp) {
-		    goto nomem;
-		}
-		p = qp;
-		*qp++ = 'X';
-		*qp++ = '\'';
-		for (k = 0; k < nbytes; k++) {
-		    *qp++ = xdigits[(bp[k] >> 4)];
-		    *qp++ = xdigits[(bp[k] & 0xF)];
-		}
-		*qp++ = '\'';
-		*qp = '\0';
-#ifdef _MSC_VER
-	    } else if (coltype == SQLITE_FLOAT) {
-		struct lconv *lc = 0;
-		double val = sqlite3_column_double(t->stmt, i);
-		char buffer[128];
-
-		/*
-		 * This avoids floating point rounding
-		 * and formatting problems of some SQLite
-		 * versions in conjunction with MSVC 2010.
-		 */
-		snprintf(buffer, sizeof (buffer), "%.15g", val);
-		lc = localeconv();
-		if (lc && lc->decimal_point && lc->decimal_point[0] &&
-		    lc->decimal_point[0] != '.') {
-		    p = strchr(buffer, lc->decimal_point[0]);
-		    if (p) {
-			*p = '.';
-		    }
-		}
-		p = xstrdup(buffer);
-		if (!p) {
-		    goto nomem;
-		}
-#endif
-	    } else if (coltype != SQLITE_NULL) {
-		p = xstrdup((char *) sqlite3_column_text(t->stmt, i));
-		if (!p) {
-		    goto nomem;
-		}
-	    }
-	    t->resarr[t->ndata++] = p;
+    if (rc != SQLITE_ROW || ncol <= 0) {
+	return 0;
+    }
+    if (t->s) {
+	((DBC *) t->s->dbc)->stats.rows++;
+    }
+    if (t->nrow >= t->nalloc) {
+	CELL *cellnew;
+	int nalloc = t->nalloc * 2 + 16;
+
+	cellnew = xrealloc(t->cells, sizeof (CELL) * ncol * nalloc);
+	if (!cellnew) {
+	    t->rc = SQLITE_NOMEM;
+	    return 1;
 	}
-	t->nrow++;
+	/* spread columns to new stride, last column first */
+	for (i = ncol - 1; i > 0; i--) {
+	    memmove(cellnew + i * nalloc, cellnew + i * t->nalloc,
+		    sizeof (CELL) * t->nrow);
+	}
+	t->cells = cellnew;
+	t->nalloc = nalloc;
     }
+    /* copy row data */
+    t->rc = storecells(t->s, t->stmt, t->cells + t->nrow, t->nalloc, ncol);
+    if (t->rc != SQLITE_OK) {
+	return 1;
+    }
+    t->nrow++;
     return 0;
 }
 
 static int
-drvgettable(STMT *s, const char *sql, char ***resp, int *nrowp,
-	    int *ncolp, char **errp, int nparam, BINDPARM *p)
+drvgettable(STMT *s, const char *sql, int *nrowp, int *ncolp,
+	    char **errp, int nparam, BINDPARM *p)
 {
     DBC *d = (DBC *) s->dbc;
     int rc = SQLITE_OK, keep = sql == NULL;
     TBLRES tres;
-    const char *sqlleft = 0;
-    int nretry = 0, haveerr = 0;
+    const char *sqlleft = 0, *cachesql = NULL;
+    int nretry = 0, haveerr = 0, cacheit = 0;
 
-    if (!resp) {
-	return SQLITE_ERROR;
-    }
-    *resp = NULL;
     if (nrowp) {
 	*nrowp = 0;
     }
     if (ncolp) {
 	*ncolp = 0;
     }
+    tres.cells = NULL;
     tres.errmsg = NULL;
     tres.nrow = 0;
     tres.ncol = 0;
-    tres.ndata = 1;
-    tres.nalloc = 20;
+    tres.nalloc = 0;
     tres.rc = SQLITE_OK;
-    tres.resarr = xmalloc(sizeof (char *) * tres.nalloc);
     tres.stmt = NULL;
     tres.s = s;
-    if (!tres.resarr) {
-	return SQLITE_NOMEM;
-    }
-    tres.resarr[0] = 0;
     if (sql == NULL) {
 	tres.stmt = s->s3stmt;
 	if (tres.stmt == NULL) {
@@ -1545,11 +2399,25 @@ drvgettable(STMT *s, const char *sql, char ***resp, int *nrowp,
 	}
 	goto retrieve;
     }
+    if (sql == (char *) s->query && (s->isselect == 0 || s->isselect == 1)) {
+	/* single statement, may use prepared statement cache */
+	cachesql = sql;
+    }
     while (sql && *sql && (rc == SQLITE_OK ||
 			   (rc == SQLITE_SCHEMA && (++nretry) < 2))) {
 	int ncol;
 
 	tres.stmt = NULL;
+	cacheit = 0;
+	if (sql == cachesql) {
+	    tres.stmt = s3cache_get(d, sql);
+	    if (tres.stmt) {
+		sqlleft = sql + strlen(sql);
+		cacheit = 1;
+		goto retrieve;
+	    }
+	}
+	d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	dbtraceapi(d, "sqlite3_prepare_v2", sql);
 	rc = sqlite3_prepare_v2(d->sqlite, sql, -1, &tres.stmt, &sqlleft);
@@ -1570,6 +2438,14 @@ drvgettable(STMT *s, const char *sql, char ***resp, int *nrowp,
 	    sql = sqlleft;
 	    continue;
 	}
+	if (sql == cachesql) {
+	    const char *p = sqlleft;
+
+	    while (p && ISSPACE(*p)) {
+		p++;
+	    }
+	    cacheit = p && !*p;
+	}
 retrieve:
 	if (sqlite3_bind_parameter_count(tres.stmt) != nparam) {
 	    if (errp) {
@@ -1580,13 +2456,14 @@ retrieve:
 	    rc = SQLITE_ERROR;
 	    goto tbldone;
 	}
-	s3bind(d, tres.stmt, nparam, p);
+	s3bind(d, tres.stmt, nparam, p, 0);
 	ncol = sqlite3_column_count(tres.stmt);
 	while (1) {
 	    if (s->max_rows && tres.nrow >= s->max_rows) {
 		rc = SQLITE_OK;
 		break;
 	    }
+	    d->stats.steps++;
 	    rc = sqlite3_step(tres.stmt);
 	    if (rc == SQLITE_ROW || rc == SQLITE_DONE) {
 		if (drvgettable_row(&tres, ncol, rc)) {
@@ -1599,6 +2476,16 @@ retrieve:
 		    dbtraceapi(d, "sqlite3_reset", 0);
 		    rc = sqlite3_reset(tres.stmt);
 		    s->s3stmt_noreset = 1;
+		} else if (cacheit) {
+		    dbtraceapi(d, "sqlite3_reset", 0);
+		    rc = sqlite3_reset(tres.stmt);
+		    if (rc == SQLITE_SCHEMA) {
+			s3cache_flush(d);
+			dbtraceapi(d, "sqlite3_finalize", 0);
+			sqlite3_finalize(tres.stmt);
+		    } else {
+			s3cache_put(d, sql, tres.stmt);
+		    }
 		} else {
 		    dbtraceapi(d, "sqlite3_finalize", 0);
 		    rc = sqlite3_finalize(tres.stmt);
@@ -1638,11 +2525,8 @@ tbldone:
     } else if (errp) {
 	*errp = NULL;
     }
-    if (tres.resarr) {
-	tres.resarr[0] = (char *) (tres.ndata - 1);
-    }
     if (rc == SQLITE_ABORT) {
-	freerows(&tres.resarr[1]);
+	xfree(tres.cells);
 	if (tres.errmsg) {
 	    if (errp) {
 		if (*errp) {
@@ -1657,10 +2541,11 @@ tbldone:
     }
     sqlite3_free(tres.errmsg);
     if (rc != SQLITE_OK) {
-	freerows(&tres.resarr[1]);
+	xfree(tres.cells);
 	return rc;
     }
-    *resp = &tres.resarr[1];
+    s->cells = tres.cells;
+    s->cellstride = tres.nalloc;
     if (ncolp) {
 	*ncolp = tres.ncol;
     }
@@ -1828,6 +2713,118 @@ noconn(STMT *s)
     return SQL_ERROR;
 }
 
+/**
+ * Exactly representable powers of ten for ln_strtod().
+ */
+
+static const double ln_exp10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Locale neutral fast path for decimal number to double conversion.
+ * @param data pointer to string
+ * @param endp pointer for ending character
+ * @param valp pointer to result
+ * @result true when converted, false when strtod() must be used
+ *
+ * Handles numbers with at most 19 significant digits whose value
+ * results from a single correctly rounded multiplication or division
+ * of exact doubles (Clinger's fast path), which covers nearly all
+ * numbers stored as text in a database.
+ */
+
+static int
+ln_fastatof(const char *data, char **endp, double *valp)
+{
+    const char *p = data, *q;
+    sqlite_uint64 m = 0;
+    int neg = 0, nd = 0, nz = 0, x = 0, xs, xn;
+    double v;
+
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD != 0)
+    /* excess precision would round twice */
+    return 0;
+#endif
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r')) {
+	++p;
+    }
+    if (*p == '-' || *p == '+') {
+	neg = *p++ == '-';
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+	return 0;
+    }
+    q = p;
+    while (*p == '0') {
+	++p;
+    }
+    while (*p >= '0' && *p <= '9') {
+	if (nd >= 19) {
+	    return 0;
+	}
+	m = m * 10 + (*p++ - '0');
+	++nd;
+    }
+    if (*p == '.') {
+	++p;
+	if (!nd) {
+	    while (*p == '0') {
+		++p;
+		++nz;
+	    }
+	}
+	while (*p >= '0' && *p <= '9') {
+	    if (nd >= 19) {
+		return 0;
+	    }
+	    m = m * 10 + (*p++ - '0');
+	    ++nd;
+	    ++nz;
+	}
+	if (p == q + 1) {
+	    /* lone "." */
+	    return 0;
+	}
+    } else if (p == q) {
+	return 0;
+    }
+    if (*p == 'e' || *p == 'E') {
+	q = p + 1;
+	xs = 0;
+	if (*q == '-' || *q == '+') {
+	    xs = *q++ == '-';
+	}
+	if (*q >= '0' && *q <= '9') {
+	    xn = 0;
+	    while (*q >= '0' && *q <= '9') {
+		if (xn < 10000) {
+		    xn = xn * 10 + (*q - '0');
+		}
+		++q;
+	    }
+	    x = xs ? -xn : xn;
+	    p = q;
+	}
+    }
+    x -= nz;
+    if (m == 0) {
+	v = 0.0;
+    } else if (m > ((sqlite_uint64) 1 << 53) || x < -22 || x > 22) {
+	return 0;
+    } else if (x < 0) {
+	v = (double) m / ln_exp10[-x];
+    } else {
+	v = (double) m * ln_exp10[x];
+    }
+    *valp = neg ? -v : v;
+    if (endp) {
+	*endp = (char *) p;
+    }
+    return 1;
+}
+
 /**
  * Internal locale neutral strtod function.
  * @param data pointer to string
@@ -1844,6 +2841,9 @@ ln_strtod(const char *data, char **endp)
     char buf[128], *p, *end;
     double value;
 
+    if (ln_fastatof(data, endp, &value)) {
+	return value;
+    }
     lc = localeconv();
     if (lc && lc->decimal_point && lc->decimal_point[0] &&
 	lc->decimal_point[0] != '.') {
@@ -1867,37 +2867,154 @@ ln_strtod(const char *data, char **endp)
 
 #else
 
-#define ln_strtod(A,B) strtod(A,B)
+static double
+ln_strtod(const char *data, char **endp)
+{
+    double value;
+
+    if (ln_fastatof(data, endp, &value)) {
+	return value;
+    }
+    return strtod(data, endp);
+}
 
 #endif
 
 /**
- * Strip quotes from quoted string in-place.
- * @param str string
+ * Locale neutral fast path for decimal string to integer conversion.
+ * @param data pointer to string
+ * @param endp pointer for ending character
+ * @param valp pointer to result
+ * @result true when converted, false when strtol() must be used
+ *
+ * Octal and hexadecimal numbers and numbers with more than
+ * 18 digits are left to the C library.
  */
 
-static char *
-unquote(char *str)
+static int
+ln_fastatoi(const char *data, char **endp, sqlite_int64 *valp)
 {
-    if (str) {
-	int len = strlen(str);
-
-	if (len > 1) {
-	    int end = len - 1;
+    const char *p = data, *q;
+    sqlite_uint64 m = 0;
+    int neg = 0;
 
-	    if ((str[0] == '\'' && str[end] == '\'') ||
-		(str[0] == '"' && str[end] == '"') ||
-		(str[0] == '[' && str[end] == ']')) {
-		memmove(str, str + 1, end - 1);
-		str[end - 1] = '\0';
-	    }
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r')) {
+	++p;
+    }
+    if (*p == '-' || *p == '+') {
+	neg = *p++ == '-';
+    }
+    if (p[0] == '0' &&
+	((p[1] >= '0' && p[1] <= '9') || p[1] == 'x' || p[1] == 'X')) {
+	return 0;
+    }
+    q = p;
+    while (*p >= '0' && *p <= '9') {
+	if (p - q >= 18) {
+	    return 0;
 	}
+	m = m * 10 + (*p++ - '0');
     }
-    return str;
+    if (p == q) {
+	return 0;
+    }
+    *valp = neg ? -(sqlite_int64) m : (sqlite_int64) m;
+    if (endp) {
+	*endp = (char *) p;
+    }
+    return 1;
 }
 
 /**
- * Unescape search pattern for e.g. table name in
+ * Internal strtol(..., 0) replacement with fast path for decimals.
+ * @param data pointer to string
+ * @param endp pointer for ending character
+ * @result long value
+ */
+
+static long
+ln_strtol(const char *data, char **endp)
+{
+    sqlite_int64 v;
+
+    if (ln_fastatoi(data, endp, &v) && (sqlite_int64) (long) v == v) {
+	return (long) v;
+    }
+    return strtol(data, endp, 0);
+}
+
+/**
+ * Internal strtoll(..., 0) replacement with fast path for decimals.
+ * @param data pointer to string
+ * @param endp pointer for ending character
+ * @result 64 bit value
+ */
+
+static sqlite_int64
+ln_strtoll(const char *data, char **endp)
+{
+    sqlite_int64 v;
+
+    if (ln_fastatoi(data, endp, &v)) {
+	return v;
+    }
+#ifdef __osf__
+    return strtol(data, endp, 0);
+#else
+    return strtoll(data, endp, 0);
+#endif
+}
+
+/**
+ * Strip quotes from quoted string in-place.
+ * @param str string
+ */
+
+static char *
+unquote(char *str)
+{
+    if (str) {
+	int len = strlen(str);
+
+	if (len > 1) {
+	    int end = len - 1;
+
+	    if ((str[0] == '\'' && str[end] == '\'') ||
+		(str[0] == '"' && str[end] == '"') ||
+		(str[0] == '[' && str[end] == ']')) {
+		memmove(str, str + 1, end - 1);
+		str[end - 1] = '\0';
+	    }
+	}
+    }
+    return str;
+}
+
+/**
+ * Compare name with string which may be quoted, ignoring case.
+ * @param name name
+ * @param len length of name
+ * @param str string, left unchanged
+ * @result true when equal after removing the quotes of string
+ */
+
+static int
+unquotematch(char *name, int len, char *str)
+{
+    int slen = strlen(str);
+
+    if (slen > 1 &&
+	((str[0] == '\'' && str[slen - 1] == '\'') ||
+	 (str[0] == '"' && str[slen - 1] == '"') ||
+	 (str[0] == '[' && str[slen - 1] == ']'))) {
+	str++;
+	slen -= 2;
+    }
+    return slen == len && strncasecmp(name, str, len) == 0;
+}
+
+/**
+ * Unescape search pattern for e.g. table name in
  * catalog functions. Replacements in string are done in-place.
  * @param str string
  * @result number of pattern characters in string or 0
@@ -2008,55 +3125,48 @@ nomatch:
 }
 
 /**
- * Busy callback for SQLite.
- * @param udata user data, pointer to DBC
- * @param count count of subsequenct calls
- * @result true or false
+ * Return current time in microseconds for the time counters.
+ * @result time in microseconds
  */
 
-static int
-busy_handler(void *udata, int count)
+static sqlite_int64
+getusec(void)
 {
-    DBC *d = (DBC *) udata;
-    long t1;
-    int ret = 0;
-#if !defined(_WIN32) && !defined(_WIN64)
-    struct timeval tv;
-#ifdef HAVE_NANOSLEEP
-    struct timespec ts;
-#endif
-#endif
-
-    if (d->busyint) {
-	d->busyint = 0;
-	return ret;
-    }
-    if (d->timeout <= 0) {
-	return ret;
-    }
-    if (count <= 1) {
 #if defined(_WIN32) || defined(_WIN64)
-	d->t0 = GetTickCount();
-#else
-	gettimeofday(&tv, NULL);
-	d->t0 = tv.tv_sec * 1000 + tv.tv_usec / 1000;
-#endif
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (!freq.QuadPart) {
+	QueryPerformanceFrequency(&freq);
     }
-#if defined(_WIN32) || defined(_WIN64)
-    t1 = GetTickCount();
+    QueryPerformanceCounter(&now);
+    return (now.QuadPart / freq.QuadPart) * 1000000 +
+	((now.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart;
 #else
+    struct timeval tv;
+
     gettimeofday(&tv, NULL);
-    t1 = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return (sqlite_int64) tv.tv_sec * 1000000 + tv.tv_usec;
 #endif
-    if (t1 - d->t0 > d->timeout) {
-	goto done;
-    }
+}
+
+/**
+ * Sleep for the given number of microseconds.
+ * @param us time to sleep
+ */
+
+static void
+usecsleep(long us)
+{
 #if defined(_WIN32) || defined(_WIN64)
-    Sleep(10);
+    Sleep((us + 999) / 1000);
 #else
 #ifdef HAVE_NANOSLEEP
-    ts.tv_sec = 0;
-    ts.tv_nsec = 10000000;
+    struct timespec ts;
+    int ret;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
     do {
 	ret = nanosleep(&ts, &ts);
 	if (ret < 0 && errno != EINTR) {
@@ -2065,17 +3175,104 @@ busy_handler(void *udata, int count)
     } while (ret);
 #else
 #ifdef HAVE_USLEEP
-    usleep(10000);
+    usleep(us);
 #else
-    tv.tv_sec = 0;
-    tv.tv_usec = 10000;
+    struct timeval tv;
+
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
     select(0, NULL, NULL, NULL, &tv);
 #endif
 #endif
 #endif
-    ret = 1;
-done:
-    return ret;
+}
+
+/**
+ * Compute sleep time of busy handler.
+ * @param d DBC pointer
+ * @param count count of subsequent calls
+ * @result time to sleep in microseconds
+ *
+ * The "backoff" policy retries busyspin times without sleeping,
+ * then doubles the sleep time starting with busymin up to busymax
+ * (BUSY_WALMAX in WAL mode, where only writers wait for each other
+ * and a write lock is held for a single commit). Half of the sleep
+ * time is randomized to keep waiting connections from retrying
+ * in lock step.
+ */
+
+static long
+busydelay(DBC *d, int count)
+{
+    long delay, max;
+    int n;
+
+    if (d->busypolicy != BUSY_BACKOFF) {
+	return 10000;
+    }
+    if (count <= d->busyspin) {
+	return 0;
+    }
+    max = d->busymax;
+    if (d->busywal && max > BUSY_WALMAX) {
+	max = BUSY_WALMAX;
+    }
+    delay = d->busymin;
+    for (n = count - d->busyspin - 1; n > 0 && delay < max; n--) {
+	delay *= 2;
+    }
+    if (delay > max) {
+	delay = max;
+    }
+    d->busyseed = d->busyseed * 1103515245 + 12345;
+    return delay / 2 + (long) ((d->busyseed >> 16) % (delay / 2 + 1));
+}
+
+/**
+ * Busy callback for SQLite.
+ * @param udata user data, pointer to DBC
+ * @param count count of subsequenct calls
+ * @result true or false
+ */
+
+static int
+busy_handler(void *udata, int count)
+{
+    DBC *d = (DBC *) udata;
+    sqlite_int64 t1, t2, left;
+    long us;
+
+    if (d->busyint) {
+	d->busyint = 0;
+	return 0;
+    }
+    if (d->timeout <= 0) {
+	return 0;
+    }
+    t1 = getusec();
+    if (count <= 1) {
+	d->t0 = t1;
+	d->stats.busywaits++;
+    }
+    left = (sqlite_int64) d->timeout * 1000 - (t1 - d->t0);
+    if (left < 0) {
+	return 0;
+    }
+    us = busydelay(d, count);
+    if (us > left) {
+	us = (long) left;
+    }
+    d->stats.busyretries++;
+    t2 = t1;
+    if (us > 0) {
+	usecsleep(us);
+	t2 = getusec();
+	d->stats.busysleep += t2 - t1;
+    }
+    if ((SQLULEN) (t2 - d->t0) > d->stats.busywaitmax) {
+	d->stats.busywaitmax = t2 - d->t0;
+    }
+    return 1;
 }
 
 /**
@@ -2104,8 +3301,14 @@ setsqliteopts(sqlite3 *x, DBC *d)
     }
     while (step < max) {
 	if (step < 1) {
-	    rc = sqlite3_exec(x, "PRAGMA empty_result_callbacks = on;",
-			      NULL, NULL, NULL);
+	    rc = SQLITE_OK;
+	    if (d->perfsql && !d->pooled) {
+		rc = sqlite3_exec(x, d->perfsql, NULL, NULL, NULL);
+	    }
+	    if (rc == SQLITE_OK) {
+		rc = sqlite3_exec(x, "PRAGMA empty_result_callbacks = on;",
+				  NULL, NULL, NULL);
+	    }
 	    if (rc == SQLITE_OK) {
 		rc = sqlite3_exec(x, d->fksupport ?
 				  "PRAGMA foreign_keys = on;" :
@@ -2464,7 +3667,7 @@ mapdeftype(int type, int stype, int nosign, int nowchar)
 /**
  * Check if query is a DDL statement.
  * @param sql query string
- * @result true or false
+ * @result 0 (no DDL), 1 (DDL) or 2 (transaction control)
  */
 
 static int
@@ -2480,28 +3683,29 @@ checkddl(char *sql)
 	static const struct {
 	    int len;
 	    const char *str;
+	    int type;
 	} ddlstr[] = {
-	    { 5, "alter" },
-	    { 7, "analyze" },
-	    { 6, "attach" },
-	    { 5, "begin" },
-	    { 6, "commit" },
-	    { 6, "create" },
-	    { 6, "detach" },
-	    { 4, "drop" },
-	    { 3, "end" },
-	    { 7, "reindex" },
-	    { 7, "release" },
-	    { 8, "rollback" },
-	    { 9, "savepoint" },
-	    { 6, "vacuum" }
+	    { 5, "alter", 1 },
+	    { 7, "analyze", 1 },
+	    { 6, "attach", 1 },
+	    { 5, "begin", 2 },
+	    { 6, "commit", 2 },
+	    { 6, "create", 1 },
+	    { 6, "detach", 1 },
+	    { 4, "drop", 1 },
+	    { 3, "end", 2 },
+	    { 7, "reindex", 1 },
+	    { 7, "release", 2 },
+	    { 8, "rollback", 2 },
+	    { 9, "savepoint", 2 },
+	    { 6, "vacuum", 1 }
 	};
 
 	size = strlen(sql);
 	for (i = 0; i < array_size(ddlstr); i++) {
 	    if (size >= ddlstr[i].len &&
 		strncasecmp(sql, ddlstr[i].str, ddlstr[i].len) == 0) {
-		isddl = 1;
+		isddl = ddlstr[i].type;
 		break;
 	    }
 	}
@@ -2772,23 +3976,14 @@ findcol(char **cols, int ncols, char *name)
  *
  * The column labels get the table names stripped
  * when there's more than one column and all table
- * names are identical.
- *
- * The "dyncols" field of STMT is filled with column
- * information obtained by SQLite "PRAGMA table_info"
- * for each column whose table name is known. If the
- * types are already present as with SQLite 2.5.7
- * this information is used instead.
+ * names are identical. Column meta data requiring
+ * catalog lookups is deferred to getdynmeta().
  */
 
 static void
 fixupdyncols(STMT *s, DBC *d)
 {
-    int i, k;
-#ifndef FULL_METADATA
-    int pk, nn, t, r, nrows, ncols;
-    char **rowp, *flagp, flags[128];
-#endif
+    int i;
 
     if (!s->dyncols) {
 	return;
@@ -2837,7 +4032,121 @@ fixupdyncols(STMT *s, DBC *d)
 	    s->dyncols[i].type = SQL_LONGVARBINARY;
 	}
     }
+    s->dynmeta = 1;
+}
+
+#ifdef FULL_METADATA
+
+/**
+ * Add meta data for column from its origin table.
+ * @param d DBC pointer
+ * @param ci pointer to COL
+ */
+
+static void
+getcolmeta(DBC *d, COL *ci)
+{
+    int nn = 0, pk = 0, ai = 0;
+    const char *dn = NULL, *tn = NULL, *cn = NULL, *dummy[4];
+
+    if (ci->db && ci->db[0]) {
+	dn = ci->db;
+    }
+    if (ci->table && ci->table[0]) {
+	tn = ci->table;
+    }
+    cn = ci->origin;
+    dummy[0] = dummy[1] = 0;
+    if (tn && cn) {
+	sqlite3_table_column_metadata(d->sqlite, dn, tn, cn,
+				      dummy, dummy + 1,
+				      &nn, &pk, &ai);
+    }
+    ci->autoinc = ai ? SQL_TRUE: SQL_FALSE;
+    ci->notnull = nn ? SQL_NO_NULLS : SQL_NULLABLE;
+    ci->ispk = pk ? 1 : 0;
+    if (d->trace) {
+	fprintf(d->trace, "-- column %d %s\n",
+		ci->index + 1, nn ? "notnull" : "nullable");
+	if (ai) {
+	    fprintf(d->trace, "-- column %d autoincrement\n", ci->index + 1);
+	}
+	fflush(d->trace);
+    }
+    ci->isrowid = 0;
+    if (ci->ispk && tn) {
+	nn = pk = ai = 0;
+	dummy[2] = dummy[3] = 0;
+
+	sqlite3_table_column_metadata(d->sqlite, dn, tn, "rowid",
+				      dummy + 2, dummy + 3,
+				      &nn, &pk, &ai);
+	if (pk && dummy[0] && dummy[0] == dummy[2]) {
+	    ci->isrowid = 1;
+	}
+    }
+}
+
+#endif
+
+/**
+ * Resolve deferred column meta data of a running statement.
+ * @param s statement pointer
+ * @param col column number (0 based) when only the NOT NULL and
+ * AUTOINCREMENT information of that column is needed, or -1 for
+ * all columns including the single table, primary key, and ROWID
+ * information of the result set
+ *
+ * The information is obtained on first use only, since it requires
+ * catalog lookups which most applications never need.
+ */
+
+static void
+getdynmeta(STMT *s, int col)
+{
+    DBC *d = (DBC *) s->dbc;
+    int i, k;
 #ifndef FULL_METADATA
+    int pk, nn, t, r, nrows, ncols;
+    char **rowp, *flagp, flags[128];
+#endif
+
+    if (!s->dynmeta || !s->dyncols || s->cols != s->dyncols) {
+	return;
+    }
+#ifdef FULL_METADATA
+    if (col >= 0) {
+	if (col < s->dcols && s->dyncols[col].ispk < 0) {
+	    getcolmeta(d, &s->dyncols[col]);
+	}
+	return;
+    }
+    s->dynmeta = 0;
+    for (i = 0; i < s->dcols; i++) {
+	if (s->dyncols[i].ispk < 0) {
+	    getcolmeta(d, &s->dyncols[i]);
+	}
+    }
+    for (i = 1, k = 0; i < s->dcols; i++) {
+	if (strcmp(s->dyncols[i].table, s->dyncols[0].table) == 0) {
+	    k++;
+	}
+    }
+    s->one_tbl = (k && k + 1 == s->dcols) ? 1 : 0;
+    k = 0;
+    if (s->one_tbl) {
+	for (i = 0; i < s->dcols; i++) {
+	    if (s->dyncols[i].ispk > 0) {
+		++k;
+		if (s->has_rowid < 0 && s->dyncols[i].isrowid > 0) {
+		    s->has_rowid = i;
+		}
+	    }
+	}
+    }
+    s->has_pk = k;
+#else
+    s->dynmeta = 0;
     if (s->dcols > array_size(flags)) {
 	flagp = xmalloc(sizeof (flags[0]) * s->dcols);
 	if (flagp == NULL) {
@@ -2851,6 +4160,7 @@ fixupdyncols(STMT *s, DBC *d)
 	s->dyncols[i].autoinc = SQL_FALSE;
 	s->dyncols[i].notnull = SQL_NULLABLE;
     }
+    sccache_check(d);
     for (i = 0; i < s->dcols; i++) {
 	int ret, lastpk = -1, autoinccount = 0;
 	char *sql;
@@ -2865,8 +4175,7 @@ fixupdyncols(STMT *s, DBC *d)
 	if (!sql) {
 	    continue;
 	}
-	dbtraceapi(d, "sqlite3_get_table", sql);
-	ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, NULL);
+	ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, NULL);
 	sqlite3_free(sql);
 	if (ret != SQLITE_OK) {
 	    continue;
@@ -2897,8 +4206,8 @@ fixupdyncols(STMT *s, DBC *d)
 		    char *typename = rowp[r * ncols + t];
 
 		    flagp[m] = i + 1;
-		    freep(&s->dyncols[m].typename);
-		    s->dyncols[m].typename = xstrdup(typename);
+		    s->dyncols[m].typename =
+			arena_strdup(&s->dynarena, typename);
 		    s->dyncols[m].type =
 			mapsqltype(typename, &s->dyncols[m].nosign, *s->ov3,
 				   s->nowchar[0] || s->nowchar[1],
@@ -2947,7 +4256,7 @@ fixupdyncols(STMT *s, DBC *d)
 	    }
 	}
 freet:
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
     }
     for (i = k = 0; i < s->dcols; i++) {
 	if (flagp[i] == 0) {
@@ -2973,25 +4282,6 @@ freet:
     if (flagp != flags) {
 	freep(&flagp);
     }
-#else
-    for (i = 1, k = 0; i < s->dcols; i++) {
-	if (strcmp(s->dyncols[i].table, s->dyncols[0].table) == 0) {
-	    k++;
-	}
-    }
-    s->one_tbl = (k && k + 1 == s->dcols) ? 1 : 0;
-    k = 0;
-    if (s->one_tbl) {
-	for (i = 0; i < s->dcols; i++) {
-	    if (s->dyncols[i].ispk > 0) {
-		++k;
-		if (s->has_rowid < 0 && s->dyncols[i].isrowid > 0) {
-		    s->has_rowid = i;
-		}
-	    }
-	}
-    }
-    s->has_pk = k;
 #endif
 }
 
@@ -3077,6 +4367,102 @@ getmdays(int year, int month)
     return mday;
 }
 
+/**
+ * Parse fixed number of decimal digits.
+ * @param p pointer to first digit
+ * @param n number of digits
+ * @result value of digits or -1 when a non-digit is found
+ */
+
+static int
+isodigits(const char *p, int n)
+{
+    int v = 0;
+
+    while (n-- > 0) {
+	unsigned int d = (unsigned char) *p++ - '0';
+
+	if (d > 9) {
+	    return -1;
+	}
+	v = v * 10 + d;
+    }
+    return v;
+}
+
+/**
+ * Fast path for the canonical 'YYYY-MM-DD hh:mm:ss.fff' layout.
+ * @param str string to be converted
+ * @param tss output TIMESTAMP_STRUCT
+ * @result number of characters parsed, 10 when only the date
+ * part matched, or 0 when str doesn't start with 'YYYY-MM-DD'
+ *
+ * All fields are read at fixed offsets, the separator between
+ * date and time may be ' ' or 'T', the fraction takes 1 to 9
+ * digits. No range checks are made, the callers fall back to
+ * the generic parsers for anything not matching this layout.
+ */
+
+static int
+isodatetime(const char *str, TIMESTAMP_STRUCT *tss)
+{
+    int y, mo, d, h, mi, s, f = 0, n = 0;
+    const char *p;
+
+    y = isodigits(str, 4);
+    if (y < 0 || str[4] != '-') {
+	return 0;
+    }
+    mo = isodigits(str + 5, 2);
+    if (mo < 0 || str[7] != '-') {
+	return 0;
+    }
+    d = isodigits(str + 8, 2);
+    if (d < 0) {
+	return 0;
+    }
+    tss->year = y;
+    tss->month = mo;
+    tss->day = d;
+    tss->hour = tss->minute = tss->second = 0;
+    tss->fraction = 0;
+    if (str[10] != ' ' && str[10] != 'T') {
+	return 10;
+    }
+    h = isodigits(str + 11, 2);
+    if (h < 0 || str[13] != ':') {
+	return 10;
+    }
+    mi = isodigits(str + 14, 2);
+    if (mi < 0 || str[16] != ':') {
+	return 10;
+    }
+    s = isodigits(str + 17, 2);
+    if (s < 0) {
+	return 10;
+    }
+    p = str + 19;
+    if (*p == '.') {
+	++p;
+	while (n < 9 && ISDIGIT(*p)) {
+	    f = f * 10 + (*p++ - '0');
+	    ++n;
+	}
+	if (n == 0 || ISDIGIT(*p)) {
+	    return 10;
+	}
+	while (n < 9) {
+	    f *= 10;
+	    ++n;
+	}
+    }
+    tss->hour = h;
+    tss->minute = mi;
+    tss->second = s;
+    tss->fraction = f;
+    return p - str;
+}
+
 /**
  * Convert string to ODBC DATE_STRUCT.
  * @param jdconv when true, allow julian day format
@@ -3098,6 +4484,7 @@ str2date(int jdconv, char *str, DATE_STRUCT *ds)
     int i, err = 0;
     double jd;
     char *p, *q, sepc = '\0';
+    TIMESTAMP_STRUCT tss;
 
     ds->year = ds->month = ds->day = 0;
     if (jdconv) {
@@ -3112,6 +4499,16 @@ str2date(int jdconv, char *str, DATE_STRUCT *ds)
 	    }
 	}
     }
+    /* fast path for 'YYYY-MM-DD' */
+    if (isodatetime(str, &tss) &&
+	(str[10] == '\0' || str[10] == ' ' || str[10] == 'T') &&
+	tss.month >= 1 && tss.month <= 12 &&
+	tss.day >= 1 && tss.day <= getmdays(tss.year, tss.month)) {
+	ds->year = tss.year;
+	ds->month = tss.month;
+	ds->day = tss.day;
+	return 0;
+    }
     p = str;
     while (*p && !ISDIGIT(*p)) {
 	++p;
@@ -3210,9 +4607,10 @@ done:
 static int
 str2time(int jdconv, char *str, TIME_STRUCT *ts)
 {
-    int i, err = 0, ampm = -1;
+    int i, err = 0, ampm = -1, h, mi, s;
     double jd;
     char *p, *q;
+    TIMESTAMP_STRUCT tss;
 
     ts->hour = ts->minute = ts->second = 0;
     if (jdconv) {
@@ -3227,6 +4625,28 @@ str2time(int jdconv, char *str, TIME_STRUCT *ts)
 	    }
 	}
     }
+    /* fast path for 'hh:mm:ss' and 'YYYY-MM-DD hh:mm:ss.fff' */
+    i = isodatetime(str, &tss);
+    if (i > 10) {
+	if (str[i] != '\0') {
+	    i = -1;
+	}
+    } else if (i == 0 &&
+	       (h = isodigits(str, 2)) >= 0 && str[2] == ':' &&
+	       (mi = isodigits(str + 3, 2)) >= 0 && str[5] == ':' &&
+	       (s = isodigits(str + 6, 2)) >= 0 && str[8] == '\0') {
+	tss.hour = h;
+	tss.minute = mi;
+	tss.second = s;
+    } else {
+	i = -1;
+    }
+    if (i >= 0 && tss.hour <= 23 && tss.minute <= 59 && tss.second <= 59) {
+	ts->hour = tss.hour;
+	ts->minute = tss.minute;
+	ts->second = tss.second;
+	return 0;
+    }
     p = str;
     while (*p && !ISDIGIT(*p)) {
 	++p;
@@ -3373,6 +4793,22 @@ str2timestamp(int jdconv, char *str, TIMESTAMP_STRUCT *tss)
 	    }
 	}
     }
+    /* fast path for 'YYYY-MM-DD hh:mm:ss.fff' */
+    n = isodatetime(str, tss);
+    if (n) {
+	if (n > 10 && str[n] == 'Z') {
+	    ++n;
+	}
+	if (str[n] == '\0' &&
+	    tss->month >= 1 && tss->month <= 12 &&
+	    tss->day >= 1 && tss->day <= getmdays(tss->year, tss->month) &&
+	    tss->hour <= 23 && tss->minute <= 59 && tss->second <= 59) {
+	    return 0;
+	}
+	tss->year = tss->month = tss->day = 0;
+	tss->hour = tss->minute = tss->second = 0;
+	tss->fraction = 0;
+    }
     p = str;
     while (*p && !ISDIGIT(*p)) {
 	++p;
@@ -3669,6 +5105,73 @@ getbool(char *string)
     return 0;
 }
 
+/**
+ * Get integer value from string.
+ * @param string string to be inspected
+ * @param dflt default value for empty or invalid string
+ * @param minval minimum value
+ * @param maxval maximum value
+ * @result integer value limited to minval...maxval
+ */
+
+static int
+getint(char *string, int dflt, int minval, int maxval)
+{
+    char *endp = NULL;
+    long val;
+
+    if (!string || !string[0]) {
+	return dflt;
+    }
+    val = strtol(string, &endp, 0);
+    if (endp == string) {
+	return dflt;
+    }
+    if (val < minval) {
+	val = minval;
+    } else if (val > maxval) {
+	val = maxval;
+    }
+    return (int) val;
+}
+
+/**
+ * Set busy handler policy from BusyPolicy DSN option.
+ * @param d DBC pointer
+ * @param policy "fixed" (default) or "backoff[:spin[:min[:max]]]"
+ */
+
+static void
+setbusypolicy(DBC *d, char *policy)
+{
+    char *p;
+
+    d->busypolicy = BUSY_FIXED;
+    d->busyspin = BUSY_SPIN;
+    d->busymin = BUSY_MIN;
+    d->busymax = BUSY_MAX;
+    d->busyseed = (unsigned int) getusec() ^ (unsigned int) (size_t) d;
+    if (!policy || strncasecmp(policy, "backoff", 7) != 0) {
+	return;
+    }
+    d->busypolicy = BUSY_BACKOFF;
+    p = strchr(policy, ':');
+    if (p) {
+	d->busyspin = getint(p + 1, BUSY_SPIN, 0, 1000);
+	p = strchr(p + 1, ':');
+    }
+    if (p) {
+	d->busymin = getint(p + 1, BUSY_MIN, 1, 1000000);
+	p = strchr(p + 1, ':');
+    }
+    if (p) {
+	d->busymax = getint(p + 1, BUSY_MAX, 1, 1000000);
+    }
+    if (d->busymax < d->busymin) {
+	d->busymax = d->busymin;
+    }
+}
+
 /**
  * SQLite function to import a BLOB from a file
  * @param ctx function context
@@ -3804,2277 +5307,4266 @@ blob_export(sqlite3_context *ctx, int nargs, sqlite3_value **args)
 }
 
 /**
- * SQLite trace or profile callback
- * @param arg DBC pointer
- * @param msg log message, SQL text
- * @param et  elapsed time
- */
+ * Table of runtime performance counters of a connection, used
+ * by drvgetconnectattr() and the "odbc_stats" virtual table.
+ * The pool counters are those of the environment.
+ */
+
+static const struct {
+    const char *name;		/**< Counter name */
+    SQLINTEGER attr;		/**< Connection attribute */
+    int offs;			/**< Offset of SQLULEN counter in DBC */
+    int env;			/**< True when offset is in ENV */
+} statinfo[] = {
+    { "prepares", SQL_ATTR_SQLITE_STATS_PREPARES,
+      offsetof(DBC, stats.prepares), 0 },
+    { "stmtcache_hits", SQL_ATTR_SQLITE_STMTCACHE_HITS,
+      offsetof(DBC, s3cache_hits), 0 },
+    { "stmtcache_misses", SQL_ATTR_SQLITE_STMTCACHE_MISSES,
+      offsetof(DBC, s3cache_misses), 0 },
+    { "steps", SQL_ATTR_SQLITE_STATS_STEPS,
+      offsetof(DBC, stats.steps), 0 },
+    { "rows", SQL_ATTR_SQLITE_STATS_ROWS,
+      offsetof(DBC, stats.rows), 0 },
+    { "conv_bytes", SQL_ATTR_SQLITE_STATS_CONVBYTES,
+      offsetof(DBC, stats.convbytes), 0 },
+    { "busy_retries", SQL_ATTR_SQLITE_STATS_BUSYRETRIES,
+      offsetof(DBC, stats.busyretries), 0 },
+    { "busy_sleep_us", SQL_ATTR_SQLITE_STATS_BUSYSLEEP,
+      offsetof(DBC, stats.busysleep), 0 },
+    { "busy_waits", SQL_ATTR_SQLITE_STATS_BUSYWAITS,
+      offsetof(DBC, stats.busywaits), 0 },
+    { "busy_wait_max_us", SQL_ATTR_SQLITE_STATS_BUSYWAITMAX,
+      offsetof(DBC, stats.busywaitmax), 0 },
+    { "tran_begin", SQL_ATTR_SQLITE_STATS_BEGINS,
+      offsetof(DBC, stats.begins), 0 },
+    { "tran_commit", SQL_ATTR_SQLITE_STATS_COMMITS,
+      offsetof(DBC, stats.commits), 0 },
+    { "tran_rollback", SQL_ATTR_SQLITE_STATS_ROLLBACKS,
+      offsetof(DBC, stats.rollbacks), 0 },
+    { "gettable_us", SQL_ATTR_SQLITE_STATS_GETTABLE,
+      offsetof(DBC, stats.gettable), 0 },
+    { "getrowdata_us", SQL_ATTR_SQLITE_STATS_GETROWDATA,
+      offsetof(DBC, stats.getrowdata), 0 },
+    { "pool_hits", SQL_ATTR_SQLITE_POOL_HITS,
+      offsetof(ENV, poolhits), 1 },
+    { "pool_misses", SQL_ATTR_SQLITE_POOL_MISSES,
+      offsetof(ENV, poolmisses), 1 },
+    { "pool_expired", SQL_ATTR_SQLITE_POOL_EXPIRED,
+      offsetof(ENV, poolexpired), 1 },
+    { "pool_idle", SQL_ATTR_SQLITE_POOL_IDLE,
+      offsetof(ENV, pooln), 1 },
+};
 
-static void
-#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
-dbtrace(void *arg, const char *msg, sqlite_uint64 et)
-#else
-dbtrace(void *arg, const char *msg)
-#endif
-{
-    DBC *d = (DBC *) arg;
+#define NSTATINFO (int) (sizeof (statinfo) / sizeof (statinfo[0]))
 
-    if (msg && d->trace) {
-	int len = strlen(msg);
-#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
-	unsigned long s, f;
-#endif
+/**
+ * Return value of runtime performance counter.
+ * @param d DBC pointer
+ * @param i index into statinfo[]
+ * @result counter value
+ */
 
-	if (len > 0) {
-	    char *end = "\n";
+static SQLULEN
+statval(DBC *d, int i)
+{
+    char *base = (char *) d;
 
-	    if (msg[len - 1] != ';') {
-		end = ";\n";
-	    }
-	    fprintf(d->trace, "%s%s", msg, end);
-#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
-	    s = et / 1000000000LL;
-	    f = et % 1000000000LL;
-	    fprintf(d->trace, "-- took %lu.%09lu seconds\n", s, f);
-#endif
-	    fflush(d->trace);
+    if (statinfo[i].env) {
+	base = (char *) d->env;
+	if (!base) {
+	    return 0;
 	}
     }
+    return *((SQLULEN *) (base + statinfo[i].offs));
 }
 
+#if defined(HAVE_SQLITE3CREATEMODULEV2) && (HAVE_SQLITE3CREATEMODULEV2)
+
 /**
- * Trace function for SQLite API calls
- * @param d pointer to database connection handle
- * @param fn SQLite function name
- * @param sql SQL string
+ * @typedef STATVTAB
+ * @struct STATVTAB
+ * Virtual table "odbc_stats", one row per counter with
+ * the columns "name" and "value".
  */
 
-static void
-dbtraceapi(DBC *d, char *fn, const char *sql)
+typedef struct {
+    sqlite3_vtab vtab;		/**< SQLite virtual table */
+    DBC **dbref;		/**< Cell pointing to database connection */
+} STATVTAB;
+
+/**
+ * @typedef STATCUR
+ * @struct STATCUR
+ * Cursor on virtual table "odbc_stats".
+ */
+
+typedef struct {
+    sqlite3_vtab_cursor cursor;	/**< SQLite virtual table cursor */
+    int row;			/**< Current row, index into statinfo[] */
+} STATCUR;
+
+/**
+ * Connect to virtual table "odbc_stats".
+ * @param db SQLite database pointer
+ * @param aux user data, cell pointing to DBC (see dbopen())
+ * @param argc number arguments
+ * @param argv argument vector
+ * @param vtabp pointer receiving virtual table pointer
+ * @param errmsg pointer to error message
+ * @result SQLite error code
+ */
+
+static int
+stat_vtab_connect(sqlite3 *db, void *aux, int argc, const char * const *argv,
+		  sqlite3_vtab **vtabp, char **errmsg)
 {
-    if (fn && d->trace) {
-	if (sql) {
-	    fprintf(d->trace, "-- %s: %s\n", fn, sql);
-	} else {
-	    fprintf(d->trace, "-- %s\n", fn);
-	}
-	fflush(d->trace);
+    STATVTAB *vtab;
+    int rc;
+
+    rc = sqlite3_declare_vtab(db, "CREATE TABLE x(name TEXT, value INTEGER)");
+    if (rc != SQLITE_OK) {
+	return rc;
+    }
+    vtab = sqlite3_malloc(sizeof (STATVTAB));
+    if (!vtab) {
+	return SQLITE_NOMEM;
     }
+    memset(vtab, 0, sizeof (STATVTAB));
+    vtab->dbref = (DBC **) aux;
+    *vtabp = &vtab->vtab;
+    return SQLITE_OK;
 }
 
 /**
- * Trace function for SQLite return codes
- * @param d pointer to database connection handle
- * @param rc SQLite return code
- * @param err error string or NULL
+ * Disconnect from virtual table "odbc_stats".
+ * @param vtab virtual table pointer
+ * @result SQLite error code
  */
 
-static void
-dbtracerc(DBC *d, int rc, char *err)
+static int
+stat_vtab_disconnect(sqlite3_vtab *vtab)
 {
-    if (rc != SQLITE_OK && d->trace) {
-	fprintf(d->trace, "-- SQLITE ERROR CODE %d", rc);
-	fprintf(d->trace, err ? ": %s\n" : "\n", err);
-	fflush(d->trace);
-    }
+    sqlite3_free(vtab);
+    return SQLITE_OK;
 }
 
 /**
- * Open SQLite database file given file name and flags.
- * @param d DBC pointer
- * @param name file name
- * @param isu true/false: file name is UTF8 encoded
- * @param dsn data source name
- * @param sflag STEPAPI flag
- * @param spflag SyncPragma string
- * @param ntflag NoTransaction string
- * @param jmode JournalMode string
- * @param busy busy/lock timeout
- * @result ODBC error code
+ * Determine best index on virtual table "odbc_stats", always a full scan.
+ * @param vtab virtual table pointer
+ * @param info index information
+ * @result SQLite error code
  */
 
-static SQLRETURN
-dbopen(DBC *d, char *name, int isu, char *dsn, char *sflag,
-       char *spflag, char *ntflag, char *jmode, char *busy)
+static int
+stat_vtab_bestindex(sqlite3_vtab *vtab, sqlite3_index_info *info)
 {
-    char *endp = NULL;
-    int rc, tmp, busyto = 100000;
-#if defined(HAVE_SQLITE3VFS) && (HAVE_SQLITE3VFS)
-    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
-    char *uname = name;
-    const char *vfs_name = NULL;
-#endif
+    info->estimatedCost = NSTATINFO;
+    return SQLITE_OK;
+}
 
-    if (d->sqlite) {
-	if (d->trace) {
-	    fprintf(d->trace, "-- sqlite3_close (deferred): '%s'\n",
-		    d->dbname);
-	    fflush(d->trace);
-	}
-#if defined(HAVE_SQLITE3CLOSEV2) && (HAVE_SQLITE3CLOSEV2)
-	sqlite3_close_v2(d->sqlite);
-#else
-	sqlite3_close(d->sqlite);
-#endif
-	d->sqlite = NULL;
-    }
-#if defined(HAVE_SQLITE3VFS) && (HAVE_SQLITE3VFS)
-    if (d->nocreat) {
-	flags &= ~ SQLITE_OPEN_CREATE;
-    }
-#if defined(_WIN32) || defined(_WIN64)
-    if (!isu) {
-	char expname[SQL_MAX_MESSAGE_LENGTH * 2];
+/**
+ * Open cursor on virtual table "odbc_stats".
+ * @param vtab virtual table pointer
+ * @param curp pointer receiving cursor pointer
+ * @result SQLite error code
+ */
 
-	expname[0] = '\0';
-	rc = ExpandEnvironmentStrings(name, expname, sizeof (expname));
-	if (rc <= sizeof (expname)) {
-	    uname = wmb_to_utf(expname, rc - 1);
-	} else {
-	    uname = wmb_to_utf(name, -1);
-	}
-	if (!uname) {
-	    rc = SQLITE_NOMEM;
-	    setstatd(d, rc, "out of memory", (*d->ov3) ? "HY000" : "S1000");
-	    return SQL_ERROR;
-	}
-    }
-#endif
-#if defined(ENABLE_NVFS) && (ENABLE_NVFS)
-    vfs_name = nvfs_makevfs(uname);
-#endif
-#ifdef SQLITE_OPEN_URI
-    flags |= SQLITE_OPEN_URI;
-#endif
-    rc = sqlite3_open_v2(uname, &d->sqlite, flags, vfs_name);
-#if defined(WINTERFACE) || defined(_WIN32) || defined(_WIN64)
-    if (uname != name) {
-	uc_free(uname);
+static int
+stat_vtab_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **curp)
+{
+    STATCUR *cur = sqlite3_malloc(sizeof (STATCUR));
+
+    if (!cur) {
+	return SQLITE_NOMEM;
     }
-#endif
-#else
-#if defined(_WIN32) || defined(_WIN64)
-    if (d->nocreat) {
-	char *cname = NULL;
+    memset(cur, 0, sizeof (STATCUR));
+    *curp = &cur->cursor;
+    return SQLITE_OK;
+}
 
-	if (isu) {
-	    cname = utf_to_wmb(name, -1);
-	}
-	if (GetFileAttributesA(cname ? cname : name) ==
-	    INVALID_FILE_ATTRIBUTES) {
-	    uc_free(cname);
-	    rc = SQLITE_CANTOPEN;
-	    setstatd(d, rc, "cannot open database",
-		     (*d->ov3) ? "HY000" : "S1000");
-	    return SQL_ERROR;
-	}
-	uc_free(cname);
-    }
-#else
-    if (d->nocreat && access(name, 004) < 0) {
-	rc = SQLITE_CANTOPEN;
-	setstatd(d, rc, "cannot open database", (*d->ov3) ? "HY000" : "S1000");
-	return SQL_ERROR;
+/**
+ * Close cursor on virtual table "odbc_stats".
+ * @param cur cursor pointer
+ * @result SQLite error code
+ */
+
+static int
+stat_vtab_close(sqlite3_vtab_cursor *cur)
+{
+    sqlite3_free(cur);
+    return SQLITE_OK;
+}
+
+/**
+ * Start scan of virtual table "odbc_stats".
+ * @param cur cursor pointer
+ * @param idxn index number (unused)
+ * @param idxs index string (unused)
+ * @param argc number of arguments (unused)
+ * @param argv argument vector (unused)
+ * @result SQLite error code
+ */
+
+static int
+stat_vtab_filter(sqlite3_vtab_cursor *cur, int idxn, const char *idxs,
+		 int argc, sqlite3_value **argv)
+{
+    ((STATCUR *) cur)->row = 0;
+    return SQLITE_OK;
+}
+
+/**
+ * Advance cursor on virtual table "odbc_stats".
+ * @param cur cursor pointer
+ * @result SQLite error code
+ */
+
+static int
+stat_vtab_next(sqlite3_vtab_cursor *cur)
+{
+    ((STATCUR *) cur)->row++;
+    return SQLITE_OK;
+}
+
+/**
+ * Check for end of virtual table "odbc_stats".
+ * @param cur cursor pointer
+ * @result true when no more rows
+ */
+
+static int
+stat_vtab_eof(sqlite3_vtab_cursor *cur)
+{
+    return ((STATCUR *) cur)->row >= NSTATINFO;
+}
+
+/**
+ * Return column value of virtual table "odbc_stats".
+ * @param cur cursor pointer
+ * @param ctx SQLite function context
+ * @param n column number
+ * @result SQLite error code
+ */
+
+static int
+stat_vtab_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int n)
+{
+    STATVTAB *vtab = (STATVTAB *) cur->pVtab;
+    int row = ((STATCUR *) cur)->row;
+
+    if (n == 0) {
+	sqlite3_result_text(ctx, statinfo[row].name, -1, SQLITE_STATIC);
+    } else if (!*vtab->dbref) {
+	/* no connection, e.g. while the handle is reset for the pool */
+	sqlite3_result_null(ctx);
+    } else {
+	sqlite3_result_int64(ctx, (sqlite_int64) statval(*vtab->dbref, row));
     }
-#endif
-#if defined(_WIN32) || defined(_WIN64)
-    if (!isu) {
-	WCHAR *wname = wmb_to_uc(name, -1);
+    return SQLITE_OK;
+}
+
+/**
+ * Return ROWID of current row of virtual table "odbc_stats".
+ * @param cur cursor pointer
+ * @param rowidp pointer receiving ROWID
+ * @result SQLite error code
+ */
+
+static int
+stat_vtab_rowid(sqlite3_vtab_cursor *cur, sqlite_int64 *rowidp)
+{
+    *rowidp = ((STATCUR *) cur)->row;
+    return SQLITE_OK;
+}
+
+/**
+ * Module of virtual table "odbc_stats". xCreate equals xConnect,
+ * thus the table is eponymous in SQLite 3.9.0 and later but can
+ * be created explicitly, e.g.
+ *   CREATE VIRTUAL TABLE temp.odbc_stats USING odbc_stats
+ * in older versions.
+ */
+
+static const sqlite3_module stat_vtab_mod = {
+    1,				/* iVersion */
+    stat_vtab_connect,		/* xCreate */
+    stat_vtab_connect,		/* xConnect */
+    stat_vtab_bestindex,	/* xBestIndex */
+    stat_vtab_disconnect,	/* xDisconnect */
+    stat_vtab_disconnect,	/* xDestroy */
+    stat_vtab_open,		/* xOpen */
+    stat_vtab_close,		/* xClose */
+    stat_vtab_filter,		/* xFilter */
+    stat_vtab_next,		/* xNext */
+    stat_vtab_eof,		/* xEof */
+    stat_vtab_column,		/* xColumn */
+    stat_vtab_rowid,		/* xRowid */
+    0,				/* xUpdate */
+    0,				/* xBegin */
+    0,				/* xSync */
+    0,				/* xCommit */
+    0,				/* xRollback */
+    0,				/* xFindFunction */
+    0,				/* xRename */
+};
 
-	if (!wname) {
-	    rc = SQLITE_NOMEM;
-	    setstatd(d, rc, "out of memory", (*d->ov3) ? "HY000" : "S1000");
-	    return SQL_ERROR;
-	}
-	rc = sqlite3_open16(wname, &d->sqlite);
-	uc_free(wname);
-    } else
 #endif
-    rc = sqlite3_open(name, &d->sqlite);
-#endif /* !HAVE_SQLITE3VFS */
-    if (rc != SQLITE_OK) {
-connfail:
-	setstatd(d, rc, "connect failed", (*d->ov3) ? "HY000" : "S1000");
-	if (d->sqlite) {
-	    sqlite3_close(d->sqlite);
-	    d->sqlite = NULL;
-	}
-	return SQL_ERROR;
-    }
-#if defined(SQLITE_DYNLOAD) || defined(SQLITE_HAS_CODEC)
-    if (d->pwd) {
-	sqlite3_key(d->sqlite, d->pwd, d->pwdLen);
+
+/**
+ * Write binary trace buffer to trace file.
+ * @param d DBC pointer
+ */
+
+static void
+trcflush(DBC *d)
+{
+    if (d->trcn > 0 && d->trcfile) {
+	fwrite(d->trcbuf, sizeof (TRCREC), d->trcn, d->trcfile);
     }
-#endif
-    d->pwd = NULL;
-    d->pwdLen = 0;
-    if (d->trace) {
-#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
-	sqlite3_profile(d->sqlite, dbtrace, d);
-#else
-	sqlite3_trace(d->sqlite, dbtrace, d);
-#endif
+    d->trcn = 0;
+}
+
+/**
+ * Write text to binary trace buffer unless recently done.
+ * @param d DBC pointer
+ * @param text text string
+ * @result hash of text which other records use to refer to it
+ *
+ * The hash is FNV-1a over the full text, the text itself is
+ * truncated to TRC_NREC / 4 records.
+ */
+
+static unsigned int
+trctext(DBC *d, const char *text)
+{
+    const unsigned char *p = (const unsigned char *) text;
+    unsigned int h = 2166136261U;
+    int len, n;
+    TRCREC *r;
+
+    for (len = 0; p[len]; len++) {
+	h = (h ^ p[len]) * 16777619U;
     }
-    d->step_enable = getbool(sflag);
-    d->trans_disable = getbool(ntflag);
-    d->curtype = d->step_enable ?
-	SQL_CURSOR_FORWARD_ONLY : SQL_CURSOR_STATIC;
-    tmp = strtol(busy, &endp, 0);
-    if (endp && *endp == '\0' && endp != busy) {
-	busyto = tmp;
+    if (h == 0) {
+	h = 1;
     }
-    if (busyto < 1 || busyto > 1000000) {
-	busyto = 1000000;
+    if (d->trcseen[h % TRC_NSEEN] == h) {
+	return h;
     }
-    d->timeout = busyto;
-    freep(&d->dbname);
-    d->dbname = xstrdup(name);
-    freep(&d->dsn);
-    d->dsn = xstrdup(dsn);
-    if ((rc = setsqliteopts(d->sqlite, d)) != SQLITE_OK) {
-	if (d->trace) {
-	    fprintf(d->trace, "-- sqlite3_close: '%s'\n",
-		    d->dbname);
-	    fflush(d->trace);
-	}
-	sqlite3_close(d->sqlite);
-	d->sqlite = NULL;
-	goto connfail;
+    d->trcseen[h % TRC_NSEEN] = h;
+    if (len > (TRC_NREC / 4) * (int) sizeof (TRCREC)) {
+	len = (TRC_NREC / 4) * sizeof (TRCREC);
     }
-    if (!spflag || spflag[0] == '\0') {
-	spflag = "NORMAL";
+    n = (len + sizeof (TRCREC) - 1) / sizeof (TRCREC);
+    if (d->trcn + 1 + n > TRC_NREC) {
+	trcflush(d);
     }
-    if (spflag[0] != '\0') {
-	char syncp[128];
+    r = &d->trcbuf[d->trcn++];
+    memset(r, 0, sizeof (TRCREC));
+    r->time = getusec();
+    r->handle = (sqlite_uint64) (size_t) d;
+    r->event = TRC_TEXT;
+    r->hash = h;
+    r->name = len;
+    r = &d->trcbuf[d->trcn];
+    memset(r, 0, n * sizeof (TRCREC));
+    memcpy(r, text, len);
+    d->trcn += n;
+    return h;
+}
 
-	sprintf(syncp, "PRAGMA synchronous = %8.8s;", spflag);
-	sqlite3_exec(d->sqlite, syncp, NULL, NULL, NULL);
+/**
+ * Append event record to binary trace buffer.
+ * @param d DBC pointer
+ * @param event event code, TRC_*
+ * @param text text of event (SQL, database name etc.) or NULL
+ * @result pointer to record for filling in further fields
+ */
+
+static TRCREC *
+trcevent(DBC *d, int event, const char *text)
+{
+    unsigned int h = text ? trctext(d, text) : 0;
+    TRCREC *r;
+
+    if (d->trcn >= TRC_NREC) {
+	trcflush(d);
     }
-    if (jmode[0] != '\0') {
-	char jourp[128];
+    r = &d->trcbuf[d->trcn++];
+    memset(r, 0, sizeof (TRCREC));
+    r->time = getusec();
+    r->handle = (sqlite_uint64) (size_t) d;
+    r->event = event;
+    r->hash = h;
+    return r;
+}
 
-	sprintf(jourp, "PRAGMA journal_mode = %16.16s;", jmode);
-	sqlite3_exec(d->sqlite, jourp, NULL, NULL, NULL);
+/**
+ * Open binary trace file and allocate trace buffer.
+ * @param d DBC pointer
+ * @param name file name, records are appended
+ */
+
+static void
+trcopen(DBC *d, char *name)
+{
+    TRCREC *r;
+
+    d->trcfile = fopen(name, "ab");
+    if (!d->trcfile) {
+	return;
     }
-    if (d->trace) {
-	fprintf(d->trace, "-- sqlite3_open: '%s'\n", d->dbname);
-	fflush(d->trace);
+    d->trcbuf = xmalloc(TRC_NREC * sizeof (TRCREC));
+    d->trcseen = xmalloc(TRC_NSEEN * sizeof (unsigned int));
+    if (!d->trcbuf || !d->trcseen) {
+	freep(&d->trcbuf);
+	freep(&d->trcseen);
+	fclose(d->trcfile);
+	d->trcfile = NULL;
+	return;
     }
-#if defined(_WIN32) || defined(_WIN64)
-    {
-	char pname[MAX_PATH];
-	HANDLE h = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
-			       FALSE, GetCurrentProcessId());
-
-	pname[0] = '\0';
-	if (h) {
-	    HMODULE m = NULL, l = LoadLibrary("psapi.dll");
-	    DWORD need;
-	    typedef BOOL (WINAPI *epmfunc)(HANDLE, HMODULE *, DWORD, LPDWORD);
-	    typedef BOOL (WINAPI *gmbfunc)(HANDLE, HMODULE, LPSTR, DWORD);
-	    epmfunc epm;
-	    gmbfunc gmb;
+    memset(d->trcseen, 0, TRC_NSEEN * sizeof (unsigned int));
+    d->trcn = 0;
+    r = trcevent(d, TRC_START, NULL);
+    r->hash = TRC_VERSION;
+    r->name = (unsigned int) time(NULL);
+}
 
-	    if (l) {
-		epm = (epmfunc) GetProcAddress(l, "EnumProcessModules");
-		gmb = (gmbfunc) GetProcAddress(l, "GetModuleBaseNameA");
-		if (epm && gmb && epm(h, &m, sizeof (m), &need)) {
-		    gmb(h, m, pname, sizeof (pname));
-		}
-		FreeLibrary(l);
-	    }
-	    CloseHandle(h);
-	}
-	d->xcelqrx = strncasecmp(pname, "EXCEL", 5) == 0 ||
-		     strncasecmp(pname, "MSQRY", 5) == 0;
-	if (d->trace && d->xcelqrx) {
+/**
+ * Flush and close binary trace file, release trace buffer.
+ * @param d DBC pointer
+ */
 
-	    fprintf(d->trace, "-- enabled EXCEL quirks\n");
-	    fflush(d->trace);
-	}
+static void
+trcclose(DBC *d)
+{
+    if (d->trcbuf) {
+	trcflush(d);
+	freep(&d->trcbuf);
+	freep(&d->trcseen);
+    }
+    if (d->trcfile) {
+	fclose(d->trcfile);
+	d->trcfile = NULL;
     }
-#endif
-    sqlite3_create_function(d->sqlite, "blob_import", 1, SQLITE_UTF8,
-			    d, blob_import, 0, 0);
-    sqlite3_create_function(d->sqlite, "blob_export", 2, SQLITE_UTF8,
-			    d, blob_export, 0, 0);
-    return SQL_SUCCESS;
 }
 
 /**
- * Load SQLite extension modules, if any
+ * Binary trace of bound parameter, see s3bind().
  * @param d DBC pointer
- * @param exts string, comma separated extension names
+ * @param n parameter number, starting at 1
+ * @param p pointer to bound parameter
  */
 
 static void
-dbloadext(DBC *d, char *exts)
+trcparam(DBC *d, int n, BINDPARM *p)
 {
-#if defined(HAVE_SQLITE3LOADEXTENSION) && (HAVE_SQLITE3LOADEXTENSION)
-    char *p;
-    char path[SQL_MAX_MESSAGE_LENGTH];
-    int plen = 0;
+    TRCREC *r = trcevent(d, TRC_PARAM, NULL);
 
-    if (!d->sqlite) {
-	return;
-    }
-    sqlite3_enable_load_extension(d->sqlite, 1);
-#if defined(_WIN32) || defined(_WIN64)
-    GetModuleFileName(hModule, path, sizeof (path));
-    p = strrchr(path, '\\');
-    plen = p ? ((p + 1) - path) : 0;
+    r->name = n;
+    r->rc = p->s3type;
+    r->dur = (p->s3type == SQLITE_TEXT || p->s3type == SQLITE_BLOB) ?
+	p->s3size : 0;
+}
+
+/**
+ * SQLite trace or profile callback
+ * @param arg DBC pointer
+ * @param msg log message, SQL text
+ * @param et  elapsed time
+ */
+
+static void
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+dbtrace(void *arg, const char *msg, sqlite_uint64 et)
+#else
+dbtrace(void *arg, const char *msg)
 #endif
-    do {
-	p = strchr(exts, ',');
-	if (p) {
-	    strncpy(path + plen, exts, p - exts);
-	    path[plen + (p - exts)] = '\0';
-	} else {
-	    strcpy(path + plen, exts);
-	}
-	if (exts[0]) {
-	    char *errmsg = NULL;
-	    int rc;
-#if defined(_WIN32) || defined(_WIN64)
-	    int i;
-	    char *q;
+{
+    DBC *d = (DBC *) arg;
 
-	    q = path + plen;
-	    if (!(q[0] &&
-		  ((q[1] == ':' && (q[2] == '\\' || q[2] == '/')) ||
-		   q[0] == '\\' || q[0] == '/' || q[0] == '.'))) {
-		q = path;
-	    }
-	    /* sqlite3_load_extension() dislikes backslashes */
-	    for (i = 0; q[i] != '\0'; i++) {
-		if (q[i] == '\\') {
-		    q[i] = '/';
-		}
-	    }
-	    rc = sqlite3_load_extension(d->sqlite, q, 0, &errmsg);
+    if (msg && d->trcbuf) {
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+	trcevent(d, TRC_SQL, msg)->dur = (unsigned int) (et / 1000);
 #else
-	    rc = sqlite3_load_extension(d->sqlite, path, 0, &errmsg);
+	trcevent(d, TRC_SQL, msg);
 #endif
-	    if (rc != SQLITE_OK) {
-#if defined(_WIN32) || defined(_WIN64)
-		char buf[512], msg[512];
-
-		LoadString(hModule, IDS_EXTERR, buf, sizeof (buf));
-		wsprintf(msg, buf, q, errmsg ?
-			 errmsg : "no error info available");
-		LoadString(hModule, IDS_EXTTITLE, buf, sizeof (buf));
-		MessageBox(NULL, msg, buf,
-			   MB_ICONEXCLAMATION | MB_OK | MB_TASKMODAL |
-			   MB_SETFOREGROUND);
-#else
-		fprintf(stderr, "extension '%s' did not load%s%s\n",
-			path, errmsg ? ": " : "", errmsg ? errmsg : "");
+    }
+    if (msg && d->trace) {
+	int len = strlen(msg);
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+	unsigned long s, f;
 #endif
+
+	if (len > 0) {
+	    char *end = "\n";
+
+	    if (msg[len - 1] != ';') {
+		end = ";\n";
 	    }
+	    fprintf(d->trace, "%s%s", msg, end);
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+	    s = et / 1000000000LL;
+	    f = et % 1000000000LL;
+	    fprintf(d->trace, "-- took %lu.%09lu seconds\n", s, f);
+#endif
+	    fflush(d->trace);
 	}
-	if (p) {
-	    exts = p + 1;
-	}
-    } while (p);
-#endif /* HAVE_SQLITE3LOADEXTENSION */
+    }
 }
 
 /**
- * Find out column type
- * @param s3stmt SQLite statement pointer
- * @param col column number
- * @param d DBC pointer (for tracing only)
- * @param guessed_types flag array
- * @result type name as string
+ * Trace function for SQLite API calls
+ * @param d pointer to database connection handle
+ * @param fn SQLite function name
+ * @param sql SQL string
  */
 
-static char *
-s3stmt_coltype(sqlite3_stmt *s3stmt, int col, DBC *d, int *guessed_types)
+static void
+dbtraceapi(DBC *d, char *fn, const char *sql)
 {
-    char *typename = (char *) sqlite3_column_decltype(s3stmt, col);
-    char guess[64];
-
-    guess[0] = '\0';
-    if (!typename) {
-	int coltype = sqlite3_column_type(s3stmt, col);
+    if (fn && d->trcbuf) {
+	unsigned int h = sql ? trctext(d, sql) : 0;
+	TRCREC *r = trcevent(d, TRC_API, fn);
 
-	if (guessed_types) {
-	    guessed_types[0]++;
-	}
-	if (d->trace) {
-	    sprintf(guess, " (guessed from %d)", coltype);
-	}
-	switch (coltype) {
-	case SQLITE_INTEGER: typename = "integer"; break;
-	case SQLITE_FLOAT:   typename = "double";  break;
-	default:
-	case SQLITE_TEXT:    typename = "varchar"; break;
-	case SQLITE_BLOB:    typename = "blob";    break;
-#if 0
-	case SQLITE_NULL:    typename = "null";    break;
-#endif
-	}
+	r->name = r->hash;
+	r->hash = h;
     }
-    if (d->trace) {
-	fprintf(d->trace, "-- column %d type%s: '%s'\n", col + 1,
-		guess, typename);
+    if (fn && d->trace) {
+	if (sql) {
+	    fprintf(d->trace, "-- %s: %s\n", fn, sql);
+	} else {
+	    fprintf(d->trace, "-- %s\n", fn);
+	}
 	fflush(d->trace);
     }
-    return typename;
 }
 
-#ifdef FULL_METADATA
-
 /**
- * Add meta data for column
- * @param s3stmt SQLite statement pointer
- * @param col column number
- * @param d DBC pointer (for tracing only)
- * @param ci pointer to COL
+ * Trace function for SQLite return codes
+ * @param d pointer to database connection handle
+ * @param rc SQLite return code
+ * @param err error string or NULL
  */
 
 static void
-s3stmt_addmeta(sqlite3_stmt *s3stmt, int col, DBC *d, COL *ci)
+dbtracerc(DBC *d, int rc, char *err)
 {
-    int nn = 0, pk = 0, ai = 0;
-    const char *dn = NULL, *tn = NULL, *cn = NULL, *dummy[4];
+    if (rc != SQLITE_OK && d->trcbuf) {
+	TRCREC *r = trcevent(d, TRC_RC, err);
 
-    dn = sqlite3_column_database_name(s3stmt, col);
-    tn = sqlite3_column_table_name(s3stmt, col);
-    cn = sqlite3_column_origin_name(s3stmt, col);
-    dummy[0] = dummy[1] = 0;
-    if (tn && cn) {
-	sqlite3_table_column_metadata(d->sqlite, dn, tn, cn,
-				      dummy, dummy + 1,
-				      &nn, &pk, &ai);
+	r->rc = rc;
     }
-    ci->autoinc = ai ? SQL_TRUE: SQL_FALSE;
-    ci->notnull = nn ? SQL_NO_NULLS : SQL_NULLABLE;
-    ci->ispk = pk ? 1 : 0;
-    if (d->trace) {
-	fprintf(d->trace, "-- column %d %s\n",
-		col + 1, nn ? "notnull" : "nullable");
-	if (ai) {
-	    fprintf(d->trace, "-- column %d autoincrement\n", col + 1);
-	}
+    if (rc != SQLITE_OK && d->trace) {
+	fprintf(d->trace, "-- SQLITE ERROR CODE %d", rc);
+	fprintf(d->trace, err ? ": %s\n" : "\n", err);
 	fflush(d->trace);
     }
-    ci->isrowid = 0;
-    if (ci->ispk && tn) {
-	nn = pk = ai = 0;
-	dummy[2] = dummy[3] = 0;
+}
 
-	sqlite3_table_column_metadata(d->sqlite, dn, tn, "rowid",
-				      dummy + 2, dummy + 3,
-				      &nn, &pk, &ai);
-	if (pk && dummy[0] && dummy[0] == dummy[2]) {
-	    ci->isrowid = 1;
+/**
+ * Setup connection pooling of DBC from Pool DSN option.
+ * @param d DBC pointer
+ * @param pool "max[:idle[:age]]", idle and age in seconds, or empty
+ * for the defaults when SQL_CP_ONE_PER_DRIVER is set on the ENV
+ * @param dbname database name
+ * @param isu true/false: file name is UTF8 encoded
+ * @param spflag SyncPragma string
+ * @param jmode JournalMode string
+ * @param loadext LoadExt string
+ *
+ * The pool key is made of all options which determine the state
+ * of a freshly opened SQLite handle, in fixed order, thus
+ * perfsetup() must be called before. Connections
+ * with a password are never pooled.
+ */
+
+static void
+poolsetup(DBC *d, char *pool, char *dbname, int isu, char *spflag,
+	  char *jmode, char *loadext)
+{
+    char *p;
+
+    freep(&d->poolkey);
+    d->poolmax = 0;
+    d->poolidle = POOL_IDLE;
+    d->poolage = POOL_AGE;
+    if (pool && pool[0]) {
+	d->poolmax = getint(pool, 0, 0, 1000);
+	p = strchr(pool, ':');
+	if (p) {
+	    d->poolidle = getint(p + 1, POOL_IDLE, 0, 86400);
+	    p = strchr(p + 1, ':');
+	}
+	if (p) {
+	    d->poolage = getint(p + 1, POOL_AGE, 0, 86400);
 	}
+    } else if (d->env && d->env->pool) {
+	d->poolmax = POOL_MAX;
+    }
+    if (d->poolmax <= 0 || !d->env || d->pwd) {
+	return;
+    }
+    if (!spflag || spflag[0] == '\0') {
+	spflag = "NORMAL";
+    }
+    p = d->perfsql ? d->perfsql : "";
+    d->poolkey = xmalloc(strlen(dbname) + strlen(spflag) + strlen(jmode) +
+			 strlen(loadext) + strlen(p) + 16);
+    if (d->poolkey) {
+	sprintf(d->poolkey, "%d%d%d%d%d%d;%s;%s;%s;%s;%s", isu, d->nocreat,
+		d->fksupport, d->shortnames, d->longnames, d->sharedcache,
+		spflag, jmode, p, loadext, dbname);
     }
 }
 
+/**
+ * Close SQLite handles of list of connection pool entries.
+ * @param p first entry or NULL
+ */
+
+static void
+poolfree(POOLENT *p)
+{
+    POOLENT *next;
+
+    while (p) {
+	next = p->next;
+#if defined(HAVE_SQLITE3CLOSEV2) && (HAVE_SQLITE3CLOSEV2)
+	sqlite3_close_v2(p->sqlite);
+#else
+	sqlite3_close(p->sqlite);
 #endif
+	xfree(p->key);
+	xfree(p);
+	p = next;
+    }
+}
 
 /**
- * Do one sqlite statement step gathering one result row
- * @param s statement pointer
- * @result ODBC error code
+ * Take SQLite handle matching pool key of DBC from connection
+ * pool of ENV, closing expired handles on the way.
+ * @param d DBC pointer
+ * @result true when d->sqlite was taken from the pool
  */
 
 static int
-s3stmt_step(STMT *s)
+pooltake(DBC *d)
 {
-    DBC *d = (DBC *) s->dbc;
-    char **rowd = NULL;
-    const char *errp = NULL;
-    int i, ncols, rc;
+    ENV *e = d->env;
+    POOLENT *p, **pp, *hit = NULL, *dead = NULL;
+    sqlite_int64 now = getusec();
 
-    if (s != d->cur_s3stmt || !s->s3stmt) {
-	setstat(s, -1, "stale statement", (*s->ov3) ? "HY000" : "S1000");
-	return SQL_ERROR;
+#if defined(_WIN32) || defined(_WIN64)
+    EnterCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_lock(&e->poolmutex);
+#endif
+    pp = &e->poolents;
+    while ((p = *pp)) {
+	if (now >= p->expires) {
+	    *pp = p->next;
+	    p->next = dead;
+	    dead = p;
+	    e->pooln--;
+	    e->poolexpired++;
+	    continue;
+	}
+	if (!hit && strcmp(p->key, d->poolkey) == 0) {
+	    *pp = p->next;
+	    hit = p;
+	    e->pooln--;
+	    continue;
+	}
+	pp = &p->next;
     }
-    rc = sqlite3_step(s->s3stmt);
-    if (rc == SQLITE_ROW || rc == SQLITE_DONE) {
-	++s->s3stmt_rownum;
-	ncols = sqlite3_column_count(s->s3stmt);
-	if (d->s3stmt_needmeta && s->s3stmt_rownum == 0 && ncols > 0) {
-	    PTRDIFF_T size;
-	    char *p;
-	    COL *dyncols;
-	    const char *colname, *typename;
-#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
-	    char *tblname;
-#endif
-#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
-	    char *dbname;
+    if (hit) {
+	e->poolhits++;
+    } else {
+	e->poolmisses++;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    LeaveCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_unlock(&e->poolmutex);
 #endif
+    poolfree(dead);
+    if (!hit) {
+	return 0;
+    }
+    d->sqlite = hit->sqlite;
+    d->poolborn = hit->born;
+    d->dbref = hit->dbref;
+    if (d->dbref) {
+	*d->dbref = d;
+    }
+    xfree(hit->key);
+    xfree(hit);
+    return 1;
+}
 
-	    for (i = size = 0; i < ncols; i++) {
-		colname = sqlite3_column_name(s->s3stmt, i);
-		size += 3 + 3 * strlen(colname);
-	    }
-#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
-	    tblname = (char *) size;
-	    for (i = 0; i < ncols; i++) {
-		p = (char *) sqlite3_column_table_name(s->s3stmt, i);
-		size += 2 + (p ? strlen(p) : 0);
-	    }
-#endif
-#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
-	    dbname = (char *) size;
-	    for (i = 0; i < ncols; i++) {
-		p = (char *) sqlite3_column_database_name(s->s3stmt, i);
-		size += 2 + (p ? strlen(p) : 0);
-	    }
-#endif
-	    dyncols = xmalloc(ncols * sizeof (COL) + size);
-	    if (!dyncols) {
-		freedyncols(s);
-		s->ncols = 0;
-		dbtraceapi(d, "sqlite3_finalize", 0);
-		sqlite3_finalize(s->s3stmt);
-		s->s3stmt = NULL;
-		d->cur_s3stmt = NULL;
-		return nomem(s);
-	    }
-	    p = (char *) (dyncols + ncols);
-#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
-	    tblname = p + (PTRDIFF_T) tblname;
-#endif
-#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
-	    dbname = p + (PTRDIFF_T) dbname;
-#endif
-	    for (i = 0; i < ncols; i++) {
-		char *q;
+/**
+ * Reset SQLite handle of DBC for the connection pool: clear
+ * callbacks referring to the DBC, roll back an open transaction,
+ * drop temporary tables, views, and triggers, detach databases.
+ * @param d DBC pointer
+ * @result true when the handle can be pooled
+ */
 
-		colname = sqlite3_column_name(s->s3stmt, i);
-		if (d->trace) {
-		    fprintf(d->trace, "-- column %d name: '%s'\n",
-			    i + 1, colname);
-		    fflush(d->trace);
-		}
-#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
-		q = (char *) sqlite3_column_table_name(s->s3stmt, i);
-		strcpy(tblname, q ? q : "");
-		if (d->trace) {
-		    fprintf(d->trace, "-- table %d name: '%s'\n",
-			    i + 1, tblname);
-		    fflush(d->trace);
-		}
-		dyncols[i].table = tblname;
-		tblname += strlen(tblname) + 1;
-#endif
-#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
-		q = (char *) sqlite3_column_database_name(s->s3stmt, i);
-		strcpy(dbname, q ? q : "");
-		if (d->trace) {
-		    fprintf(d->trace, "-- database %d name: '%s'\n",
-			    i + 1, dbname);
-		    fflush(d->trace);
-		}
-		dyncols[i].db = dbname;
-		dbname += strlen(dbname) + 1;
-#else
-		dyncols[i].db = ((DBC *) (s->dbc))->dbname;
-#endif
-		typename = s3stmt_coltype(s->s3stmt, i, d, 0);
-		strcpy(p, colname);
-		dyncols[i].label = p;
-		p += strlen(p) + 1;
-		q = strchr(colname, '.');
-		if (q) {
-		    char *q2 = strchr(q + 1, '.');
+static int
+poolreset(DBC *d)
+{
+    sqlite3 *x = d->sqlite;
+    char **rows = NULL, *sql;
+    int i, nrows = 0, ncols = 0, rc;
 
-		    /* SQLite 3.3.4 produces view.table.column sometimes */
-		    if (q2) {
-			q = q2;
-		    }
-		}
-		if (q) {
-#if !defined(HAVE_SQLITE3COLUMNTABLENAME) || !(HAVE_SQLITE3COLUMNTABLENAME)
-		    dyncols[i].table = p;
-#endif
-		    strncpy(p, colname, q - colname);
-		    p[q - colname] = '\0';
-		    p += strlen(p) + 1;
-		    strcpy(p, q + 1);
-		    dyncols[i].column = p;
-		    p += strlen(p) + 1;
-		} else {
-#if !defined(HAVE_SQLITE3COLUMNTABLENAME) || !(HAVE_SQLITE3COLUMNTABLENAME)
-		    dyncols[i].table = "";
-#endif
-		    strcpy(p, colname);
-		    dyncols[i].column = p;
-		    p += strlen(p) + 1;
-		}
-		if (s->longnames) {
-		    dyncols[i].column = dyncols[i].label;
-		}
-#ifdef SQL_LONGVARCHAR
-		dyncols[i].type = SQL_LONGVARCHAR;
-		dyncols[i].size = 65535;
+    sqlite3_busy_handler(x, NULL, NULL);
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+    sqlite3_profile(x, NULL, NULL);
 #else
-		dyncols[i].type = SQL_VARCHAR;
-		dyncols[i].size = 255;
-#endif
-		dyncols[i].index = i;
-		dyncols[i].scale = 0;
-		dyncols[i].prec = 0;
-		dyncols[i].nosign = 1;
-		dyncols[i].autoinc = SQL_FALSE;
-		dyncols[i].notnull = SQL_NULLABLE;
-		dyncols[i].ispk = -1;
-		dyncols[i].isrowid = -1;
-#ifdef FULL_METADATA
-		s3stmt_addmeta(s->s3stmt, i, d, &dyncols[i]);
-#endif
-		dyncols[i].typename = xstrdup(typename);
-	    }
-	    freedyncols(s);
-	    s->ncols = s->dcols = ncols;
-	    s->dyncols = s->cols = dyncols;
-	    fixupdyncols(s, d);
-	    mkbindcols(s, s->ncols);
-	    d->s3stmt_needmeta = 0;
-	}
-	if (ncols <= 0) {
-	    goto killstmt;
-	}
-	if (rc == SQLITE_DONE) {
-	    freeresult(s, 0);
-	    s->nrows = 0;
-	    dbtraceapi(d, "sqlite3_finalize", 0);
-	    sqlite3_finalize(s->s3stmt);
-	    s->s3stmt = NULL;
-	    d->cur_s3stmt = NULL;
-	    return SQL_SUCCESS;
-	}
-	rowd = xmalloc((1 + 2 * ncols) * sizeof (char *));
-	if (rowd) {
-	    const unsigned char *value;
-
-	    rowd[0] = (char *) ((PTRDIFF_T) (ncols * 2));
-	    ++rowd;
-	    for (i = 0; i < ncols; i++) {
-		int coltype = sqlite3_column_type(s->s3stmt, i);
-
-		rowd[i] = rowd[i + ncols] = NULL;
-		if (coltype == SQLITE_BLOB) {
-		    int k, nbytes = sqlite3_column_bytes(s->s3stmt, i);
-		    char *qp;
-		    unsigned const char *bp;
-
-		    bp = sqlite3_column_blob(s->s3stmt, i);
-		    qp = xmalloc(nbytes * 2 + 4);
-		    if (qp) {
-			rowd[i + ncols] = qp;
-			*qp++ = 'X';
-			*qp++ = '\'';
-			for (k = 0; k < nbytes; k++) {
-			    *qp++ = xdigits[(bp[k] >> 4)];
-			    *qp++ = xdigits[(bp[k] & 0xF)];
-			}
-			*qp++ = '\'';
-			*qp = '\0';
-		    }
-#ifdef _MSC_VER
-		} else if (coltype == SQLITE_FLOAT) {
-		    struct lconv *lc = 0;
-		    double d = sqlite3_column_double(s->s3stmt, i);
-		    char *p, buffer[128];
-
-		    /*
-		     * This avoids floating point rounding
-		     * and formatting problems of some SQLite
-		     * versions in conjunction with MSVC 2010.
-		     */
-		    snprintf(buffer, sizeof (buffer), "%.15g", d);
-		    lc = localeconv();
-		    if (lc && lc->decimal_point && lc->decimal_point[0] &&
-			lc->decimal_point[0] != '.') {
-			p = strchr(buffer, lc->decimal_point[0]);
-			if (p) {
-			    *p = '.';
-			}
-		    }
-		    rowd[i + ncols] = xstrdup(buffer);
+    sqlite3_trace(x, NULL, NULL);
 #endif
-		} else if (coltype != SQLITE_NULL) {
-		    value = sqlite3_column_text(s->s3stmt, i);
-		    rowd[i + ncols] = xstrdup((char *) value);
-		}
-	    }
-	    for (i = 0; i < ncols; i++) {
-		int coltype = sqlite3_column_type(s->s3stmt, i);
-
-		value = NULL;
-		if (coltype == SQLITE_BLOB) {
-		    value = sqlite3_column_blob(s->s3stmt, i);
-		} else if (coltype != SQLITE_NULL) {
-		    value = sqlite3_column_text(s->s3stmt, i);
-		}
-		if (value && !rowd[i + ncols]) {
-		    freerows(rowd);
-		    rowd = 0;
-		    break;
-		}
-	    }
-	}
-	if (rowd) {
-	    freeresult(s, 0);
-	    s->nrows = 1;
-	    s->rows = rowd;
-	    s->rowfree = freerows;
-	    if (rc == SQLITE_DONE) {
-		dbtraceapi(d, "sqlite3_finalize", 0);
-		sqlite3_finalize(s->s3stmt);
-		s->s3stmt = NULL;
-		d->cur_s3stmt = NULL;
-	    }
-	    return SQL_SUCCESS;
-	}
+    if (d->dbref) {
+	*d->dbref = NULL;
     }
-killstmt:
-    dbtraceapi(d, "sqlite3_reset", 0);
-    rc = sqlite3_reset(s->s3stmt);
-    s->s3stmt_noreset = 1;
-    errp = sqlite3_errmsg(d->sqlite);
-    if (d->cur_s3stmt == s) {
-	d->cur_s3stmt = NULL;
+    if (!sqlite3_get_autocommit(x) &&
+	sqlite3_exec(x, "ROLLBACK", NULL, NULL, NULL) != SQLITE_OK) {
+	return 0;
     }
-    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
-	    errp ? errp : "unknown error", rc);
-    return SQL_ERROR;
-}
-
-/**
- * Stop running sqlite statement
- * @param s statement pointer
- */
-
-static void
-s3stmt_end(STMT *s)
-{
-    DBC *d;
-
-    if (!s || !s->s3stmt) {
-	return;
+    rc = sqlite3_get_table(x, "SELECT type, name FROM sqlite_temp_master "
+			   "WHERE type IN ('table', 'view', 'trigger') "
+			   "AND name NOT LIKE 'sqlite%' ORDER BY type DESC",
+			   &rows, &nrows, &ncols, NULL);
+    for (i = 1; rc == SQLITE_OK && i <= nrows; i++) {
+	sql = sqlite3_mprintf("DROP %s IF EXISTS temp.\"%w\"",
+			      rows[i * ncols], rows[i * ncols + 1]);
+	rc = sql ? sqlite3_exec(x, sql, NULL, NULL, NULL) : SQLITE_NOMEM;
+	sqlite3_free(sql);
     }
-    d = (DBC *) s->dbc;
-    if (d) {
-	d->busyint = 0;
+    if (rows) {
+	sqlite3_free_table(rows);
+	rows = NULL;
     }
-    if (!s->s3stmt_noreset) {
-	dbtraceapi(d, "sqlite3_reset", 0);
-	sqlite3_reset(s->s3stmt);
-	s->s3stmt_noreset = 1;
-	s->s3stmt_rownum = -1;
+    if (rc != SQLITE_OK) {
+	return 0;
+    }
+    rc = sqlite3_get_table(x, "PRAGMA database_list", &rows, &nrows, &ncols,
+			   NULL);
+    for (i = 1; rc == SQLITE_OK && i <= nrows; i++) {
+	char *name = rows[i * ncols + 1];
+
+	if (!name || strcmp(name, "main") == 0 || strcmp(name, "temp") == 0) {
+	    continue;
+	}
+	sql = sqlite3_mprintf("DETACH DATABASE \"%w\"", name);
+	rc = sql ? sqlite3_exec(x, sql, NULL, NULL, NULL) : SQLITE_NOMEM;
+	sqlite3_free(sql);
     }
-    if (d->cur_s3stmt == s) {
-	d->cur_s3stmt = NULL;
+    if (rows) {
+	sqlite3_free_table(rows);
     }
+    return rc == SQLITE_OK;
 }
 
 /**
- * Conditionally stop running sqlite statement
- * @param s statement pointer
+ * Undo the callback part of poolreset() when the SQLite handle
+ * of DBC is not pooled after all and stays with the DBC.
+ * @param d DBC pointer
  */
 
 static void
-s3stmt_end_if(STMT *s)
+poolunreset(DBC *d)
 {
-    DBC *d = (DBC *) s->dbc;
-
-    if (d) {
-	d->busyint = 0;
+    sqlite3_busy_handler(d->sqlite, busy_handler, (void *) d);
+    if (d->trace || d->trcbuf) {
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+	sqlite3_profile(d->sqlite, dbtrace, d);
+#else
+	sqlite3_trace(d->sqlite, dbtrace, d);
+#endif
     }
-    if (d && d->cur_s3stmt == s) {
-	s3stmt_end(s);
+    if (d->dbref) {
+	*d->dbref = d;
     }
 }
 
 /**
- * Drop running sqlite statement in STMT
- * @param s statement pointer
+ * Return SQLite handle of DBC to connection pool of ENV.
+ * @param d DBC pointer
+ * @result true when pooled, false when the handle must be closed
+ *
+ * The handle is not pooled when it is older than the max. age,
+ * when statements or blob handles are still open on it, or when
+ * the pool is full.
  */
 
-static void
-s3stmt_drop(STMT *s)
+static int
+poolput(DBC *d)
 {
-    if (s->s3stmt) {
-	DBC *d = (DBC *) s->dbc;
+    ENV *e = d->env;
+    POOLENT *p;
+    STMT *s;
+    sqlite_int64 now = getusec(), expires;
 
-	if (d) {
-	    dbtraceapi(d, "sqlite3_finalize", 0);
+    if (!d->poolkey || !e || e->magic != ENV_MAGIC) {
+	return 0;
+    }
+    expires = d->poolborn + (sqlite_int64) d->poolage * 1000000;
+    if (now >= expires) {
+	return 0;
+    }
+    if (now + (sqlite_int64) d->poolidle * 1000000 < expires) {
+	expires = now + (sqlite_int64) d->poolidle * 1000000;
+    }
+    for (s = d->stmt; s; s = s->next) {
+	if (s->s3stmt || s->lobh) {
+	    return 0;
 	}
-	sqlite3_finalize(s->s3stmt);
-	s->s3stmt = NULL;
-	s->s3stmt_rownum = 0;
     }
+    p = xmalloc(sizeof (POOLENT));
+    if (!p) {
+	return 0;
+    }
+    /* reserve a slot before the handle is reset */
+#if defined(_WIN32) || defined(_WIN64)
+    EnterCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_lock(&e->poolmutex);
+#endif
+    if (e->pooln < (SQLULEN) d->poolmax) {
+	e->pooln++;
+    } else {
+	xfree(p);
+	p = NULL;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    LeaveCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_unlock(&e->poolmutex);
+#endif
+    if (!p) {
+	return 0;
+    }
+    if (!poolreset(d)) {
+#if defined(_WIN32) || defined(_WIN64)
+	EnterCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	pthread_mutex_lock(&e->poolmutex);
+#endif
+	e->pooln--;
+#if defined(_WIN32) || defined(_WIN64)
+	LeaveCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	pthread_mutex_unlock(&e->poolmutex);
+#endif
+	xfree(p);
+	poolunreset(d);
+	return 0;
+    }
+    p->sqlite = d->sqlite;
+    p->key = d->poolkey;
+    p->dbref = d->dbref;
+    p->born = d->poolborn;
+    p->expires = expires;
+#if defined(_WIN32) || defined(_WIN64)
+    EnterCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_lock(&e->poolmutex);
+#endif
+    p->next = e->poolents;
+    e->poolents = p;
+#if defined(_WIN32) || defined(_WIN64)
+    LeaveCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_unlock(&e->poolmutex);
+#endif
+    d->poolkey = NULL;
+    d->sqlite = NULL;
+    d->dbref = NULL;
+    return 1;
 }
 
 /**
- * Start sqlite statement for execution of SELECT statement.
- * @param s statement pointer
+ * Open SQLite database file given file name and flags.
+ * @param d DBC pointer
+ * @param name file name
+ * @param isu true/false: file name is UTF8 encoded
+ * @param dsn data source name
+ * @param sflag STEPAPI flag
+ * @param spflag SyncPragma string
+ * @param ntflag NoTransaction string
+ * @param jmode JournalMode string
+ * @param busy busy/lock timeout
  * @result ODBC error code
+ *
+ * When the DBC has a pool key (see poolsetup()) an idle handle
+ * from the connection pool is reused if available.
  */
 
 static SQLRETURN
-s3stmt_start(STMT *s)
+dbopen(DBC *d, char *name, int isu, char *dsn, char *sflag,
+       char *spflag, char *ntflag, char *jmode, char *busy)
 {
-    DBC *d = (DBC *) s->dbc;
-    const char *endp;
-    sqlite3_stmt *s3stmt = NULL;
-    int rc, nretry = 0;
-
-    d->s3stmt_needmeta = 0;
-    if (!s->s3stmt) {
-#if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
-	dbtraceapi(d, "sqlite3_prepare_v2", (char *) s->query);
-#else
-	dbtraceapi(d, "sqlite3_prepare", (char *) s->query);
+    char *endp = NULL;
+    int rc, tmp, busyto = 100000;
+#if defined(HAVE_SQLITE3VFS) && (HAVE_SQLITE3VFS)
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    char *uname = name;
+    const char *vfs_name = NULL;
 #endif
-	do {
-	    s3stmt = NULL;
-#if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
-	    rc = sqlite3_prepare_v2(d->sqlite, (char *) s->query, -1,
-				    &s3stmt, &endp);
+
+    s3cache_flush(d);
+    sccache_flush(d);
+    if (d->sqlite) {
+	if (d->trace) {
+	    fprintf(d->trace, "-- sqlite3_close (deferred): '%s'\n",
+		    d->dbname);
+	    fflush(d->trace);
+	}
+	if (d->trcbuf) {
+	    trcevent(d, TRC_CLOSE, d->dbname);
+	}
+#if defined(HAVE_SQLITE3CLOSEV2) && (HAVE_SQLITE3CLOSEV2)
+	sqlite3_close_v2(d->sqlite);
 #else
-	    rc = sqlite3_prepare(d->sqlite, (char *) s->query, -1,
-				 &s3stmt, &endp);
+	sqlite3_close(d->sqlite);
 #endif
-	    if (rc != SQLITE_OK) {
-		if (s3stmt) {
-		    sqlite3_finalize(s3stmt);
-		    s3stmt = NULL;
-		}
-	    }
-	} while (rc == SQLITE_SCHEMA && (++nretry) < 2);
-	dbtracerc(d, rc, NULL);
-	if (rc != SQLITE_OK) {
-	    if (s3stmt) {
-		dbtraceapi(d, "sqlite3_finalize", NULL);
-		sqlite3_finalize(s3stmt);
-	    }
-	    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
-		    sqlite3_errmsg(d->sqlite), rc);
-	    return SQL_ERROR;
+	d->sqlite = NULL;
+	d->dbref = NULL;
+    }
+    d->pooled = 0;
+    if (d->poolkey && pooltake(d)) {
+	d->pooled = 1;
+	goto pooled;
+    }
+#if defined(HAVE_SQLITE3VFS) && (HAVE_SQLITE3VFS)
+    if (d->nocreat) {
+	flags &= ~ SQLITE_OPEN_CREATE;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    if (!isu) {
+	char expname[SQL_MAX_MESSAGE_LENGTH * 2];
+
+	expname[0] = '\0';
+	rc = ExpandEnvironmentStrings(name, expname, sizeof (expname));
+	if (rc <= sizeof (expname)) {
+	    uname = wmb_to_utf(expname, rc - 1);
+	} else {
+	    uname = wmb_to_utf(name, -1);
 	}
-	if (sqlite3_bind_parameter_count(s3stmt) != s->nparams) {
-	    dbtraceapi(d, "sqlite3_finalize", 0);
-	    sqlite3_finalize(s3stmt);
-	    setstat(s, SQLITE_ERROR, "parameter marker count incorrect",
-		    (*s->ov3) ? "HY000" : "S1000");
+	if (!uname) {
+	    rc = SQLITE_NOMEM;
+	    setstatd(d, rc, "out of memory", (*d->ov3) ? "HY000" : "S1000");
 	    return SQL_ERROR;
 	}
-	s->s3stmt = s3stmt;
-	s->s3stmt_noreset = 1;
-	d->s3stmt_needmeta = 1;
     }
-    d->cur_s3stmt = s;
-    s->s3stmt_rownum = -1;
-    s3bind(d, s->s3stmt, s->nparams, s->bindparms);
-    return SQL_SUCCESS;
-}
-
-#ifndef WINTERFACE
-/**
- * Function not implemented.
- */
-
-SQLRETURN SQL_API
-SQLDataSources(SQLHENV env, SQLUSMALLINT dir, SQLCHAR *srvname,
-	       SQLSMALLINT buflen1, SQLSMALLINT *lenp1,
-	       SQLCHAR *desc, SQLSMALLINT buflen2, SQLSMALLINT *lenp2)
-{
-    if (env == SQL_NULL_HENV) {
-	return SQL_INVALID_HANDLE;
+#endif
+#if defined(ENABLE_NVFS) && (ENABLE_NVFS)
+    vfs_name = nvfs_makevfs(uname);
+#endif
+#ifdef SQLITE_OPEN_URI
+    flags |= SQLITE_OPEN_URI;
+#endif
+#ifdef SQLITE_OPEN_SHAREDCACHE
+    if (d->sharedcache) {
+	flags |= SQLITE_OPEN_SHAREDCACHE;
     }
-    return SQL_ERROR;
-}
 #endif
-
-#ifdef WINTERFACE
-/**
- * Function not implemented.
- */
-
-SQLRETURN SQL_API
-SQLDataSourcesW(SQLHENV env, SQLUSMALLINT dir, SQLWCHAR *srvname,
-		SQLSMALLINT buflen1, SQLSMALLINT *lenp1,
-		SQLWCHAR *desc, SQLSMALLINT buflen2, SQLSMALLINT *lenp2)
-{
-    if (env == SQL_NULL_HENV) {
-	return SQL_INVALID_HANDLE;
+    rc = sqlite3_open_v2(uname, &d->sqlite, flags, vfs_name);
+#if defined(WINTERFACE) || defined(_WIN32) || defined(_WIN64)
+    if (uname != name) {
+	uc_free(uname);
     }
-    return SQL_ERROR;
-}
 #endif
+#else
+#if defined(_WIN32) || defined(_WIN64)
+    if (d->nocreat) {
+	char *cname = NULL;
 
-#ifndef WINTERFACE
-/**
- * Function not implemented.
- */
-
-SQLRETURN SQL_API
-SQLDrivers(SQLHENV env, SQLUSMALLINT dir, SQLCHAR *drvdesc,
-	   SQLSMALLINT descmax, SQLSMALLINT *desclenp,
-	   SQLCHAR *drvattr, SQLSMALLINT attrmax, SQLSMALLINT *attrlenp)
-{
-    if (env == SQL_NULL_HENV) {
-	return SQL_INVALID_HANDLE;
+	if (isu) {
+	    cname = utf_to_wmb(name, -1);
+	}
+	if (GetFileAttributesA(cname ? cname : name) ==
+	    INVALID_FILE_ATTRIBUTES) {
+	    uc_free(cname);
+	    rc = SQLITE_CANTOPEN;
+	    setstatd(d, rc, "cannot open database",
+		     (*d->ov3) ? "HY000" : "S1000");
+	    return SQL_ERROR;
+	}
+	uc_free(cname);
+    }
+#else
+    if (d->nocreat && access(name, 004) < 0) {
+	rc = SQLITE_CANTOPEN;
+	setstatd(d, rc, "cannot open database", (*d->ov3) ? "HY000" : "S1000");
+	return SQL_ERROR;
     }
-    return SQL_ERROR;
-}
 #endif
+#if defined(_WIN32) || defined(_WIN64)
+    if (!isu) {
+	WCHAR *wname = wmb_to_uc(name, -1);
 
-#ifdef WINTERFACE
-/**
- * Function not implemented.
- */
-
-SQLRETURN SQL_API
-SQLDriversW(SQLHENV env, SQLUSMALLINT dir, SQLWCHAR *drvdesc,
-	    SQLSMALLINT descmax, SQLSMALLINT *desclenp,
-	    SQLWCHAR *drvattr, SQLSMALLINT attrmax, SQLSMALLINT *attrlenp)
-{
-    if (env == SQL_NULL_HENV) {
-	return SQL_INVALID_HANDLE;
+	if (!wname) {
+	    rc = SQLITE_NOMEM;
+	    setstatd(d, rc, "out of memory", (*d->ov3) ? "HY000" : "S1000");
+	    return SQL_ERROR;
+	}
+	rc = sqlite3_open16(wname, &d->sqlite);
+	uc_free(wname);
+    } else
+#endif
+    rc = sqlite3_open(name, &d->sqlite);
+#endif /* !HAVE_SQLITE3VFS */
+    if (rc != SQLITE_OK) {
+connfail:
+	setstatd(d, rc, "connect failed", (*d->ov3) ? "HY000" : "S1000");
+	if (d->sqlite) {
+	    sqlite3_close(d->sqlite);
+	    d->sqlite = NULL;
+	}
+	return SQL_ERROR;
+    }
+    d->poolborn = getusec();
+#if defined(SQLITE_DYNLOAD) || defined(SQLITE_HAS_CODEC)
+    if (d->pwd) {
+	sqlite3_key(d->sqlite, d->pwd, d->pwdLen);
     }
-    return SQL_ERROR;
-}
 #endif
+pooled:
+    d->pwd = NULL;
+    d->pwdLen = 0;
+    if (d->trace || d->trcbuf) {
+#if defined(HAVE_SQLITE3PROFILE) && (HAVE_SQLITE3PROFILE)
+	sqlite3_profile(d->sqlite, dbtrace, d);
+#else
+	sqlite3_trace(d->sqlite, dbtrace, d);
+#endif
+    }
+    d->step_enable = getbool(sflag);
+    d->trans_disable = getbool(ntflag);
+    d->curtype = d->step_enable ?
+	SQL_CURSOR_FORWARD_ONLY : SQL_CURSOR_STATIC;
+    tmp = strtol(busy, &endp, 0);
+    if (endp && *endp == '\0' && endp != busy) {
+	busyto = tmp;
+    }
+    if (busyto < 1 || busyto > 1000000) {
+	busyto = 1000000;
+    }
+    d->timeout = busyto;
+    freep(&d->dbname);
+    d->dbname = xstrdup(name);
+    freep(&d->dsn);
+    d->dsn = xstrdup(dsn);
+    if ((rc = setsqliteopts(d->sqlite, d)) != SQLITE_OK) {
+	if (d->trace) {
+	    fprintf(d->trace, "-- sqlite3_close: '%s'\n",
+		    d->dbname);
+	    fflush(d->trace);
+	}
+	if (d->trcbuf) {
+	    trcevent(d, TRC_CLOSE, d->dbname);
+	}
+	sqlite3_close(d->sqlite);
+	d->sqlite = NULL;
+	d->dbref = NULL;
+	goto connfail;
+    }
+    if (!spflag || spflag[0] == '\0') {
+	spflag = "NORMAL";
+    }
+    /* SyncPragma and JournalMode are part of the pool key */
+    if (!d->pooled && spflag[0] != '\0') {
+	char syncp[128];
 
-#ifndef WINTERFACE
-/**
- * Function not implemented.
- */
+	sprintf(syncp, "PRAGMA synchronous = %8.8s;", spflag);
+	sqlite3_exec(d->sqlite, syncp, NULL, NULL, NULL);
+    }
+    if (!d->pooled && jmode[0] != '\0') {
+	char jourp[128];
 
-SQLRETURN SQL_API
-SQLBrowseConnect(SQLHDBC dbc, SQLCHAR *connin, SQLSMALLINT conninLen,
-		 SQLCHAR *connout, SQLSMALLINT connoutMax,
-		 SQLSMALLINT *connoutLen)
-{
-    SQLRETURN ret;
+	sprintf(jourp, "PRAGMA journal_mode = %16.16s;", jmode);
+	sqlite3_exec(d->sqlite, jourp, NULL, NULL, NULL);
+    }
+    d->busywal = strncasecmp(jmode, "wal", 3) == 0;
+    if (d->trace) {
+	fprintf(d->trace, d->pooled ? "-- sqlite3_open (pooled): '%s'\n" :
+		"-- sqlite3_open: '%s'\n", d->dbname);
+	fflush(d->trace);
+    }
+    if (d->trcbuf) {
+	trcevent(d, TRC_OPEN, d->dbname);
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    {
+	char pname[MAX_PATH];
+	HANDLE h = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
+			       FALSE, GetCurrentProcessId());
 
-    HDBC_LOCK(dbc);
-    ret = drvunimpldbc(dbc);
-    HDBC_UNLOCK(dbc);
-    return ret;
-}
-#endif
+	pname[0] = '\0';
+	if (h) {
+	    HMODULE m = NULL, l = LoadLibrary("psapi.dll");
+	    DWORD need;
+	    typedef BOOL (WINAPI *epmfunc)(HANDLE, HMODULE *, DWORD, LPDWORD);
+	    typedef BOOL (WINAPI *gmbfunc)(HANDLE, HMODULE, LPSTR, DWORD);
+	    epmfunc epm;
+	    gmbfunc gmb;
+
+	    if (l) {
+		epm = (epmfunc) GetProcAddress(l, "EnumProcessModules");
+		gmb = (gmbfunc) GetProcAddress(l, "GetModuleBaseNameA");
+		if (epm && gmb && epm(h, &m, sizeof (m), &need)) {
+		    gmb(h, m, pname, sizeof (pname));
+		}
+		FreeLibrary(l);
+	    }
+	    CloseHandle(h);
+	}
+	d->xcelqrx = strncasecmp(pname, "EXCEL", 5) == 0 ||
+		     strncasecmp(pname, "MSQRY", 5) == 0;
+	if (d->trace && d->xcelqrx) {
+
+	    fprintf(d->trace, "-- enabled EXCEL quirks\n");
+	    fflush(d->trace);
+	}
+    }
+#endif
+    sqlite3_create_function(d->sqlite, "blob_import", 1, SQLITE_UTF8,
+			    d, blob_import, 0, 0);
+    sqlite3_create_function(d->sqlite, "blob_export", 2, SQLITE_UTF8,
+			    d, blob_export, 0, 0);
+#if defined(HAVE_SQLITE3CREATEMODULEV2) && (HAVE_SQLITE3CREATEMODULEV2)
+    /*
+     * The module refers to the DBC through a cell owned by the
+     * SQLite handle, which pooltake() updates on reuse.
+     */
+    if (!d->pooled) {
+	d->dbref = sqlite3_malloc(sizeof (DBC *));
+	if (d->dbref) {
+	    *d->dbref = d;
+	    sqlite3_create_module_v2(d->sqlite, "odbc_stats", &stat_vtab_mod,
+				     d->dbref, sqlite3_free);
+	}
+    }
+#endif
+    return SQL_SUCCESS;
+}
 
-#ifdef WINTERFACE
 /**
- * Function not implemented.
+ * Load SQLite extension modules, if any
+ * @param d DBC pointer
+ * @param exts string, comma separated extension names
  */
 
-SQLRETURN SQL_API
-SQLBrowseConnectW(SQLHDBC dbc, SQLWCHAR *connin, SQLSMALLINT conninLen,
-		  SQLWCHAR *connout, SQLSMALLINT connoutMax,
-		  SQLSMALLINT *connoutLen)
+static void
+dbloadext(DBC *d, char *exts)
 {
-    SQLRETURN ret;
+#if defined(HAVE_SQLITE3LOADEXTENSION) && (HAVE_SQLITE3LOADEXTENSION)
+    char *p;
+    char path[SQL_MAX_MESSAGE_LENGTH];
+    int plen = 0;
 
-    HDBC_LOCK(dbc);
-    ret = drvunimpldbc(dbc);
-    HDBC_UNLOCK(dbc);
-    return ret;
+    if (!d->sqlite) {
+	return;
+    }
+    sqlite3_enable_load_extension(d->sqlite, 1);
+#if defined(_WIN32) || defined(_WIN64)
+    GetModuleFileName(hModule, path, sizeof (path));
+    p = strrchr(path, '\\');
+    plen = p ? ((p + 1) - path) : 0;
+#endif
+    do {
+	p = strchr(exts, ',');
+	if (p) {
+	    strncpy(path + plen, exts, p - exts);
+	    path[plen + (p - exts)] = '\0';
+	} else {
+	    strcpy(path + plen, exts);
+	}
+	if (exts[0]) {
+	    char *errmsg = NULL;
+	    int rc;
+#if defined(_WIN32) || defined(_WIN64)
+	    int i;
+	    char *q;
+
+	    q = path + plen;
+	    if (!(q[0] &&
+		  ((q[1] == ':' && (q[2] == '\\' || q[2] == '/')) ||
+		   q[0] == '\\' || q[0] == '/' || q[0] == '.'))) {
+		q = path;
+	    }
+	    /* sqlite3_load_extension() dislikes backslashes */
+	    for (i = 0; q[i] != '\0'; i++) {
+		if (q[i] == '\\') {
+		    q[i] = '/';
+		}
+	    }
+	    rc = sqlite3_load_extension(d->sqlite, q, 0, &errmsg);
+#else
+	    rc = sqlite3_load_extension(d->sqlite, path, 0, &errmsg);
+#endif
+	    if (rc != SQLITE_OK) {
+#if defined(_WIN32) || defined(_WIN64)
+		char buf[512], msg[512];
+
+		LoadString(hModule, IDS_EXTERR, buf, sizeof (buf));
+		wsprintf(msg, buf, q, errmsg ?
+			 errmsg : "no error info available");
+		LoadString(hModule, IDS_EXTTITLE, buf, sizeof (buf));
+		MessageBox(NULL, msg, buf,
+			   MB_ICONEXCLAMATION | MB_OK | MB_TASKMODAL |
+			   MB_SETFOREGROUND);
+#else
+		fprintf(stderr, "extension '%s' did not load%s%s\n",
+			path, errmsg ? ": " : "", errmsg ? errmsg : "");
+#endif
+	    }
+	}
+	if (p) {
+	    exts = p + 1;
+	}
+    } while (p);
+#endif /* HAVE_SQLITE3LOADEXTENSION */
 }
+
+/**
+ * Find out column type
+ * @param s3stmt SQLite statement pointer
+ * @param col column number
+ * @param d DBC pointer (for tracing only)
+ * @param guessed_types flag array
+ * @result type name as string
+ */
+
+static char *
+s3stmt_coltype(sqlite3_stmt *s3stmt, int col, DBC *d, int *guessed_types)
+{
+    char *typename = (char *) sqlite3_column_decltype(s3stmt, col);
+    char guess[64];
+
+    guess[0] = '\0';
+    if (!typename) {
+	int coltype = sqlite3_column_type(s3stmt, col);
+
+	if (guessed_types) {
+	    guessed_types[0]++;
+	}
+	if (d->trace) {
+	    sprintf(guess, " (guessed from %d)", coltype);
+	}
+	switch (coltype) {
+	case SQLITE_INTEGER: typename = "integer"; break;
+	case SQLITE_FLOAT:   typename = "double";  break;
+	default:
+	case SQLITE_TEXT:    typename = "varchar"; break;
+	case SQLITE_BLOB:    typename = "blob";    break;
+#if 0
+	case SQLITE_NULL:    typename = "null";    break;
 #endif
+	}
+    }
+    if (d->trace) {
+	fprintf(d->trace, "-- column %d type%s: '%s'\n", col + 1,
+		guess, typename);
+	fflush(d->trace);
+    }
+    return typename;
+}
 
 /**
- * Internal put (partial) parameter data into executing statement.
- * @param stmt statement handle
- * @param data pointer to data
- * @param len length of data
- * @result ODBC error code
+ * Store current row of stepped sqlite statement as cells.
+ * @param s statement pointer
+ * @param ncols number of columns
+ * @result SQLite error code
  */
 
-static SQLRETURN
-drvputdata(SQLHSTMT stmt, SQLPOINTER data, SQLLEN len)
+static int
+s3stmt_rowcells(STMT *s, int ncols)
 {
-    STMT *s;
-    int i, dlen, done = 0;
-    BINDPARM *p;
+    int rc;
 
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
+    s->s3stmt_rowlazy = 0;
+    if (s->cells && s->cellstride == 1 && s->ncols == ncols) {
+	/* reuse cells of previous row */
+	freep(&s->bincache);
+	s->bincell = NULL;
+	s->binlen = 0;
+	arena_reset(&s->arena);
+    } else {
+	freeresult(s, 0);
+	s->cells = xmalloc(ncols * sizeof (CELL));
+	if (!s->cells) {
+	    return SQLITE_NOMEM;
+	}
+	s->cellstride = 1;
     }
-    s = (STMT *) stmt;
-    if (!s->query || s->nparams <= 0) {
-seqerr:
-	setstat(s, -1, "sequence error", "HY010");
-	return SQL_ERROR;
+    rc = storecells(s, s->s3stmt, s->cells, 1, ncols);
+    if (rc == SQLITE_OK) {
+	s->nrows = 1;
     }
-    for (i = (s->pdcount < 0) ? 0 : s->pdcount; i < s->nparams; i++) {
-	p = &s->bindparms[i];
-	if (p->need > 0) {
-	    int type = mapdeftype(p->type, p->stype, -1, s->nowchar[0]);
+    return rc;
+}
 
-	    if (len == SQL_NULL_DATA) {
-		freep(&p->parbuf);
-		p->param = NULL;
-		p->len = SQL_NULL_DATA;
-		p->need = -1;
-	    } else if (type != SQL_C_CHAR
-#ifdef WCHARSUPPORT
-		       && type != SQL_C_WCHAR
-#endif
-		       && type != SQL_C_BINARY) {
-		int size = 0;
+/**
+ * Do one sqlite statement step gathering one result row
+ * @param s statement pointer
+ * @param lazy when true, leave the row in the sqlite statement,
+ * cells are filled on demand, see dofetchbind()
+ * @result ODBC error code
+ */
 
-		switch (type) {
-		case SQL_C_TINYINT:
-		case SQL_C_UTINYINT:
-		case SQL_C_STINYINT:
-#ifdef SQL_BIT
-		case SQL_C_BIT:
+static int
+s3stmt_step(STMT *s, int lazy)
+{
+    DBC *d = (DBC *) s->dbc;
+    const char *errp = NULL;
+    int i, ncols, rc;
+
+    if (!s->s3stmt_stream || !s->s3stmt) {
+	setstat(s, -1, "stale statement", (*s->ov3) ? "HY000" : "S1000");
+	return SQL_ERROR;
+    }
+    d->stats.steps++;
+    rc = sqlite3_step(s->s3stmt);
+    if (rc == SQLITE_ROW) {
+	d->stats.rows++;
+    }
+    if (rc == SQLITE_ROW || rc == SQLITE_DONE) {
+	++s->s3stmt_rownum;
+	ncols = sqlite3_column_count(s->s3stmt);
+	if (s->s3stmt_needmeta && s->s3stmt_rownum == 0 && ncols > 0) {
+	    PTRDIFF_T size;
+	    char *p;
+	    COL *dyncols;
+	    const char *colname, *typename;
+	    int guessed = 0;
+#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
+	    char *tblname;
 #endif
-		    size = sizeof (SQLCHAR);
-		    break;
-		case SQL_C_SHORT:
-		case SQL_C_USHORT:
-		case SQL_C_SSHORT:
-		    size = sizeof (SQLSMALLINT);
-		    break;
-		case SQL_C_LONG:
-		case SQL_C_ULONG:
-		case SQL_C_SLONG:
-		    size = sizeof (SQLINTEGER);
-		    break;
-#ifdef SQL_BIGINT
-		case SQL_C_UBIGINT:
-		case SQL_C_SBIGINT:
-		    size = sizeof (SQLBIGINT);
-		    break;
+#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
+	    char *dbname;
 #endif
-		case SQL_C_FLOAT:
-		    size = sizeof (float);
-		    break;
-		case SQL_C_DOUBLE:
-		    size = sizeof (double);
-		    break;
-#ifdef SQL_C_TYPE_DATE
-		case SQL_C_TYPE_DATE:
+
+	    for (i = size = 0; i < ncols; i++) {
+		colname = sqlite3_column_name(s->s3stmt, i);
+		size += 3 + 3 * strlen(colname);
+	    }
+#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
+	    tblname = (char *) size;
+	    for (i = 0; i < ncols; i++) {
+		p = (char *) sqlite3_column_table_name(s->s3stmt, i);
+		size += 2 + (p ? strlen(p) : 0);
+	    }
 #endif
-		case SQL_C_DATE:
-		    size = sizeof (DATE_STRUCT);
-		    break;
-#ifdef SQL_C_TYPE_DATE
-		case SQL_C_TYPE_TIME:
+#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
+	    dbname = (char *) size;
+	    for (i = 0; i < ncols; i++) {
+		p = (char *) sqlite3_column_database_name(s->s3stmt, i);
+		size += 2 + (p ? strlen(p) : 0);
+	    }
 #endif
-		case SQL_C_TIME:
-		    size = sizeof (TIME_STRUCT);
-		    break;
-#ifdef SQL_C_TYPE_DATE
-		case SQL_C_TYPE_TIMESTAMP:
+	    freedyncols(s);
+	    dyncols = arena_alloc(&s->dynarena, ncols * sizeof (COL) + size);
+	    if (!dyncols) {
+		s->ncols = 0;
+		dbtraceapi(d, "sqlite3_finalize", 0);
+		sqlite3_finalize(s->s3stmt);
+		s->s3stmt = NULL;
+		s3stmt_unstream(s);
+		return nomem(s);
+	    }
+	    p = (char *) (dyncols + ncols);
+#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
+	    tblname = p + (PTRDIFF_T) tblname;
 #endif
-		case SQL_C_TIMESTAMP:
-		    size = sizeof (TIMESTAMP_STRUCT);
-		    break;
-		}
-		freep(&p->parbuf);
-		p->parbuf = xmalloc(size);
-		if (!p->parbuf) {
-		    return nomem(s);
-		}
-		p->param = p->parbuf;
-		memcpy(p->param, data, size);
-		p->len = size;
-		p->need = -1;
-	    } else if (len == SQL_NTS && (
-		       type == SQL_C_CHAR
-#ifdef WCHARSUPPORT
-		       || type == SQL_C_WCHAR
+#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
+	    dbname = p + (PTRDIFF_T) dbname;
 #endif
-		      )) {
-		char *dp = data;
+	    for (i = 0; i < ncols; i++) {
+		char *q;
 
-#ifdef WCHARSUPPORT
-		if (type == SQL_C_WCHAR) {
-		    dp = uc_to_utf(data, len);
-		    if (!dp) {
-			return nomem(s);
-		    }
+		colname = sqlite3_column_name(s->s3stmt, i);
+		if (d->trace) {
+		    fprintf(d->trace, "-- column %d name: '%s'\n",
+			    i + 1, colname);
+		    fflush(d->trace);
+		}
+#if defined(HAVE_SQLITE3COLUMNTABLENAME) && (HAVE_SQLITE3COLUMNTABLENAME)
+		q = (char *) sqlite3_column_table_name(s->s3stmt, i);
+		strcpy(tblname, q ? q : "");
+		if (d->trace) {
+		    fprintf(d->trace, "-- table %d name: '%s'\n",
+			    i + 1, tblname);
+		    fflush(d->trace);
 		}
+		dyncols[i].table = tblname;
+		tblname += strlen(tblname) + 1;
 #endif
-#if defined(_WIN32) || defined(_WIN64)
-		if (*s->oemcp) {
-		    dp = wmb_to_utf(data, strlen (data));
-		    if (!dp) {
-			return nomem(s);
-		    }
+#if defined(HAVE_SQLITE3COLUMNDATABASENAME) && (HAVE_SQLITE3COLUMNDATABASENAME)
+		q = (char *) sqlite3_column_database_name(s->s3stmt, i);
+		strcpy(dbname, q ? q : "");
+		if (d->trace) {
+		    fprintf(d->trace, "-- database %d name: '%s'\n",
+			    i + 1, dbname);
+		    fflush(d->trace);
 		}
+		dyncols[i].db = dbname;
+		dbname += strlen(dbname) + 1;
+#else
+		dyncols[i].db = ((DBC *) (s->dbc))->dbname;
 #endif
-		dlen = strlen(dp);
-		freep(&p->parbuf);
-		p->parbuf = xmalloc(dlen + 1);
-		if (!p->parbuf) {
-		    if (dp != data) {
-			uc_free(dp);
+		typename = s3stmt_coltype(s->s3stmt, i, d, &guessed);
+		strcpy(p, colname);
+		dyncols[i].label = p;
+		p += strlen(p) + 1;
+		q = strchr(colname, '.');
+		if (q) {
+		    char *q2 = strchr(q + 1, '.');
+
+		    /* SQLite 3.3.4 produces view.table.column sometimes */
+		    if (q2) {
+			q = q2;
 		    }
-		    return nomem(s);
 		}
-		p->param = p->parbuf;
-		strcpy(p->param, dp);
-		if (dp != data) {
-		    uc_free(dp);
+		if (q) {
+#if !defined(HAVE_SQLITE3COLUMNTABLENAME) || !(HAVE_SQLITE3COLUMNTABLENAME)
+		    dyncols[i].table = p;
+#endif
+		    strncpy(p, colname, q - colname);
+		    p[q - colname] = '\0';
+		    p += strlen(p) + 1;
+		    strcpy(p, q + 1);
+		    dyncols[i].column = p;
+		    p += strlen(p) + 1;
+		} else {
+#if !defined(HAVE_SQLITE3COLUMNTABLENAME) || !(HAVE_SQLITE3COLUMNTABLENAME)
+		    dyncols[i].table = "";
+#endif
+		    strcpy(p, colname);
+		    dyncols[i].column = p;
+		    p += strlen(p) + 1;
 		}
-		p->len = dlen;
-		p->need = -1;
-	    } else if (len < 0) {
-		setstat(s, -1, "invalid length", "HY090");
-		return SQL_ERROR;
-	    } else {
-		dlen = min(p->len - p->offs, len);
-		if (!p->param) {
-		    setstat(s, -1, "no memory for parameter", "HY013");
-		    return SQL_ERROR;
+		if (s->longnames) {
+		    dyncols[i].column = dyncols[i].label;
 		}
-		memcpy((char *) p->param + p->offs, data, dlen);
-		p->offs += dlen;
-		if (p->offs >= p->len) {
-#ifdef WCHARSUPPORT
-		    if (type == SQL_C_WCHAR) {
-			char *dp = uc_to_utf(p->param, p->len);
-			char *np;
-			int nlen;
-
-			if (!dp) {
-			    return nomem(s);
-			}
-			nlen = strlen(dp);
-			np = xmalloc(nlen + 1);
-			if (!np) {
-			    uc_free(dp);
-			    return nomem(s);
-			}
-			strcpy(np, dp);
-			uc_free(dp);
-			if (p->param == p->parbuf) {
-			    freep(&p->parbuf);
-			}
-			p->parbuf = p->param = np;
-			p->len = nlen;
-		    } else {
-			*((char *) p->param + p->len) = '\0';
-		    }
-		    p->need = (type == SQL_C_CHAR || type == SQL_C_WCHAR)
-			    ? -1 : 0;
+#ifdef SQL_LONGVARCHAR
+		dyncols[i].type = SQL_LONGVARCHAR;
+		dyncols[i].size = 65535;
 #else
-		    *((char *) p->param + p->len) = '\0';
-		    p->need = (type == SQL_C_CHAR) ? -1 : 0;
-#endif
-#if defined(_WIN32) || defined(_WIN64)
-		    if (type == SQL_C_CHAR && *s->oemcp &&
-			!(p->stype == SQL_BINARY ||
-			  p->stype == SQL_VARBINARY ||
-			  p->stype == SQL_LONGVARBINARY)) {
-			char *dp = wmb_to_utf(p->param, p->len);
-
-			if (!dp) {
-			    return nomem(s);
-			}
-			if (p->param == p->parbuf) {
-			    freep(&p->parbuf);
-			}
-			p->parbuf = p->param = dp;
-			p->len = strlen(dp);
-		    }
-		    if (p->type == SQL_C_WCHAR &&
-			(p->stype == SQL_VARCHAR ||
-			 p->stype == SQL_LONGVARCHAR) &&
-			 p->len == p->coldef * sizeof (SQLWCHAR)) {
-			/* fix for MS-Access */
-			p->len = p->coldef;
-		    }
+		dyncols[i].type = SQL_VARCHAR;
+		dyncols[i].size = 255;
 #endif
+		dyncols[i].index = i;
+		dyncols[i].scale = 0;
+		dyncols[i].prec = 0;
+		dyncols[i].nosign = 1;
+		dyncols[i].autoinc = SQL_FALSE;
+		dyncols[i].notnull = SQL_NULLABLE;
+		dyncols[i].ispk = -1;
+		dyncols[i].isrowid = -1;
+		dyncols[i].origin = NULL;
+#if defined(HAVE_SQLITE3COLUMNORIGINNAME) && (HAVE_SQLITE3COLUMNORIGINNAME)
+		q = (char *) sqlite3_column_origin_name(s->s3stmt, i);
+		if (q) {
+		    dyncols[i].origin = arena_strdup(&s->dynarena, q);
 		}
+#endif
+		dyncols[i].typename = arena_strdup(&s->dynarena, typename);
 	    }
-	    done = 1;
-	    break;
+	    s->ncols = s->dcols = ncols;
+	    s->dyncols = s->cols = dyncols;
+	    fixupdyncols(s, d);
+#ifndef FULL_METADATA
+	    if (guessed) {
+		/* need declared types of table columns right now */
+		getdynmeta(s, -1);
+	    }
+#endif
+	    mkbindcols(s, s->ncols);
+	    s->s3stmt_needmeta = 0;
 	}
+	if (ncols <= 0) {
+	    goto killstmt;
+	}
+	if (rc == SQLITE_DONE) {
+	    freeresult(s, 0);
+	    s->nrows = 0;
+	    s3cache_put(d, (char *) s->query, s->s3stmt);
+	    s->s3stmt = NULL;
+	    s3stmt_unstream(s);
+	    return SQL_SUCCESS;
+	}
+	if (lazy && s->ncols == ncols) {
+	    s->s3stmt_rowlazy = 1;
+	    s->nrows = 1;
+	    return SQL_SUCCESS;
+	}
+	if (s3stmt_rowcells(s, ncols) == SQLITE_OK) {
+	    return SQL_SUCCESS;
+	}
+	freeresult(s, 0);
+	dbtraceapi(d, "sqlite3_reset", 0);
+	sqlite3_reset(s->s3stmt);
+	s->s3stmt_noreset = 1;
+	s3stmt_unstream(s);
+	return nomem(s);
     }
-    if (!done) {
-	goto seqerr;
-    }
-    return SQL_SUCCESS;
+killstmt:
+    dbtraceapi(d, "sqlite3_reset", 0);
+    rc = sqlite3_reset(s->s3stmt);
+    s->s3stmt_noreset = 1;
+    if (rc == SQLITE_SCHEMA) {
+	s3cache_flush(d);
+    }
+    errp = sqlite3_errmsg(d->sqlite);
+    s3stmt_unstream(s);
+    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+	    errp ? errp : "unknown error", rc);
+    return SQL_ERROR;
 }
 
 /**
- * Put (partial) parameter data into executing statement.
- * @param stmt statement handle
- * @param data pointer to data
- * @param len length of data
- * @result ODBC error code
+ * Compute hash value of SQL text for prepared statement cache.
+ * @param sql SQL text
+ * @result hash value
  */
 
-SQLRETURN SQL_API
-SQLPutData(SQLHSTMT stmt, SQLPOINTER data, SQLLEN len)
+static unsigned int
+s3cache_hash(const char *sql)
 {
-    SQLRETURN ret;
+    unsigned int hash = 5381;
 
-    HSTMT_LOCK(stmt);
-    ret = drvputdata(stmt, data, len);
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    while (*sql) {
+	hash = (hash * 33) ^ (unsigned char) *sql++;
+    }
+    return hash;
 }
 
 /**
- * Clear out parameter bindings, if any.
- * @param s statement pointer
+ * Take prepared statement out of cache of DBC.
+ * @param d database connection pointer
+ * @param sql SQL text (after fixupsql())
+ * @result prepared statement or NULL when not cached
+ *
+ * The entry is removed from the cache, thus a statement
+ * is never shared between two STMTs.
  */
 
-static SQLRETURN
-freeparams(STMT *s)
+static sqlite3_stmt *
+s3cache_get(DBC *d, const char *sql)
 {
-    if (s->bindparms) {
-	int n;
+    unsigned int hash;
+    int i;
 
-	for (n = 0; n < s->nbindparms; n++) {
-	    freep(&s->bindparms[n].parbuf);
-	    memset(&s->bindparms[n], 0, sizeof (BINDPARM));
+    if (d->s3cache_max <= 0 || !sql) {
+	return NULL;
+    }
+    hash = s3cache_hash(sql);
+    for (i = 0; i < d->s3cache_n; i++) {
+	S3CENT *e = &d->s3cache[i];
+
+	if (e->hash == hash && strcmp(e->sql, sql) == 0) {
+	    sqlite3_stmt *stmt = e->stmt;
+
+	    xfree(e->sql);
+	    d->s3cache_n--;
+	    if (i < d->s3cache_n) {
+		*e = d->s3cache[d->s3cache_n];
+	    }
+	    d->s3cache_hits++;
+	    if (d->trace) {
+		fprintf(d->trace, "-- statement cache hit: '%s'\n", sql);
+		fflush(d->trace);
+	    }
+	    return stmt;
 	}
     }
-    return SQL_SUCCESS;
+    d->s3cache_misses++;
+    return NULL;
 }
 
 /**
- * Setup SQLite3 parameter for statement parameter.
- * @param s statement pointer
- * @param sql sql string
- * @param pnum parameter number
- * @result ODBC error code
+ * Return prepared statement to cache of DBC.
+ * @param d database connection pointer
+ * @param sql SQL text (after fixupsql()) or NULL
+ * @param stmt prepared statement
  *
- * The parameter is converted within BINDPARM in order to
- * be presented to sqlite3_bind_*() functions.
+ * The statement is reset and kept for reuse when caching is
+ * enabled, otherwise or when no SQL text is given it is finalized.
+ * When the cache is full, its least recently used entry is finalized.
  */
 
-static SQLRETURN
-setupparam(STMT *s, char *sql, int pnum)
+static void
+s3cache_put(DBC *d, const char *sql, sqlite3_stmt *stmt)
 {
-    int type, len = 0, needalloc = 0;
-    BINDPARM *p;
+    S3CENT *e;
+    char *key;
+    int i;
 
-    if (!s->bindparms || pnum < 0 || pnum >= s->nbindparms) {
-	goto error;
-    }
-    p = &s->bindparms[pnum];
-    type = mapdeftype(p->type, p->stype, -1, s->nowchar[0]);
-#if (defined(_WIN32) || defined(_WIN64)) && defined(WINTERFACE)
-    /* MS Access hack part 4 (map SQL_C_DEFAULT to SQL_C_CHAR) */
-    if (type == SQL_C_WCHAR && p->type == SQL_C_DEFAULT) {
-	type = SQL_C_CHAR;
+    if (!stmt) {
+	return;
     }
-#endif
-    if (p->need > 0) {
-	return setupparbuf(s, p);
+    if (d->s3cache_max <= 0 || !sql || !d->sqlite) {
+	goto drop;
     }
-    p->strbuf[0] = '\0';
-    if (!p->param || (p->lenp && *p->lenp == SQL_NULL_DATA)) {
-	p->s3type = SQLITE_NULL;
-	p->s3size = 0;
-	return SQL_SUCCESS;
+    if (!d->s3cache) {
+	d->s3cache = xmalloc(d->s3cache_max * sizeof (S3CENT));
+	if (!d->s3cache) {
+	    goto drop;
+	}
+	d->s3cache_n = 0;
     }
-    if (type == SQL_C_CHAR &&
-	(p->stype == SQL_BINARY ||
-	 p->stype == SQL_VARBINARY ||
-	 p->stype == SQL_LONGVARBINARY)) {
-	type = SQL_C_BINARY;
+    key = xstrdup(sql);
+    if (!key) {
+	goto drop;
     }
-    switch (type) {
-    case SQL_C_BINARY:
-	p->s3type = SQLITE_BLOB;
-	p->s3size = p->len;
-	p->s3val = p->param;
-	if (p->need < 0) {
-	    break;
-	}
-	if (!p->lenp) {
-	    len = p->len;
-	} else if (*p->lenp == SQL_DATA_AT_EXEC) {
-	    len = p->len;
-	} else {
-	    len = *p->lenp;
-	    if (len <= SQL_LEN_DATA_AT_EXEC_OFFSET) {
-		len = SQL_LEN_DATA_AT_EXEC(len);
+    dbtraceapi(d, "sqlite3_reset", 0);
+    sqlite3_reset(stmt);
+    if (d->s3cache_n < d->s3cache_max) {
+	e = &d->s3cache[d->s3cache_n++];
+    } else {
+	e = &d->s3cache[0];
+	for (i = 1; i < d->s3cache_n; i++) {
+	    if (d->s3cache[i].used < e->used) {
+		e = &d->s3cache[i];
 	    }
 	}
-	if (len < 0) {
-	    setstat(s, -1, "invalid length", "HY009");
-	    return SQL_ERROR;
+	dbtraceapi(d, "sqlite3_finalize", 0);
+	sqlite3_finalize(e->stmt);
+	xfree(e->sql);
+    }
+    e->sql = key;
+    e->hash = s3cache_hash(key);
+    e->used = ++d->s3cache_clock;
+    e->stmt = stmt;
+    return;
+drop:
+    dbtraceapi(d, "sqlite3_finalize", 0);
+    sqlite3_finalize(stmt);
+}
+
+/**
+ * Finalize all statements of prepared statement cache of DBC.
+ * @param d database connection pointer
+ */
+
+static void
+s3cache_flush(DBC *d)
+{
+    int i;
+
+    for (i = 0; i < d->s3cache_n; i++) {
+	dbtraceapi(d, "sqlite3_finalize", 0);
+	sqlite3_finalize(d->s3cache[i].stmt);
+	xfree(d->s3cache[i].sql);
+    }
+    d->s3cache_n = 0;
+    freep(&d->s3cache);
+}
+
+/* Max. number of entries of schema cache */
+
+#define SCCACHE_MAX 64
+
+/**
+ * Flush schema cache of DBC.
+ * @param d database connection pointer
+ *
+ * Entries still in use by a caller of sccache_get_table()
+ * lose their key and are released by sccache_free_table().
+ */
+
+static void
+sccache_flush(DBC *d)
+{
+    int i = 0;
+
+    while (i < d->sccache_n) {
+	SCCENT *e = &d->sccache[i];
+
+	freep(&e->sql);
+	if (e->refs > 0) {
+	    i++;
+	    continue;
 	}
-	p->len = len;
-	p->max = p->len;
-	p->need = -1;
-	p->s3size = len;
-	break;
-#ifdef WCHARSUPPORT
-    case SQL_C_WCHAR:
-#endif
-    case SQL_C_CHAR:
-	p->s3type = SQLITE_TEXT;
-	p->s3size = -1;
-	p->s3val = p->param;
-	if (!p->parbuf) {
-#ifdef WCHARSUPPORT
-	    if (type == SQL_C_WCHAR) {
-		if (!p->lenp || *p->lenp == SQL_NTS) {
-		    p->max = uc_strlen(p->param) * sizeof (SQLWCHAR);
-		} else if (*p->lenp >= 0) {
-		    p->max = *p->lenp;
-		}
-	    } else
-#endif
-	    if (type == SQL_C_CHAR) {
-		if (!p->lenp || *p->lenp == SQL_NTS) {
-		    p->len = p->max = strlen(p->param);
-#if defined(_WIN32) || defined(_WIN64)
-		    needalloc = 1;
+	sqlite3_free_table(e->rows);
+	d->sccache_n--;
+	if (i < d->sccache_n) {
+	    *e = d->sccache[d->sccache_n];
+	}
+    }
+    if (d->sccache_n == 0) {
+	freep(&d->sccache);
+    }
+    if (d->sccache_vstmt) {
+	dbtraceapi(d, "sqlite3_finalize", 0);
+	sqlite3_finalize(d->sccache_vstmt);
+	d->sccache_vstmt = NULL;
+    }
+}
+
+/**
+ * Validate schema cache of DBC against the schema version
+ * of the database, to be called once per catalog function
+ * or result set before sccache_get_table() is used.
+ * @param d database connection pointer
+ *
+ * Schema changes made through this connection (including
+ * "temp" tables and ATTACH/DETACH) flush the cache in
+ * drvexecute(), see checkddl().
+ */
+
+static void
+sccache_check(DBC *d)
+{
+    int rc, ver;
+
+    if (!d->sqlite) {
+	return;
+    }
+    if (!d->sccache_vstmt) {
+	dbtraceapi(d, "sqlite3_prepare", "PRAGMA schema_version");
+	d->stats.prepares++;
+#if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
+	rc = sqlite3_prepare_v2(d->sqlite, "PRAGMA schema_version", -1,
+				&d->sccache_vstmt, NULL);
+#else
+	rc = sqlite3_prepare(d->sqlite, "PRAGMA schema_version", -1,
+			     &d->sccache_vstmt, NULL);
 #endif
-		} else if (*p->lenp >= 0) {
-		    p->len = p->max = *p->lenp;
-		    needalloc = 1;
-		}
-	    }
+	if (rc != SQLITE_OK) {
+	    d->sccache_vstmt = NULL;
+	    sccache_flush(d);
+	    return;
 	}
-	if (p->need < 0 && p->parbuf == p->param) {
-	    break;
+    }
+    d->stats.steps++;
+    rc = sqlite3_step(d->sccache_vstmt);
+    ver = (rc == SQLITE_ROW) ?
+	(int) sqlite3_column_int64(d->sccache_vstmt, 0) : 0;
+    sqlite3_reset(d->sccache_vstmt);
+    if (rc != SQLITE_ROW) {
+	sccache_flush(d);
+	return;
+    }
+    if (ver != d->sccache_schema) {
+	if (d->sccache_n > 0) {
+	    if (d->trace) {
+		fprintf(d->trace, "-- schema cache flushed: version %d\n",
+			ver);
+		fflush(d->trace);
+	    }
+	    sccache_flush(d);
 	}
-#ifdef WCHARSUPPORT
-	if (type == SQL_C_WCHAR) {
-	    char *dp = uc_to_utf(p->param, p->max);
+	d->sccache_schema = ver;
+    }
+}
 
-	    if (!dp) {
-		return nomem(s);
+/**
+ * Run schema query like "PRAGMA table_info" using the schema
+ * cache of DBC, replacement for sqlite3_get_table().
+ * @param d database connection pointer
+ * @param sql SQL text, key of cache
+ * @param rowpp output result table
+ * @param nrowp output number of rows
+ * @param ncolp output number of columns
+ * @param errp output error message or NULL
+ * @result SQLite error code
+ *
+ * The result table is shared and must not be modified,
+ * it is released by sccache_free_table().
+ */
+
+static int
+sccache_get_table(DBC *d, const char *sql, char ***rowpp,
+		  int *nrowp, int *ncolp, char **errp)
+{
+    SCCENT *e;
+    unsigned int hash = s3cache_hash(sql);
+    char *key;
+    int i, rc;
+
+    for (i = 0; i < d->sccache_n; i++) {
+	e = &d->sccache[i];
+	if (e->sql && e->hash == hash && strcmp(e->sql, sql) == 0) {
+	    e->refs++;
+	    e->used = ++d->sccache_clock;
+	    *rowpp = e->rows;
+	    *nrowp = e->nrows;
+	    *ncolp = e->ncols;
+	    if (d->trace) {
+		fprintf(d->trace, "-- schema cache hit: '%s'\n", sql);
+		fflush(d->trace);
 	    }
-	    if (p->param == p->parbuf) {
-		freep(&p->parbuf);
+	    return SQLITE_OK;
+	}
+    }
+    dbtraceapi(d, "sqlite3_get_table", sql);
+    *rowpp = NULL;
+    rc = sqlite3_get_table(d->sqlite, sql, rowpp, nrowp, ncolp, errp);
+    if (rc != SQLITE_OK || !*rowpp) {
+	return rc;
+    }
+    if (!d->sccache) {
+	d->sccache = xmalloc(SCCACHE_MAX * sizeof (SCCENT));
+	if (!d->sccache) {
+	    return rc;
+	}
+	d->sccache_n = 0;
+    }
+    e = NULL;
+    if (d->sccache_n >= SCCACHE_MAX) {
+	for (i = 0; i < d->sccache_n; i++) {
+	    if (d->sccache[i].refs == 0 &&
+		(!e || d->sccache[i].used < e->used)) {
+		e = &d->sccache[i];
 	    }
-	    p->parbuf = p->param = dp;
-	    p->need = -1;
-	    p->len = strlen(p->param);
-	    p->s3val = p->param;
-	    p->s3size = p->len;
-	} else
-#endif
-	if (type == SQL_C_CHAR) {
-	    p->s3val = p->param;
-	    if (needalloc) {
-		char *dp;
+	}
+	if (!e) {
+	    /* all entries in use, result is not cached */
+	    return rc;
+	}
+    }
+    key = xstrdup(sql);
+    if (!key) {
+	return rc;
+    }
+    if (e) {
+	sqlite3_free_table(e->rows);
+	xfree(e->sql);
+    } else {
+	e = &d->sccache[d->sccache_n++];
+    }
+    e->sql = key;
+    e->hash = hash;
+    e->used = ++d->sccache_clock;
+    e->refs = 1;
+    e->rows = *rowpp;
+    e->nrows = *nrowp;
+    e->ncols = *ncolp;
+    return rc;
+}
 
-#if defined(_WIN32) || defined(_WIN64)
-		if (*s->oemcp) {
-		    dp = wmb_to_utf(p->param, p->len);
-		} else {
-		    dp = xmalloc(p->len + 1);
+/**
+ * Release result table of sccache_get_table().
+ * @param d database connection pointer
+ * @param rowp result table or NULL
+ */
+
+static void
+sccache_free_table(DBC *d, char **rowp)
+{
+    int i;
+
+    if (!rowp) {
+	return;
+    }
+    for (i = 0; i < d->sccache_n; i++) {
+	SCCENT *e = &d->sccache[i];
+
+	if (e->rows == rowp) {
+	    if (--e->refs <= 0 && !e->sql) {
+		sqlite3_free_table(e->rows);
+		d->sccache_n--;
+		if (i < d->sccache_n) {
+		    *e = d->sccache[d->sccache_n];
 		}
-#else
-		dp = xmalloc(p->len + 1);
-#endif
-		if (!dp) {
-		    return nomem(s);
-		}
-#if defined(_WIN32) || defined(_WIN64)
-		if (*s->oemcp) {
-		    p->len = strlen(dp);
-		} else {
-		    memcpy(dp, p->param, p->len);
-		    dp[p->len] = '\0';
-		}
-#else
-		memcpy(dp, p->param, p->len);
-		dp[p->len] = '\0';
-#endif
-		if (p->param == p->parbuf) {
-		    freep(&p->parbuf);
+		if (d->sccache_n == 0) {
+		    freep(&d->sccache);
 		}
-		p->parbuf = p->param = dp;
-		p->need = -1;
-		p->s3val = p->param;
-		p->s3size = p->len;
-	    }
-	}
-	break;
-    case SQL_C_UTINYINT:
-    case SQL_C_TINYINT:
-    case SQL_C_STINYINT:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (int);
-	p->s3ival = *((SQLCHAR *) p->param);
-	break;
-    case SQL_C_USHORT:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (int);
-	p->s3ival = *((SQLUSMALLINT *) p->param);
-	break;
-    case SQL_C_SHORT:
-    case SQL_C_SSHORT:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (int);
-	p->s3ival = *((SQLSMALLINT *) p->param);
-	break;
-    case SQL_C_ULONG:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (int);
-	p->s3ival = *((SQLUINTEGER *) p->param);
-	break;
-    case SQL_C_LONG:
-    case SQL_C_SLONG:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (int);
-	p->s3ival = *((SQLINTEGER *) p->param);
-	break;
-#ifdef SQL_BIT
-    case SQL_C_BIT:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (int);
-	p->s3ival = (*((SQLCHAR *) p->param)) ? 1 : 0;
-	break;
-#endif
-#ifdef SQL_BIGINT
-    case SQL_C_SBIGINT:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (sqlite_int64);
-	p->s3lival = *((sqlite_int64 *) p->param);
-	break;
-    case SQL_C_UBIGINT:
-	p->s3type = SQLITE_INTEGER;
-	p->s3size = sizeof (sqlite_int64);
-	p->s3lival = *((sqlite_uint64 *) p->param);
-	break;
-#endif
-    case SQL_C_FLOAT:
-	p->s3type = SQLITE_FLOAT;
-	p->s3size = sizeof (double);
-	p->s3dval = *((float *) p->param);
-	break;
-    case SQL_C_DOUBLE:
-	p->s3type = SQLITE_FLOAT;
-	p->s3size = sizeof (double);
-	p->s3dval = *((double *) p->param);
-	break;
-#ifdef SQL_C_TYPE_DATE
-    case SQL_C_TYPE_DATE:
-#endif
-    case SQL_C_DATE:
-	if (*s->jdconv) {
-	    int a, b, x1, x2, y, m, d;
-
-	    p->s3type = SQLITE_FLOAT;
-	    p->s3size = sizeof (double);
-	    y = ((DATE_STRUCT *) p->param)->year;
-	    m = ((DATE_STRUCT *) p->param)->month;
-	    d = ((DATE_STRUCT *) p->param)->day;
-	    if (m <= 2) {
-		y--;
-		m += 12;
-	    }
-	    a = y / 100;
-	    b = 2 - a + (a / 4);
-	    x1 = 36525 * (y + 4716) / 100;
-	    x2 = 306001 * (m + 1) / 10000;
-	    p->s3dval = x1 + x2 + d + b - 1524.5;
-	    break;
-	}
-	sprintf(p->strbuf, "%04d-%02d-%02d",
-		((DATE_STRUCT *) p->param)->year,
-		((DATE_STRUCT *) p->param)->month,
-		((DATE_STRUCT *) p->param)->day);
-	p->s3type = SQLITE_TEXT;
-	p->s3size = -1;
-	p->s3val = p->strbuf;
-	break;
-#ifdef SQL_C_TYPE_TIME
-    case SQL_C_TYPE_TIME:
-#endif
-    case SQL_C_TIME:
-	if (*s->jdconv) {
-	    p->s3type = SQLITE_FLOAT;
-	    p->s3size = sizeof (double);
-	    p->s3dval = 2451544.5 +
-	       (((TIME_STRUCT *) p->param)->hour * 3600000.0 +
-		((TIME_STRUCT *) p->param)->minute * 60000.0 +
-		((TIME_STRUCT *) p->param)->second * 1000.0) / 86400000.0;
-	    break;
-	}
-	sprintf(p->strbuf, "%02d:%02d:%02d",
-		((TIME_STRUCT *) p->param)->hour,
-		((TIME_STRUCT *) p->param)->minute,
-		((TIME_STRUCT *) p->param)->second);
-	p->s3type = SQLITE_TEXT;
-	p->s3size = -1;
-	p->s3val = p->strbuf;
-	break;
-#ifdef SQL_C_TYPE_TIMESTAMP
-    case SQL_C_TYPE_TIMESTAMP:
-#endif
-    case SQL_C_TIMESTAMP:
-	if (*s->jdconv) {
-	    int a, b, x1, x2, y, m, d;
-
-	    p->s3type = SQLITE_FLOAT;
-	    p->s3size = sizeof (double);
-	    y = ((TIMESTAMP_STRUCT *) p->param)->year;
-	    m = ((TIMESTAMP_STRUCT *) p->param)->month;
-	    d = ((TIMESTAMP_STRUCT *) p->param)->day;
-	    if (m <= 2) {
-		y--;
-		m += 12;
 	    }
-	    a = y / 100;
-	    b = 2 - a + (a / 4);
-	    x1 = 36525 * (y + 4716) / 100;
-	    x2 = 306001 * (m + 1) / 10000;
-	    p->s3dval = x1 + x2 + d + b - 1524.5 +
-	       (((TIMESTAMP_STRUCT *) p->param)->hour * 3600000.0 +
-		((TIMESTAMP_STRUCT *) p->param)->minute * 60000.0 +
-		((TIMESTAMP_STRUCT *) p->param)->second * 1000.0 +
-		((TIMESTAMP_STRUCT *) p->param)->fraction / 1.0E6)
-	       / 86400000.0;
-	    break;
-	}
-	len = (int) ((TIMESTAMP_STRUCT *) p->param)->fraction;
-	len /= 1000000;
-	len = len % 1000;
-	if (len < 0) {
-	    len = 0;
-	}
-	if (p->coldef && p->coldef <= 16) {
-	    sprintf(p->strbuf, "%04d-%02d-%02d %02d:%02d:00.000",
-		    ((TIMESTAMP_STRUCT *) p->param)->year,
-		    ((TIMESTAMP_STRUCT *) p->param)->month,
-		    ((TIMESTAMP_STRUCT *) p->param)->day,
-		    ((TIMESTAMP_STRUCT *) p->param)->hour,
-		    ((TIMESTAMP_STRUCT *) p->param)->minute);
-	} else if (p->coldef && p->coldef <= 19) {
-	    sprintf(p->strbuf, "%04d-%02d-%02d %02d:%02d:%02d.000",
-		    ((TIMESTAMP_STRUCT *) p->param)->year,
-		    ((TIMESTAMP_STRUCT *) p->param)->month,
-		    ((TIMESTAMP_STRUCT *) p->param)->day,
-		    ((TIMESTAMP_STRUCT *) p->param)->hour,
-		    ((TIMESTAMP_STRUCT *) p->param)->minute,
-		    ((TIMESTAMP_STRUCT *) p->param)->second);
-	} else {
-	    sprintf(p->strbuf, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
-		    ((TIMESTAMP_STRUCT *) p->param)->year,
-		    ((TIMESTAMP_STRUCT *) p->param)->month,
-		    ((TIMESTAMP_STRUCT *) p->param)->day,
-		    ((TIMESTAMP_STRUCT *) p->param)->hour,
-		    ((TIMESTAMP_STRUCT *) p->param)->minute,
-		    ((TIMESTAMP_STRUCT *) p->param)->second,
-		    len);
+	    return;
 	}
-	p->s3type = SQLITE_TEXT;
-	p->s3size = -1;
-	p->s3val = p->strbuf;
-	break;
-    default:
-    error:
-	setstat(s, -1, "unsupported parameter type",
-		(*s->ov3) ? "07009" : "S1093");
-	return SQL_ERROR;
     }
-    return SQL_SUCCESS;
+    sqlite3_free_table(rowp);
 }
 
 /**
- * Internal bind parameter on HSTMT.
- * @param stmt statement handle
- * @param pnum parameter number, starting at 1
- * @param iotype input/output type of parameter
- * @param buftype type of host variable
- * @param ptype
- * @param coldef
- * @param scale
- * @param data pointer to host variable
- * @param buflen length of host variable
- * @param len output length pointer
- * @result ODBC error code
+ * Stop running sqlite statement
+ * @param s statement pointer
  */
 
-static SQLRETURN
-drvbindparam(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT iotype,
-	     SQLSMALLINT buftype, SQLSMALLINT ptype, SQLUINTEGER coldef,
-	     SQLSMALLINT scale,
-	     SQLPOINTER data, SQLINTEGER buflen, SQLLEN *len)
+static void
+s3stmt_end(STMT *s)
 {
-    STMT *s;
-    BINDPARM *p;
+    DBC *d;
 
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
+    if (!s || !s->s3stmt) {
+	return;
     }
-    s = (STMT *) stmt;
-    if (pnum == 0) {
-	setstat(s, -1, "invalid parameter", (*s->ov3) ? "07009" : "S1093");
-	return SQL_ERROR;
+    d = (DBC *) s->dbc;
+    if (d) {
+	d->busyint = 0;
     }
-    if (!data && !len) {
-	setstat(s, -1, "invalid buffer", "HY003");
-	return SQL_ERROR;
+    if (!s->s3stmt_noreset) {
+	dbtraceapi(d, "sqlite3_reset", 0);
+	sqlite3_reset(s->s3stmt);
+	s->s3stmt_noreset = 1;
+	s->s3stmt_rownum = -1;
     }
-    --pnum;
-    if (s->bindparms) {
-	if (pnum >= s->nbindparms) {
-	    BINDPARM *newparms;
+    s3stmt_unstream(s);
+}
 
-	    newparms = xrealloc(s->bindparms,
-				(pnum + 1) * sizeof (BINDPARM));
-	    if (!newparms) {
-outofmem:
-		return nomem(s);
-	    }
-	    s->bindparms = newparms;
-	    memset(&s->bindparms[s->nbindparms], 0,
-		   (pnum + 1 - s->nbindparms) * sizeof (BINDPARM));
-	    s->nbindparms = pnum + 1;
-	}
-    } else {
-	int npar = max(10, pnum + 1);
+/**
+ * Conditionally stop running sqlite statement
+ * @param s statement pointer
+ */
 
-	s->bindparms = xmalloc(npar * sizeof (BINDPARM));
-	if (!s->bindparms) {
-	    goto outofmem;
-	}
-	memset(s->bindparms, 0, npar * sizeof (BINDPARM));
-	s->nbindparms = npar;
+static void
+s3stmt_end_if(STMT *s)
+{
+    DBC *d = (DBC *) s->dbc;
+
+    if (d) {
+	d->busyint = 0;
     }
-    switch (buftype) {
-    case SQL_C_STINYINT:
-    case SQL_C_UTINYINT:
-    case SQL_C_TINYINT:
-#ifdef SQL_C_BIT
-    case SQL_C_BIT:
-#endif
-	buflen = sizeof (SQLCHAR);
-	break;
-    case SQL_C_SHORT:
-    case SQL_C_USHORT:
-    case SQL_C_SSHORT:
-	buflen = sizeof (SQLSMALLINT);
-	break;
-    case SQL_C_SLONG:
-    case SQL_C_ULONG:
-    case SQL_C_LONG:
-	buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_C_FLOAT:
-	buflen = sizeof (float);
-	break;
-    case SQL_C_DOUBLE:
-	buflen = sizeof (double);
-	break;
-    case SQL_C_TIMESTAMP:
-#ifdef SQL_C_TYPE_TIMESTAMP
-    case SQL_C_TYPE_TIMESTAMP:
-#endif
-	buflen = sizeof (TIMESTAMP_STRUCT);
-	break;
-    case SQL_C_TIME:
-#ifdef SQL_C_TYPE_TIME
-    case SQL_C_TYPE_TIME:
-#endif
-	buflen = sizeof (TIME_STRUCT);
-	break;
-    case SQL_C_DATE:
-#ifdef SQL_C_TYPE_DATE
-    case SQL_C_TYPE_DATE:
-#endif
-	buflen = sizeof (DATE_STRUCT);
-	break;
-#ifdef SQL_C_UBIGINT
-    case SQL_C_UBIGINT:
-	buflen = sizeof (SQLBIGINT);
-	break;
-#endif
-#ifdef SQL_C_SBIGINT
-    case SQL_C_SBIGINT:
-	buflen = sizeof (SQLBIGINT);
-	break;
-#endif
-#ifdef SQL_C_BIGINT
-    case SQL_C_BIGINT:
-	buflen = sizeof (SQLBIGINT);
-	break;
-#endif
+    if (s->s3stmt_stream) {
+	s3stmt_end(s);
     }
-    p = &s->bindparms[pnum];
-    p->type = buftype;
-    p->stype = ptype;
-    p->coldef = coldef;
-    p->scale = scale;
-    p->max = buflen;
-    p->inc = buflen;
-    p->lenp = p->lenp0 = len;
-    p->offs = 0;
-    p->len = 0;
-    p->param0 = data;
-    freep(&p->parbuf);
-    p->param = p->param0;
-    p->bound = 1;
-    p->need = 0;
-    return SQL_SUCCESS;
 }
 
 /**
- * Bind parameter on HSTMT.
- * @param stmt statement handle
- * @param pnum parameter number, starting at 1
- * @param iotype input/output type of parameter
- * @param buftype type of host variable
- * @param ptype
- * @param coldef
- * @param scale
- * @param data pointer to host variable
- * @param buflen length of host variable
- * @param len output length pointer
- * @result ODBC error code
+ * Drop running sqlite statement in STMT
+ * @param s statement pointer
  */
 
-SQLRETURN SQL_API
-SQLBindParameter(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT iotype,
-		 SQLSMALLINT buftype, SQLSMALLINT ptype, SQLULEN coldef,
-		 SQLSMALLINT scale,
-		 SQLPOINTER data, SQLLEN buflen, SQLLEN *len)
+static void
+s3stmt_drop(STMT *s)
 {
-    SQLRETURN ret;
+    if (s->s3stmt) {
+	DBC *d = (DBC *) s->dbc;
 
-    HSTMT_LOCK(stmt);
-    ret = drvbindparam(stmt, pnum, iotype, buftype, ptype, coldef,
-		       scale, data, buflen, len);
-    HSTMT_UNLOCK(stmt);
-    return ret;
+	if (d) {
+	    s3stmt_unstream(s);
+	    s3cache_put(d, (char *) s->query, s->s3stmt);
+	} else {
+	    sqlite3_finalize(s->s3stmt);
+	}
+	s->s3stmt = NULL;
+	s->s3stmt_rownum = 0;
+    }
 }
 
-#ifndef HAVE_IODBC
 /**
- * Bind parameter on HSTMT.
- * @param stmt statement handle
- * @param pnum parameter number, starting at 1
- * @param vtype input/output type of parameter
- * @param ptype
- * @param lenprec
- * @param scale
- * @param val pointer to host variable
- * @param lenp output length pointer
- * @result ODBC error code
+ * Mark STMT as no longer stepping its sqlite statement.
+ * @param s statement pointer
  */
 
-SQLRETURN SQL_API
-SQLBindParam(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT vtype,
-	     SQLSMALLINT ptype, SQLULEN lenprec,
-	     SQLSMALLINT scale, SQLPOINTER val,
-	     SQLLEN *lenp)
+static void
+s3stmt_unstream(STMT *s)
 {
-    SQLRETURN ret;
+    if (s->s3stmt_stream) {
+	DBC *d = (DBC *) s->dbc;
 
-    HSTMT_LOCK(stmt);
-    ret = drvbindparam(stmt, pnum, SQL_PARAM_INPUT, vtype, ptype,
-		       lenprec, scale, val, 0, lenp);
-    HSTMT_UNLOCK(stmt);
-    return ret;
+	s->s3stmt_stream = 0;
+	s->s3stmt_rowlazy = 0;
+	if (d && d->s3stmt_nstream > 0) {
+	    d->s3stmt_nstream--;
+	}
+    }
 }
-#endif
 
 /**
- * Return number of parameters.
- * @param stmt statement handle
- * @param nparam output parameter count
- * @result ODBC error code
+ * Turn streaming STMT into a materialized result set by fetching
+ * its remaining rows, so that it survives the end of a transaction.
+ * The current row is kept as first row of the result set.
+ * @param s statement pointer
+ * @result SQLite error code
  */
 
-SQLRETURN SQL_API
-SQLNumParams(SQLHSTMT stmt, SQLSMALLINT *nparam)
+static int
+s3stmt_spill(STMT *s)
 {
-    STMT *s;
-    SQLSMALLINT dummy;
+    DBC *d = (DBC *) s->dbc;
+    TBLRES tres;
+    int i, rc, ncols = s->ncols;
 
-    HSTMT_LOCK(stmt);
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
+    if (!s->s3stmt_stream || !s->s3stmt) {
+	return SQLITE_OK;
     }
-    s = (STMT *) stmt;
-    if (!nparam) {
-	nparam = &dummy;
+    if (s->s3stmt_rowlazy) {
+	rc = s3stmt_rowcells(s, ncols);
+	if (rc != SQLITE_OK) {
+	    tres.cells = NULL;
+	    tres.errmsg = NULL;
+	    goto done;
+	}
     }
-    *nparam = s->nparams;
-    HSTMT_UNLOCK(stmt);
-    return SQL_SUCCESS;
+    tres.cells = NULL;
+    tres.errmsg = NULL;
+    tres.nrow = 0;
+    tres.ncol = ncols;
+    tres.nalloc = 0;
+    tres.rc = SQLITE_OK;
+    tres.stmt = s->s3stmt;
+    tres.s = s;
+    if (s->cells && s->cellstride == 1 && s->nrows == 1 && ncols > 0) {
+	tres.nalloc = 16;
+	tres.cells = xmalloc(sizeof (CELL) * ncols * tres.nalloc);
+	if (!tres.cells) {
+	    rc = SQLITE_NOMEM;
+	    goto done;
+	}
+	for (i = 0; i < ncols; i++) {
+	    tres.cells[i * tres.nalloc] = s->cells[i];
+	}
+	tres.nrow = 1;
+    }
+    rc = SQLITE_OK;
+    while (!s->max_rows || s->s3stmt_rownum + tres.nrow < s->max_rows) {
+	d->stats.steps++;
+	rc = sqlite3_step(s->s3stmt);
+	if (rc != SQLITE_ROW) {
+	    break;
+	}
+	if (drvgettable_row(&tres, ncols, rc)) {
+	    rc = tres.rc;
+	    break;
+	}
+	rc = SQLITE_OK;
+    }
+    if (rc == SQLITE_DONE) {
+	rc = SQLITE_OK;
+    }
+done:
+    dbtraceapi(d, "sqlite3_reset", 0);
+    sqlite3_reset(s->s3stmt);
+    s->s3stmt_noreset = 1;
+    s3stmt_unstream(s);
+    sqlite3_free(tres.errmsg);
+    if (rc != SQLITE_OK) {
+	xfree(tres.cells);
+	freeresult(s, 0);
+	s->nrows = 0;
+	return rc;
+    }
+    freep(&s->bincache);
+    s->bincell = NULL;
+    s->binlen = 0;
+    xfree(s->cells);
+    s->cells = tres.cells;
+    s->cellstride = tres.nalloc;
+    s->nrows = tres.nrow;
+    s->rowp = s->rowprs = tres.nrow ? 0 : -1;
+    return SQLITE_OK;
 }
 
 /**
- * Setup parameter buffer for deferred parameter.
- * @param s pointer to STMT
- * @param p pointer to BINDPARM
- * @result ODBC error code (success indicated by SQL_NEED_DATA)
+ * Materialize result sets of all streaming STMTs of a DBC,
+ * used before the end of a transaction.
+ * @param d database connection pointer
  */
 
-static SQLRETURN
-setupparbuf(STMT *s, BINDPARM *p)
+static void
+s3stmt_spillall(DBC *d)
 {
-    if (!p->parbuf) {
-	if (*p->lenp == SQL_DATA_AT_EXEC) {
-	    p->len = p->max;
-	} else {
-	    p->len = SQL_LEN_DATA_AT_EXEC(*p->lenp);
-	}
-	if (p->len < 0 && p->len != SQL_NTS &&
-	    p->len != SQL_NULL_DATA) {
-	    setstat(s, -1, "invalid length", "HY009");
-	    return SQL_ERROR;
-	}
-	if (p->len >= 0) {
-	    p->parbuf = xmalloc(p->len + 2);
-	    if (!p->parbuf) {
-		return nomem(s);
+    STMT *s;
+    int rc;
+
+    for (s = d->stmt; s && d->s3stmt_nstream > 0; s = s->next) {
+	if (s->s3stmt_stream) {
+	    rc = s3stmt_spill(s);
+	    if (rc != SQLITE_OK) {
+		setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+			sqlite3_errmsg(d->sqlite), rc);
 	    }
-	    p->param = p->parbuf;
-	} else {
-	    p->param = NULL;
 	}
     }
-    return SQL_NEED_DATA;
 }
 
 /**
- * Retrieve next parameter for sending data to executing query.
- * @param stmt statement handle
- * @param pind pointer to output parameter indicator
- * @result ODBC error code
+ * Stop all streaming STMTs of a DBC.
+ * @param d database connection pointer
  */
 
-SQLRETURN SQL_API
-SQLParamData(SQLHSTMT stmt, SQLPOINTER *pind)
+static void
+s3stmt_endall(DBC *d)
 {
     STMT *s;
-    int i;
-    SQLPOINTER dummy;
-    SQLRETURN ret;
-    BINDPARM *p;
 
-    HSTMT_LOCK(stmt);
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
-    }
-    s = (STMT *) stmt;
-    if (!pind) {
-	pind = &dummy;
-    }
-    if (s->pdcount < s->nparams) {
-	s->pdcount++;
+    for (s = d->stmt; s && d->s3stmt_nstream > 0; s = s->next) {
+	if (s->s3stmt_stream) {
+	    s3stmt_end(s);
+	}
     }
-    for (i = 0; i < s->pdcount; i++) {
-	p = &s->bindparms[i];
-	if (p->need > 0) {
-	    int type = mapdeftype(p->type, p->stype, -1, s->nowchar[0]);
+}
 
-	    p->need = (type == SQL_C_CHAR || type == SQL_C_WCHAR) ? -1 : 0;
+#ifdef USE_LOBSTREAM
+
+/*
+ * Incremental blob I/O. Large blobs of result sets are left in
+ * the database and read piecewise by SQLGetData(), see lobsetup().
+ * Large SQL_LEN_DATA_AT_EXEC blob parameters of single row INSERTs
+ * are written by SQLPutData() into a zeroblob placeholder of the
+ * inserted row, see lobinsert().
+ */
+
+#define LOBIDCHAR(c)				\
+    (((c) >= 'a' && (c) <= 'z') ||		\
+     ((c) >= 'A' && (c) <= 'Z') ||		\
+     ((c) >= '0' && (c) <= '9') ||		\
+     (c) == '_' || (c) == '$' || ((c) & 0x80))
+
+#define LOBCELL(c) \
+    ((c)->type == SQLITE_BLOB && !(c)->v.p && (c)->len > 0)
+
+/**
+ * End savepoint of blob parameter, see lobinsert().
+ * @param s statement pointer
+ * @param ok true to keep the inserted row, false to undo the INSERT
+ * @result SQLite error code
+ */
+
+static int
+lobsavepoint(STMT *s, int ok)
+{
+    DBC *d = (DBC *) s->dbc;
+    char *errp = NULL;
+    int rc, busy_count = 0;
+
+    if (!ok) {
+	rc = sqlite3_exec(d->sqlite, "ROLLBACK TO sqlite3odbc_lob",
+			  NULL, NULL, &errp);
+	dbtracerc(d, rc, errp);
+	if (errp) {
+	    sqlite3_free(errp);
+	    errp = NULL;
 	}
     }
-    for (; i < s->nparams; i++) {
-	p = &s->bindparms[i];
-	if (p->need > 0) {
-	    *pind = (SQLPOINTER) p->param0;
-	    ret = setupparbuf(s, p);
-	    s->pdcount = i;
-	    goto done;
+again:
+    rc = sqlite3_exec(d->sqlite, "RELEASE sqlite3odbc_lob", NULL, NULL, &errp);
+    dbtracerc(d, rc, errp);
+    if (rc == SQLITE_BUSY && busy_handler((void *) d, ++busy_count)) {
+	if (errp) {
+	    sqlite3_free(errp);
+	    errp = NULL;
 	}
+	goto again;
     }
-    ret = drvexecute(stmt, 0);
-done:
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    if (rc != SQLITE_OK) {
+	setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		errp ? errp : "unknown error", rc);
+    }
+    if (errp) {
+	sqlite3_free(errp);
+	errp = NULL;
+    }
+    return rc;
 }
 
 /**
- * Return information about parameter.
- * @param stmt statement handle
- * @param pnum parameter number, starting at 1
- * @param dtype output type indicator
- * @param size output size indicator
- * @param decdigits output number of digits
- * @param nullable output NULL allowed indicator
+ * Close incremental blob handle of statement.
+ * @param s statement pointer
+ * @param ok for a blob parameter, true to keep the inserted row,
+ * false to undo the INSERT
  * @result ODBC error code
  */
 
-SQLRETURN SQL_API
-SQLDescribeParam(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT *dtype,
-		 SQLULEN *size, SQLSMALLINT *decdigits, SQLSMALLINT *nullable)
+static SQLRETURN
+lobend(STMT *s, int ok)
 {
-    STMT *s;
-    SQLRETURN ret = SQL_ERROR;
+    DBC *d = (DBC *) s->dbc;
+    int rc = SQLITE_OK;
 
-    HSTMT_LOCK(stmt);
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
-    }
-    s = (STMT *) stmt;
-    --pnum;
-    if (pnum >= s->nparams) {
-	setstat(s, -1, "invalid parameter index",
-		(*s->ov3) ? "HY000" : "S1000");
-	goto done;
-    }
-    if (dtype) {
-#ifdef SQL_LONGVARCHAR
-#ifdef WINTERFACE
-	*dtype = s->nowchar[0] ? SQL_LONGVARCHAR : SQL_WLONGVARCHAR;
-#else
-	*dtype = SQL_LONGVARCHAR;
-#endif
-#else
-#ifdef WINTERFACE
-	*dtype = s->nowchar[0] ? SQL_VARCHAR : SQL_WVARCHAR;
-#else
-	*dtype = SQL_VARCHAR;
-#endif
-#endif
-    }
-    if (size) {
-#ifdef SQL_LONGVARCHAR
-	*size = 65536;
-#else
-	*size = 255;
-#endif
+    if (s->lobh) {
+	dbtraceapi(d, "sqlite3_blob_close", 0);
+	rc = sqlite3_blob_close(s->lobh);
+	s->lobh = NULL;
+	if (rc != SQLITE_OK && s->lobname && ok) {
+	    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		    sqlite3_errmsg(d->sqlite), rc);
+	    ok = 0;
+	}
     }
-    if (decdigits) {
-	*decdigits = 0;
+    if (!s->lobname) {
+	return SQL_SUCCESS;
     }
-    if (nullable) {
-	*nullable = SQL_NULLABLE;
+    freep(&s->lobname);
+    if (lobsavepoint(s, ok) != SQLITE_OK || rc != SQLITE_OK) {
+	return SQL_ERROR;
     }
-    ret = SQL_SUCCESS;
-done:
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    return SQL_SUCCESS;
 }
 
 /**
- * Set information on parameter.
- * @param stmt statement handle
- * @param par parameter number, starting at 1
- * @param type type of host variable
- * @param sqltype
- * @param coldef
- * @param scale
- * @param val pointer to host variable
- * @param nval output length pointer
+ * Open deferred blob cell of result set for reading.
+ * @param s statement pointer
+ * @param col column number, 0 based
+ * @param row row index of cells
  * @result ODBC error code
  */
 
-SQLRETURN SQL_API
-SQLSetParam(SQLHSTMT stmt, SQLUSMALLINT par, SQLSMALLINT type,
-	    SQLSMALLINT sqltype, SQLULEN coldef,
-	    SQLSMALLINT scale, SQLPOINTER val, SQLLEN *nval)
+static SQLRETURN
+lobopen(STMT *s, int col, int row)
 {
-    SQLRETURN ret;
+    DBC *d = (DBC *) s->dbc;
+    CELL *c = &s->cells[col * s->cellstride + row];
+    CELL *r = &s->cells[s->has_rowid * s->cellstride + row];
+    int rc;
 
-    HSTMT_LOCK(stmt);
-    ret = drvbindparam(stmt, par, SQL_PARAM_INPUT,
-		       type, sqltype, coldef, scale, val,
-		       SQL_SETPARAM_VALUE_MAX, nval);
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    if (r->type != SQLITE_INTEGER) {
+	setstat(s, -1, "no ROWID for blob", (*s->ov3) ? "HY000" : "S1000");
+	return SQL_ERROR;
+    }
+    if (s->lobh) {
+	if (s->lobhcol == col && s->lobhrow == r->v.i) {
+	    return SQL_SUCCESS;
+	}
+	lobend(s, 0);
+    }
+    dbtraceapi(d, "sqlite3_blob_open", 0);
+    rc = sqlite3_blob_open(d->sqlite, s->dyncols[col].db,
+			   s->dyncols[col].table, s->lobcols[col],
+			   r->v.i, 0, &s->lobh);
+    if (rc != SQLITE_OK) {
+	setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		sqlite3_errmsg(d->sqlite), rc);
+	s->lobh = NULL;
+	return SQL_ERROR;
+    }
+    s->lobhcol = col;
+    s->lobhrow = r->v.i;
+    if (sqlite3_blob_bytes(s->lobh) != c->len) {
+	lobend(s, 0);
+	setstat(s, -1, "blob changed after fetch",
+		(*s->ov3) ? "HY000" : "S1000");
+	return SQL_ERROR;
+    }
+    return SQL_SUCCESS;
 }
 
 /**
- * Function not implemented.
+ * Read part of deferred blob cell of result set.
+ * @param s statement pointer
+ * @param col column number, 0 based
+ * @param row row index of cells
+ * @param offs offset into blob
+ * @param buf output buffer
+ * @param n number of bytes to read
+ * @result ODBC error code
+ *
+ * The blob handle is kept open for the next piece and closed
+ * when the end of the blob is reached.
  */
 
-SQLRETURN SQL_API
-SQLParamOptions(SQLHSTMT stmt, SQLULEN rows, SQLULEN *rowp)
+static SQLRETURN
+lobread(STMT *s, int col, int row, int offs, char *buf, int n)
 {
-    SQLRETURN ret;
+    DBC *d = (DBC *) s->dbc;
+    int rc;
 
-    HSTMT_LOCK(stmt);
-    ret = drvunimplstmt(stmt);
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    if (lobopen(s, col, row) != SQL_SUCCESS) {
+	return SQL_ERROR;
+    }
+    rc = sqlite3_blob_read(s->lobh, buf, n, offs);
+    if (rc != SQLITE_OK) {
+	setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		sqlite3_errmsg(d->sqlite), rc);
+	lobend(s, 0);
+	return SQL_ERROR;
+    }
+    if (offs + n >= s->cells[col * s->cellstride + row].len) {
+	lobend(s, 0);
+    }
+    return SQL_SUCCESS;
 }
 
-#ifndef WINTERFACE
 /**
- * Function not implemented.
+ * Load deferred blob cell of result set into the statement's arena,
+ * used when the blob is needed as a whole.
+ * @param s statement pointer
+ * @param col column number, 0 based
+ * @param row row index of cells
+ * @result ODBC error code
  */
 
-SQLRETURN SQL_API
-SQLGetDescField(SQLHDESC handle, SQLSMALLINT recno,
-		SQLSMALLINT fieldid, SQLPOINTER value,
-		SQLINTEGER buflen, SQLINTEGER *strlen)
+static SQLRETURN
+lobload(STMT *s, int col, int row)
 {
-    return SQL_ERROR;
+    CELL *c = &s->cells[col * s->cellstride + row];
+    char *p;
+
+    p = arena_alloc(&s->arena, c->len + 1);
+    if (!p) {
+	return nomem(s);
+    }
+    if (lobread(s, col, row, 0, p, c->len) != SQL_SUCCESS) {
+	return SQL_ERROR;
+    }
+    p[c->len] = '\0';
+    c->v.p = p;
+    return SQL_SUCCESS;
 }
-#endif
 
-#ifdef WINTERFACE
 /**
- * Function not implemented.
+ * Skip keyword in SQL text.
+ * @param sp pointer to SQL text pointer, advanced past keyword
+ * @param kw keyword
+ * @result true when keyword was found
  */
 
-SQLRETURN SQL_API
-SQLGetDescFieldW(SQLHDESC handle, SQLSMALLINT recno,
-		 SQLSMALLINT fieldid, SQLPOINTER value,
-		 SQLINTEGER buflen, SQLINTEGER *strlen)
+static int
+lobkw(char **sp, char *kw)
 {
-    return SQL_ERROR;
+    char *p = *sp;
+    int len = strlen(kw);
+
+    while (ISSPACE(*p)) {
+	p++;
+    }
+    if (strncasecmp(p, kw, len) == 0 && !LOBIDCHAR(p[len])) {
+	*sp = p + len;
+	return 1;
+    }
+    return 0;
 }
-#endif
 
-#ifndef WINTERFACE
 /**
- * Function not implemented.
+ * Scan bare or quoted identifier in SQL text.
+ * @param sp pointer to SQL text pointer, advanced past identifier
+ * @param buf output buffer for unquoted identifier, at least
+ * as long as the remaining SQL text
+ * @result true when identifier was found
  */
 
-SQLRETURN SQL_API
-SQLSetDescField(SQLHDESC handle, SQLSMALLINT recno,
-		SQLSMALLINT fieldid, SQLPOINTER value,
-		SQLINTEGER buflen)
+static int
+lobident(char **sp, char *buf)
 {
-    return SQL_ERROR;
+    char *p = *sp, q = '\0';
+    int n = 0;
+
+    while (ISSPACE(*p)) {
+	p++;
+    }
+    if (*p == '"' || *p == '`') {
+	q = *p++;
+    } else if (*p == '[') {
+	q = ']';
+	p++;
+    }
+    if (q) {
+	while (*p) {
+	    if (*p == q) {
+		if (q == ']' || p[1] != q) {
+		    break;
+		}
+		p++;
+	    }
+	    buf[n++] = *p++;
+	}
+	if (*p != q) {
+	    return 0;
+	}
+	p++;
+    } else {
+	while (LOBIDCHAR(*p)) {
+	    buf[n++] = *p++;
+	}
+    }
+    buf[n] = '\0';
+    *sp = p;
+    return n > 0;
 }
-#endif
 
-#ifdef WINTERFACE
 /**
- * Function not implemented.
+ * Map parameter of INSERT statement to the table column it is
+ * assigned to. Only statements of the form
+ * "INSERT [OR ABORT|OR FAIL] INTO [db.]table (col, ...) VALUES (expr, ...)"
+ * whose parameter is a plain "?" item of the VALUES list are mapped.
+ * @param s statement pointer
+ * @param pnum parameter number, 0 based
+ * @result xmalloc()'ed "db\0table\0column\0" or NULL
  */
 
-SQLRETURN SQL_API
-SQLSetDescFieldW(SQLHDESC handle, SQLSMALLINT recno,
-		 SQLSMALLINT fieldid, SQLPOINTER value,
-		 SQLINTEGER buflen)
+static char *
+lobinsmap(STMT *s, int pnum)
 {
-    return SQL_ERROR;
-}
-#endif
+    char *p = (char *) s->query, *cols, *buf, *tbl, *col, *q;
+    int len, k, ncols, np, depth, item = -1;
 
-#ifndef WINTERFACE
-/**
- * Function not implemented.
- */
+    if (!p || !lobkw(&p, "insert")) {
+	return NULL;
+    }
+    if (lobkw(&p, "or") && !lobkw(&p, "abort") && !lobkw(&p, "fail")) {
+	return NULL;
+    }
+    if (!lobkw(&p, "into")) {
+	return NULL;
+    }
+    len = strlen(p) + 1;
+    buf = xmalloc(len * 3);
+    if (!buf) {
+	return NULL;
+    }
+    tbl = buf + len;
+    col = tbl + len;
+    buf[0] = '\0';
+    if (!lobident(&p, tbl)) {
+	goto fail;
+    }
+    while (ISSPACE(*p)) {
+	p++;
+    }
+    if (*p == '.') {
+	p++;
+	strcpy(buf, tbl);
+	if (!lobident(&p, tbl)) {
+	    goto fail;
+	}
+	while (ISSPACE(*p)) {
+	    p++;
+	}
+    }
+    if (*p != '(') {
+	goto fail;
+    }
+    p++;
+    cols = p;
+    for (ncols = 0; ; ncols++) {
+	if (!lobident(&p, col)) {
+	    goto fail;
+	}
+	while (ISSPACE(*p)) {
+	    p++;
+	}
+	if (*p == ')') {
+	    p++;
+	    break;
+	}
+	if (*p != ',') {
+	    goto fail;
+	}
+	p++;
+    }
+    ncols++;
+    if (!lobkw(&p, "values")) {
+	goto fail;
+    }
+    while (ISSPACE(*p)) {
+	p++;
+    }
+    if (*p != '(') {
+	goto fail;
+    }
+    p++;
+    for (k = np = 0; ; k++) {
+	char *start;
 
-SQLRETURN SQL_API
-SQLGetDescRec(SQLHDESC handle, SQLSMALLINT recno,
-	      SQLCHAR *name, SQLSMALLINT buflen,
-	      SQLSMALLINT *strlen, SQLSMALLINT *type,
-	      SQLSMALLINT *subtype, SQLLEN *len,
-	      SQLSMALLINT *prec, SQLSMALLINT *scale,
-	      SQLSMALLINT *nullable)
-{
-    return SQL_ERROR;
+	while (ISSPACE(*p)) {
+	    p++;
+	}
+	start = p;
+	depth = 0;
+	while (*p && (depth > 0 || (*p != ',' && *p != ')'))) {
+	    switch (*p) {
+	    case '\'':
+	    case '"':
+		q = p++;
+		while (*p) {
+		    if (*p == *q) {
+			if (p[1] != *q) {
+			    break;
+			}
+			p++;
+		    }
+		    p++;
+		}
+		if (!*p) {
+		    goto fail;
+		}
+		break;
+	    case '(':
+		depth++;
+		break;
+	    case ')':
+		depth--;
+		break;
+	    case '?':
+		if (p[1] >= '0' && p[1] <= '9') {
+		    goto fail;
+		}
+		if (np++ == pnum) {
+		    q = p + 1;
+		    while (ISSPACE(*q)) {
+			q++;
+		    }
+		    if (p != start || (*q != ',' && *q != ')')) {
+			goto fail;
+		    }
+		    item = k;
+		}
+		break;
+	    case '-':
+	    case '/':
+		if (p[1] != '-' && p[1] != '*') {
+		    break;
+		}
+		/* fall through */
+	    case ':':
+	    case '@':
+	    case '$':
+	    case '[':
+	    case '`':
+		/* comments, named parameters, odd quoting */
+		goto fail;
+	    }
+	    p++;
+	}
+	if (*p == ')') {
+	    p++;
+	    break;
+	}
+	if (*p != ',') {
+	    goto fail;
+	}
+	p++;
+    }
+    while (ISSPACE(*p) || *p == ';') {
+	p++;
+    }
+    if (*p || item < 0 || k + 1 != ncols || np != s->nparams) {
+	goto fail;
+    }
+    p = cols;
+    for (k = 0; k <= item; k++) {
+	lobident(&p, col);
+	while (ISSPACE(*p) || *p == ',') {
+	    p++;
+	}
+    }
+    /* pack to "db\0table\0column\0" */
+    q = buf + strlen(buf) + 1;
+    memmove(q, tbl, strlen(tbl) + 1);
+    q += strlen(q) + 1;
+    memmove(q, col, strlen(col) + 1);
+    return buf;
+fail:
+    xfree(buf);
+    return NULL;
 }
-#endif
 
-#ifdef WINTERFACE
 /**
- * Function not implemented.
+ * Execute INSERT with a large SQL_LEN_DATA_AT_EXEC blob parameter
+ * bound as zeroblob placeholder and open the inserted blob for
+ * writing by SQLPutData(), used by SQLParamData().
+ * @param s statement pointer
+ * @param pnum parameter number, 0 based
+ * @param retp output ODBC return code
+ * @result true when the blob handle is set up, false when
+ * the parameter must be buffered as usual
+ *
+ * The INSERT is run in the savepoint "sqlite3odbc_lob" which
+ * is undone when streaming is not possible or gets cancelled.
+ * Tables having triggers are left alone since the triggers
+ * would see the placeholder instead of the data.
  */
 
-SQLRETURN SQL_API
-SQLGetDescRecW(SQLHDESC handle, SQLSMALLINT recno,
-	       SQLWCHAR *name, SQLSMALLINT buflen,
-	       SQLSMALLINT *strlen, SQLSMALLINT *type,
-	       SQLSMALLINT *subtype, SQLLEN *len,
-	       SQLSMALLINT *prec, SQLSMALLINT *scale,
-	       SQLSMALLINT *nullable)
+static int
+lobinsert(STMT *s, int pnum, SQLRETURN *retp)
 {
-    return SQL_ERROR;
-}
-#endif
+    DBC *d = (DBC *) s->dbc;
+    BINDPARM *p = &s->bindparms[pnum];
+    char *name, *tbl, *col, *db, *lbl, *lob, *sql, *errp = NULL;
+    char **rowp = NULL;
+    int i, rc, nrows, ncols, trig = 0;
+    SQLLEN len;
+    SQLRETURN ret;
+    sqlite_int64 rowid;
 
-/**
- * Function not implemented.
- */
+    if (d->lobstream <= 0 || s->isselect != 0 || s->paramset_size > 1 ||
+	!p->lenp || *p->lenp > SQL_LEN_DATA_AT_EXEC_OFFSET ||
+	mapdeftype(p->type, p->stype, -1, s->nowchar[0]) != SQL_C_BINARY) {
+	return 0;
+    }
+    len = SQL_LEN_DATA_AT_EXEC(*p->lenp);
+    if (len < d->lobstream || len > 0x7fffffff) {
+	return 0;
+    }
+    for (i = 0; i < s->nparams; i++) {
+	SQLLEN *lenp = s->bindparms[i].lenp;
 
-SQLRETURN SQL_API
-SQLSetDescRec(SQLHDESC handle, SQLSMALLINT recno,
-	      SQLSMALLINT type, SQLSMALLINT subtype,
-	      SQLLEN len, SQLSMALLINT prec,
-	      SQLSMALLINT scale, SQLPOINTER data,
-	      SQLLEN *strlen, SQLLEN *indicator)
-{
-    return SQL_ERROR;
+	if (i != pnum && lenp && (*lenp <= SQL_LEN_DATA_AT_EXEC_OFFSET ||
+				  *lenp == SQL_DATA_AT_EXEC)) {
+	    return 0;
+	}
+    }
+    name = lobinsmap(s, pnum);
+    if (!name) {
+	return 0;
+    }
+    tbl = name + strlen(name) + 1;
+    col = tbl + strlen(tbl) + 1;
+    lbl = name[0] ? name : "main";
+    sql = sqlite3_mprintf("SELECT type, %Q FROM \"%w\".sqlite_master"
+			  " WHERE tbl_name = %Q COLLATE NOCASE"
+			  " UNION ALL SELECT type, 'temp'"
+			  " FROM sqlite_temp_master"
+			  " WHERE tbl_name = %Q COLLATE NOCASE",
+			  lbl, lbl, tbl, tbl);
+    if (!sql) {
+	xfree(name);
+	return 0;
+    }
+    dbtraceapi(d, "sqlite3_get_table", sql);
+    rc = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, NULL);
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK || ncols != 2) {
+	if (rowp) {
+	    sqlite3_free_table(rowp);
+	}
+	xfree(name);
+	return 0;
+    }
+    /* the table unqualified names refer to is found first in "temp" */
+    db = NULL;
+    for (i = 1; i <= nrows; i++) {
+	char *type = rowp[i * ncols], *schema = rowp[i * ncols + 1];
+
+	if (strcmp(type, "trigger") == 0) {
+	    trig = 1;
+	} else if (strcmp(type, "table") == 0 &&
+		   (name[0] ? strcmp(schema, lbl) == 0 :
+		    (!db || strcmp(schema, "temp") == 0))) {
+	    db = schema;
+	}
+    }
+    if (trig || !db) {
+	sqlite3_free_table(rowp);
+	xfree(name);
+	return 0;
+    }
+    lob = xmalloc(strlen(db) + strlen(tbl) + strlen(col) + 3);
+    if (!lob) {
+	sqlite3_free_table(rowp);
+	xfree(name);
+	return 0;
+    }
+    strcpy(lob, db);
+    strcpy(lob + strlen(db) + 1, tbl);
+    strcpy(lob + strlen(db) + strlen(tbl) + 2, col);
+    sqlite3_free_table(rowp);
+    xfree(name);
+    db = lob;
+    tbl = db + strlen(db) + 1;
+    col = tbl + strlen(tbl) + 1;
+    if (starttran(s) != SQL_SUCCESS) {
+	xfree(lob);
+	return 0;
+    }
+    rc = sqlite3_exec(d->sqlite, "SAVEPOINT sqlite3odbc_lob",
+		      NULL, NULL, &errp);
+    dbtracerc(d, rc, errp);
+    if (errp) {
+	sqlite3_free(errp);
+	errp = NULL;
+    }
+    if (rc != SQLITE_OK) {
+	xfree(lob);
+	return 0;
+    }
+    p->lobzero = 1;
+    p->need = 0;
+    p->len = len;
+    ret = drvexecute((SQLHSTMT) s, 0);
+    p->lobzero = 0;
+    /* set after drvexecute() which ends a pending blob parameter */
+    s->lobname = lob;
+    if (SQL_SUCCEEDED(ret) && sqlite3_changes(d->sqlite) == 1) {
+	rowid = sqlite3_last_insert_rowid(d->sqlite);
+	dbtraceapi(d, "sqlite3_blob_open", 0);
+	rc = sqlite3_blob_open(d->sqlite, db, tbl, col, rowid, 1, &s->lobh);
+	if (rc == SQLITE_OK && sqlite3_blob_bytes(s->lobh) == len) {
+	    s->lobhcol = -1 - pnum;
+	    s->lobhrow = rowid;
+	    p->need = 1;
+	    p->offs = 0;
+	    p->len = len;
+	    *retp = SQL_NEED_DATA;
+	    return 1;
+	}
+	if (rc != SQLITE_OK) {
+	    s->lobh = NULL;
+	}
+    }
+    /* undo and buffer the parameter instead */
+    lobend(s, 0);
+    setstat(s, 0, NULL, "00000");
+    p->need = 1;
+    p->offs = 0;
+    p->len = 0;
+    return 0;
 }
 
 /**
- * Setup empty result set from constant column specification.
- * @param stmt statement handle
- * @param colspec column specification array (default, ODBC2)
- * @param ncols number of columns (default, ODBC2)
- * @param colspec3 column specification array (ODBC3)
- * @param ncols3 number of columns (ODBC3)
- * @param nret returns number of columns
+ * Write data of streamed blob parameter, used by SQLPutData().
+ * @param s statement pointer
+ * @param p parameter pointer
+ * @param data data pointer
+ * @param len length of data or SQL_NULL_DATA
  * @result ODBC error code
+ *
+ * Missing data is left zero, data beyond the given length is
+ * dropped and further calls fail like for buffered parameters.
  */
 
 static SQLRETURN
-mkresultset(HSTMT stmt, COL *colspec, int ncols, COL *colspec3,
-	    int ncols3, int *nret)
+lobput(STMT *s, BINDPARM *p, SQLPOINTER data, SQLLEN len)
 {
-    STMT *s;
-    DBC *d;
+    DBC *d = (DBC *) s->dbc;
+    char *db = s->lobname, *tbl, *col, *sql, *errp = NULL;
+    int rc = SQLITE_OK, dlen;
 
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
-    }
-    s = (STMT *) stmt;
-    if (s->dbc == SQL_NULL_HDBC) {
-noconn:
-	return noconn(s);
-    }
-    d = (DBC *) s->dbc;
-    if (!d->sqlite) {
-	goto noconn;
+    if (p->offs < 0 || p->offs >= p->len) {
+	setstat(s, -1, "sequence error", "HY010");
+	return SQL_ERROR;
     }
-    s3stmt_end_if(s);
-    freeresult(s, 0);
-    if (colspec3 && *s->ov3) {
-	s->ncols = ncols3;
-	s->cols = colspec3;
+    if (len == SQL_NULL_DATA) {
+	tbl = db + strlen(db) + 1;
+	col = tbl + strlen(tbl) + 1;
+	sql = sqlite3_mprintf("UPDATE \"%w\".\"%w\" SET \"%w\" = NULL"
+			      " WHERE rowid = %lld", db, tbl, col,
+			      s->lobhrow);
+	if (!sql) {
+	    p->offs = -1;
+	    return nomem(s);
+	}
+	rc = sqlite3_exec(d->sqlite, sql, NULL, NULL, &errp);
+	dbtracerc(d, rc, errp);
+	sqlite3_free(sql);
+	p->offs = p->len;
+    } else if (len < 0) {
+	setstat(s, -1, "invalid length", "HY090");
+	return SQL_ERROR;
     } else {
-	s->ncols = ncols;
-	s->cols = colspec;
+	dlen = min(p->len - p->offs, len);
+	if (dlen > 0) {
+	    rc = sqlite3_blob_write(s->lobh, data, dlen, p->offs);
+	    p->offs += dlen;
+	}
     }
-    mkbindcols(s, s->ncols);
-    s->nowchar[1] = 1;
-    s->nrows = 0;
-    s->rowp = s->rowprs = -1;
-    s->isselect = -1;
-    if (nret) {
-	*nret = s->ncols;
+    if (rc != SQLITE_OK) {
+	setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		errp ? errp : sqlite3_errmsg(d->sqlite), rc);
+	p->offs = -1;
     }
-    return SQL_SUCCESS;
+    if (errp) {
+	sqlite3_free(errp);
+	errp = NULL;
+    }
+    return (rc == SQLITE_OK) ? SQL_SUCCESS : SQL_ERROR;
 }
 
-/**
- * Columns for result set of SQLTablePrivileges().
- */
-
-static COL tablePrivSpec2[] = {
-    { "SYSTEM", "TABLEPRIV", "TABLE_QUALIFIER", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "TABLE_OWNER", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "TABLE_NAME", SCOL_VARCHAR, 255 },
-    { "SYSTEM", "TABLEPRIV", "GRANTOR", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "GRANTEE", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "PRIVILEGE", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "IS_GRANTABLE", SCOL_VARCHAR, 50 }
-};
-
-static COL tablePrivSpec3[] = {
-    { "SYSTEM", "TABLEPRIV", "TABLE_CAT", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "TABLE_SCHEM", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "TABLE_NAME", SCOL_VARCHAR, 255 },
-    { "SYSTEM", "TABLEPRIV", "GRANTOR", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "GRANTEE", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "PRIVILEGE", SCOL_VARCHAR, 50 },
-    { "SYSTEM", "TABLEPRIV", "IS_GRANTABLE", SCOL_VARCHAR, 50 }
-};
+#endif
 
 /**
- * Retrieve privileges on tables and/or views.
- * @param stmt statement handle
- * @param cat catalog name/pattern or NULL
- * @param catLen length of catalog name/pattern or SQL_NTS
- * @param schema schema name/pattern or NULL
- * @param schemaLen length of schema name/pattern or SQL_NTS
- * @param table table name/pattern or NULL
- * @param tableLen length of table name/pattern or SQL_NTS
+ * Start sqlite statement for execution of SELECT statement.
+ * @param s statement pointer
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvtableprivileges(SQLHSTMT stmt,
-		   SQLCHAR *cat, SQLSMALLINT catLen,
-		   SQLCHAR *schema, SQLSMALLINT schemaLen,
-		   SQLCHAR *table, SQLSMALLINT tableLen)
+s3stmt_start(STMT *s)
+{
+    DBC *d = (DBC *) s->dbc;
+    const char *endp;
+    sqlite3_stmt *s3stmt = NULL;
+    int rc, nretry = 0;
+
+    s->s3stmt_needmeta = 0;
+    if (!s->s3stmt) {
+	s3stmt = s3cache_get(d, (char *) s->query);
+	if (s3stmt) {
+	    goto gotstmt;
+	}
+#if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
+	dbtraceapi(d, "sqlite3_prepare_v2", (char *) s->query);
+#else
+	dbtraceapi(d, "sqlite3_prepare", (char *) s->query);
+#endif
+	do {
+	    s3stmt = NULL;
+	    d->stats.prepares++;
+#if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
+	    rc = sqlite3_prepare_v2(d->sqlite, (char *) s->query, -1,
+				    &s3stmt, &endp);
+#else
+	    rc = sqlite3_prepare(d->sqlite, (char *) s->query, -1,
+				 &s3stmt, &endp);
+#endif
+	    if (rc != SQLITE_OK) {
+		if (s3stmt) {
+		    sqlite3_finalize(s3stmt);
+		    s3stmt = NULL;
+		}
+	    }
+	} while (rc == SQLITE_SCHEMA && (++nretry) < 2);
+	dbtracerc(d, rc, NULL);
+	if (rc != SQLITE_OK) {
+	    if (s3stmt) {
+		dbtraceapi(d, "sqlite3_finalize", NULL);
+		sqlite3_finalize(s3stmt);
+	    }
+	    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		    sqlite3_errmsg(d->sqlite), rc);
+	    return SQL_ERROR;
+	}
+gotstmt:
+	if (sqlite3_bind_parameter_count(s3stmt) != s->nparams) {
+	    dbtraceapi(d, "sqlite3_finalize", 0);
+	    sqlite3_finalize(s3stmt);
+	    setstat(s, SQLITE_ERROR, "parameter marker count incorrect",
+		    (*s->ov3) ? "HY000" : "S1000");
+	    return SQL_ERROR;
+	}
+	s->s3stmt = s3stmt;
+	s->s3stmt_noreset = 1;
+	s->s3stmt_needmeta = 1;
+    }
+    if (!s->s3stmt_stream) {
+	s->s3stmt_stream = 1;
+	d->s3stmt_nstream++;
+    }
+    s->s3stmt_rownum = -1;
+    s3bind(d, s->s3stmt, s->nparams, s->bindparms, 1);
+    return SQL_SUCCESS;
+}
+
+#ifndef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLDataSources(SQLHENV env, SQLUSMALLINT dir, SQLCHAR *srvname,
+	       SQLSMALLINT buflen1, SQLSMALLINT *lenp1,
+	       SQLCHAR *desc, SQLSMALLINT buflen2, SQLSMALLINT *lenp2)
+{
+    if (env == SQL_NULL_HENV) {
+	return SQL_INVALID_HANDLE;
+    }
+    return SQL_ERROR;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLDataSourcesW(SQLHENV env, SQLUSMALLINT dir, SQLWCHAR *srvname,
+		SQLSMALLINT buflen1, SQLSMALLINT *lenp1,
+		SQLWCHAR *desc, SQLSMALLINT buflen2, SQLSMALLINT *lenp2)
+{
+    if (env == SQL_NULL_HENV) {
+	return SQL_INVALID_HANDLE;
+    }
+    return SQL_ERROR;
+}
+#endif
+
+#ifndef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLDrivers(SQLHENV env, SQLUSMALLINT dir, SQLCHAR *drvdesc,
+	   SQLSMALLINT descmax, SQLSMALLINT *desclenp,
+	   SQLCHAR *drvattr, SQLSMALLINT attrmax, SQLSMALLINT *attrlenp)
+{
+    if (env == SQL_NULL_HENV) {
+	return SQL_INVALID_HANDLE;
+    }
+    return SQL_ERROR;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLDriversW(SQLHENV env, SQLUSMALLINT dir, SQLWCHAR *drvdesc,
+	    SQLSMALLINT descmax, SQLSMALLINT *desclenp,
+	    SQLWCHAR *drvattr, SQLSMALLINT attrmax, SQLSMALLINT *attrlenp)
+{
+    if (env == SQL_NULL_HENV) {
+	return SQL_INVALID_HANDLE;
+    }
+    return SQL_ERROR;
+}
+#endif
+
+#ifndef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLBrowseConnect(SQLHDBC dbc, SQLCHAR *connin, SQLSMALLINT conninLen,
+		 SQLCHAR *connout, SQLSMALLINT connoutMax,
+		 SQLSMALLINT *connoutLen)
+{
+    SQLRETURN ret;
+
+    HDBC_LOCK(dbc);
+    ret = drvunimpldbc(dbc);
+    HDBC_UNLOCK(dbc);
+    return ret;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLBrowseConnectW(SQLHDBC dbc, SQLWCHAR *connin, SQLSMALLINT conninLen,
+		  SQLWCHAR *connout, SQLSMALLINT connoutMax,
+		  SQLSMALLINT *connoutLen)
 {
     SQLRETURN ret;
+
+    HDBC_LOCK(dbc);
+    ret = drvunimpldbc(dbc);
+    HDBC_UNLOCK(dbc);
+    return ret;
+}
+#endif
+
+/**
+ * Internal put (partial) parameter data into executing statement.
+ * @param stmt statement handle
+ * @param data pointer to data
+ * @param len length of data
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvputdata(SQLHSTMT stmt, SQLPOINTER data, SQLLEN len)
+{
     STMT *s;
-    DBC *d;
-    int ncols, rc, size, npatt;
-    char *errp = NULL, *sql, tname[512];
+    int i, dlen, done = 0;
+    BINDPARM *p;
 
-    ret = mkresultset(stmt, tablePrivSpec2, array_size(tablePrivSpec2),
-		      tablePrivSpec3, array_size(tablePrivSpec3), NULL);
-    if (ret != SQL_SUCCESS) {
-	return ret;
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
     }
     s = (STMT *) stmt;
-    d = (DBC *) s->dbc;
-    if (cat && (catLen > 0 || catLen == SQL_NTS) && cat[0] == '%') {
-	table = NULL;
-	goto doit;
-    }
-    if (schema && (schemaLen > 0 || schemaLen == SQL_NTS) &&
-	schema[0] == '%') {
-	if ((!cat || catLen == 0 || !cat[0]) &&
-	    (!table || tableLen == 0 || !table[0])) {
-	    table = NULL;
-	    goto doit;
-	}
-    }
-doit:
-    if (!table) {
-	size = 1;
-	tname[0] = '%';
-    } else {
-	if (tableLen == SQL_NTS) {
-	    size = sizeof (tname) - 1;
-	} else {
-	    size = min(sizeof (tname) - 1, tableLen);
-	}
-	strncpy(tname, (char *) table, size);
+    if (!s->query || s->nparams <= 0) {
+seqerr:
+	setstat(s, -1, "sequence error", "HY010");
+	return SQL_ERROR;
     }
-    tname[size] = '\0';
-    npatt = unescpat(tname);
-#if defined(_WIN32) || defined(_WIN64)
-    if (npatt) {
-	sql = sqlite3_mprintf("select %s as 'TABLE_QUALIFIER', "
-			      "%s as 'TABLE_OWNER', "
-			      "tbl_name as 'TABLE_NAME', "
-			      "'' as 'GRANTOR', "
-			      "'' as 'GRANTEE', "
-			      "'SELECT' AS 'PRIVILEGE', "
-			      "NULL as 'IS_GRANTABLE' "
-			      "from sqlite_master where "
-			      "(type = 'table' or type = 'view') "
-			      "and tbl_name like %Q "
-			      "UNION "
-			      "select %s as 'TABLE_QUALIFIER', "
-			      "%s as 'TABLE_OWNER', "
-			      "tbl_name as 'TABLE_NAME', "
-			      "'' as 'GRANTOR', "
-			      "'' as 'GRANTEE', "
-			      "'UPDATE' AS 'PRIVILEGE', "
-			      "NULL as 'IS_GRANTABLE' "
-			      "from sqlite_master where "
-			      "(type = 'table' or type = 'view') "
-			      "and tbl_name like %Q "
-			      "UNION "
-			      "select %s as 'TABLE_QUALIFIER', "
-			      "%s as 'TABLE_OWNER', "
-			      "tbl_name as 'TABLE_NAME', "
-			      "'' as 'GRANTOR', "
-			      "'' as 'GRANTEE', "
-			      "'DELETE' AS 'PRIVILEGE', "
-			      "NULL as 'IS_GRANTABLE' "
-			      "from sqlite_master where "
-			      "(type = 'table' or type = 'view') "
-			      "and tbl_name like %Q "
-			      "UNION "
-			      "select %s as 'TABLE_QUALIFIER', "
-			      "%s as 'TABLE_OWNER', "
-			      "tbl_name as 'TABLE_NAME', "
-			      "'' as 'GRANTOR', "
-			      "'' as 'GRANTEE', "
-			      "'INSERT' AS 'PRIVILEGE', "
-			      "NULL as 'IS_GRANTABLE' "
-			      "from sqlite_master where "
-			      "(type = 'table' or type = 'view') "
-			      "and tbl_name like %Q "
+    for (i = (s->pdcount < 0) ? 0 : s->pdcount; i < s->nparams; i++) {
+	p = &s->bindparms[i];
+	if (p->need > 0) {
+	    int type = mapdeftype(p->type, p->stype, -1, s->nowchar[0]);
+
+#ifdef USE_LOBSTREAM
+	    if (s->lobname && s->lobhcol == -1 - i) {
+		return lobput(s, p, data, len);
+	    }
+#endif
+	    if (len == SQL_NULL_DATA) {
+		freep(&p->parbuf);
+		p->param = NULL;
+		p->len = SQL_NULL_DATA;
+		p->need = -1;
+	    } else if (type != SQL_C_CHAR
+#ifdef WCHARSUPPORT
+		       && type != SQL_C_WCHAR
+#endif
+		       && type != SQL_C_BINARY) {
+		int size = 0;
+
+		switch (type) {
+		case SQL_C_TINYINT:
+		case SQL_C_UTINYINT:
+		case SQL_C_STINYINT:
+#ifdef SQL_BIT
+		case SQL_C_BIT:
+#endif
+		    size = sizeof (SQLCHAR);
+		    break;
+		case SQL_C_SHORT:
+		case SQL_C_USHORT:
+		case SQL_C_SSHORT:
+		    size = sizeof (SQLSMALLINT);
+		    break;
+		case SQL_C_LONG:
+		case SQL_C_ULONG:
+		case SQL_C_SLONG:
+		    size = sizeof (SQLINTEGER);
+		    break;
+#ifdef SQL_BIGINT
+		case SQL_C_UBIGINT:
+		case SQL_C_SBIGINT:
+		    size = sizeof (SQLBIGINT);
+		    break;
+#endif
+		case SQL_C_FLOAT:
+		    size = sizeof (float);
+		    break;
+		case SQL_C_DOUBLE:
+		    size = sizeof (double);
+		    break;
+#ifdef SQL_C_TYPE_DATE
+		case SQL_C_TYPE_DATE:
+#endif
+		case SQL_C_DATE:
+		    size = sizeof (DATE_STRUCT);
+		    break;
+#ifdef SQL_C_TYPE_DATE
+		case SQL_C_TYPE_TIME:
+#endif
+		case SQL_C_TIME:
+		    size = sizeof (TIME_STRUCT);
+		    break;
+#ifdef SQL_C_TYPE_DATE
+		case SQL_C_TYPE_TIMESTAMP:
+#endif
+		case SQL_C_TIMESTAMP:
+		    size = sizeof (TIMESTAMP_STRUCT);
+		    break;
+		}
+		freep(&p->parbuf);
+		p->parbuf = xmalloc(size);
+		if (!p->parbuf) {
+		    return nomem(s);
+		}
+		p->param = p->parbuf;
+		memcpy(p->param, data, size);
+		p->len = size;
+		p->need = -1;
+	    } else if (len == SQL_NTS && (
+		       type == SQL_C_CHAR
+#ifdef WCHARSUPPORT
+		       || type == SQL_C_WCHAR
+#endif
+		      )) {
+		char *dp = data;
+
+#ifdef WCHARSUPPORT
+		if (type == SQL_C_WCHAR) {
+		    dp = uc_to_utf(data, len);
+		    if (!dp) {
+			return nomem(s);
+		    }
+		}
+#endif
+#if defined(_WIN32) || defined(_WIN64)
+		if (*s->oemcp) {
+		    dp = wmb_to_utf(data, strlen (data));
+		    if (!dp) {
+			return nomem(s);
+		    }
+		}
+#endif
+		dlen = strlen(dp);
+		freep(&p->parbuf);
+		p->parbuf = xmalloc(dlen + 1);
+		if (!p->parbuf) {
+		    if (dp != data) {
+			uc_free(dp);
+		    }
+		    return nomem(s);
+		}
+		p->param = p->parbuf;
+		strcpy(p->param, dp);
+		if (dp != data) {
+		    uc_free(dp);
+		}
+		p->len = dlen;
+		p->need = -1;
+	    } else if (len < 0) {
+		setstat(s, -1, "invalid length", "HY090");
+		return SQL_ERROR;
+	    } else {
+		dlen = min(p->len - p->offs, len);
+		if (!p->param) {
+		    setstat(s, -1, "no memory for parameter", "HY013");
+		    return SQL_ERROR;
+		}
+		memcpy((char *) p->param + p->offs, data, dlen);
+		p->offs += dlen;
+		if (p->offs >= p->len) {
+#ifdef WCHARSUPPORT
+		    if (type == SQL_C_WCHAR) {
+			char *dp = uc_to_utf(p->param, p->len);
+			char *np;
+			int nlen;
+
+			if (!dp) {
+			    return nomem(s);
+			}
+			nlen = strlen(dp);
+			np = xmalloc(nlen + 1);
+			if (!np) {
+			    uc_free(dp);
+			    return nomem(s);
+			}
+			strcpy(np, dp);
+			uc_free(dp);
+			if (p->param == p->parbuf) {
+			    freep(&p->parbuf);
+			}
+			p->parbuf = p->param = np;
+			p->len = nlen;
+		    } else {
+			*((char *) p->param + p->len) = '\0';
+		    }
+		    p->need = (type == SQL_C_CHAR || type == SQL_C_WCHAR)
+			    ? -1 : 0;
+#else
+		    *((char *) p->param + p->len) = '\0';
+		    p->need = (type == SQL_C_CHAR) ? -1 : 0;
+#endif
+#if defined(_WIN32) || defined(_WIN64)
+		    if (type == SQL_C_CHAR && *s->oemcp &&
+			!(p->stype == SQL_BINARY ||
+			  p->stype == SQL_VARBINARY ||
+			  p->stype == SQL_LONGVARBINARY)) {
+			char *dp = wmb_to_utf(p->param, p->len);
+
+			if (!dp) {
+			    return nomem(s);
+			}
+			if (p->param == p->parbuf) {
+			    freep(&p->parbuf);
+			}
+			p->parbuf = p->param = dp;
+			p->len = strlen(dp);
+		    }
+		    if (p->type == SQL_C_WCHAR &&
+			(p->stype == SQL_VARCHAR ||
+			 p->stype == SQL_LONGVARCHAR) &&
+			 p->len == p->coldef * sizeof (SQLWCHAR)) {
+			/* fix for MS-Access */
+			p->len = p->coldef;
+		    }
+#endif
+		}
+	    }
+	    done = 1;
+	    break;
+	}
+    }
+    if (!done) {
+	goto seqerr;
+    }
+    return SQL_SUCCESS;
+}
+
+/**
+ * Put (partial) parameter data into executing statement.
+ * @param stmt statement handle
+ * @param data pointer to data
+ * @param len length of data
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLPutData(SQLHSTMT stmt, SQLPOINTER data, SQLLEN len)
+{
+    SQLRETURN ret;
+
+    HSTMT_LOCK(stmt);
+    ret = drvputdata(stmt, data, len);
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+
+/**
+ * Clear out parameter bindings, if any.
+ * @param s statement pointer
+ */
+
+static SQLRETURN
+freeparams(STMT *s)
+{
+#ifdef USE_LOBSTREAM
+    lobend(s, 0);
+#endif
+    if (s->bindparms) {
+	int n;
+
+	for (n = 0; n < s->nbindparms; n++) {
+	    freep(&s->bindparms[n].parbuf);
+	    memset(&s->bindparms[n], 0, sizeof (BINDPARM));
+	}
+    }
+    return SQL_SUCCESS;
+}
+
+/**
+ * Setup SQLite3 parameter for statement parameter.
+ * @param s statement pointer
+ * @param sql sql string
+ * @param pnum parameter number
+ * @result ODBC error code
+ *
+ * The parameter is converted within BINDPARM in order to
+ * be presented to sqlite3_bind_*() functions.
+ */
+
+static SQLRETURN
+setupparam(STMT *s, char *sql, int pnum)
+{
+    int type, len = 0, needalloc = 0;
+    BINDPARM *p;
+
+    if (!s->bindparms || pnum < 0 || pnum >= s->nbindparms) {
+	goto error;
+    }
+    p = &s->bindparms[pnum];
+    type = mapdeftype(p->type, p->stype, -1, s->nowchar[0]);
+#if (defined(_WIN32) || defined(_WIN64)) && defined(WINTERFACE)
+    /* MS Access hack part 4 (map SQL_C_DEFAULT to SQL_C_CHAR) */
+    if (type == SQL_C_WCHAR && p->type == SQL_C_DEFAULT) {
+	type = SQL_C_CHAR;
+    }
+#endif
+    if (p->need > 0) {
+	return setupparbuf(s, p);
+    }
+#ifdef USE_LOBSTREAM
+    if (p->lobzero) {
+	/* placeholder, data written later, see lobinsert() */
+	p->s3type = SQLITE_BLOB;
+	p->s3size = p->len;
+	p->s3val = NULL;
+	return SQL_SUCCESS;
+    }
+#endif
+    p->strbuf[0] = '\0';
+    if (!p->param || (p->lenp && *p->lenp == SQL_NULL_DATA)) {
+	p->s3type = SQLITE_NULL;
+	p->s3size = 0;
+	return SQL_SUCCESS;
+    }
+    if (type == SQL_C_CHAR &&
+	(p->stype == SQL_BINARY ||
+	 p->stype == SQL_VARBINARY ||
+	 p->stype == SQL_LONGVARBINARY)) {
+	type = SQL_C_BINARY;
+    }
+    switch (type) {
+    case SQL_C_BINARY:
+	p->s3type = SQLITE_BLOB;
+	p->s3size = p->len;
+	p->s3val = p->param;
+	if (p->need < 0) {
+	    break;
+	}
+	if (!p->lenp) {
+	    len = p->len;
+	} else if (*p->lenp == SQL_DATA_AT_EXEC) {
+	    len = p->len;
+	} else {
+	    len = *p->lenp;
+	    if (len <= SQL_LEN_DATA_AT_EXEC_OFFSET) {
+		len = SQL_LEN_DATA_AT_EXEC(len);
+	    }
+	}
+	if (len < 0) {
+	    setstat(s, -1, "invalid length", "HY009");
+	    return SQL_ERROR;
+	}
+	p->len = len;
+	p->max = p->len;
+	p->need = -1;
+	p->s3size = len;
+	break;
+#ifdef WCHARSUPPORT
+    case SQL_C_WCHAR:
+#endif
+    case SQL_C_CHAR:
+	p->s3type = SQLITE_TEXT;
+	p->s3size = -1;
+	p->s3val = p->param;
+	if (!p->parbuf) {
+#ifdef WCHARSUPPORT
+	    if (type == SQL_C_WCHAR) {
+		if (!p->lenp || *p->lenp == SQL_NTS) {
+		    p->max = uc_strlen(p->param) * sizeof (SQLWCHAR);
+		} else if (*p->lenp >= 0) {
+		    p->max = *p->lenp;
+		}
+	    } else
+#endif
+	    if (type == SQL_C_CHAR) {
+		if (!p->lenp || *p->lenp == SQL_NTS) {
+		    p->len = p->max = strlen(p->param);
+#if defined(_WIN32) || defined(_WIN64)
+		    needalloc = 1;
+#endif
+		} else if (*p->lenp >= 0) {
+		    p->len = p->max = *p->lenp;
+		    needalloc = 1;
+		}
+	    }
+	}
+	if (p->need < 0 && p->parbuf == p->param) {
+	    break;
+	}
+#ifdef WCHARSUPPORT
+	if (type == SQL_C_WCHAR) {
+	    char *dp = uc_to_utf(p->param, p->max);
+
+	    if (!dp) {
+		return nomem(s);
+	    }
+	    if (p->param == p->parbuf) {
+		freep(&p->parbuf);
+	    }
+	    p->parbuf = p->param = dp;
+	    p->need = -1;
+	    p->len = strlen(p->param);
+	    p->s3val = p->param;
+	    p->s3size = p->len;
+	} else
+#endif
+	if (type == SQL_C_CHAR) {
+	    p->s3val = p->param;
+	    if (needalloc) {
+		char *dp;
+
+#if defined(_WIN32) || defined(_WIN64)
+		if (*s->oemcp) {
+		    dp = wmb_to_utf(p->param, p->len);
+		} else {
+		    dp = xmalloc(p->len + 1);
+		}
+#else
+		dp = xmalloc(p->len + 1);
+#endif
+		if (!dp) {
+		    return nomem(s);
+		}
+#if defined(_WIN32) || defined(_WIN64)
+		if (*s->oemcp) {
+		    p->len = strlen(dp);
+		} else {
+		    memcpy(dp, p->param, p->len);
+		    dp[p->len] = '\0';
+		}
+#else
+		memcpy(dp, p->param, p->len);
+		dp[p->len] = '\0';
+#endif
+		if (p->param == p->parbuf) {
+		    freep(&p->parbuf);
+		}
+		p->parbuf = p->param = dp;
+		p->need = -1;
+		p->s3val = p->param;
+		p->s3size = p->len;
+	    }
+	}
+	break;
+    case SQL_C_UTINYINT:
+    case SQL_C_TINYINT:
+    case SQL_C_STINYINT:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (int);
+	p->s3ival = *((SQLCHAR *) p->param);
+	break;
+    case SQL_C_USHORT:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (int);
+	p->s3ival = *((SQLUSMALLINT *) p->param);
+	break;
+    case SQL_C_SHORT:
+    case SQL_C_SSHORT:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (int);
+	p->s3ival = *((SQLSMALLINT *) p->param);
+	break;
+    case SQL_C_ULONG:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (int);
+	p->s3ival = *((SQLUINTEGER *) p->param);
+	break;
+    case SQL_C_LONG:
+    case SQL_C_SLONG:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (int);
+	p->s3ival = *((SQLINTEGER *) p->param);
+	break;
+#ifdef SQL_BIT
+    case SQL_C_BIT:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (int);
+	p->s3ival = (*((SQLCHAR *) p->param)) ? 1 : 0;
+	break;
+#endif
+#ifdef SQL_BIGINT
+    case SQL_C_SBIGINT:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (sqlite_int64);
+	p->s3lival = *((sqlite_int64 *) p->param);
+	break;
+    case SQL_C_UBIGINT:
+	p->s3type = SQLITE_INTEGER;
+	p->s3size = sizeof (sqlite_int64);
+	p->s3lival = *((sqlite_uint64 *) p->param);
+	break;
+#endif
+    case SQL_C_FLOAT:
+	p->s3type = SQLITE_FLOAT;
+	p->s3size = sizeof (double);
+	p->s3dval = *((float *) p->param);
+	break;
+    case SQL_C_DOUBLE:
+	p->s3type = SQLITE_FLOAT;
+	p->s3size = sizeof (double);
+	p->s3dval = *((double *) p->param);
+	break;
+#ifdef SQL_C_TYPE_DATE
+    case SQL_C_TYPE_DATE:
+#endif
+    case SQL_C_DATE:
+	if (*s->jdconv) {
+	    int a, b, x1, x2, y, m, d;
+
+	    p->s3type = SQLITE_FLOAT;
+	    p->s3size = sizeof (double);
+	    y = ((DATE_STRUCT *) p->param)->year;
+	    m = ((DATE_STRUCT *) p->param)->month;
+	    d = ((DATE_STRUCT *) p->param)->day;
+	    if (m <= 2) {
+		y--;
+		m += 12;
+	    }
+	    a = y / 100;
+	    b = 2 - a + (a / 4);
+	    x1 = 36525 * (y + 4716) / 100;
+	    x2 = 306001 * (m + 1) / 10000;
+	    p->s3dval = x1 + x2 + d + b - 1524.5;
+	    break;
+	}
+	sprintf(p->strbuf, "%04d-%02d-%02d",
+		((DATE_STRUCT *) p->param)->year,
+		((DATE_STRUCT *) p->param)->month,
+		((DATE_STRUCT *) p->param)->day);
+	p->s3type = SQLITE_TEXT;
+	p->s3size = -1;
+	p->s3val = p->strbuf;
+	break;
+#ifdef SQL_C_TYPE_TIME
+    case SQL_C_TYPE_TIME:
+#endif
+    case SQL_C_TIME:
+	if (*s->jdconv) {
+	    p->s3type = SQLITE_FLOAT;
+	    p->s3size = sizeof (double);
+	    p->s3dval = 2451544.5 +
+	       (((TIME_STRUCT *) p->param)->hour * 3600000.0 +
+		((TIME_STRUCT *) p->param)->minute * 60000.0 +
+		((TIME_STRUCT *) p->param)->second * 1000.0) / 86400000.0;
+	    break;
+	}
+	sprintf(p->strbuf, "%02d:%02d:%02d",
+		((TIME_STRUCT *) p->param)->hour,
+		((TIME_STRUCT *) p->param)->minute,
+		((TIME_STRUCT *) p->param)->second);
+	p->s3type = SQLITE_TEXT;
+	p->s3size = -1;
+	p->s3val = p->strbuf;
+	break;
+#ifdef SQL_C_TYPE_TIMESTAMP
+    case SQL_C_TYPE_TIMESTAMP:
+#endif
+    case SQL_C_TIMESTAMP:
+	if (*s->jdconv) {
+	    int a, b, x1, x2, y, m, d;
+
+	    p->s3type = SQLITE_FLOAT;
+	    p->s3size = sizeof (double);
+	    y = ((TIMESTAMP_STRUCT *) p->param)->year;
+	    m = ((TIMESTAMP_STRUCT *) p->param)->month;
+	    d = ((TIMESTAMP_STRUCT *) p->param)->day;
+	    if (m <= 2) {
+		y--;
+		m += 12;
+	    }
+	    a = y / 100;
+	    b = 2 - a + (a / 4);
+	    x1 = 36525 * (y + 4716) / 100;
+	    x2 = 306001 * (m + 1) / 10000;
+	    p->s3dval = x1 + x2 + d + b - 1524.5 +
+	       (((TIMESTAMP_STRUCT *) p->param)->hour * 3600000.0 +
+		((TIMESTAMP_STRUCT *) p->param)->minute * 60000.0 +
+		((TIMESTAMP_STRUCT *) p->param)->second * 1000.0 +
+		((TIMESTAMP_STRUCT *) p->param)->fraction / 1.0E6)
+	       / 86400000.0;
+	    break;
+	}
+	len = (int) ((TIMESTAMP_STRUCT *) p->param)->fraction;
+	len /= 1000000;
+	len = len % 1000;
+	if (len < 0) {
+	    len = 0;
+	}
+	if (p->coldef && p->coldef <= 16) {
+	    sprintf(p->strbuf, "%04d-%02d-%02d %02d:%02d:00.000",
+		    ((TIMESTAMP_STRUCT *) p->param)->year,
+		    ((TIMESTAMP_STRUCT *) p->param)->month,
+		    ((TIMESTAMP_STRUCT *) p->param)->day,
+		    ((TIMESTAMP_STRUCT *) p->param)->hour,
+		    ((TIMESTAMP_STRUCT *) p->param)->minute);
+	} else if (p->coldef && p->coldef <= 19) {
+	    sprintf(p->strbuf, "%04d-%02d-%02d %02d:%02d:%02d.000",
+		    ((TIMESTAMP_STRUCT *) p->param)->year,
+		    ((TIMESTAMP_STRUCT *) p->param)->month,
+		    ((TIMESTAMP_STRUCT *) p->param)->day,
+		    ((TIMESTAMP_STRUCT *) p->param)->hour,
+		    ((TIMESTAMP_STRUCT *) p->param)->minute,
+		    ((TIMESTAMP_STRUCT *) p->param)->second);
+	} else {
+	    sprintf(p->strbuf, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+		    ((TIMESTAMP_STRUCT *) p->param)->year,
+		    ((TIMESTAMP_STRUCT *) p->param)->month,
+		    ((TIMESTAMP_STRUCT *) p->param)->day,
+		    ((TIMESTAMP_STRUCT *) p->param)->hour,
+		    ((TIMESTAMP_STRUCT *) p->param)->minute,
+		    ((TIMESTAMP_STRUCT *) p->param)->second,
+		    len);
+	}
+	p->s3type = SQLITE_TEXT;
+	p->s3size = -1;
+	p->s3val = p->strbuf;
+	break;
+    default:
+    error:
+	setstat(s, -1, "unsupported parameter type",
+		(*s->ov3) ? "07009" : "S1093");
+	return SQL_ERROR;
+    }
+    return SQL_SUCCESS;
+}
+
+/**
+ * Internal bind parameter on HSTMT.
+ * @param stmt statement handle
+ * @param pnum parameter number, starting at 1
+ * @param iotype input/output type of parameter
+ * @param buftype type of host variable
+ * @param ptype
+ * @param coldef
+ * @param scale
+ * @param data pointer to host variable
+ * @param buflen length of host variable
+ * @param len output length pointer
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvbindparam(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT iotype,
+	     SQLSMALLINT buftype, SQLSMALLINT ptype, SQLUINTEGER coldef,
+	     SQLSMALLINT scale,
+	     SQLPOINTER data, SQLINTEGER buflen, SQLLEN *len)
+{
+    STMT *s;
+    BINDPARM *p;
+
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    if (pnum == 0) {
+	setstat(s, -1, "invalid parameter", (*s->ov3) ? "07009" : "S1093");
+	return SQL_ERROR;
+    }
+    if (!data && !len) {
+	setstat(s, -1, "invalid buffer", "HY003");
+	return SQL_ERROR;
+    }
+    --pnum;
+    if (s->bindparms) {
+	if (pnum >= s->nbindparms) {
+	    BINDPARM *newparms;
+
+	    newparms = xrealloc(s->bindparms,
+				(pnum + 1) * sizeof (BINDPARM));
+	    if (!newparms) {
+outofmem:
+		return nomem(s);
+	    }
+	    s->bindparms = newparms;
+	    memset(&s->bindparms[s->nbindparms], 0,
+		   (pnum + 1 - s->nbindparms) * sizeof (BINDPARM));
+	    s->nbindparms = pnum + 1;
+	}
+    } else {
+	int npar = max(10, pnum + 1);
+
+	s->bindparms = xmalloc(npar * sizeof (BINDPARM));
+	if (!s->bindparms) {
+	    goto outofmem;
+	}
+	memset(s->bindparms, 0, npar * sizeof (BINDPARM));
+	s->nbindparms = npar;
+    }
+    switch (buftype) {
+    case SQL_C_STINYINT:
+    case SQL_C_UTINYINT:
+    case SQL_C_TINYINT:
+#ifdef SQL_C_BIT
+    case SQL_C_BIT:
+#endif
+	buflen = sizeof (SQLCHAR);
+	break;
+    case SQL_C_SHORT:
+    case SQL_C_USHORT:
+    case SQL_C_SSHORT:
+	buflen = sizeof (SQLSMALLINT);
+	break;
+    case SQL_C_SLONG:
+    case SQL_C_ULONG:
+    case SQL_C_LONG:
+	buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_C_FLOAT:
+	buflen = sizeof (float);
+	break;
+    case SQL_C_DOUBLE:
+	buflen = sizeof (double);
+	break;
+    case SQL_C_TIMESTAMP:
+#ifdef SQL_C_TYPE_TIMESTAMP
+    case SQL_C_TYPE_TIMESTAMP:
+#endif
+	buflen = sizeof (TIMESTAMP_STRUCT);
+	break;
+    case SQL_C_TIME:
+#ifdef SQL_C_TYPE_TIME
+    case SQL_C_TYPE_TIME:
+#endif
+	buflen = sizeof (TIME_STRUCT);
+	break;
+    case SQL_C_DATE:
+#ifdef SQL_C_TYPE_DATE
+    case SQL_C_TYPE_DATE:
+#endif
+	buflen = sizeof (DATE_STRUCT);
+	break;
+#ifdef SQL_C_UBIGINT
+    case SQL_C_UBIGINT:
+	buflen = sizeof (SQLBIGINT);
+	break;
+#endif
+#ifdef SQL_C_SBIGINT
+    case SQL_C_SBIGINT:
+	buflen = sizeof (SQLBIGINT);
+	break;
+#endif
+#ifdef SQL_C_BIGINT
+    case SQL_C_BIGINT:
+	buflen = sizeof (SQLBIGINT);
+	break;
+#endif
+    }
+    p = &s->bindparms[pnum];
+    p->type = buftype;
+    p->stype = ptype;
+    p->coldef = coldef;
+    p->scale = scale;
+    p->max = buflen;
+    p->inc = buflen;
+    p->lenp = p->lenp0 = len;
+    p->offs = 0;
+    p->len = 0;
+    p->param0 = data;
+    freep(&p->parbuf);
+    p->param = p->param0;
+    p->bound = 1;
+    p->need = 0;
+    return SQL_SUCCESS;
+}
+
+/**
+ * Bind parameter on HSTMT.
+ * @param stmt statement handle
+ * @param pnum parameter number, starting at 1
+ * @param iotype input/output type of parameter
+ * @param buftype type of host variable
+ * @param ptype
+ * @param coldef
+ * @param scale
+ * @param data pointer to host variable
+ * @param buflen length of host variable
+ * @param len output length pointer
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLBindParameter(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT iotype,
+		 SQLSMALLINT buftype, SQLSMALLINT ptype, SQLULEN coldef,
+		 SQLSMALLINT scale,
+		 SQLPOINTER data, SQLLEN buflen, SQLLEN *len)
+{
+    SQLRETURN ret;
+
+    HSTMT_LOCK(stmt);
+    ret = drvbindparam(stmt, pnum, iotype, buftype, ptype, coldef,
+		       scale, data, buflen, len);
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+
+#ifndef HAVE_IODBC
+/**
+ * Bind parameter on HSTMT.
+ * @param stmt statement handle
+ * @param pnum parameter number, starting at 1
+ * @param vtype input/output type of parameter
+ * @param ptype
+ * @param lenprec
+ * @param scale
+ * @param val pointer to host variable
+ * @param lenp output length pointer
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLBindParam(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT vtype,
+	     SQLSMALLINT ptype, SQLULEN lenprec,
+	     SQLSMALLINT scale, SQLPOINTER val,
+	     SQLLEN *lenp)
+{
+    SQLRETURN ret;
+
+    HSTMT_LOCK(stmt);
+    ret = drvbindparam(stmt, pnum, SQL_PARAM_INPUT, vtype, ptype,
+		       lenprec, scale, val, 0, lenp);
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+#endif
+
+/**
+ * Return number of parameters.
+ * @param stmt statement handle
+ * @param nparam output parameter count
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLNumParams(SQLHSTMT stmt, SQLSMALLINT *nparam)
+{
+    STMT *s;
+    SQLSMALLINT dummy;
+
+    HSTMT_LOCK(stmt);
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    if (!nparam) {
+	nparam = &dummy;
+    }
+    *nparam = s->nparams;
+    HSTMT_UNLOCK(stmt);
+    return SQL_SUCCESS;
+}
+
+/**
+ * Setup parameter buffer for deferred parameter.
+ * @param s pointer to STMT
+ * @param p pointer to BINDPARM
+ * @result ODBC error code (success indicated by SQL_NEED_DATA)
+ */
+
+static SQLRETURN
+setupparbuf(STMT *s, BINDPARM *p)
+{
+    if (!p->parbuf) {
+	if (*p->lenp == SQL_DATA_AT_EXEC) {
+	    p->len = p->max;
+	} else {
+	    p->len = SQL_LEN_DATA_AT_EXEC(*p->lenp);
+	}
+	if (p->len < 0 && p->len != SQL_NTS &&
+	    p->len != SQL_NULL_DATA) {
+	    setstat(s, -1, "invalid length", "HY009");
+	    return SQL_ERROR;
+	}
+	if (p->len >= 0) {
+	    p->parbuf = xmalloc(p->len + 2);
+	    if (!p->parbuf) {
+		return nomem(s);
+	    }
+	    p->param = p->parbuf;
+	} else {
+	    p->param = NULL;
+	}
+    }
+    return SQL_NEED_DATA;
+}
+
+/**
+ * Retrieve next parameter for sending data to executing query.
+ * @param stmt statement handle
+ * @param pind pointer to output parameter indicator
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLParamData(SQLHSTMT stmt, SQLPOINTER *pind)
+{
+    STMT *s;
+    int i;
+    SQLPOINTER dummy;
+    SQLRETURN ret;
+    BINDPARM *p;
+
+    HSTMT_LOCK(stmt);
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    if (!pind) {
+	pind = &dummy;
+    }
+#ifdef USE_LOBSTREAM
+    if (s->lobname) {
+	/* INSERT of streamed blob parameter done, see lobinsert() */
+	if (s->bindparms[-1 - s->lobhcol].offs < 0) {
+	    lobend(s, 0);
+	    setstat(s, -1, "blob parameter incomplete",
+		    (*s->ov3) ? "HY000" : "S1000");
+	    ret = SQL_ERROR;
+	} else {
+	    ret = lobend(s, 1);
+	}
+	goto done;
+    }
+#endif
+    if (s->pdcount < s->nparams) {
+	s->pdcount++;
+    }
+    for (i = 0; i < s->pdcount; i++) {
+	p = &s->bindparms[i];
+	if (p->need > 0) {
+	    int type = mapdeftype(p->type, p->stype, -1, s->nowchar[0]);
+
+	    p->need = (type == SQL_C_CHAR || type == SQL_C_WCHAR) ? -1 : 0;
+	}
+    }
+    for (; i < s->nparams; i++) {
+	p = &s->bindparms[i];
+	if (p->need > 0) {
+	    *pind = (SQLPOINTER) p->param0;
+	    s->pdcount = i;
+#ifdef USE_LOBSTREAM
+	    if (lobinsert(s, i, &ret)) {
+		goto done;
+	    }
+#endif
+	    ret = setupparbuf(s, p);
+	    goto done;
+	}
+    }
+    ret = drvexecute(stmt, 0);
+done:
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+
+/**
+ * Return information about parameter.
+ * @param stmt statement handle
+ * @param pnum parameter number, starting at 1
+ * @param dtype output type indicator
+ * @param size output size indicator
+ * @param decdigits output number of digits
+ * @param nullable output NULL allowed indicator
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLDescribeParam(SQLHSTMT stmt, SQLUSMALLINT pnum, SQLSMALLINT *dtype,
+		 SQLULEN *size, SQLSMALLINT *decdigits, SQLSMALLINT *nullable)
+{
+    STMT *s;
+    SQLRETURN ret = SQL_ERROR;
+
+    HSTMT_LOCK(stmt);
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    --pnum;
+    if (pnum >= s->nparams) {
+	setstat(s, -1, "invalid parameter index",
+		(*s->ov3) ? "HY000" : "S1000");
+	goto done;
+    }
+    if (dtype) {
+#ifdef SQL_LONGVARCHAR
+#ifdef WINTERFACE
+	*dtype = s->nowchar[0] ? SQL_LONGVARCHAR : SQL_WLONGVARCHAR;
+#else
+	*dtype = SQL_LONGVARCHAR;
+#endif
+#else
+#ifdef WINTERFACE
+	*dtype = s->nowchar[0] ? SQL_VARCHAR : SQL_WVARCHAR;
+#else
+	*dtype = SQL_VARCHAR;
+#endif
+#endif
+    }
+    if (size) {
+#ifdef SQL_LONGVARCHAR
+	*size = 65536;
+#else
+	*size = 255;
+#endif
+    }
+    if (decdigits) {
+	*decdigits = 0;
+    }
+    if (nullable) {
+	*nullable = SQL_NULLABLE;
+    }
+    ret = SQL_SUCCESS;
+done:
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+
+/**
+ * Set information on parameter.
+ * @param stmt statement handle
+ * @param par parameter number, starting at 1
+ * @param type type of host variable
+ * @param sqltype
+ * @param coldef
+ * @param scale
+ * @param val pointer to host variable
+ * @param nval output length pointer
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLSetParam(SQLHSTMT stmt, SQLUSMALLINT par, SQLSMALLINT type,
+	    SQLSMALLINT sqltype, SQLULEN coldef,
+	    SQLSMALLINT scale, SQLPOINTER val, SQLLEN *nval)
+{
+    SQLRETURN ret;
+
+    HSTMT_LOCK(stmt);
+    ret = drvbindparam(stmt, par, SQL_PARAM_INPUT,
+		       type, sqltype, coldef, scale, val,
+		       SQL_SETPARAM_VALUE_MAX, nval);
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLParamOptions(SQLHSTMT stmt, SQLULEN rows, SQLULEN *rowp)
+{
+    SQLRETURN ret;
+
+    HSTMT_LOCK(stmt);
+    ret = drvunimplstmt(stmt);
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+
+#ifndef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLGetDescField(SQLHDESC handle, SQLSMALLINT recno,
+		SQLSMALLINT fieldid, SQLPOINTER value,
+		SQLINTEGER buflen, SQLINTEGER *strlen)
+{
+    return SQL_ERROR;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLGetDescFieldW(SQLHDESC handle, SQLSMALLINT recno,
+		 SQLSMALLINT fieldid, SQLPOINTER value,
+		 SQLINTEGER buflen, SQLINTEGER *strlen)
+{
+    return SQL_ERROR;
+}
+#endif
+
+#ifndef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLSetDescField(SQLHDESC handle, SQLSMALLINT recno,
+		SQLSMALLINT fieldid, SQLPOINTER value,
+		SQLINTEGER buflen)
+{
+    return SQL_ERROR;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLSetDescFieldW(SQLHDESC handle, SQLSMALLINT recno,
+		 SQLSMALLINT fieldid, SQLPOINTER value,
+		 SQLINTEGER buflen)
+{
+    return SQL_ERROR;
+}
+#endif
+
+#ifndef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLGetDescRec(SQLHDESC handle, SQLSMALLINT recno,
+	      SQLCHAR *name, SQLSMALLINT buflen,
+	      SQLSMALLINT *strlen, SQLSMALLINT *type,
+	      SQLSMALLINT *subtype, SQLLEN *len,
+	      SQLSMALLINT *prec, SQLSMALLINT *scale,
+	      SQLSMALLINT *nullable)
+{
+    return SQL_ERROR;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLGetDescRecW(SQLHDESC handle, SQLSMALLINT recno,
+	       SQLWCHAR *name, SQLSMALLINT buflen,
+	       SQLSMALLINT *strlen, SQLSMALLINT *type,
+	       SQLSMALLINT *subtype, SQLLEN *len,
+	       SQLSMALLINT *prec, SQLSMALLINT *scale,
+	       SQLSMALLINT *nullable)
+{
+    return SQL_ERROR;
+}
+#endif
+
+/**
+ * Function not implemented.
+ */
+
+SQLRETURN SQL_API
+SQLSetDescRec(SQLHDESC handle, SQLSMALLINT recno,
+	      SQLSMALLINT type, SQLSMALLINT subtype,
+	      SQLLEN len, SQLSMALLINT prec,
+	      SQLSMALLINT scale, SQLPOINTER data,
+	      SQLLEN *strlen, SQLLEN *indicator)
+{
+    return SQL_ERROR;
+}
+
+/**
+ * Setup empty result set from constant column specification.
+ * @param stmt statement handle
+ * @param colspec column specification array (default, ODBC2)
+ * @param ncols number of columns (default, ODBC2)
+ * @param colspec3 column specification array (ODBC3)
+ * @param ncols3 number of columns (ODBC3)
+ * @param nret returns number of columns
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+mkresultset(HSTMT stmt, COL *colspec, int ncols, COL *colspec3,
+	    int ncols3, int *nret)
+{
+    STMT *s;
+    DBC *d;
+
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    if (s->dbc == SQL_NULL_HDBC) {
+noconn:
+	return noconn(s);
+    }
+    d = (DBC *) s->dbc;
+    if (!d->sqlite) {
+	goto noconn;
+    }
+    s3stmt_end_if(s);
+    freeresult(s, 0);
+    if (colspec3 && *s->ov3) {
+	s->ncols = ncols3;
+	s->cols = colspec3;
+    } else {
+	s->ncols = ncols;
+	s->cols = colspec;
+    }
+    mkbindcols(s, s->ncols);
+    s->nowchar[1] = 1;
+    s->nrows = 0;
+    s->rowp = s->rowprs = -1;
+    s->isselect = -1;
+    if (nret) {
+	*nret = s->ncols;
+    }
+    return SQL_SUCCESS;
+}
+
+/**
+ * Columns for result set of SQLTablePrivileges().
+ */
+
+static COL tablePrivSpec2[] = {
+    { "SYSTEM", "TABLEPRIV", "TABLE_QUALIFIER", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "TABLE_OWNER", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "TABLE_NAME", SCOL_VARCHAR, 255 },
+    { "SYSTEM", "TABLEPRIV", "GRANTOR", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "GRANTEE", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "PRIVILEGE", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "IS_GRANTABLE", SCOL_VARCHAR, 50 }
+};
+
+static COL tablePrivSpec3[] = {
+    { "SYSTEM", "TABLEPRIV", "TABLE_CAT", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "TABLE_SCHEM", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "TABLE_NAME", SCOL_VARCHAR, 255 },
+    { "SYSTEM", "TABLEPRIV", "GRANTOR", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "GRANTEE", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "PRIVILEGE", SCOL_VARCHAR, 50 },
+    { "SYSTEM", "TABLEPRIV", "IS_GRANTABLE", SCOL_VARCHAR, 50 }
+};
+
+/**
+ * Retrieve privileges on tables and/or views.
+ * @param stmt statement handle
+ * @param cat catalog name/pattern or NULL
+ * @param catLen length of catalog name/pattern or SQL_NTS
+ * @param schema schema name/pattern or NULL
+ * @param schemaLen length of schema name/pattern or SQL_NTS
+ * @param table table name/pattern or NULL
+ * @param tableLen length of table name/pattern or SQL_NTS
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvtableprivileges(SQLHSTMT stmt,
+		   SQLCHAR *cat, SQLSMALLINT catLen,
+		   SQLCHAR *schema, SQLSMALLINT schemaLen,
+		   SQLCHAR *table, SQLSMALLINT tableLen)
+{
+    SQLRETURN ret;
+    STMT *s;
+    DBC *d;
+    int ncols, rc, size, npatt;
+    char *errp = NULL, *sql, tname[512];
+
+    ret = mkresultset(stmt, tablePrivSpec2, array_size(tablePrivSpec2),
+		      tablePrivSpec3, array_size(tablePrivSpec3), NULL);
+    if (ret != SQL_SUCCESS) {
+	return ret;
+    }
+    s = (STMT *) stmt;
+    d = (DBC *) s->dbc;
+    if (cat && (catLen > 0 || catLen == SQL_NTS) && cat[0] == '%') {
+	table = NULL;
+	goto doit;
+    }
+    if (schema && (schemaLen > 0 || schemaLen == SQL_NTS) &&
+	schema[0] == '%') {
+	if ((!cat || catLen == 0 || !cat[0]) &&
+	    (!table || tableLen == 0 || !table[0])) {
+	    table = NULL;
+	    goto doit;
+	}
+    }
+doit:
+    if (!table) {
+	size = 1;
+	tname[0] = '%';
+    } else {
+	if (tableLen == SQL_NTS) {
+	    size = sizeof (tname) - 1;
+	} else {
+	    size = min(sizeof (tname) - 1, tableLen);
+	}
+	strncpy(tname, (char *) table, size);
+    }
+    tname[size] = '\0';
+    npatt = unescpat(tname);
+#if defined(_WIN32) || defined(_WIN64)
+    if (npatt) {
+	sql = sqlite3_mprintf("select %s as 'TABLE_QUALIFIER', "
+			      "%s as 'TABLE_OWNER', "
+			      "tbl_name as 'TABLE_NAME', "
+			      "'' as 'GRANTOR', "
+			      "'' as 'GRANTEE', "
+			      "'SELECT' AS 'PRIVILEGE', "
+			      "NULL as 'IS_GRANTABLE' "
+			      "from sqlite_master where "
+			      "(type = 'table' or type = 'view') "
+			      "and tbl_name like %Q "
+			      "UNION "
+			      "select %s as 'TABLE_QUALIFIER', "
+			      "%s as 'TABLE_OWNER', "
+			      "tbl_name as 'TABLE_NAME', "
+			      "'' as 'GRANTOR', "
+			      "'' as 'GRANTEE', "
+			      "'UPDATE' AS 'PRIVILEGE', "
+			      "NULL as 'IS_GRANTABLE' "
+			      "from sqlite_master where "
+			      "(type = 'table' or type = 'view') "
+			      "and tbl_name like %Q "
+			      "UNION "
+			      "select %s as 'TABLE_QUALIFIER', "
+			      "%s as 'TABLE_OWNER', "
+			      "tbl_name as 'TABLE_NAME', "
+			      "'' as 'GRANTOR', "
+			      "'' as 'GRANTEE', "
+			      "'DELETE' AS 'PRIVILEGE', "
+			      "NULL as 'IS_GRANTABLE' "
+			      "from sqlite_master where "
+			      "(type = 'table' or type = 'view') "
+			      "and tbl_name like %Q "
+			      "UNION "
+			      "select %s as 'TABLE_QUALIFIER', "
+			      "%s as 'TABLE_OWNER', "
+			      "tbl_name as 'TABLE_NAME', "
+			      "'' as 'GRANTOR', "
+			      "'' as 'GRANTEE', "
+			      "'INSERT' AS 'PRIVILEGE', "
+			      "NULL as 'IS_GRANTABLE' "
+			      "from sqlite_master where "
+			      "(type = 'table' or type = 'view') "
+			      "and tbl_name like %Q "
 			      "UNION "
 			      "select %s as 'TABLE_QUALIFIER', "
 			      "%s as 'TABLE_OWNER', "
@@ -6615,8 +10107,8 @@ drvprimarykeys(SQLHSTMT stmt,
 	sqlite3_free(sql);
 	return sret;
     }
-    dbtraceapi(d, "sqlite3_get_table", sql);
-    ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, &errp);
+    sccache_check(d);
+    ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
     sqlite3_free(sql);
     if (ret != SQLITE_OK) {
 	setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -6649,16 +10141,14 @@ drvprimarykeys(SQLHSTMT stmt,
     if (size == 0) {
 	sql = sqlite3_mprintf("PRAGMA index_list(%Q)", tname);
 	if (!sql) {
-	    sqlite3_free_table(rowp);
+	    sccache_free_table(d, rowp);
 	    return nomem(s);
 	}
-	dbtraceapi(d, "sqlite3_get_table", sql);
-	ret = sqlite3_get_table(d->sqlite, sql, &rowp2, &nrows2, &ncols2,
-				&errp);
+	ret = sccache_get_table(d, sql, &rowp2, &nrows2, &ncols2, &errp);
 	sqlite3_free(sql);
 	if (ret != SQLITE_OK) {
-	    sqlite3_free_table(rowp);
-	    sqlite3_free_table(rowp2);
+	    sccache_free_table(d, rowp);
+	    sccache_free_table(d, rowp2);
 	    setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
 		    errp ? errp : "unknown error", ret);
 	    if (errp) {
@@ -6693,22 +10183,21 @@ drvprimarykeys(SQLHSTMT stmt,
 		    sql = sqlite3_mprintf("PRAGMA index_info(%Q)",
 					  rowp2[i * ncols2 + namec2]);
 		    if (sql) {
-			dbtraceapi(d, "sqlite3_get_table", sql);
-			ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+			ret = sccache_get_table(d, sql, &rowpp,
 						&nnrows, &nncols, NULL);
 			sqlite3_free(sql);
 		    }
 		    if (ret == SQLITE_OK) {
 			size += nnrows;
-			sqlite3_free_table(rowpp);
+			sccache_free_table(d, rowpp);
 		    }
 		}
 	    }
 	}
     }
     if (size == 0) {
-	sqlite3_free_table(rowp);
-	sqlite3_free_table(rowp2);
+	sccache_free_table(d, rowp);
+	sccache_free_table(d, rowp2);
 	return SQL_SUCCESS;
     }
     s->nrows = size;
@@ -6716,8 +10205,8 @@ drvprimarykeys(SQLHSTMT stmt,
     s->rows = xmalloc((size + 1) * sizeof (char *));
     if (!s->rows) {
 	s->nrows = 0;
-	sqlite3_free_table(rowp);
-	sqlite3_free_table(rowp2);
+	sccache_free_table(d, rowp);
+	sccache_free_table(d, rowp2);
 	return nomem(s);
     }
     s->rows[0] = (char *) size;
@@ -6764,8 +10253,7 @@ drvprimarykeys(SQLHSTMT stmt,
 		sql = sqlite3_mprintf("PRAGMA index_info(%Q)",
 				      rowp2[i * ncols2 + namec2]);
 		if (sql) {
-		    dbtraceapi(d, "sqlite3_get_table", sql);
-		    ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+		    ret = sccache_get_table(d, sql, &rowpp,
 					    &nnrows, &nncols, NULL);
 		    sqlite3_free(sql);
 		}
@@ -6808,12 +10296,12 @@ drvprimarykeys(SQLHSTMT stmt,
 		    }
 		}
 		offs += nnrows * s->ncols;
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 	    }
 	}
     }
-    sqlite3_free_table(rowp);
-    sqlite3_free_table(rowp2);
+    sccache_free_table(d, rowp);
+    sccache_free_table(d, rowp2);
     return SQL_SUCCESS;
 }
 
@@ -7034,8 +10522,8 @@ drvspecialcolumns(SQLHSTMT stmt, SQLUSMALLINT id,
 	sqlite3_free(sql);
 	return sret;
     }
-    dbtraceapi(d, "sqlite3_get_table", sql);
-    ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, &errp);
+    sccache_check(d);
+    ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
     sqlite3_free(sql);
     if (ret != SQLITE_OK) {
 doerr:
@@ -7059,12 +10547,10 @@ doerr:
     if (!sql) {
 	return nomem(s);
     }
-    dbtraceapi(d, "sqlite3_get_table", sql);
-    ret = sqlite3_get_table(d->sqlite, sql, &rowppp, &nnnrows, &nnncols,
-			    &errp);
+    ret = sccache_get_table(d, sql, &rowppp, &nnnrows, &nnncols, &errp);
     sqlite3_free(sql);
     if (ret != SQLITE_OK) {
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
 	goto doerr;
     }
     if (errp) {
@@ -7088,14 +10574,13 @@ doerr:
 	    sql = sqlite3_mprintf("PRAGMA index_info(%Q)",
 				  rowp[i * ncols + namec]);
 	    if (sql) {
-		dbtraceapi(d, "sqlite3_get_table", sql);
-		ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+		ret = sccache_get_table(d, sql, &rowpp,
 					&nnrows, &nncols, NULL);
 		sqlite3_free(sql);
 	    }
 	    if (ret == SQLITE_OK) {
 		size += nnrows;
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 	    }
 	}
     }
@@ -7109,8 +10594,8 @@ nodata_but_rowid:
     s->rows = xmalloc((size + 1) * sizeof (char *));
     if (!s->rows) {
 	s->nrows = 0;
-	sqlite3_free_table(rowp);
-	sqlite3_free_table(rowppp);
+	sccache_free_table(d, rowp);
+	sccache_free_table(d, rowppp);
 	return nomem(s);
     }
     s->rows[0] = (char *) size;
@@ -7133,8 +10618,7 @@ nodata_but_rowid:
 	    sql = sqlite3_mprintf("PRAGMA index_info(%Q)",
 				  rowp[i * ncols + namec]);
 	    if (sql) {
-		dbtraceapi(d, "sqlite3_get_table", sql);
-		ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+		ret = sccache_get_table(d, sql, &rowpp,
 					&nnrows, &nncols, NULL);
 		sqlite3_free(sql);
 	    }
@@ -7205,7 +10689,7 @@ nodata_but_rowid:
 		}
 	    }
 	    offs += nnrows;
-	    sqlite3_free_table(rowpp);
+	    sccache_free_table(d, rowpp);
 	}
     }
     if (nullable == SQL_NO_NULLS) {
@@ -7230,8 +10714,8 @@ nodata_but_rowid:
 	}
     }
 mkrowid:
-    sqlite3_free_table(rowp);
-    sqlite3_free_table(rowppp);
+    sccache_free_table(d, rowp);
+    sccache_free_table(d, rowppp);
     if (s->nrows == 0) {
 	s->rows[s->ncols + 0] = xstrdup(stringify(SQL_SCOPE_SESSION));
 	s->rows[s->ncols + 1] = xstrdup("_ROWID_");
@@ -7467,6 +10951,7 @@ drvforeignkeys(SQLHSTMT stmt,
 	return sret;
     }
     d = (DBC *) s->dbc;
+    sccache_check(d);
     if ((!PKtable || PKtable[0] == '\0' || PKtable[0] == '%') &&
 	(!FKtable || FKtable[0] == '\0' || FKtable[0] == '%')) {
 	setstat(s, -1, "need table name", (*s->ov3) ? "HY000" : "S1000");
@@ -7499,9 +10984,7 @@ drvforeignkeys(SQLHSTMT stmt,
 	ret = SQLITE_ERROR;
 	sql = sqlite3_mprintf("PRAGMA foreign_key_list(%Q)", fname);
 	if (sql) {
-	    dbtraceapi(d, "sqlite3_get_table", sql);
-	    ret = sqlite3_get_table(d->sqlite, sql, &rowp,
-				    &nrows, &ncols, &errp);
+	    ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
 	    sqlite3_free(sql);
 	}
 	if (ret != SQLITE_OK) {
@@ -7519,7 +11002,7 @@ drvforeignkeys(SQLHSTMT stmt,
 	}
 	if (ncols * nrows <= 0) {
 nodata:
-	    sqlite3_free_table(rowp);
+	    sccache_free_table(d, rowp);
 	    return SQL_SUCCESS;
 	}
 	size = 0;
@@ -7534,14 +11017,10 @@ nodata:
 	}
 	plen = strlen(pname);
 	for (i = 1; i <= nrows; i++) {
-	    char *ptab = unquote(rowp[i * ncols + namec]);
-
-	    if (plen && ptab) {
-		int len = strlen(ptab);
+	    char *ptab = rowp[i * ncols + namec];
 
-		if (plen != len || strncasecmp(pname, ptab, plen) != 0) {
-		    continue;
-		}
+	    if (plen && ptab && !unquotematch(pname, plen, ptab)) {
+		continue;
 	    }
 	    size++;
 	}
@@ -7553,6 +11032,7 @@ nodata:
 	s->rows = xmalloc((size + 1) * sizeof (char *));
 	if (!s->rows) {
 	    s->nrows = 0;
+	    sccache_free_table(d, rowp);
 	    return nomem(s);
 	}
 	s->rows[0] = (char *) size;
@@ -7565,12 +11045,8 @@ nodata:
 	    char *ptab = rowp[i * ncols + namec];
 	    char buf[32];
 
-	    if (plen && ptab) {
-		int len = strlen(ptab);
-
-		if (plen != len || strncasecmp(pname, ptab, plen) != 0) {
-		    continue;
-		}
+	    if (plen && ptab && !unquotematch(pname, plen, ptab)) {
+		continue;
 	    }
 #if defined(_WIN32) || defined(_WIN64)
 	    s->rows[roffs + 0] = xstrdup(d->xcelqrx ? "main" : "");
@@ -7579,7 +11055,7 @@ nodata:
 	    s->rows[roffs + 0] = xstrdup("");
 	    s->rows[roffs + 1] = xstrdup("");
 #endif
-	    s->rows[roffs + 2] = xstrdup(ptab);
+	    s->rows[roffs + 2] = unquote(xstrdup(ptab));
 	    s->rows[roffs + 3] = xstrdup(rowp[i * ncols + toc]);
 	    s->rows[roffs + 4] = xstrdup("");
 	    s->rows[roffs + 5] = xstrdup("");
@@ -7623,14 +11099,13 @@ nodata:
 	    s->rows[roffs + 13] = xstrdup(stringify(SQL_NOT_DEFERRABLE));
 	    offs++;
 	}
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
     } else {
 	int nnrows, nncols, plen = strlen(pname);
 	char **rowpp;
 
 	sql = "select name from sqlite_master where type='table'";
-	dbtraceapi(d, "sqlite3_get_table", sql);
-	ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, &errp);
+	ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
 	if (ret != SQLITE_OK) {
 	    setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
 		    errp ? errp : "unknown error", ret);
@@ -7658,13 +11133,12 @@ nodata:
 	    ret = SQLITE_ERROR;
 	    sql = sqlite3_mprintf("PRAGMA foreign_key_list(%Q)", rowp[i]);
 	    if (sql) {
-		dbtraceapi(d, "sqlite3_get_table", sql);
-		ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
-				      &nnrows, &nncols, NULL);
+		ret = sccache_get_table(d, sql, &rowpp,
+					&nnrows, &nncols, NULL);
 		sqlite3_free(sql);
 	    }
 	    if (ret != SQLITE_OK || nncols * nnrows <= 0) {
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 		continue;
 	    }
 	    namec = findcol(rowpp, nncols, "table");
@@ -7672,22 +11146,18 @@ nodata:
 	    fromc = findcol(rowpp, nncols, "from");
 	    toc = findcol(rowpp, nncols, "to");
 	    if (namec < 0 || seqc < 0 || fromc < 0 || toc < 0) {
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 		continue;
 	    }
 	    for (k = 1; k <= nnrows; k++) {
-		char *ptab = unquote(rowpp[k * nncols + namec]);
+		char *ptab = rowpp[k * nncols + namec];
 
-		if (plen && ptab) {
-		    int len = strlen(ptab);
-
-		    if (len != plen || strncasecmp(pname, ptab, plen) != 0) {
-			continue;
-		    }
+		if (plen && ptab && !unquotematch(pname, plen, ptab)) {
+		    continue;
 		}
 		size++;
 	    }
-	    sqlite3_free_table(rowpp);
+	    sccache_free_table(d, rowpp);
 	}
 	if (size == 0) {
 	    goto nodata;
@@ -7697,6 +11167,7 @@ nodata:
 	s->rows = xmalloc((size + 1) * sizeof (char *));
 	if (!s->rows) {
 	    s->nrows = 0;
+	    sccache_free_table(d, rowp);
 	    return nomem(s);
 	}
 	s->rows[0] = (char *) size;
@@ -7714,13 +11185,12 @@ nodata:
 	    ret = SQLITE_ERROR;
 	    sql = sqlite3_mprintf("PRAGMA foreign_key_list(%Q)", rowp[i]);
 	    if (sql) {
-		dbtraceapi(d, "sqlite3_get_table", sql);
-		ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+		ret = sccache_get_table(d, sql, &rowpp,
 					&nnrows, &nncols, NULL);
 		sqlite3_free(sql);
 	    }
 	    if (ret != SQLITE_OK || nncols * nnrows <= 0) {
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 		continue;
 	    }
 	    namec = findcol(rowpp, nncols, "table");
@@ -7730,20 +11200,16 @@ nodata:
 	    onu = findcol(rowpp, nncols, "on_update");
 	    ond = findcol(rowpp, nncols, "on_delete");
 	    if (namec < 0 || seqc < 0 || fromc < 0 || toc < 0) {
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 		continue;
 	    }
 	    for (k = 1; k <= nnrows; k++) {
 		int pos = 0, roffs = (offs + 1) * s->ncols;
-		char *ptab = unquote(rowpp[k * nncols + namec]);
+		char *ptab = rowpp[k * nncols + namec];
 		char buf[32];
 
-		if (plen && ptab) {
-		    int len = strlen(ptab);
-
-		    if (len != plen || strncasecmp(pname, ptab, plen) != 0) {
-			continue;
-		    }
+		if (plen && ptab && !unquotematch(pname, plen, ptab)) {
+		    continue;
 		}
 #if defined(_WIN32) || defined(_WIN64)
 		s->rows[roffs + 0] = xstrdup(d->xcelqrx ? "main" : "");
@@ -7752,7 +11218,7 @@ nodata:
 		s->rows[roffs + 0] = xstrdup("");
 		s->rows[roffs + 1] = xstrdup("");
 #endif
-		s->rows[roffs + 2] = xstrdup(ptab);
+		s->rows[roffs + 2] = unquote(xstrdup(ptab));
 		s->rows[roffs + 3] = xstrdup(rowpp[k * nncols + toc]);
 		s->rows[roffs + 4] = xstrdup("");
 		s->rows[roffs + 5] = xstrdup("");
@@ -7806,9 +11272,9 @@ nodata:
 		s->rows[roffs + 13] = xstrdup(stringify(SQL_NOT_DEFERRABLE));
 		offs++;
 	    }
-	    sqlite3_free_table(rowpp);
+	    sccache_free_table(d, rowpp);
 	}
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
     }
     return SQL_SUCCESS;
 }
@@ -8051,6 +11517,7 @@ begin_again:
 	    ret = SQL_ERROR;
 	} else {
 	    d->intrans = 1;
+	    d->stats.begins++;
 	}
 	if (errp) {
 	    sqlite3_free(errp);
@@ -8073,6 +11540,9 @@ endtran(DBC *d, SQLSMALLINT comptype, int force)
 {
     int ret, busy_count = 0;
     char *sql, *errp = NULL;
+#ifdef USE_LOBSTREAM
+    STMT *s;
+#endif
 
     if (!d->sqlite) {
 	setstatd(d, -1, "not connected", (*d->ov3) ? "HY000" : "S1000");
@@ -8081,6 +11551,12 @@ endtran(DBC *d, SQLSMALLINT comptype, int force)
     if ((!force && d->autocommit) || !d->intrans) {
 	return SQL_SUCCESS;
     }
+#ifdef USE_LOBSTREAM
+    for (s = d->stmt; s; s = s->next) {
+	lobend(s, 0);
+    }
+#endif
+    s3stmt_spillall(d);
     switch (comptype) {
     case SQL_COMMIT:
 	sql = "COMMIT TRANSACTION";
@@ -8113,6 +11589,11 @@ endtran(DBC *d, SQLSMALLINT comptype, int force)
 	    errp = NULL;
 	}
 	d->intrans = 0;
+	if (comptype == SQL_COMMIT) {
+	    d->stats.commits++;
+	} else {
+	    d->stats.rollbacks++;
+	}
 	return SQL_SUCCESS;
     }
     setstatd(d, -1, "invalid completion type", (*d->ov3) ? "HY000" : "S1000");
@@ -8157,6 +11638,11 @@ drvendtran(SQLSMALLINT type, SQLHANDLE handle, SQLSMALLINT comptype)
 	    return SQL_INVALID_HANDLE;
 	}
 	EnterCriticalSection(&env->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	if (((ENV *) handle)->magic != ENV_MAGIC) {
+	    return SQL_INVALID_HANDLE;
+	}
+	pthread_mutex_lock(&((ENV *) handle)->mutex);
 #endif
 	dbc = ((ENV *) handle)->dbcs;
 	while (dbc) {
@@ -8170,6 +11656,8 @@ drvendtran(SQLSMALLINT type, SQLHANDLE handle, SQLSMALLINT comptype)
 	}
 #if defined(_WIN32) || defined(_WIN64)
 	LeaveCriticalSection(&env->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	pthread_mutex_unlock(&((ENV *) handle)->mutex);
 #endif
 	return fail ? SQL_ERROR : SQL_SUCCESS;
     }
@@ -8528,6 +12016,8 @@ SQLGetEnvAttr(SQLHENV env, SQLINTEGER attr, SQLPOINTER val,
     }
 #if defined(_WIN32) || defined(_WIN64)
     EnterCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_lock(&e->mutex);
 #endif
     switch (attr) {
     case SQL_ATTR_CONNECTION_POOLING:
@@ -8568,6 +12058,8 @@ SQLGetEnvAttr(SQLHENV env, SQLINTEGER attr, SQLPOINTER val,
     }
 #if defined(_WIN32) || defined(_WIN64)
     LeaveCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_unlock(&e->mutex);
 #endif
     return ret;
 }
@@ -8596,6 +12088,8 @@ SQLSetEnvAttr(SQLHENV env, SQLINTEGER attr, SQLPOINTER val, SQLINTEGER len)
     }
 #if defined(_WIN32) || defined(_WIN64)
     EnterCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_lock(&e->mutex);
 #endif
     switch (attr) {
     case SQL_ATTR_CONNECTION_POOLING:
@@ -8630,6 +12124,8 @@ SQLSetEnvAttr(SQLHENV env, SQLINTEGER attr, SQLPOINTER val, SQLINTEGER len)
     }
 #if defined(_WIN32) || defined(_WIN64)
     LeaveCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_unlock(&e->mutex);
 #endif
     return ret;
 }
@@ -9264,7 +12760,19 @@ drvgetstmtattr(SQLHSTMT stmt, SQLINTEGER attr, SQLPOINTER val,
 	*((SQLULEN *) uval) = SQL_FALSE;
 	*buflen = sizeof (SQLULEN);
 	return SQL_SUCCESS;
-#endif
+#endif
+    case SQL_ATTR_SQLITE_ARENA_RESERVED:
+	*((SQLULEN *) uval) = s->arena.reserved + s->dynarena.reserved;
+	*buflen = sizeof (SQLULEN);
+	return SQL_SUCCESS;
+    case SQL_ATTR_SQLITE_ARENA_INUSE:
+	*((SQLULEN *) uval) = s->arena.inuse + s->dynarena.inuse;
+	*buflen = sizeof (SQLULEN);
+	return SQL_SUCCESS;
+    case SQL_ATTR_SQLITE_ARENA_HIGHWATER:
+	*((SQLULEN *) uval) = s->arena.hiwater + s->dynarena.hiwater;
+	*buflen = sizeof (SQLULEN);
+	return SQL_SUCCESS;
     }
     return drvunimplstmt(stmt);
 }
@@ -10128,6 +13636,59 @@ setposibind(STMT *s, sqlite3_stmt *stmt, int i, int si, int rsi)
 	return SQL_ERROR;
     }
     pos += rsi;
+    if (s->cells) {
+	CELL *c = &s->cells[i * s->cellstride + pos];
+
+	switch (c->type) {
+	case SQLITE_INTEGER:
+	    sqlite3_bind_int64(stmt, si, c->v.i);
+	    if (d->trace) {
+		char buf[64];
+
+		fprintf(d->trace, "-- parameter %d: %s\n", si,
+			cell2str(c, buf, sizeof (buf)));
+		fflush(d->trace);
+	    }
+	    break;
+	case SQLITE_FLOAT:
+	    sqlite3_bind_double(stmt, si, c->v.f);
+	    if (d->trace) {
+		char buf[64];
+
+		fprintf(d->trace, "-- parameter %d: %s\n", si,
+			cell2str(c, buf, sizeof (buf)));
+		fflush(d->trace);
+	    }
+	    break;
+	case SQLITE_NULL:
+	    sqlite3_bind_null(stmt, si);
+	    if (d->trace) {
+		fprintf(d->trace, "-- parameter %d: NULL\n", si);
+		fflush(d->trace);
+	    }
+	    break;
+	case SQLITE_BLOB:
+#ifdef USE_LOBSTREAM
+	    if (LOBCELL(c) && lobload(s, i, pos) != SQL_SUCCESS) {
+		return SQL_ERROR;
+	    }
+#endif
+	    sqlite3_bind_blob(stmt, si, c->v.p, c->len, SQLITE_STATIC);
+	    if (d->trace) {
+		fprintf(d->trace, "-- parameter %d: [BLOB]\n", si);
+		fflush(d->trace);
+	    }
+	    break;
+	default:
+	    sqlite3_bind_text(stmt, si, c->v.p, c->len, SQLITE_STATIC);
+	    if (d->trace) {
+		fprintf(d->trace, "-- parameter %d: '%s'\n", si, c->v.p);
+		fflush(d->trace);
+	    }
+	    break;
+	}
+	return SQL_SUCCESS;
+    }
     data = s->rows + s->ncols + (pos * s->ncols) + i;
     if (*data == NULL) {
 	sqlite3_bind_null(stmt, si);
@@ -10239,6 +13800,7 @@ drvsetpos(SQLHSTMT stmt, SQLSETPOSIROW row, SQLUSMALLINT op, SQLUSMALLINT lock)
 		(*s->ov3) ? "HY000" : "S1000");
 	return SQL_ERROR;
     }
+    getdynmeta(s, -1);
     if (op == SQL_ADD) {
 	if (s->one_tbl <= 0) {
 	    setstat(s, -1, "incompatible rowset",
@@ -10278,6 +13840,7 @@ drvsetpos(SQLHSTMT stmt, SQLSETPOSIROW row, SQLUSMALLINT op, SQLUSMALLINT lock)
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    rc = sqlite3_prepare_v2(d->sqlite, dsval(sql), -1,
 				    &s3stmt, &endp);
@@ -10313,6 +13876,7 @@ istmterr:
 	    }
 	    k++;
 	}
+	d->stats.steps++;
 	rc = sqlite3_step(s3stmt);
 	if (rc != SQLITE_DONE) {
 	    goto istmterr;
@@ -10353,7 +13917,8 @@ istmterr:
     }
     if (op == SQL_POSITION) {
 	rowp = s->rowp + row - 1;
-	if (!s->rows || row == 0 || rowp < -1 || rowp >= s->nrows) {
+	if ((!s->rows && !s->cells) ||
+	    row == 0 || rowp < -1 || rowp >= s->nrows) {
 rowoor:
 	    setstat(s, -1, "row out of range", (*s->ov3) ? "HY107" : "S1107");
 	    return SQL_ERROR;
@@ -10401,6 +13966,7 @@ rowoor:
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    rc = sqlite3_prepare_v2(d->sqlite, dsval(sql), -1,
 				    &s3stmt, &endp);
@@ -10439,6 +14005,7 @@ dstmterr:
 	    }
 	    k++;
 	}
+	d->stats.steps++;
 	rc = sqlite3_step(s3stmt);
 	if (rc != SQLITE_DONE) {
 	    goto dstmterr;
@@ -10489,6 +14056,7 @@ dstmterr:
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    rc = sqlite3_prepare_v2(d->sqlite, dsval(sql), -1,
 				    &s3stmt, &endp);
@@ -10536,6 +14104,7 @@ ustmterr:
 	    }
 	    k++;
 	}
+	d->stats.steps++;
 	rc = sqlite3_step(s3stmt);
 	if (rc != SQLITE_DONE) {
 	    goto ustmterr;
@@ -10597,6 +14166,7 @@ drvbulkoperations(SQLHSTMT stmt, SQLSMALLINT op)
 		(*s->ov3) ? "HY000" : "S1000");
 	return SQL_ERROR;
     }
+    getdynmeta(s, -1);
     if (op == SQL_ADD) {
 	if (s->one_tbl <= 0) {
 	    setstat(s, -1, "incompatible rowset",
@@ -10633,6 +14203,7 @@ drvbulkoperations(SQLHSTMT stmt, SQLSMALLINT op)
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    rc = sqlite3_prepare_v2(d->sqlite, dsval(sql), -1,
 				    &s3stmt, &endp);
@@ -10675,6 +14246,7 @@ istmterr:
 		}
 		k++;
 	    }
+	    d->stats.steps++;
 	    rc = sqlite3_step(s3stmt);
 	    if (rc != SQLITE_DONE) {
 		setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -10756,6 +14328,7 @@ istmterr:
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    rc = sqlite3_prepare_v2(d->sqlite, dsval(sql), -1,
 				    &s3stmt, &endp);
@@ -10823,6 +14396,7 @@ istmterr:
 			rowid);
 		fflush(d->trace);
 	    }
+	    d->stats.steps++;
 	    rc = sqlite3_step(s3stmt);
 	    if (rc != SQLITE_DONE) {
 		setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -10890,6 +14464,7 @@ istmterr:
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    rc = sqlite3_prepare_v2(d->sqlite, dsval(sql), -1,
 				    &s3stmt, &endp);
@@ -10973,6 +14548,7 @@ ustmterr:
 			k, rowid);
 		fflush(d->trace);
 	    }
+	    d->stats.steps++;
 	    rc = sqlite3_step(s3stmt);
 	    if (rc != SQLITE_DONE) {
 		setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -11456,648 +15032,1043 @@ drvgetinfo(SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER val, SQLSMALLINT valMax,
 	*valLen = sizeof (SQLUINTEGER);
 	break;
 #endif
-    case SQL_MAX_STATEMENT_LEN:
-	*((SQLUINTEGER *) val) = 16384;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_QUALIFIER_LOCATION:
-	*((SQLSMALLINT *) val) = SQL_QL_START;
-	*valLen = sizeof (SQLSMALLINT);
-	break;
-    case SQL_GETDATA_EXTENSIONS:
-	*((SQLUINTEGER *) val) =
-	    SQL_GD_ANY_COLUMN | SQL_GD_ANY_ORDER | SQL_GD_BOUND;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_STATIC_SENSITIVITY:
-	*((SQLUINTEGER *) val) = 0;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_FILE_USAGE:
+    case SQL_MAX_STATEMENT_LEN:
+	*((SQLUINTEGER *) val) = 16384;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_QUALIFIER_LOCATION:
+	*((SQLSMALLINT *) val) = SQL_QL_START;
+	*valLen = sizeof (SQLSMALLINT);
+	break;
+    case SQL_GETDATA_EXTENSIONS:
+	*((SQLUINTEGER *) val) =
+	    SQL_GD_ANY_COLUMN | SQL_GD_ANY_ORDER | SQL_GD_BOUND;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_STATIC_SENSITIVITY:
+	*((SQLUINTEGER *) val) = 0;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_FILE_USAGE:
+#if defined(_WIN32) || defined(_WIN64)
+	*((SQLSMALLINT *) val) =
+	    d->xcelqrx ? SQL_FILE_CATALOG : SQL_FILE_NOT_SUPPORTED;
+#else
+	*((SQLSMALLINT *) val) = SQL_FILE_NOT_SUPPORTED;
+#endif
+	*valLen = sizeof (SQLSMALLINT);
+	break;
+    case SQL_GROUP_BY:
+	*((SQLSMALLINT *) val) = SQL_GB_GROUP_BY_EQUALS_SELECT;
+	*valLen = sizeof (SQLSMALLINT);
+	break;
+    case SQL_KEYWORDS:
+	strmak(val, "CREATE,SELECT,DROP,DELETE,UPDATE,INSERT,"
+	       "INTO,VALUES,TABLE,INDEX,FROM,SET,WHERE,AND,CURRENT,OF",
+	       valMax, valLen);
+	break;
+    case SQL_SPECIAL_CHARACTERS:
+#ifdef SQL_COLLATION_SEQ
+    case SQL_COLLATION_SEQ:
+#endif
+	strmak(val, "", valMax, valLen);
+	break;
+    case SQL_BATCH_SUPPORT:
+    case SQL_BATCH_ROW_COUNT:
+    case SQL_PARAM_ARRAY_ROW_COUNTS:
+	*((SQLUINTEGER *) val) = 0;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_FORWARD_ONLY_CURSOR_ATTRIBUTES1:
+	*((SQLUINTEGER *) val) = SQL_CA1_NEXT | SQL_CA1_BOOKMARK;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_STATIC_CURSOR_ATTRIBUTES1:
+	*((SQLUINTEGER *) val) = SQL_CA1_NEXT | SQL_CA1_ABSOLUTE |
+	    SQL_CA1_RELATIVE | SQL_CA1_BOOKMARK | SQL_CA1_POS_POSITION |
+	    SQL_CA1_POS_DELETE | SQL_CA1_POS_UPDATE | SQL_CA1_POS_REFRESH |
+	    SQL_CA1_LOCK_NO_CHANGE | SQL_CA1_BULK_ADD |
+	    SQL_CA1_BULK_UPDATE_BY_BOOKMARK | SQL_CA1_BULK_DELETE_BY_BOOKMARK;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_FORWARD_ONLY_CURSOR_ATTRIBUTES2:
+    case SQL_STATIC_CURSOR_ATTRIBUTES2:
+	*((SQLUINTEGER *) val) = SQL_CA2_READ_ONLY_CONCURRENCY |
+	    SQL_CA2_LOCK_CONCURRENCY;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_KEYSET_CURSOR_ATTRIBUTES1:
+    case SQL_KEYSET_CURSOR_ATTRIBUTES2:
+    case SQL_DYNAMIC_CURSOR_ATTRIBUTES1:
+    case SQL_DYNAMIC_CURSOR_ATTRIBUTES2:
+	*((SQLUINTEGER *) val) = 0;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_ODBC_INTERFACE_CONFORMANCE:
+	*((SQLUINTEGER *) val) = SQL_OIC_CORE;
+	*valLen = sizeof (SQLUINTEGER);
+	break;
+    default:
+	setstatd(d, -1, "unsupported info option %d",
+		 (*d->ov3) ? "HYC00" : "S1C00", type);
+	return SQL_ERROR;
+    }
+    return SQL_SUCCESS;
+}
+
+#if (defined(HAVE_UNIXODBC) && (HAVE_UNIXODBC)) || !defined(WINTERFACE)
+/**
+ * Return information about what this ODBC driver supports.
+ * @param dbc database connection handle
+ * @param type type of information to be retrieved
+ * @param val output buffer
+ * @param valMax length of output buffer
+ * @param valLen output length
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLGetInfo(SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER val, SQLSMALLINT valMax,
+	   SQLSMALLINT *valLen)
+{
+    SQLRETURN ret;
+
+    HDBC_LOCK(dbc);
+    ret = drvgetinfo(dbc, type, val, valMax, valLen);
+    HDBC_UNLOCK(dbc);
+    return ret;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Return information about what this ODBC driver supports.
+ * @param dbc database connection handle
+ * @param type type of information to be retrieved
+ * @param val output buffer
+ * @param valMax length of output buffer
+ * @param valLen output length
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLGetInfoW(SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER val, SQLSMALLINT valMax,
+	    SQLSMALLINT *valLen)
+{
+    SQLRETURN ret;
+    SQLSMALLINT len = 0;
+
+    HDBC_LOCK(dbc);
+    ret = drvgetinfo(dbc, type, val, valMax, &len);
+    HDBC_UNLOCK(dbc);
+    if (ret == SQL_SUCCESS) {
+	SQLWCHAR *v = NULL;
+
+	switch (type) {
+	case SQL_USER_NAME:
+	case SQL_DRIVER_ODBC_VER:
+	case SQL_DATA_SOURCE_NAME:
+	case SQL_DRIVER_NAME:
+	case SQL_DRIVER_VER:
+	case SQL_ODBC_VER:
+	case SQL_SERVER_NAME:
+	case SQL_DATABASE_NAME:
+	case SQL_SEARCH_PATTERN_ESCAPE:
+	case SQL_DBMS_NAME:
+	case SQL_DBMS_VER:
+	case SQL_NEED_LONG_DATA_LEN:
+	case SQL_ROW_UPDATES:
+	case SQL_ACCESSIBLE_PROCEDURES:
+	case SQL_PROCEDURES:
+	case SQL_EXPRESSIONS_IN_ORDERBY:
+	case SQL_ODBC_SQL_OPT_IEF:
+	case SQL_LIKE_ESCAPE_CLAUSE:
+	case SQL_ORDER_BY_COLUMNS_IN_SELECT:
+	case SQL_OUTER_JOINS:
+	case SQL_COLUMN_ALIAS:
+	case SQL_ACCESSIBLE_TABLES:
+	case SQL_MULT_RESULT_SETS:
+	case SQL_MULTIPLE_ACTIVE_TXN:
+	case SQL_MAX_ROW_SIZE_INCLUDES_LONG:
+	case SQL_DATA_SOURCE_READ_ONLY:
+#ifdef SQL_DESCRIBE_PARAMETER
+	case SQL_DESCRIBE_PARAMETER:
+#endif
+	case SQL_IDENTIFIER_QUOTE_CHAR:
+	case SQL_OWNER_TERM:
+	case SQL_PROCEDURE_TERM:
+	case SQL_QUALIFIER_NAME_SEPARATOR:
+	case SQL_QUALIFIER_TERM:
+	case SQL_TABLE_TERM:
+	case SQL_KEYWORDS:
+	case SQL_SPECIAL_CHARACTERS:
+#ifdef SQL_CATALOG_NAME
+	case SQL_CATALOG_NAME:
+#endif
+#ifdef SQL_COLLATION_SEQ
+	case SQL_COLLATION_SEQ:
+#endif
+	    if (val) {
+		if (len > 0) {
+		    v = uc_from_utf((SQLCHAR *) val, len);
+		    if (v) {
+			int vmax = valMax / sizeof (SQLWCHAR);
+
+			uc_strncpy(val, v, vmax);
+			if (len < vmax) {
+			    len = min(vmax, uc_strlen(v));
+			    v[len] = 0;
+			} else {
+			    len = vmax;
+			}
+			uc_free(v);
+			len *= sizeof (SQLWCHAR);
+		    } else {
+			len = 0;
+		    }
+		}
+		if (len <= 0) {
+		    len = 0;
+		    if (valMax >= sizeof (SQLWCHAR)) {
+			*((SQLWCHAR *)val) = 0;
+		    }
+		}
+	    } else {
+		len *= sizeof (SQLWCHAR);
+	    }
+	    break;
+	}
+	if (valLen) {
+	    *valLen = len;
+	}
+    }
+    return ret;
+}
+#endif
+
+/**
+ * Return information about supported ODBC API functions.
+ * @param dbc database connection handle
+ * @param func function code to be retrieved
+ * @param flags output indicator
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLGetFunctions(SQLHDBC dbc, SQLUSMALLINT func,
+		SQLUSMALLINT *flags)
+{
+    int i;
+    SQLUSMALLINT exists[100];
+
+    if (dbc == SQL_NULL_HDBC) {
+	return SQL_INVALID_HANDLE;
+    }
+    for (i = 0; i < array_size(exists); i++) {
+	exists[i] = SQL_FALSE;
+    }
+    exists[SQL_API_SQLALLOCCONNECT] = SQL_TRUE;
+    exists[SQL_API_SQLFETCH] = SQL_TRUE;
+    exists[SQL_API_SQLALLOCENV] = SQL_TRUE;
+    exists[SQL_API_SQLFREECONNECT] = SQL_TRUE;
+    exists[SQL_API_SQLALLOCSTMT] = SQL_TRUE;
+    exists[SQL_API_SQLFREEENV] = SQL_TRUE;
+    exists[SQL_API_SQLBINDCOL] = SQL_TRUE;
+    exists[SQL_API_SQLFREESTMT] = SQL_TRUE;
+    exists[SQL_API_SQLCANCEL] = SQL_TRUE;
+    exists[SQL_API_SQLGETCURSORNAME] = SQL_TRUE;
+    exists[SQL_API_SQLCOLATTRIBUTES] = SQL_TRUE;
+    exists[SQL_API_SQLNUMRESULTCOLS] = SQL_TRUE;
+    exists[SQL_API_SQLCONNECT] = SQL_TRUE;
+    exists[SQL_API_SQLPREPARE] = SQL_TRUE;
+    exists[SQL_API_SQLDESCRIBECOL] = SQL_TRUE;
+    exists[SQL_API_SQLROWCOUNT] = SQL_TRUE;
+    exists[SQL_API_SQLDISCONNECT] = SQL_TRUE;
+    exists[SQL_API_SQLSETCURSORNAME] = SQL_FALSE;
+    exists[SQL_API_SQLERROR] = SQL_TRUE;
+    exists[SQL_API_SQLSETPARAM] = SQL_TRUE;
+    exists[SQL_API_SQLEXECDIRECT] = SQL_TRUE;
+    exists[SQL_API_SQLTRANSACT] = SQL_TRUE;
+    exists[SQL_API_SQLBULKOPERATIONS] = SQL_TRUE;
+    exists[SQL_API_SQLEXECUTE] = SQL_TRUE;
+    exists[SQL_API_SQLBINDPARAMETER] = SQL_TRUE;
+    exists[SQL_API_SQLGETTYPEINFO] = SQL_TRUE;
+    exists[SQL_API_SQLCOLUMNS] = SQL_TRUE;
+    exists[SQL_API_SQLPARAMDATA] = SQL_TRUE;
+    exists[SQL_API_SQLDRIVERCONNECT] = SQL_TRUE;
+    exists[SQL_API_SQLPUTDATA] = SQL_TRUE;
+    exists[SQL_API_SQLGETCONNECTOPTION] = SQL_TRUE;
+    exists[SQL_API_SQLSETCONNECTOPTION] = SQL_TRUE;
+    exists[SQL_API_SQLGETDATA] = SQL_TRUE;
+    exists[SQL_API_SQLSETSTMTOPTION] = SQL_TRUE;
+    exists[SQL_API_SQLGETFUNCTIONS] = SQL_TRUE;
+    exists[SQL_API_SQLSPECIALCOLUMNS] = SQL_TRUE;
+    exists[SQL_API_SQLGETINFO] = SQL_TRUE;
+    exists[SQL_API_SQLSTATISTICS] = SQL_TRUE;
+    exists[SQL_API_SQLGETSTMTOPTION] = SQL_TRUE;
+    exists[SQL_API_SQLTABLES] = SQL_TRUE;
+    exists[SQL_API_SQLBROWSECONNECT] = SQL_FALSE;
+    exists[SQL_API_SQLNUMPARAMS] = SQL_TRUE;
+    exists[SQL_API_SQLCOLUMNPRIVILEGES] = SQL_FALSE;
+    exists[SQL_API_SQLPARAMOPTIONS] = SQL_FALSE;
+    exists[SQL_API_SQLDATASOURCES] = SQL_TRUE;
+    exists[SQL_API_SQLPRIMARYKEYS] = SQL_TRUE;
+    exists[SQL_API_SQLDESCRIBEPARAM] = SQL_TRUE;
+    exists[SQL_API_SQLPROCEDURECOLUMNS] = SQL_TRUE;
+    exists[SQL_API_SQLDRIVERS] = SQL_FALSE;
+    exists[SQL_API_SQLPROCEDURES] = SQL_TRUE;
+    exists[SQL_API_SQLEXTENDEDFETCH] = SQL_TRUE;
+    exists[SQL_API_SQLSETPOS] = SQL_TRUE;
+    exists[SQL_API_SQLFOREIGNKEYS] = SQL_TRUE;
+    exists[SQL_API_SQLSETSCROLLOPTIONS] = SQL_TRUE;
+    exists[SQL_API_SQLMORERESULTS] = SQL_TRUE;
+    exists[SQL_API_SQLTABLEPRIVILEGES] = SQL_TRUE;
+    exists[SQL_API_SQLNATIVESQL] = SQL_TRUE;
+    if (func == SQL_API_ALL_FUNCTIONS) {
+	memcpy(flags, exists, sizeof (exists));
+    } else if (func == SQL_API_ODBC3_ALL_FUNCTIONS) {
+	int i;
+#define SET_EXISTS(x) \
+	flags[(x) >> 4] |= (1 << ((x) & 0xF))
+#define CLR_EXISTS(x) \
+	flags[(x) >> 4] &= ~(1 << ((x) & 0xF))
+
+	memset(flags, 0,
+	       sizeof (SQLUSMALLINT) * SQL_API_ODBC3_ALL_FUNCTIONS_SIZE);
+	for (i = 0; i < array_size(exists); i++) {
+	    if (exists[i]) {
+		flags[i >> 4] |= (1 << (i & 0xF));
+	    }
+	}
+	SET_EXISTS(SQL_API_SQLALLOCHANDLE);
+	SET_EXISTS(SQL_API_SQLFREEHANDLE);
+	SET_EXISTS(SQL_API_SQLGETSTMTATTR);
+	SET_EXISTS(SQL_API_SQLSETSTMTATTR);
+	SET_EXISTS(SQL_API_SQLGETCONNECTATTR);
+	SET_EXISTS(SQL_API_SQLSETCONNECTATTR);
+	SET_EXISTS(SQL_API_SQLGETENVATTR);
+	SET_EXISTS(SQL_API_SQLSETENVATTR);
+	SET_EXISTS(SQL_API_SQLCLOSECURSOR);
+	SET_EXISTS(SQL_API_SQLBINDPARAM);
+#if !defined(HAVE_UNIXODBC) || !(HAVE_UNIXODBC)
+	/*
+	 * Some unixODBC versions have problems with
+	 * SQLError() vs. SQLGetDiagRec() with loss
+	 * of error/warning messages.
+	 */
+	SET_EXISTS(SQL_API_SQLGETDIAGREC);
+#endif
+	SET_EXISTS(SQL_API_SQLGETDIAGFIELD);
+	SET_EXISTS(SQL_API_SQLFETCHSCROLL);
+	SET_EXISTS(SQL_API_SQLENDTRAN);
+    } else {
+	if (func < array_size(exists)) {
+	    *flags = exists[func];
+	} else {
+	    switch (func) {
+	    case SQL_API_SQLALLOCHANDLE:
+	    case SQL_API_SQLFREEHANDLE:
+	    case SQL_API_SQLGETSTMTATTR:
+	    case SQL_API_SQLSETSTMTATTR:
+	    case SQL_API_SQLGETCONNECTATTR:
+	    case SQL_API_SQLSETCONNECTATTR:
+	    case SQL_API_SQLGETENVATTR:
+	    case SQL_API_SQLSETENVATTR:
+	    case SQL_API_SQLCLOSECURSOR:
+	    case SQL_API_SQLBINDPARAM:
+#if !defined(HAVE_UNIXODBC) || !(HAVE_UNIXODBC)
+	    /*
+	     * Some unixODBC versions have problems with
+	     * SQLError() vs. SQLGetDiagRec() with loss
+	     * of error/warning messages.
+	     */
+	    case SQL_API_SQLGETDIAGREC:
+#endif
+	    case SQL_API_SQLGETDIAGFIELD:
+	    case SQL_API_SQLFETCHSCROLL:
+	    case SQL_API_SQLENDTRAN:
+		*flags = SQL_TRUE;
+		break;
+	    default:
+		*flags = SQL_FALSE;
+	    }
+	}
+    }
+    return SQL_SUCCESS;
+}
+
+/**
+ * Internal allocate HENV.
+ * @param env pointer to environment handle
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvallocenv(SQLHENV *env)
+{
+    ENV *e;
+
+    if (env == NULL) {
+	return SQL_INVALID_HANDLE;
+    }
+    e = (ENV *) xmalloc(sizeof (ENV));
+    if (e == NULL) {
+	*env = SQL_NULL_HENV;
+	return SQL_ERROR;
+    }
+    e->magic = ENV_MAGIC;
+    e->ov3 = 0;
+    e->pool = 0;
+    e->poolents = NULL;
+    e->pooln = e->poolhits = e->poolmisses = e->poolexpired = 0;
 #if defined(_WIN32) || defined(_WIN64)
-	*((SQLSMALLINT *) val) =
-	    d->xcelqrx ? SQL_FILE_CATALOG : SQL_FILE_NOT_SUPPORTED;
+    InitializeCriticalSection(&e->cs);
+    InitializeCriticalSection(&e->poolcs);
 #else
-	*((SQLSMALLINT *) val) = SQL_FILE_NOT_SUPPORTED;
+#if defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    initmutex(&e->mutex);
+    pthread_mutex_init(&e->poolmutex, NULL);
 #endif
-	*valLen = sizeof (SQLSMALLINT);
-	break;
-    case SQL_GROUP_BY:
-	*((SQLSMALLINT *) val) = SQL_GB_GROUP_BY_EQUALS_SELECT;
-	*valLen = sizeof (SQLSMALLINT);
-	break;
-    case SQL_KEYWORDS:
-	strmak(val, "CREATE,SELECT,DROP,DELETE,UPDATE,INSERT,"
-	       "INTO,VALUES,TABLE,INDEX,FROM,SET,WHERE,AND,CURRENT,OF",
-	       valMax, valLen);
-	break;
-    case SQL_SPECIAL_CHARACTERS:
-#ifdef SQL_COLLATION_SEQ
-    case SQL_COLLATION_SEQ:
+#if defined(ENABLE_NVFS) && (ENABLE_NVFS)
+    nvfs_init();
+#endif
+#endif
+    e->dbcs = NULL;
+    *env = (SQLHENV) e;
+    return SQL_SUCCESS;
+}
+
+/**
+ * Allocate HENV.
+ * @param env pointer to environment handle
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLAllocEnv(SQLHENV *env)
+{
+    return drvallocenv(env);
+}
+
+/**
+ * Internal free HENV.
+ * @param env environment handle
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvfreeenv(SQLHENV env)
+{
+    ENV *e;
+
+    if (env == SQL_NULL_HENV) {
+	return SQL_INVALID_HANDLE;
+    }
+    e = (ENV *) env;
+    if (e->magic != ENV_MAGIC) {
+	return SQL_SUCCESS;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    EnterCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_lock(&e->mutex);
+#endif
+    if (e->dbcs) {
+#if defined(_WIN32) || defined(_WIN64)
+	LeaveCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	pthread_mutex_unlock(&e->mutex);
 #endif
-	strmak(val, "", valMax, valLen);
-	break;
-    case SQL_BATCH_SUPPORT:
-    case SQL_BATCH_ROW_COUNT:
-    case SQL_PARAM_ARRAY_ROW_COUNTS:
-	*((SQLUINTEGER *) val) = 0;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_FORWARD_ONLY_CURSOR_ATTRIBUTES1:
-	*((SQLUINTEGER *) val) = SQL_CA1_NEXT | SQL_CA1_BOOKMARK;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_STATIC_CURSOR_ATTRIBUTES1:
-	*((SQLUINTEGER *) val) = SQL_CA1_NEXT | SQL_CA1_ABSOLUTE |
-	    SQL_CA1_RELATIVE | SQL_CA1_BOOKMARK | SQL_CA1_POS_POSITION |
-	    SQL_CA1_POS_DELETE | SQL_CA1_POS_UPDATE | SQL_CA1_POS_REFRESH |
-	    SQL_CA1_LOCK_NO_CHANGE | SQL_CA1_BULK_ADD |
-	    SQL_CA1_BULK_UPDATE_BY_BOOKMARK | SQL_CA1_BULK_DELETE_BY_BOOKMARK;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_FORWARD_ONLY_CURSOR_ATTRIBUTES2:
-    case SQL_STATIC_CURSOR_ATTRIBUTES2:
-	*((SQLUINTEGER *) val) = SQL_CA2_READ_ONLY_CONCURRENCY |
-	    SQL_CA2_LOCK_CONCURRENCY;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_KEYSET_CURSOR_ATTRIBUTES1:
-    case SQL_KEYSET_CURSOR_ATTRIBUTES2:
-    case SQL_DYNAMIC_CURSOR_ATTRIBUTES1:
-    case SQL_DYNAMIC_CURSOR_ATTRIBUTES2:
-	*((SQLUINTEGER *) val) = 0;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    case SQL_ODBC_INTERFACE_CONFORMANCE:
-	*((SQLUINTEGER *) val) = SQL_OIC_CORE;
-	*valLen = sizeof (SQLUINTEGER);
-	break;
-    default:
-	setstatd(d, -1, "unsupported info option %d",
-		 (*d->ov3) ? "HYC00" : "S1C00", type);
 	return SQL_ERROR;
     }
+    e->magic = DEAD_MAGIC;
+    poolfree(e->poolents);
+    e->poolents = NULL;
+#if defined(_WIN32) || defined(_WIN64)
+    LeaveCriticalSection(&e->cs);
+    DeleteCriticalSection(&e->cs);
+    DeleteCriticalSection(&e->poolcs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_unlock(&e->mutex);
+    pthread_mutex_destroy(&e->mutex);
+    pthread_mutex_destroy(&e->poolmutex);
+#endif
+    xfree(e);
     return SQL_SUCCESS;
 }
 
-#if (defined(HAVE_UNIXODBC) && (HAVE_UNIXODBC)) || !defined(WINTERFACE)
 /**
- * Return information about what this ODBC driver supports.
- * @param dbc database connection handle
- * @param type type of information to be retrieved
- * @param val output buffer
- * @param valMax length of output buffer
- * @param valLen output length
+ * Free HENV.
+ * @param env environment handle
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetInfo(SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER val, SQLSMALLINT valMax,
-	   SQLSMALLINT *valLen)
+SQLFreeEnv(SQLHENV env)
 {
-    SQLRETURN ret;
-
-    HDBC_LOCK(dbc);
-    ret = drvgetinfo(dbc, type, val, valMax, valLen);
-    HDBC_UNLOCK(dbc);
-    return ret;
+    return drvfreeenv(env);
 }
+
+/**
+ * Internal allocate HDBC.
+ * @param env environment handle
+ * @param dbc pointer to database connection handle
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvallocconnect(SQLHENV env, SQLHDBC *dbc)
+{
+    DBC *d;
+    ENV *e;
+    const char *verstr;
+    int maj = 0, min = 0, lev = 0;
+
+    if (dbc == NULL) {
+	return SQL_ERROR;
+    }
+    d = (DBC *) xmalloc(sizeof (DBC));
+    if (d == NULL) {
+	*dbc = SQL_NULL_HDBC;
+	return SQL_ERROR;
+    }
+    memset(d, 0, sizeof (DBC));
+    d->curtype = SQL_CURSOR_STATIC;
+    d->ov3 = &d->ov3val;
+    verstr = sqlite3_libversion();
+    sscanf(verstr, "%d.%d.%d", &maj, &min, &lev);
+    d->version = verinfo(maj & 0xFF, min & 0xFF, lev & 0xFF);
+    e = (ENV *) env;
+#if defined(_WIN32) || defined(_WIN64)
+    if (e->magic == ENV_MAGIC) {
+	EnterCriticalSection(&e->cs);
+    }
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    if (e->magic == ENV_MAGIC) {
+	pthread_mutex_lock(&e->mutex);
+    }
 #endif
+    if (e->magic == ENV_MAGIC) {
+	DBC *n, *p;
+
+	d->env = e;
+	d->ov3 = &e->ov3;
+	p = NULL;
+	n = e->dbcs;
+	while (n) {
+	    p = n;
+	    n = n->next;
+	}
+	if (p) {
+	    p->next = d;
+	} else {
+	    e->dbcs = d;
+	}
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    InitializeCriticalSection(&d->cs);
+    d->owner = 0;
+    if (e->magic == ENV_MAGIC) {
+	LeaveCriticalSection(&e->cs);
+    }
+    d->oemcp = 1;
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    initmutex(&d->mutex);
+    d->nlock = 0;
+    if (e->magic == ENV_MAGIC) {
+	pthread_mutex_unlock(&e->mutex);
+    }
+#endif
+    d->autocommit = 1;
+    d->magic = DBC_MAGIC;
+    *dbc = (SQLHDBC) d;
+    drvgetgpps(d);
+    return SQL_SUCCESS;
+}
 
-#ifdef WINTERFACE
 /**
- * Return information about what this ODBC driver supports.
- * @param dbc database connection handle
- * @param type type of information to be retrieved
- * @param val output buffer
- * @param valMax length of output buffer
- * @param valLen output length
+ * Allocate HDBC.
+ * @param env environment handle
+ * @param dbc pointer to database connection handle
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetInfoW(SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER val, SQLSMALLINT valMax,
-	    SQLSMALLINT *valLen)
+SQLAllocConnect(SQLHENV env, SQLHDBC *dbc)
 {
-    SQLRETURN ret;
-    SQLSMALLINT len = 0;
+    return drvallocconnect(env, dbc);
+}
 
-    HDBC_LOCK(dbc);
-    ret = drvgetinfo(dbc, type, val, valMax, &len);
-    HDBC_UNLOCK(dbc);
-    if (ret == SQL_SUCCESS) {
-	SQLWCHAR *v = NULL;
+/**
+ * Internal free connection (HDBC).
+ * @param dbc database connection handle
+ * @result ODBC error code
+ */
 
-	switch (type) {
-	case SQL_USER_NAME:
-	case SQL_DRIVER_ODBC_VER:
-	case SQL_DATA_SOURCE_NAME:
-	case SQL_DRIVER_NAME:
-	case SQL_DRIVER_VER:
-	case SQL_ODBC_VER:
-	case SQL_SERVER_NAME:
-	case SQL_DATABASE_NAME:
-	case SQL_SEARCH_PATTERN_ESCAPE:
-	case SQL_DBMS_NAME:
-	case SQL_DBMS_VER:
-	case SQL_NEED_LONG_DATA_LEN:
-	case SQL_ROW_UPDATES:
-	case SQL_ACCESSIBLE_PROCEDURES:
-	case SQL_PROCEDURES:
-	case SQL_EXPRESSIONS_IN_ORDERBY:
-	case SQL_ODBC_SQL_OPT_IEF:
-	case SQL_LIKE_ESCAPE_CLAUSE:
-	case SQL_ORDER_BY_COLUMNS_IN_SELECT:
-	case SQL_OUTER_JOINS:
-	case SQL_COLUMN_ALIAS:
-	case SQL_ACCESSIBLE_TABLES:
-	case SQL_MULT_RESULT_SETS:
-	case SQL_MULTIPLE_ACTIVE_TXN:
-	case SQL_MAX_ROW_SIZE_INCLUDES_LONG:
-	case SQL_DATA_SOURCE_READ_ONLY:
-#ifdef SQL_DESCRIBE_PARAMETER
-	case SQL_DESCRIBE_PARAMETER:
-#endif
-	case SQL_IDENTIFIER_QUOTE_CHAR:
-	case SQL_OWNER_TERM:
-	case SQL_PROCEDURE_TERM:
-	case SQL_QUALIFIER_NAME_SEPARATOR:
-	case SQL_QUALIFIER_TERM:
-	case SQL_TABLE_TERM:
-	case SQL_KEYWORDS:
-	case SQL_SPECIAL_CHARACTERS:
-#ifdef SQL_CATALOG_NAME
-	case SQL_CATALOG_NAME:
-#endif
-#ifdef SQL_COLLATION_SEQ
-	case SQL_COLLATION_SEQ:
+static SQLRETURN
+drvfreeconnect(SQLHDBC dbc)
+{
+    DBC *d;
+    ENV *e;
+    SQLRETURN ret = SQL_ERROR;
+
+    if (dbc == SQL_NULL_HDBC) {
+	return SQL_INVALID_HANDLE;
+    }
+    d = (DBC *) dbc;
+    if (d->magic != DBC_MAGIC) {
+	return SQL_INVALID_HANDLE;
+    }
+    e = d->env;
+    if (e && e->magic == ENV_MAGIC) {
+#if defined(_WIN32) || defined(_WIN64)
+	EnterCriticalSection(&e->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	pthread_mutex_lock(&e->mutex);
 #endif
-	    if (val) {
-		if (len > 0) {
-		    v = uc_from_utf((SQLCHAR *) val, len);
-		    if (v) {
-			int vmax = valMax / sizeof (SQLWCHAR);
+    } else {
+	e = NULL;
+    }
+    HDBC_LOCK(dbc);
+    if (d->sqlite) {
+	setstatd(d, -1, "not disconnected", (*d->ov3) ? "HY000" : "S1000");
+	HDBC_UNLOCK(dbc);
+	goto done;
+    }
+    while (d->stmt) {
+	freestmt((HSTMT) d->stmt);
+    }
+    if (e && e->magic == ENV_MAGIC) {
+	DBC *n, *p;
 
-			uc_strncpy(val, v, vmax);
-			if (len < vmax) {
-			    len = min(vmax, uc_strlen(v));
-			    v[len] = 0;
-			} else {
-			    len = vmax;
-			}
-			uc_free(v);
-			len *= sizeof (SQLWCHAR);
-		    } else {
-			len = 0;
-		    }
-		}
-		if (len <= 0) {
-		    len = 0;
-		    if (valMax >= sizeof (SQLWCHAR)) {
-			*((SQLWCHAR *)val) = 0;
-		    }
-		}
-	    } else {
-		len *= sizeof (SQLWCHAR);
+	p = NULL;
+	n = e->dbcs;
+	while (n) {
+	    if (n == d) {
+		break;
 	    }
-	    break;
+	    p = n;
+	    n = n->next;
 	}
-	if (valLen) {
-	    *valLen = len;
+	if (n) {
+	    if (p) {
+		p->next = d->next;
+	    } else {
+		e->dbcs = d->next;
+	    }
 	}
     }
+    drvrelgpps(d);
+    d->magic = DEAD_MAGIC;
+    freep(&d->poolkey);
+    freep(&d->perfsql);
+    if (d->trace) {
+	fclose(d->trace);
+    }
+    trcclose(d);
+#if defined(_WIN32) || defined(_WIN64)
+    d->owner = 0;
+    LeaveCriticalSection(&d->cs);
+    DeleteCriticalSection(&d->cs);
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    d->nlock = 0;
+    pthread_mutex_unlock(&d->mutex);
+    pthread_mutex_destroy(&d->mutex);
+#endif
+    xfree(d);
+    ret = SQL_SUCCESS;
+done:
+#if defined(_WIN32) || defined(_WIN64)
+    if (e) {
+	LeaveCriticalSection(&e->cs);
+    }
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    if (e) {
+	pthread_mutex_unlock(&e->mutex);
+    }
+#endif
     return ret;
 }
-#endif
 
 /**
- * Return information about supported ODBC API functions.
+ * Free connection (HDBC).
  * @param dbc database connection handle
- * @param func function code to be retrieved
- * @param flags output indicator
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetFunctions(SQLHDBC dbc, SQLUSMALLINT func,
-		SQLUSMALLINT *flags)
+SQLFreeConnect(SQLHDBC dbc)
+{
+    return drvfreeconnect(dbc);
+}
+
+/**
+ * Internal get connect attribute of HDBC.
+ * @param dbc database connection handle
+ * @param attr option to be retrieved
+ * @param val output buffer
+ * @param bufmax size of output buffer
+ * @param buflen output length
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvgetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
+		  SQLINTEGER bufmax, SQLINTEGER *buflen)
 {
+    DBC *d;
+    SQLINTEGER dummy;
     int i;
-    SQLUSMALLINT exists[100];
 
     if (dbc == SQL_NULL_HDBC) {
 	return SQL_INVALID_HANDLE;
     }
-    for (i = 0; i < array_size(exists); i++) {
-	exists[i] = SQL_FALSE;
+    d = (DBC *) dbc;
+    if (!val) {
+	val = (SQLPOINTER) &dummy;
     }
-    exists[SQL_API_SQLALLOCCONNECT] = SQL_TRUE;
-    exists[SQL_API_SQLFETCH] = SQL_TRUE;
-    exists[SQL_API_SQLALLOCENV] = SQL_TRUE;
-    exists[SQL_API_SQLFREECONNECT] = SQL_TRUE;
-    exists[SQL_API_SQLALLOCSTMT] = SQL_TRUE;
-    exists[SQL_API_SQLFREEENV] = SQL_TRUE;
-    exists[SQL_API_SQLBINDCOL] = SQL_TRUE;
-    exists[SQL_API_SQLFREESTMT] = SQL_TRUE;
-    exists[SQL_API_SQLCANCEL] = SQL_TRUE;
-    exists[SQL_API_SQLGETCURSORNAME] = SQL_TRUE;
-    exists[SQL_API_SQLCOLATTRIBUTES] = SQL_TRUE;
-    exists[SQL_API_SQLNUMRESULTCOLS] = SQL_TRUE;
-    exists[SQL_API_SQLCONNECT] = SQL_TRUE;
-    exists[SQL_API_SQLPREPARE] = SQL_TRUE;
-    exists[SQL_API_SQLDESCRIBECOL] = SQL_TRUE;
-    exists[SQL_API_SQLROWCOUNT] = SQL_TRUE;
-    exists[SQL_API_SQLDISCONNECT] = SQL_TRUE;
-    exists[SQL_API_SQLSETCURSORNAME] = SQL_FALSE;
-    exists[SQL_API_SQLERROR] = SQL_TRUE;
-    exists[SQL_API_SQLSETPARAM] = SQL_TRUE;
-    exists[SQL_API_SQLEXECDIRECT] = SQL_TRUE;
-    exists[SQL_API_SQLTRANSACT] = SQL_TRUE;
-    exists[SQL_API_SQLBULKOPERATIONS] = SQL_TRUE;
-    exists[SQL_API_SQLEXECUTE] = SQL_TRUE;
-    exists[SQL_API_SQLBINDPARAMETER] = SQL_TRUE;
-    exists[SQL_API_SQLGETTYPEINFO] = SQL_TRUE;
-    exists[SQL_API_SQLCOLUMNS] = SQL_TRUE;
-    exists[SQL_API_SQLPARAMDATA] = SQL_TRUE;
-    exists[SQL_API_SQLDRIVERCONNECT] = SQL_TRUE;
-    exists[SQL_API_SQLPUTDATA] = SQL_TRUE;
-    exists[SQL_API_SQLGETCONNECTOPTION] = SQL_TRUE;
-    exists[SQL_API_SQLSETCONNECTOPTION] = SQL_TRUE;
-    exists[SQL_API_SQLGETDATA] = SQL_TRUE;
-    exists[SQL_API_SQLSETSTMTOPTION] = SQL_TRUE;
-    exists[SQL_API_SQLGETFUNCTIONS] = SQL_TRUE;
-    exists[SQL_API_SQLSPECIALCOLUMNS] = SQL_TRUE;
-    exists[SQL_API_SQLGETINFO] = SQL_TRUE;
-    exists[SQL_API_SQLSTATISTICS] = SQL_TRUE;
-    exists[SQL_API_SQLGETSTMTOPTION] = SQL_TRUE;
-    exists[SQL_API_SQLTABLES] = SQL_TRUE;
-    exists[SQL_API_SQLBROWSECONNECT] = SQL_FALSE;
-    exists[SQL_API_SQLNUMPARAMS] = SQL_TRUE;
-    exists[SQL_API_SQLCOLUMNPRIVILEGES] = SQL_FALSE;
-    exists[SQL_API_SQLPARAMOPTIONS] = SQL_FALSE;
-    exists[SQL_API_SQLDATASOURCES] = SQL_TRUE;
-    exists[SQL_API_SQLPRIMARYKEYS] = SQL_TRUE;
-    exists[SQL_API_SQLDESCRIBEPARAM] = SQL_TRUE;
-    exists[SQL_API_SQLPROCEDURECOLUMNS] = SQL_TRUE;
-    exists[SQL_API_SQLDRIVERS] = SQL_FALSE;
-    exists[SQL_API_SQLPROCEDURES] = SQL_TRUE;
-    exists[SQL_API_SQLEXTENDEDFETCH] = SQL_TRUE;
-    exists[SQL_API_SQLSETPOS] = SQL_TRUE;
-    exists[SQL_API_SQLFOREIGNKEYS] = SQL_TRUE;
-    exists[SQL_API_SQLSETSCROLLOPTIONS] = SQL_TRUE;
-    exists[SQL_API_SQLMORERESULTS] = SQL_TRUE;
-    exists[SQL_API_SQLTABLEPRIVILEGES] = SQL_TRUE;
-    exists[SQL_API_SQLNATIVESQL] = SQL_TRUE;
-    if (func == SQL_API_ALL_FUNCTIONS) {
-	memcpy(flags, exists, sizeof (exists));
-    } else if (func == SQL_API_ODBC3_ALL_FUNCTIONS) {
-	int i;
-#define SET_EXISTS(x) \
-	flags[(x) >> 4] |= (1 << ((x) & 0xF))
-#define CLR_EXISTS(x) \
-	flags[(x) >> 4] &= ~(1 << ((x) & 0xF))
-
-	memset(flags, 0,
-	       sizeof (SQLUSMALLINT) * SQL_API_ODBC3_ALL_FUNCTIONS_SIZE);
-	for (i = 0; i < array_size(exists); i++) {
-	    if (exists[i]) {
-		flags[i >> 4] |= (1 << (i & 0xF));
+    if (!buflen) {
+	buflen = &dummy;
+    }
+    switch (attr) {
+    case SQL_ATTR_CONNECTION_DEAD:
+	*((SQLINTEGER *) val) = d->sqlite ? SQL_CD_FALSE : SQL_CD_TRUE;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_ACCESS_MODE:
+	*((SQLINTEGER *) val) = SQL_MODE_READ_WRITE;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_AUTOCOMMIT:
+	*((SQLINTEGER *) val) =
+	    d->autocommit ? SQL_AUTOCOMMIT_ON : SQL_AUTOCOMMIT_OFF;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_LOGIN_TIMEOUT:
+	*((SQLINTEGER *) val) = 100;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_ODBC_CURSORS:
+	*((SQLINTEGER *) val) = SQL_CUR_USE_DRIVER;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_PACKET_SIZE:
+	*((SQLINTEGER *) val) = 16384;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_TXN_ISOLATION:
+	*((SQLINTEGER *) val) = SQL_TXN_SERIALIZABLE;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_TRACEFILE:
+    case SQL_ATTR_TRANSLATE_LIB:
+	*((SQLCHAR *) val) = 0;
+	*buflen = 0;
+	break;
+    case SQL_ATTR_CURRENT_CATALOG:
+#if defined(_WIN32) || defined(_WIN64)
+	if (d->xcelqrx) {
+	    if ((bufmax > 4) && (val != (SQLPOINTER) &dummy)) {
+		strcpy((char *) val, "main");
+		*buflen = 4;
+		break;
 	    }
 	}
-	SET_EXISTS(SQL_API_SQLALLOCHANDLE);
-	SET_EXISTS(SQL_API_SQLFREEHANDLE);
-	SET_EXISTS(SQL_API_SQLGETSTMTATTR);
-	SET_EXISTS(SQL_API_SQLSETSTMTATTR);
-	SET_EXISTS(SQL_API_SQLGETCONNECTATTR);
-	SET_EXISTS(SQL_API_SQLSETCONNECTATTR);
-	SET_EXISTS(SQL_API_SQLGETENVATTR);
-	SET_EXISTS(SQL_API_SQLSETENVATTR);
-	SET_EXISTS(SQL_API_SQLCLOSECURSOR);
-	SET_EXISTS(SQL_API_SQLBINDPARAM);
-#if !defined(HAVE_UNIXODBC) || !(HAVE_UNIXODBC)
-	/*
-	 * Some unixODBC versions have problems with
-	 * SQLError() vs. SQLGetDiagRec() with loss
-	 * of error/warning messages.
-	 */
-	SET_EXISTS(SQL_API_SQLGETDIAGREC);
 #endif
-	SET_EXISTS(SQL_API_SQLGETDIAGFIELD);
-	SET_EXISTS(SQL_API_SQLFETCHSCROLL);
-	SET_EXISTS(SQL_API_SQLENDTRAN);
-    } else {
-	if (func < array_size(exists)) {
-	    *flags = exists[func];
-	} else {
-	    switch (func) {
-	    case SQL_API_SQLALLOCHANDLE:
-	    case SQL_API_SQLFREEHANDLE:
-	    case SQL_API_SQLGETSTMTATTR:
-	    case SQL_API_SQLSETSTMTATTR:
-	    case SQL_API_SQLGETCONNECTATTR:
-	    case SQL_API_SQLSETCONNECTATTR:
-	    case SQL_API_SQLGETENVATTR:
-	    case SQL_API_SQLSETENVATTR:
-	    case SQL_API_SQLCLOSECURSOR:
-	    case SQL_API_SQLBINDPARAM:
-#if !defined(HAVE_UNIXODBC) || !(HAVE_UNIXODBC)
-	    /*
-	     * Some unixODBC versions have problems with
-	     * SQLError() vs. SQLGetDiagRec() with loss
-	     * of error/warning messages.
-	     */
-	    case SQL_API_SQLGETDIAGREC:
+	*((SQLCHAR *) val) = 0;
+	*buflen = 0;
+	break;
+    case SQL_ATTR_TRACE:
+    case SQL_ATTR_QUIET_MODE:
+    case SQL_ATTR_TRANSLATE_OPTION:
+    case SQL_ATTR_KEYSET_SIZE:
+    case SQL_ATTR_QUERY_TIMEOUT:
+	*((SQLINTEGER *) val) = 0;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_PARAM_BIND_TYPE:
+	*((SQLULEN *) val) = SQL_PARAM_BIND_BY_COLUMN;
+	*buflen = sizeof (SQLUINTEGER);
+	break;
+    case SQL_ATTR_ROW_BIND_TYPE:
+	*((SQLULEN *) val) = SQL_BIND_BY_COLUMN;
+	*buflen = sizeof (SQLULEN);
+	break;
+    case SQL_ATTR_USE_BOOKMARKS:
+	*((SQLINTEGER *) val) = SQL_UB_OFF;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_ASYNC_ENABLE:
+	*((SQLINTEGER *) val) = SQL_ASYNC_ENABLE_OFF;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_NOSCAN:
+	*((SQLINTEGER *) val) = SQL_NOSCAN_ON;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_CONCURRENCY:
+	*((SQLINTEGER *) val) = SQL_CONCUR_LOCK;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+#ifdef SQL_ATTR_CURSOR_SENSITIVITY
+    case SQL_ATTR_CURSOR_SENSITIVITY:
+	*((SQLINTEGER *) val) = SQL_UNSPECIFIED;
+	*buflen = sizeof (SQLINTEGER);
+	break;
 #endif
-	    case SQL_API_SQLGETDIAGFIELD:
-	    case SQL_API_SQLFETCHSCROLL:
-	    case SQL_API_SQLENDTRAN:
-		*flags = SQL_TRUE;
-		break;
-	    default:
-		*flags = SQL_FALSE;
+    case SQL_ATTR_SIMULATE_CURSOR:
+	*((SQLINTEGER *) val) = SQL_SC_NON_UNIQUE;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_MAX_ROWS:
+	*((SQLINTEGER *) val) = 0;
+	*buflen = sizeof (SQLINTEGER);
+    case SQL_ATTR_MAX_LENGTH:
+	*((SQLINTEGER *) val) = 1000000000;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_CURSOR_TYPE:
+	*((SQLINTEGER *) val) = d->curtype;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+    case SQL_ATTR_RETRIEVE_DATA:
+	*((SQLINTEGER *) val) = SQL_RD_ON;
+	*buflen = sizeof (SQLINTEGER);
+	break;
+#ifdef SQL_ATTR_METADATA_ID
+    case SQL_ATTR_METADATA_ID:
+	*((SQLULEN *) val) = SQL_FALSE;
+	return SQL_SUCCESS;
+#endif
+    case SQL_ATTR_SQLITE_STMTCACHE_SIZE:
+	*((SQLULEN *) val) = d->s3cache_n;
+	*buflen = sizeof (SQLULEN);
+	break;
+    case SQL_ATTR_SQLITE_STMTCACHE_HITS:
+	*((SQLULEN *) val) = d->s3cache_hits;
+	*buflen = sizeof (SQLULEN);
+	break;
+    case SQL_ATTR_SQLITE_STMTCACHE_MISSES:
+	*((SQLULEN *) val) = d->s3cache_misses;
+	*buflen = sizeof (SQLULEN);
+	break;
+    case SQL_ATTR_SQLITE_STATS_TIMING:
+	*((SQLUINTEGER *) val) = d->stats_timing;
+	*buflen = sizeof (SQLUINTEGER);
+	break;
+    default:
+	for (i = 0; i < NSTATINFO; i++) {
+	    if (statinfo[i].attr == attr) {
+		*((SQLULEN *) val) = statval(d, i);
+		*buflen = sizeof (SQLULEN);
+		return SQL_SUCCESS;
 	    }
 	}
-    }
-    return SQL_SUCCESS;
-}
-
-/**
- * Internal allocate HENV.
- * @param env pointer to environment handle
- * @result ODBC error code
- */
-
-static SQLRETURN
-drvallocenv(SQLHENV *env)
-{
-    ENV *e;
-
-    if (env == NULL) {
-	return SQL_INVALID_HANDLE;
-    }
-    e = (ENV *) xmalloc(sizeof (ENV));
-    if (e == NULL) {
-	*env = SQL_NULL_HENV;
+	*((SQLINTEGER *) val) = 0;
+	*buflen = sizeof (SQLINTEGER);
+	setstatd(d, -1, "unsupported connect attribute %d",
+		 (*d->ov3) ? "HYC00" : "S1C00", (int) attr);
 	return SQL_ERROR;
     }
-    e->magic = ENV_MAGIC;
-    e->ov3 = 0;
-    e->pool = 0;
-#if defined(_WIN32) || defined(_WIN64)
-    InitializeCriticalSection(&e->cs);
-#else
-#if defined(ENABLE_NVFS) && (ENABLE_NVFS)
-    nvfs_init();
-#endif
-#endif
-    e->dbcs = NULL;
-    *env = (SQLHENV) e;
     return SQL_SUCCESS;
 }
 
+#ifndef WINTERFACE
 /**
- * Allocate HENV.
- * @param env pointer to environment handle
+ * Get connect attribute of HDBC.
+ * @param dbc database connection handle
+ * @param attr option to be retrieved
+ * @param val output buffer
+ * @param bufmax size of output buffer
+ * @param buflen output length
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLAllocEnv(SQLHENV *env)
-{
-    return drvallocenv(env);
-}
-
-/**
- * Internal free HENV.
- * @param env environment handle
- * @result ODBC error code
- */
-
-static SQLRETURN
-drvfreeenv(SQLHENV env)
+SQLGetConnectAttr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
+		  SQLINTEGER bufmax, SQLINTEGER *buflen)
 {
-    ENV *e;
+    SQLRETURN ret;
 
-    if (env == SQL_NULL_HENV) {
-	return SQL_INVALID_HANDLE;
-    }
-    e = (ENV *) env;
-    if (e->magic != ENV_MAGIC) {
-	return SQL_SUCCESS;
-    }
-#if defined(_WIN32) || defined(_WIN64)
-    EnterCriticalSection(&e->cs);
-#endif
-    if (e->dbcs) {
-#if defined(_WIN32) || defined(_WIN64)
-	LeaveCriticalSection(&e->cs);
-#endif
-	return SQL_ERROR;
-    }
-    e->magic = DEAD_MAGIC;
-#if defined(_WIN32) || defined(_WIN64)
-    LeaveCriticalSection(&e->cs);
-    DeleteCriticalSection(&e->cs);
-#endif
-    xfree(e);
-    return SQL_SUCCESS;
+    HDBC_LOCK(dbc);
+    ret = drvgetconnectattr(dbc, attr, val, bufmax, buflen);
+    HDBC_UNLOCK(dbc);
+    return ret;
 }
+#endif
 
+#ifdef WINTERFACE
 /**
- * Free HENV.
- * @param env environment handle
+ * Get connect attribute of HDBC (UNICODE version).
+ * @param dbc database connection handle
+ * @param attr option to be retrieved
+ * @param val output buffer
+ * @param bufmax size of output buffer
+ * @param buflen output length
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLFreeEnv(SQLHENV env)
-{
-    return drvfreeenv(env);
-}
-
-/**
- * Internal allocate HDBC.
- * @param env environment handle
- * @param dbc pointer to database connection handle
- * @result ODBC error code
- */
-
-static SQLRETURN
-drvallocconnect(SQLHENV env, SQLHDBC *dbc)
+SQLGetConnectAttrW(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
+		   SQLINTEGER bufmax, SQLINTEGER *buflen)
 {
-    DBC *d;
-    ENV *e;
-    const char *verstr;
-    int maj = 0, min = 0, lev = 0;
-
-    if (dbc == NULL) {
-	return SQL_ERROR;
-    }
-    d = (DBC *) xmalloc(sizeof (DBC));
-    if (d == NULL) {
-	*dbc = SQL_NULL_HDBC;
-	return SQL_ERROR;
-    }
-    memset(d, 0, sizeof (DBC));
-    d->curtype = SQL_CURSOR_STATIC;
-    d->ov3 = &d->ov3val;
-    verstr = sqlite3_libversion();
-    sscanf(verstr, "%d.%d.%d", &maj, &min, &lev);
-    d->version = verinfo(maj & 0xFF, min & 0xFF, lev & 0xFF);
-    e = (ENV *) env;
-#if defined(_WIN32) || defined(_WIN64)
-    if (e->magic == ENV_MAGIC) {
-	EnterCriticalSection(&e->cs);
-    }
-#endif
-    if (e->magic == ENV_MAGIC) {
-	DBC *n, *p;
+    SQLRETURN ret;
+    SQLINTEGER len = 0;
 
-	d->env = e;
-	d->ov3 = &e->ov3;
-	p = NULL;
-	n = e->dbcs;
-	while (n) {
-	    p = n;
-	    n = n->next;
-	}
-	if (p) {
-	    p->next = d;
-	} else {
-	    e->dbcs = d;
-	}
-    }
-#if defined(_WIN32) || defined(_WIN64)
-    InitializeCriticalSection(&d->cs);
-    d->owner = 0;
-    if (e->magic == ENV_MAGIC) {
-	LeaveCriticalSection(&e->cs);
-    }
-    d->oemcp = 1;
-#endif
-    d->autocommit = 1;
-    d->magic = DBC_MAGIC;
-    *dbc = (SQLHDBC) d;
-    drvgetgpps(d);
-    return SQL_SUCCESS;
-}
+    HDBC_LOCK(dbc);
+    ret = drvgetconnectattr(dbc, attr, val, bufmax, &len);
+    if (ret == SQL_SUCCESS) {
+	SQLWCHAR *v = NULL;
 
-/**
- * Allocate HDBC.
- * @param env environment handle
- * @param dbc pointer to database connection handle
- * @result ODBC error code
- */
+	switch (attr) {
+	case SQL_ATTR_TRACEFILE:
+	case SQL_ATTR_CURRENT_CATALOG:
+	case SQL_ATTR_TRANSLATE_LIB:
+	    if (val) {
+		if (len > 0) {
+		    v = uc_from_utf((SQLCHAR *) val, len);
+		    if (v) {
+			int vmax = bufmax / sizeof (SQLWCHAR);
 
-SQLRETURN SQL_API
-SQLAllocConnect(SQLHENV env, SQLHDBC *dbc)
-{
-    return drvallocconnect(env, dbc);
+			uc_strncpy(val, v, vmax);
+			if (len < vmax) {
+			    len = min(vmax, uc_strlen(v));
+			    v[len] = 0;
+			} else {
+			    len = vmax;
+			}
+			uc_free(v);
+			len *= sizeof (SQLWCHAR);
+		    } else {
+			len = 0;
+		    }
+		}
+		if (len <= 0) {
+		    len = 0;
+		    if (bufmax >= sizeof (SQLWCHAR)) {
+			*((SQLWCHAR *)val) = 0;
+		    }
+		}
+	    } else {
+		len *= sizeof (SQLWCHAR);
+	    }
+	    break;
+	}
+	if (buflen) {
+	    *buflen = len;
+	}
+    }
+    HDBC_UNLOCK(dbc);
+    return ret;
 }
+#endif
 
 /**
- * Internal free connection (HDBC).
+ * Internal set connect attribute of HDBC.
  * @param dbc database connection handle
+ * @param attr option to be set
+ * @param val option value
+ * @param len size of option
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvfreeconnect(SQLHDBC dbc)
+drvsetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
+		  SQLINTEGER len)
 {
     DBC *d;
-    ENV *e;
-    SQLRETURN ret = SQL_ERROR;
 
     if (dbc == SQL_NULL_HDBC) {
 	return SQL_INVALID_HANDLE;
     }
     d = (DBC *) dbc;
-    if (d->magic != DBC_MAGIC) {
-	return SQL_INVALID_HANDLE;
-    }
-    e = d->env;
-    if (e && e->magic == ENV_MAGIC) {
-#if defined(_WIN32) || defined(_WIN64)
-	EnterCriticalSection(&e->cs);
-#endif
-    } else {
-	e = NULL;
-    }
-    HDBC_LOCK(dbc);
-    if (d->sqlite) {
-	setstatd(d, -1, "not disconnected", (*d->ov3) ? "HY000" : "S1000");
-	HDBC_UNLOCK(dbc);
-	goto done;
-    }
-    while (d->stmt) {
-	freestmt((HSTMT) d->stmt);
-    }
-    if (e && e->magic == ENV_MAGIC) {
-	DBC *n, *p;
-
-	p = NULL;
-	n = e->dbcs;
-	while (n) {
-	    if (n == d) {
-		break;
-	    }
-	    p = n;
-	    n = n->next;
+    switch (attr) {
+    case SQL_AUTOCOMMIT:
+	d->autocommit = val == (SQLPOINTER) SQL_AUTOCOMMIT_ON;
+	if (d->autocommit && d->intrans) {
+	    return endtran(d, SQL_COMMIT, 1);
+	} else if (!d->autocommit) {
+	    s3stmt_spillall(d);
 	}
-	if (n) {
-	    if (p) {
-		p->next = d->next;
-	    } else {
-		e->dbcs = d->next;
-	    }
+	break;
+	return SQL_SUCCESS;
+    case SQL_ATTR_SQLITE_STATS_TIMING:
+	d->stats_timing = val != (SQLPOINTER) 0;
+	break;
+    case SQL_ATTR_SQLITE_STATS_RESET:
+	memset(&d->stats, 0, sizeof (d->stats));
+	d->s3cache_hits = d->s3cache_misses = 0;
+	break;
+#ifdef SQL_ATTR_METADATA_ID
+    case SQL_ATTR_METADATA_ID:
+	if (val == (SQLPOINTER) SQL_FALSE) {
+	    break;
 	}
-    }
-    drvrelgpps(d);
-    d->magic = DEAD_MAGIC;
-    if (d->trace) {
-	fclose(d->trace);
-    }
-#if defined(_WIN32) || defined(_WIN64)
-    d->owner = 0;
-    LeaveCriticalSection(&d->cs);
-    DeleteCriticalSection(&d->cs);
+	/* fall through */
 #endif
-    xfree(d);
-    ret = SQL_SUCCESS;
-done:
-#if defined(_WIN32) || defined(_WIN64)
-    if (e) {
-	LeaveCriticalSection(&e->cs);
+    default:
+	setstatd(d, -1, "option value changed", "01S02");
+	return SQL_SUCCESS_WITH_INFO;
     }
-#endif
+    return SQL_SUCCESS;
+}
+
+#ifndef WINTERFACE
+/**
+ * Set connect attribute of HDBC.
+ * @param dbc database connection handle
+ * @param attr option to be set
+ * @param val option value
+ * @param len size of option
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLSetConnectAttr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
+		  SQLINTEGER len)
+{
+    SQLRETURN ret;
+
+    HDBC_LOCK(dbc);
+    ret = drvsetconnectattr(dbc, attr, val, len);
+    HDBC_UNLOCK(dbc);
     return ret;
 }
+#endif
 
+#ifdef WINTERFACE
 /**
- * Free connection (HDBC).
+ * Set connect attribute of HDBC (UNICODE version).
  * @param dbc database connection handle
+ * @param attr option to be set
+ * @param val option value
+ * @param len size of option
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLFreeConnect(SQLHDBC dbc)
+SQLSetConnectAttrW(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
+		   SQLINTEGER len)
 {
-    return drvfreeconnect(dbc);
+    SQLRETURN ret;
+
+    HDBC_LOCK(dbc);
+    ret = drvsetconnectattr(dbc, attr, val, len);
+    HDBC_UNLOCK(dbc);
+    return ret;
 }
+#endif
 
 /**
- * Internal get connect attribute of HDBC.
+ * Internal get connect option of HDBC.
  * @param dbc database connection handle
- * @param attr option to be retrieved
- * @param val output buffer
- * @param bufmax size of output buffer
- * @param buflen output length
+ * @param opt option to be retrieved
+ * @param param output buffer
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvgetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
-		  SQLINTEGER bufmax, SQLINTEGER *buflen)
+drvgetconnectoption(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
 {
     DBC *d;
     SQLINTEGER dummy;
@@ -12106,127 +16077,72 @@ drvgetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
 	return SQL_INVALID_HANDLE;
     }
     d = (DBC *) dbc;
-    if (!val) {
-	val = (SQLPOINTER) &dummy;
-    }
-    if (!buflen) {
-	buflen = &dummy;
+    if (!param) {
+	param = (SQLPOINTER) &dummy;
     }
-    switch (attr) {
-    case SQL_ATTR_CONNECTION_DEAD:
-	*((SQLINTEGER *) val) = d->sqlite ? SQL_CD_FALSE : SQL_CD_TRUE;
-	*buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_ATTR_ACCESS_MODE:
-	*((SQLINTEGER *) val) = SQL_MODE_READ_WRITE;
-	*buflen = sizeof (SQLINTEGER);
+    switch (opt) {
+    case SQL_ACCESS_MODE:
+	*((SQLINTEGER *) param) = SQL_MODE_READ_WRITE;
 	break;
-    case SQL_ATTR_AUTOCOMMIT:
-	*((SQLINTEGER *) val) =
+    case SQL_AUTOCOMMIT:
+	*((SQLINTEGER *) param) =
 	    d->autocommit ? SQL_AUTOCOMMIT_ON : SQL_AUTOCOMMIT_OFF;
-	*buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_ATTR_LOGIN_TIMEOUT:
-	*((SQLINTEGER *) val) = 100;
-	*buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_ATTR_ODBC_CURSORS:
-	*((SQLINTEGER *) val) = SQL_CUR_USE_DRIVER;
-	*buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_ATTR_PACKET_SIZE:
-	*((SQLINTEGER *) val) = 16384;
-	*buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_ATTR_TXN_ISOLATION:
-	*((SQLINTEGER *) val) = SQL_TXN_SERIALIZABLE;
-	*buflen = sizeof (SQLINTEGER);
-	break;
-    case SQL_ATTR_TRACEFILE:
-    case SQL_ATTR_TRANSLATE_LIB:
-	*((SQLCHAR *) val) = 0;
-	*buflen = 0;
 	break;
-    case SQL_ATTR_CURRENT_CATALOG:
-#if defined(_WIN32) || defined(_WIN64)
-	if (d->xcelqrx) {
-	    if ((bufmax > 4) && (val != (SQLPOINTER) &dummy)) {
-		strcpy((char *) val, "main");
-		*buflen = 4;
-		break;
-	    }
-	}
-#endif
-	*((SQLCHAR *) val) = 0;
-	*buflen = 0;
+    case SQL_LOGIN_TIMEOUT:
+	*((SQLINTEGER *) param) = 100;
 	break;
-    case SQL_ATTR_TRACE:
-    case SQL_ATTR_QUIET_MODE:
-    case SQL_ATTR_TRANSLATE_OPTION:
-    case SQL_ATTR_KEYSET_SIZE:
-    case SQL_ATTR_QUERY_TIMEOUT:
-	*((SQLINTEGER *) val) = 0;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_ODBC_CURSORS:
+	*((SQLINTEGER *) param) = SQL_CUR_USE_DRIVER;
 	break;
-    case SQL_ATTR_PARAM_BIND_TYPE:
-	*((SQLULEN *) val) = SQL_PARAM_BIND_BY_COLUMN;
-	*buflen = sizeof (SQLUINTEGER);
+    case SQL_PACKET_SIZE:
+	*((SQLINTEGER *) param) = 16384;
 	break;
-    case SQL_ATTR_ROW_BIND_TYPE:
-	*((SQLULEN *) val) = SQL_BIND_BY_COLUMN;
-	*buflen = sizeof (SQLULEN);
+    case SQL_TXN_ISOLATION:
+	*((SQLINTEGER *) param) = SQL_TXN_SERIALIZABLE;
 	break;
-    case SQL_ATTR_USE_BOOKMARKS:
-	*((SQLINTEGER *) val) = SQL_UB_OFF;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_OPT_TRACE:
+    case SQL_OPT_TRACEFILE:
+    case SQL_QUIET_MODE:
+    case SQL_TRANSLATE_DLL:
+    case SQL_TRANSLATE_OPTION:
+    case SQL_KEYSET_SIZE:
+    case SQL_QUERY_TIMEOUT:
+    case SQL_BIND_TYPE:
+    case SQL_CURRENT_QUALIFIER:
+	*((SQLINTEGER *) param) = 0;
 	break;
-    case SQL_ATTR_ASYNC_ENABLE:
-	*((SQLINTEGER *) val) = SQL_ASYNC_ENABLE_OFF;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_USE_BOOKMARKS:
+	*((SQLINTEGER *) param) = SQL_UB_OFF;
 	break;
-    case SQL_ATTR_NOSCAN:
-	*((SQLINTEGER *) val) = SQL_NOSCAN_ON;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_ASYNC_ENABLE:
+	*((SQLINTEGER *) param) = SQL_ASYNC_ENABLE_OFF;
 	break;
-    case SQL_ATTR_CONCURRENCY:
-	*((SQLINTEGER *) val) = SQL_CONCUR_LOCK;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_NOSCAN:
+	*((SQLINTEGER *) param) = SQL_NOSCAN_ON;
 	break;
-#ifdef SQL_ATTR_CURSOR_SENSITIVITY
-    case SQL_ATTR_CURSOR_SENSITIVITY:
-	*((SQLINTEGER *) val) = SQL_UNSPECIFIED;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_CONCURRENCY:
+	*((SQLINTEGER *) param) = SQL_CONCUR_LOCK;
 	break;
-#endif
-    case SQL_ATTR_SIMULATE_CURSOR:
-	*((SQLINTEGER *) val) = SQL_SC_NON_UNIQUE;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_SIMULATE_CURSOR:
+	*((SQLINTEGER *) param) = SQL_SC_NON_UNIQUE;
 	break;
-    case SQL_ATTR_MAX_ROWS:
-	*((SQLINTEGER *) val) = 0;
-	*buflen = sizeof (SQLINTEGER);
-    case SQL_ATTR_MAX_LENGTH:
-	*((SQLINTEGER *) val) = 1000000000;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_MAX_ROWS:
+	*((SQLINTEGER *) param) = 0;
 	break;
-    case SQL_ATTR_CURSOR_TYPE:
-	*((SQLINTEGER *) val) = d->curtype;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_ROWSET_SIZE:
+    case SQL_MAX_LENGTH:
+	*((SQLINTEGER *) param) = 1000000000;
 	break;
-    case SQL_ATTR_RETRIEVE_DATA:
-	*((SQLINTEGER *) val) = SQL_RD_ON;
-	*buflen = sizeof (SQLINTEGER);
+    case SQL_CURSOR_TYPE:
+	*((SQLINTEGER *) param) = d->curtype;
+	break;
+    case SQL_RETRIEVE_DATA:
+	*((SQLINTEGER *) param) = SQL_RD_ON;
 	break;
-#ifdef SQL_ATTR_METADATA_ID
-    case SQL_ATTR_METADATA_ID:
-	*((SQLULEN *) val) = SQL_FALSE;
-	return SQL_SUCCESS;
-#endif
     default:
-	*((SQLINTEGER *) val) = 0;
-	*buflen = sizeof (SQLINTEGER);
-	setstatd(d, -1, "unsupported connect attribute %d",
-		 (*d->ov3) ? "HYC00" : "S1C00", (int) attr);
+	*((SQLINTEGER *) param) = 0;
+	setstatd(d, -1, "unsupported connect option %d",
+		 (*d->ov3) ? "HYC00" : "S1C00", opt);
 	return SQL_ERROR;
     }
     return SQL_SUCCESS;
@@ -12234,23 +16150,20 @@ drvgetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
 
 #ifndef WINTERFACE
 /**
- * Get connect attribute of HDBC.
+ * Get connect option of HDBC.
  * @param dbc database connection handle
- * @param attr option to be retrieved
- * @param val output buffer
- * @param bufmax size of output buffer
- * @param buflen output length
+ * @param opt option to be retrieved
+ * @param param output buffer
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetConnectAttr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
-		  SQLINTEGER bufmax, SQLINTEGER *buflen)
+SQLGetConnectOption(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
 {
     SQLRETURN ret;
 
     HDBC_LOCK(dbc);
-    ret = drvgetconnectattr(dbc, attr, val, bufmax, buflen);
+    ret = drvgetconnectoption(dbc, opt, param);
     HDBC_UNLOCK(dbc);
     return ret;
 }
@@ -12258,64 +16171,30 @@ SQLGetConnectAttr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
 
 #ifdef WINTERFACE
 /**
- * Get connect attribute of HDBC (UNICODE version).
+ * Get connect option of HDBC (UNICODE version).
  * @param dbc database connection handle
- * @param attr option to be retrieved
- * @param val output buffer
- * @param bufmax size of output buffer
- * @param buflen output length
+ * @param opt option to be retrieved
+ * @param param output buffer
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetConnectAttrW(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
-		   SQLINTEGER bufmax, SQLINTEGER *buflen)
+SQLGetConnectOptionW(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
 {
     SQLRETURN ret;
-    SQLINTEGER len = 0;
 
     HDBC_LOCK(dbc);
-    ret = drvgetconnectattr(dbc, attr, val, bufmax, &len);
-    if (ret == SQL_SUCCESS) {
-	SQLWCHAR *v = NULL;
-
-	switch (attr) {
-	case SQL_ATTR_TRACEFILE:
-	case SQL_ATTR_CURRENT_CATALOG:
-	case SQL_ATTR_TRANSLATE_LIB:
-	    if (val) {
-		if (len > 0) {
-		    v = uc_from_utf((SQLCHAR *) val, len);
-		    if (v) {
-			int vmax = bufmax / sizeof (SQLWCHAR);
-
-			uc_strncpy(val, v, vmax);
-			if (len < vmax) {
-			    len = min(vmax, uc_strlen(v));
-			    v[len] = 0;
-			} else {
-			    len = vmax;
-			}
-			uc_free(v);
-			len *= sizeof (SQLWCHAR);
-		    } else {
-			len = 0;
-		    }
-		}
-		if (len <= 0) {
-		    len = 0;
-		    if (bufmax >= sizeof (SQLWCHAR)) {
-			*((SQLWCHAR *)val) = 0;
-		    }
-		}
-	    } else {
-		len *= sizeof (SQLWCHAR);
+    ret = drvgetconnectoption(dbc, opt, param);
+    if (SQL_SUCCEEDED(ret)) {
+	switch (opt) {
+	case SQL_OPT_TRACEFILE:
+	case SQL_CURRENT_QUALIFIER:
+	case SQL_TRANSLATE_DLL:
+	    if (param) {
+		*(SQLWCHAR *) param = 0;
 	    }
 	    break;
 	}
-	if (buflen) {
-	    *buflen = len;
-	}
     }
     HDBC_UNLOCK(dbc);
     return ret;
@@ -12323,17 +16202,15 @@ SQLGetConnectAttrW(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
 #endif
 
 /**
- * Internal set connect attribute of HDBC.
+ * Internal set option on HDBC.
  * @param dbc database connection handle
- * @param attr option to be set
- * @param val option value
- * @param len size of option
+ * @param opt option to be set
+ * @param param option value
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvsetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
-		  SQLINTEGER len)
+drvsetconnectoption(SQLHDBC dbc, SQLUSMALLINT opt, SQLUINTEGER param)
 {
     DBC *d;
 
@@ -12341,23 +16218,15 @@ drvsetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
 	return SQL_INVALID_HANDLE;
     }
     d = (DBC *) dbc;
-    switch (attr) {
+    switch (opt) {
     case SQL_AUTOCOMMIT:
-	d->autocommit = val == (SQLPOINTER) SQL_AUTOCOMMIT_ON;
+	d->autocommit = param == SQL_AUTOCOMMIT_ON;
 	if (d->autocommit && d->intrans) {
 	    return endtran(d, SQL_COMMIT, 1);
 	} else if (!d->autocommit) {
-	    s3stmt_end(d->cur_s3stmt);
+	    s3stmt_spillall(d);
 	}
 	break;
-	return SQL_SUCCESS;
-#ifdef SQL_ATTR_METADATA_ID
-    case SQL_ATTR_METADATA_ID:
-	if (val == (SQLPOINTER) SQL_FALSE) {
-	    break;
-	}
-	/* fall through */
-#endif
     default:
 	setstatd(d, -1, "option value changed", "01S02");
 	return SQL_SUCCESS_WITH_INFO;
@@ -12367,155 +16236,496 @@ drvsetconnectattr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
 
 #ifndef WINTERFACE
 /**
- * Set connect attribute of HDBC.
+ * Set option on HDBC.
  * @param dbc database connection handle
- * @param attr option to be set
- * @param val option value
- * @param len size of option
+ * @param opt option to be set
+ * @param param option value
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLSetConnectAttr(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
-		  SQLINTEGER len)
+SQLSetConnectOption(SQLHDBC dbc, SQLUSMALLINT opt, SQLULEN param)
 {
     SQLRETURN ret;
 
     HDBC_LOCK(dbc);
-    ret = drvsetconnectattr(dbc, attr, val, len);
+    ret = drvsetconnectoption(dbc, opt, param);
+    HDBC_UNLOCK(dbc);
+    return ret;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Set option on HDBC (UNICODE version).
+ * @param dbc database connection handle
+ * @param opt option to be set
+ * @param param option value
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLSetConnectOptionW(SQLHDBC dbc, SQLUSMALLINT opt, SQLULEN param)
+{
+    SQLRETURN ret;
+
+    HDBC_LOCK(dbc);
+    ret = drvsetconnectoption(dbc, opt, param);
     HDBC_UNLOCK(dbc);
     return ret;
 }
-#endif
+#endif
+
+/**
+ * Handling of SQLConnect() connection attributes
+ * for standalone operation without driver manager,
+ * and of driver connection strings.
+ * @param dsn DSN/driver connection string
+ * @param attr attribute string to be retrieved
+ * @param out output buffer
+ * @param outLen length of output buffer
+ * @result true or false
+ */
+
+static int
+getdsnattr(char *dsn, char *attr, char *out, int outLen)
+{
+    char *str = dsn, *start;
+    int len = strlen(attr);
+
+    while (*str) {
+	while (*str && *str == ';') {
+	    ++str;
+	}
+	start = str;
+	if ((str = strchr(str, '=')) == NULL) {
+	    return 0;
+	}
+	if (str - start == len && strncasecmp(start, attr, len) == 0) {
+	    start = ++str;
+	    while (*str && *str != ';') {
+		++str;
+	    }
+	    len = min(outLen - 1, str - start);
+	    strncpy(out, start, len);
+	    out[len] = '\0';
+	    return 1;
+	}
+	while (*str && *str != ';') {
+	    ++str;
+	}
+    }
+    return 0;
+}
+
+/**
+ * Performance related DSN options. Entries with a PRAGMA are
+ * applied right after the database is opened, in this order,
+ * see perfsetup() and setsqliteopts().
+ */
+
+static const struct {
+    char *key;			/**< DSN option */
+    char *pragma;		/**< PRAGMA name or NULL */
+    double minval;		/**< Min. value of number */
+    double maxval;		/**< Max. value of number */
+    int pow2;			/**< True when number must be power of 2 */
+    char *words;		/**< Allowed keywords "A|B" or NULL */
+} perfinfo[] = {
+    { "Profile", NULL, 0, 0, 0, NULL },
+    { "PageSize", "page_size", 512, 65536, 1, NULL },
+    { "CacheSize", "cache_size", -2147483648.0, 2147483647.0, 0, NULL },
+    { "MmapSize", "mmap_size", 0, 1099511627776.0, 0, NULL },
+    { "TempStore", "temp_store", 0, 2, 0, "DEFAULT|FILE|MEMORY" },
+    { "WalAutoCheckpoint", "wal_autocheckpoint", 0, 2147483647.0, 0, NULL },
+    { "SharedCache", NULL, 0, 0, 0, NULL },
+};
+
+#define NPERFINFO (int) (sizeof (perfinfo) / sizeof (perfinfo[0]))
+
+/**
+ * Presets of the Profile DSN option written as DSN options;
+ * options given explicitly take precedence.
+ */
+
+static const struct {
+    char *name;			/**< Profile name */
+    char *opts;			/**< DSN options */
+} perfprofiles[] = {
+    { "readheavy", "MmapSize=268435456;CacheSize=-65536;TempStore=MEMORY" },
+    { "writeheavy", "CacheSize=-32768;TempStore=MEMORY;"
+      "WalAutoCheckpoint=4000" },
+    { "bulkload", "CacheSize=-262144;TempStore=MEMORY;"
+      "WalAutoCheckpoint=20000" },
+};
+
+/**
+ * Collect performance related DSN options (see perfinfo[]).
+ * @param attrs connect attribute string or NULL
+ * @param dsn data source name for ODBC.INI lookup or NULL
+ * @param out output buffer, receives "Key=value;..." of given options
+ * @param outLen length of output buffer
+ */
+
+static void
+getperfopts(char *attrs, char *dsn, char *out, int outLen)
+{
+    char val[64];
+    int i, len = 0, n;
+
+    out[0] = '\0';
+    for (i = 0; i < NPERFINFO; i++) {
+	val[0] = '\0';
+	if (attrs) {
+	    getdsnattr(attrs, perfinfo[i].key, val, sizeof (val));
+	}
+#ifndef WITHOUT_DRIVERMGR
+	if (!val[0] && dsn && dsn[0]) {
+	    SQLGetPrivateProfileString(dsn, perfinfo[i].key, "",
+				       val, sizeof (val), ODBC_INI);
+	}
+#endif
+	if (!val[0]) {
+	    continue;
+	}
+	n = strlen(perfinfo[i].key) + strlen(val) + 2;
+	if (len + n >= outLen) {
+	    break;
+	}
+	sprintf(out + len, "%s=%s;", perfinfo[i].key, val);
+	len += n;
+    }
+}
+
+/**
+ * Validate value of performance related DSN option.
+ * @param i index into perfinfo[]
+ * @param val value string, numbers are rewritten in plain digits
+ * @result true when valid
+ */
+
+static int
+perfcheck(int i, char *val)
+{
+    char *endp = NULL, *w = perfinfo[i].words;
+    int len = strlen(val);
+    double num;
+
+    while (w && *w) {
+	if (strncasecmp(w, val, len) == 0 && (w[len] == '|' || !w[len])) {
+	    return 1;
+	}
+	w = strchr(w, '|');
+	w = w ? w + 1 : NULL;
+    }
+    num = strtod(val, &endp);
+    if (!endp || endp == val || *endp != '\0' || num != (sqlite_int64) num ||
+	num < perfinfo[i].minval || num > perfinfo[i].maxval) {
+	return 0;
+    }
+    if (perfinfo[i].pow2) {
+	sqlite_int64 n = (sqlite_int64) num;
+
+	if (n & (n - 1)) {
+	    return 0;
+	}
+    }
+    sprintf(val, "%.0f", num);
+    return 1;
+}
 
-#ifdef WINTERFACE
 /**
- * Set connect attribute of HDBC (UNICODE version).
- * @param dbc database connection handle
- * @param attr option to be set
- * @param val option value
- * @param len size of option
- * @result ODBC error code
+ * Setup performance PRAGMAs of DBC from DSN options.
+ * @param d DBC pointer
+ * @param opts DSN options collected by getperfopts()
+ *
+ * Invalid values are ignored and reported in the trace file.
  */
 
-SQLRETURN SQL_API
-SQLSetConnectAttrW(SQLHDBC dbc, SQLINTEGER attr, SQLPOINTER val,
-		   SQLINTEGER len)
-{
-    SQLRETURN ret;
-
-    HDBC_LOCK(dbc);
-    ret = drvsetconnectattr(dbc, attr, val, len);
-    HDBC_UNLOCK(dbc);
-    return ret;
+static void
+perfsetup(DBC *d, char *opts)
+{
+    char val[64], sql[1024], *preset = NULL;
+    int i, k, len = 0;
+
+    freep(&d->perfsql);
+    val[0] = '\0';
+    getdsnattr(opts, "profile", val, sizeof (val));
+    if (val[0]) {
+	for (k = 0; k < (int) array_size(perfprofiles); k++) {
+	    if (strcasecmp(val, perfprofiles[k].name) == 0) {
+		preset = perfprofiles[k].opts;
+		break;
+	    }
+	}
+	if (!preset && d->trace) {
+	    fprintf(d->trace, "-- ignored Profile=%s\n", val);
+	    fflush(d->trace);
+	}
+    }
+    sql[0] = '\0';
+    for (i = 0; i < NPERFINFO; i++) {
+	if (!perfinfo[i].pragma) {
+	    continue;
+	}
+	val[0] = '\0';
+	getdsnattr(opts, perfinfo[i].key, val, sizeof (val));
+	if (val[0] && !perfcheck(i, val)) {
+	    if (d->trace) {
+		fprintf(d->trace, "-- ignored %s=%s\n", perfinfo[i].key, val);
+		fflush(d->trace);
+	    }
+	    val[0] = '\0';
+	}
+	if (!val[0] && preset) {
+	    getdsnattr(preset, perfinfo[i].key, val, sizeof (val));
+	}
+	if (!val[0]) {
+	    continue;
+	}
+	len += sprintf(sql + len, "PRAGMA %s = %s;", perfinfo[i].pragma, val);
+    }
+    if (sql[0]) {
+	d->perfsql = xstrdup(sql);
+    }
+    val[0] = '\0';
+    getdsnattr(opts, "sharedcache", val, sizeof (val));
+    d->sharedcache = getbool(val);
 }
-#endif
 
 /**
- * Internal get connect option of HDBC.
+ * Internal connect to SQLite database.
  * @param dbc database connection handle
- * @param opt option to be retrieved
- * @param param output buffer
+ * @param dsn DSN string
+ * @param dsnLen length of DSN string or SQL_NTS
+ * @param pwd password or NULL
+ * @param pwdLen length of password or SQL_NTS
+ * @param isu true/false: file name is UTF8 encoded
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvgetconnectoption(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
+drvconnect(SQLHDBC dbc, SQLCHAR *dsn, SQLSMALLINT dsnLen, char *pwd,
+	   int pwdLen, int isu)
 {
     DBC *d;
-    SQLINTEGER dummy;
+    int len;
+    SQLRETURN ret;
+    char buf[SQL_MAX_MESSAGE_LENGTH * 6], dbname[SQL_MAX_MESSAGE_LENGTH];
+    char busy[SQL_MAX_MESSAGE_LENGTH / 4], tracef[SQL_MAX_MESSAGE_LENGTH];
+    char loadext[SQL_MAX_MESSAGE_LENGTH];
+    char sflag[32], spflag[32], ntflag[32], nwflag[32], biflag[32];
+    char snflag[32], lnflag[32], ncflag[32], fkflag[32], jmode[32];
+    char jdflag[32], scsize[32], lsflag[32], tbflag[32], bpflag[64];
+    char poflag[64], perfopts[SQL_MAX_MESSAGE_LENGTH];
+#if defined(_WIN32) || defined(_WIN64)
+    char oemcp[32];
+#endif
 
     if (dbc == SQL_NULL_HDBC) {
 	return SQL_INVALID_HANDLE;
     }
     d = (DBC *) dbc;
-    if (!param) {
-	param = (SQLPOINTER) &dummy;
+    if (d->magic != DBC_MAGIC) {
+	return SQL_INVALID_HANDLE;
     }
-    switch (opt) {
-    case SQL_ACCESS_MODE:
-	*((SQLINTEGER *) param) = SQL_MODE_READ_WRITE;
-	break;
-    case SQL_AUTOCOMMIT:
-	*((SQLINTEGER *) param) =
-	    d->autocommit ? SQL_AUTOCOMMIT_ON : SQL_AUTOCOMMIT_OFF;
-	break;
-    case SQL_LOGIN_TIMEOUT:
-	*((SQLINTEGER *) param) = 100;
-	break;
-    case SQL_ODBC_CURSORS:
-	*((SQLINTEGER *) param) = SQL_CUR_USE_DRIVER;
-	break;
-    case SQL_PACKET_SIZE:
-	*((SQLINTEGER *) param) = 16384;
-	break;
-    case SQL_TXN_ISOLATION:
-	*((SQLINTEGER *) param) = SQL_TXN_SERIALIZABLE;
-	break;
-    case SQL_OPT_TRACE:
-    case SQL_OPT_TRACEFILE:
-    case SQL_QUIET_MODE:
-    case SQL_TRANSLATE_DLL:
-    case SQL_TRANSLATE_OPTION:
-    case SQL_KEYSET_SIZE:
-    case SQL_QUERY_TIMEOUT:
-    case SQL_BIND_TYPE:
-    case SQL_CURRENT_QUALIFIER:
-	*((SQLINTEGER *) param) = 0;
-	break;
-    case SQL_USE_BOOKMARKS:
-	*((SQLINTEGER *) param) = SQL_UB_OFF;
-	break;
-    case SQL_ASYNC_ENABLE:
-	*((SQLINTEGER *) param) = SQL_ASYNC_ENABLE_OFF;
-	break;
-    case SQL_NOSCAN:
-	*((SQLINTEGER *) param) = SQL_NOSCAN_ON;
-	break;
-    case SQL_CONCURRENCY:
-	*((SQLINTEGER *) param) = SQL_CONCUR_LOCK;
-	break;
-    case SQL_SIMULATE_CURSOR:
-	*((SQLINTEGER *) param) = SQL_SC_NON_UNIQUE;
-	break;
-    case SQL_MAX_ROWS:
-	*((SQLINTEGER *) param) = 0;
-	break;
-    case SQL_ROWSET_SIZE:
-    case SQL_MAX_LENGTH:
-	*((SQLINTEGER *) param) = 1000000000;
-	break;
-    case SQL_CURSOR_TYPE:
-	*((SQLINTEGER *) param) = d->curtype;
-	break;
-    case SQL_RETRIEVE_DATA:
-	*((SQLINTEGER *) param) = SQL_RD_ON;
-	break;
-    default:
-	*((SQLINTEGER *) param) = 0;
-	setstatd(d, -1, "unsupported connect option %d",
-		 (*d->ov3) ? "HYC00" : "S1C00", opt);
+    if (d->sqlite != NULL) {
+	setstatd(d, -1, "connection already established", "08002");
+	return SQL_ERROR;
+    }
+    buf[0] = '\0';
+    if (dsnLen == SQL_NTS) {
+	len = sizeof (buf) - 1;
+    } else {
+	len = min(sizeof (buf) - 1, dsnLen);
+    }
+    if (dsn != NULL) {
+	strncpy(buf, (char *) dsn, len);
+    }
+    buf[len] = '\0';
+    if (buf[0] == '\0') {
+	setstatd(d, -1, "invalid DSN", (*d->ov3) ? "HY090" : "S1090");
 	return SQL_ERROR;
     }
-    return SQL_SUCCESS;
+#if defined(_WIN32) || defined(_WIN64)
+    /*
+     * When DSN is in UTF it must be converted to ANSI
+     * here for ANSI SQLGetPrivateProfileString()
+     */
+    if (isu) {
+	char *cdsn = utf_to_wmb(buf, len);
+
+	if (!cdsn) {
+	    setstatd(d, -1, "out of memory", (*d->ov3) ? "HY000" : "S1000");
+	    return SQL_ERROR;
+	}
+	strcpy(buf, cdsn);
+	uc_free(cdsn);
+    }
+#endif
+    busy[0] = '\0';
+    dbname[0] = '\0';
+#ifdef WITHOUT_DRIVERMGR
+    getdsnattr(buf, "database", dbname, sizeof (dbname));
+    if (dbname[0] == '\0') {
+	strncpy(dbname, buf, sizeof (dbname));
+	dbname[sizeof (dbname) - 1] = '\0';
+    }
+    getdsnattr(buf, "timeout", busy, sizeof (busy));
+    sflag[0] = '\0';
+    getdsnattr(buf, "stepapi", sflag, sizeof (sflag));
+    spflag[0] = '\0';
+    getdsnattr(buf, "syncpragma", spflag, sizeof (spflag));
+    ntflag[0] = '\0';
+    getdsnattr(buf, "notxn", ntflag, sizeof (ntflag));
+    nwflag[0] = '\0';
+    getdsnattr(buf, "nowchar", nwflag, sizeof (nwflag));
+    snflag[0] = '\0';
+    getdsnattr(buf, "shortnames", snflag, sizeof (snflag));
+    lnflag[0] = '\0';
+    getdsnattr(buf, "longnames", lnflag, sizeof (lnflag));
+    ncflag[0] = '\0';
+    getdsnattr(buf, "nocreat", ncflag, sizeof (ncflag));
+    fkflag[0] = '\0';
+    getdsnattr(buf, "fksupport", fkflag, sizeof (fkflag));
+    loadext[0] = '\0';
+    getdsnattr(buf, "loadext", loadext, sizeof (loadext));
+    jmode[0] = '\0';
+    getdsnattr(buf, "journalmode", jmode, sizeof (jmode));
+    jdflag[0] = '\0';
+    getdsnattr(buf, "jdconv", jdflag, sizeof (jdflag));
+#if defined(_WIN32) || defined(_WIN64)
+    oemcp[0] = '\0';
+    getdsnattr(buf, "oemcp", oemcp, sizeof (oemcp));
+#endif
+    biflag[0] = '\0';
+    getdsnattr(buf, "bigint", biflag, sizeof (biflag));
+    scsize[0] = '\0';
+    getdsnattr(buf, "stmtcache", scsize, sizeof (scsize));
+    lsflag[0] = '\0';
+    getdsnattr(buf, "lobstream", lsflag, sizeof (lsflag));
+    bpflag[0] = '\0';
+    getdsnattr(buf, "busypolicy", bpflag, sizeof (bpflag));
+    poflag[0] = '\0';
+    getdsnattr(buf, "pool", poflag, sizeof (poflag));
+    getperfopts(buf, NULL, perfopts, sizeof (perfopts));
+#else
+    SQLGetPrivateProfileString(buf, "timeout", "100000",
+			       busy, sizeof (busy), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "database", "",
+			       dbname, sizeof (dbname), ODBC_INI);
+#if defined(_WIN32) || defined(_WIN64)
+    /* database name read from registry is not UTF8 !!! */
+    isu = 0;
+#endif
+    SQLGetPrivateProfileString(buf, "stepapi", "",
+			       sflag, sizeof (sflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "syncpragma", "NORMAL",
+			       spflag, sizeof (spflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "notxn", "",
+			       ntflag, sizeof (ntflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "nowchar", "",
+			       nwflag, sizeof (nwflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "shortnames", "",
+			       snflag, sizeof (snflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "longnames", "",
+			       lnflag, sizeof (lnflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "nocreat", "",
+			       ncflag, sizeof (ncflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "fksupport", "",
+			       fkflag, sizeof (fkflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "loadext", "",
+			       loadext, sizeof (loadext), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "journalmode", "",
+			       jmode, sizeof (jmode), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "jdconv", "",
+			       jdflag, sizeof (jdflag), ODBC_INI);
+#if defined(_WIN32) || defined(_WIN64)
+    SQLGetPrivateProfileString(buf, "oemcp", "1",
+			       oemcp, sizeof (oemcp), ODBC_INI);
+#endif
+    SQLGetPrivateProfileString(buf, "bigint", "",
+			       biflag, sizeof (biflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "stmtcache", "",
+			       scsize, sizeof (scsize), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "lobstream", "",
+			       lsflag, sizeof (lsflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "busypolicy", "",
+			       bpflag, sizeof (bpflag), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "pool", "",
+			       poflag, sizeof (poflag), ODBC_INI);
+    getperfopts(NULL, buf, perfopts, sizeof (perfopts));
+#endif
+    tracef[0] = '\0';
+    tbflag[0] = '\0';
+#ifdef WITHOUT_DRIVERMGR
+    getdsnattr(buf, "tracefile", tracef, sizeof (tracef));
+    getdsnattr(buf, "tracebinary", tbflag, sizeof (tbflag));
+#else
+    SQLGetPrivateProfileString(buf, "tracefile", "",
+			       tracef, sizeof (tracef), ODBC_INI);
+    SQLGetPrivateProfileString(buf, "tracebinary", "",
+			       tbflag, sizeof (tbflag), ODBC_INI);
+#endif
+    if (tracef[0] != '\0') {
+	if (getbool(tbflag)) {
+	    trcopen(d, tracef);
+	} else {
+	    d->trace = fopen(tracef, "a");
+	}
+    }
+    d->nowchar = getbool(nwflag);
+    d->shortnames = getbool(snflag);
+    d->longnames = getbool(lnflag);
+    d->nocreat = getbool(ncflag);
+    d->fksupport = getbool(fkflag);
+    d->jdconv = getbool(jdflag);
+#if defined(_WIN32) || defined(_WIN64)
+    d->oemcp = getbool(oemcp);
+#else
+    d->oemcp = 0;
+#endif
+    d->dobigint = getbool(biflag);
+    d->s3cache_max = getint(scsize, 0, 0, 10000);
+    d->lobstream = getint(lsflag, 0, 0, 0x40000000);
+    setbusypolicy(d, bpflag);
+    d->pwd = pwd;
+    d->pwdLen = 0;
+    if (d->pwd) {
+	d->pwdLen = (pwdLen == SQL_NTS) ? strlen(d->pwd) : pwdLen;
+    }
+    perfsetup(d, perfopts);
+    poolsetup(d, poflag, dbname, isu, spflag, jmode, loadext);
+    ret = dbopen(d, dbname, isu, (char *) dsn, sflag, spflag, ntflag,
+		  jmode, busy);
+    if (ret == SQL_SUCCESS && !d->pooled) {
+	dbloadext(d, loadext);
+    }
+    return ret;
 }
 
 #ifndef WINTERFACE
 /**
- * Get connect option of HDBC.
+ * Connect to SQLite database.
  * @param dbc database connection handle
- * @param opt option to be retrieved
- * @param param output buffer
+ * @param dsn DSN string
+ * @param dsnLen length of DSN string or SQL_NTS
+ * @param uid user id string or NULL
+ * @param uidLen length of user id string or SQL_NTS
+ * @param pwd password string or NULL
+ * @param pwdLen length of password string or SQL_NTS
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetConnectOption(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
+SQLConnect(SQLHDBC dbc, SQLCHAR *dsn, SQLSMALLINT dsnLen,
+	   SQLCHAR *uid, SQLSMALLINT uidLen,
+	   SQLCHAR *pwd, SQLSMALLINT pwdLen)
 {
     SQLRETURN ret;
 
     HDBC_LOCK(dbc);
-    ret = drvgetconnectoption(dbc, opt, param);
+    ret = drvconnect(dbc, dsn, dsnLen, (char *) pwd, pwdLen, 0);
     HDBC_UNLOCK(dbc);
     return ret;
 }
@@ -12523,1385 +16733,1671 @@ SQLGetConnectOption(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
 
 #ifdef WINTERFACE
 /**
- * Get connect option of HDBC (UNICODE version).
+ * Connect to SQLite database.
  * @param dbc database connection handle
- * @param opt option to be retrieved
- * @param param output buffer
+ * @param dsn DSN string
+ * @param dsnLen length of DSN string or SQL_NTS
+ * @param uid user id string or NULL
+ * @param uidLen length of user id string or SQL_NTS
+ * @param pwd password string or NULL
+ * @param pwdLen length of password string or SQL_NTS
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLGetConnectOptionW(SQLHDBC dbc, SQLUSMALLINT opt, SQLPOINTER param)
+SQLConnectW(SQLHDBC dbc, SQLWCHAR *dsn, SQLSMALLINT dsnLen,
+	    SQLWCHAR *uid, SQLSMALLINT uidLen,
+	    SQLWCHAR *pwd, SQLSMALLINT pwdLen)
 {
+    char *dsna = NULL;
+    char *pwda = NULL;
     SQLRETURN ret;
 
     HDBC_LOCK(dbc);
-    ret = drvgetconnectoption(dbc, opt, param);
-    if (SQL_SUCCEEDED(ret)) {
-	switch (opt) {
-	case SQL_OPT_TRACEFILE:
-	case SQL_CURRENT_QUALIFIER:
-	case SQL_TRANSLATE_DLL:
-	    if (param) {
-		*(SQLWCHAR *) param = 0;
-	    }
-	    break;
+    if (dsn) {
+	dsna = uc_to_utf_c(dsn, dsnLen);
+	if (!dsna) {
+	    DBC *d = (DBC *) dbc;
+
+	    setstatd(d, -1, "out of memory", (*d->ov3) ? "HY000" : "S1000");
+	    ret = SQL_ERROR;
+	    goto done;
+	}
+    }
+    if (pwd) {
+	pwda = uc_to_utf_c(pwd, pwdLen);
+	if (!pwda) {
+	    DBC *d = (DBC *) dbc;
+
+	    setstatd(d, -1, "out of memory", (*d->ov3) ? "HY000" : "S1000");
+	    ret = SQL_ERROR;
+	    goto done;
 	}
     }
+    ret = drvconnect(dbc, (SQLCHAR *) dsna, SQL_NTS, pwda, SQL_NTS, 1);
+done:
     HDBC_UNLOCK(dbc);
+    uc_free(dsna);
+    uc_free(pwda);
     return ret;
 }
 #endif
 
 /**
- * Internal set option on HDBC.
+ * Internal disconnect given HDBC.
  * @param dbc database connection handle
- * @param opt option to be set
- * @param param option value
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvsetconnectoption(SQLHDBC dbc, SQLUSMALLINT opt, SQLUINTEGER param)
+drvdisconnect(SQLHDBC dbc)
 {
     DBC *d;
+    int rc;
 
     if (dbc == SQL_NULL_HDBC) {
 	return SQL_INVALID_HANDLE;
     }
     d = (DBC *) dbc;
-    switch (opt) {
-    case SQL_AUTOCOMMIT:
-	d->autocommit = param == SQL_AUTOCOMMIT_ON;
-	if (d->autocommit && d->intrans) {
-	    return endtran(d, SQL_COMMIT, 1);
-	} else if (!d->autocommit) {
-	    s3stmt_end(d->cur_s3stmt);
+    if (d->magic != DBC_MAGIC) {
+	return SQL_INVALID_HANDLE;
+    }
+    if (d->intrans) {
+	setstatd(d, -1, "incomplete transaction", "25000");
+	return SQL_ERROR;
+    }
+    s3stmt_endall(d);
+    s3cache_flush(d);
+    sccache_flush(d);
+    if (d->sqlite) {
+	int pooled = poolput(d);
+
+	if (d->trace) {
+	    fprintf(d->trace, pooled ? "-- sqlite3_close (pooled): '%s'\n" :
+		    "-- sqlite3_close: '%s'\n", d->dbname);
+	    fflush(d->trace);
+	}
+	if (d->trcbuf) {
+	    trcevent(d, TRC_CLOSE, d->dbname);
+	}
+	if (!pooled) {
+	    rc = sqlite3_close(d->sqlite);
+	    if (rc == SQLITE_BUSY) {
+		setstatd(d, -1, "unfinished statements", "25000");
+		return SQL_ERROR;
+	    }
+	    d->sqlite = NULL;
+	    d->dbref = NULL;
 	}
-	break;
-    default:
-	setstatd(d, -1, "option value changed", "01S02");
-	return SQL_SUCCESS_WITH_INFO;
     }
+    freep(&d->poolkey);
+    freep(&d->dbname);
+    freep(&d->dsn);
     return SQL_SUCCESS;
 }
 
-#ifndef WINTERFACE
-/**
- * Set option on HDBC.
- * @param dbc database connection handle
- * @param opt option to be set
- * @param param option value
- * @result ODBC error code
- */
-
-SQLRETURN SQL_API
-SQLSetConnectOption(SQLHDBC dbc, SQLUSMALLINT opt, SQLULEN param)
-{
-    SQLRETURN ret;
-
-    HDBC_LOCK(dbc);
-    ret = drvsetconnectoption(dbc, opt, param);
-    HDBC_UNLOCK(dbc);
-    return ret;
-}
-#endif
-
-#ifdef WINTERFACE
 /**
- * Set option on HDBC (UNICODE version).
+ * Disconnect given HDBC.
  * @param dbc database connection handle
- * @param opt option to be set
- * @param param option value
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLSetConnectOptionW(SQLHDBC dbc, SQLUSMALLINT opt, SQLULEN param)
+SQLDisconnect(SQLHDBC dbc)
 {
     SQLRETURN ret;
 
     HDBC_LOCK(dbc);
-    ret = drvsetconnectoption(dbc, opt, param);
+    ret = drvdisconnect(dbc);
     HDBC_UNLOCK(dbc);
     return ret;
 }
-#endif
 
 #if defined(WITHOUT_DRIVERMGR) || (!defined(_WIN32) && !defined(_WIN64))
 
 /**
- * Handling of SQLConnect() connection attributes
- * for standalone operation without driver manager.
- * @param dsn DSN/driver connection string
- * @param attr attribute string to be retrieved
- * @param out output buffer
- * @param outLen length of output buffer
- * @result true or false
- */
-
-static int
-getdsnattr(char *dsn, char *attr, char *out, int outLen)
-{
-    char *str = dsn, *start;
-    int len = strlen(attr);
-
-    while (*str) {
-	while (*str && *str == ';') {
-	    ++str;
-	}
-	start = str;
-	if ((str = strchr(str, '=')) == NULL) {
-	    return 0;
-	}
-	if (str - start == len && strncasecmp(start, attr, len) == 0) {
-	    start = ++str;
-	    while (*str && *str != ';') {
-		++str;
-	    }
-	    len = min(outLen - 1, str - start);
-	    strncpy(out, start, len);
-	    out[len] = '\0';
-	    return 1;
-	}
-	while (*str && *str != ';') {
-	    ++str;
-	}
-    }
-    return 0;
-}
-#endif
-
-/**
- * Internal connect to SQLite database.
+ * Internal standalone (w/o driver manager) database connect.
  * @param dbc database connection handle
- * @param dsn DSN string
- * @param dsnLen length of DSN string or SQL_NTS
- * @param pwd password or NULL
- * @param pwdLen length of password or SQL_NTS
- * @param isu true/false: file name is UTF8 encoded
+ * @param hwnd dummy window handle or NULL
+ * @param connIn driver connect input string
+ * @param connInLen length of driver connect input string or SQL_NTS
+ * @param connOut driver connect output string
+ * @param connOutMax length of driver connect output string
+ * @param connOutLen output length of driver connect output string
+ * @param drvcompl completion type
  * @result ODBC error code
  */
 
 static SQLRETURN
-drvconnect(SQLHDBC dbc, SQLCHAR *dsn, SQLSMALLINT dsnLen, char *pwd,
-	   int pwdLen, int isu)
+drvdriverconnect(SQLHDBC dbc, SQLHWND hwnd,
+		 SQLCHAR *connIn, SQLSMALLINT connInLen,
+		 SQLCHAR *connOut, SQLSMALLINT connOutMax,
+		 SQLSMALLINT *connOutLen, SQLUSMALLINT drvcompl)
 {
     DBC *d;
     int len;
     SQLRETURN ret;
-    char buf[SQL_MAX_MESSAGE_LENGTH * 6], dbname[SQL_MAX_MESSAGE_LENGTH];
-    char busy[SQL_MAX_MESSAGE_LENGTH / 4], tracef[SQL_MAX_MESSAGE_LENGTH];
-    char loadext[SQL_MAX_MESSAGE_LENGTH];
-    char sflag[32], spflag[32], ntflag[32], nwflag[32], biflag[32];
-    char snflag[32], lnflag[32], ncflag[32], fkflag[32], jmode[32];
-    char jdflag[32];
-#if defined(_WIN32) || defined(_WIN64)
-    char oemcp[32];
-#endif
+    char buf[SQL_MAX_MESSAGE_LENGTH * 8], dbname[SQL_MAX_MESSAGE_LENGTH];
+    char dsn[SQL_MAX_MESSAGE_LENGTH], busy[SQL_MAX_MESSAGE_LENGTH / 4];
+    char tracef[SQL_MAX_MESSAGE_LENGTH], loadext[SQL_MAX_MESSAGE_LENGTH];
+    char pwd[SQL_MAX_MESSAGE_LENGTH];
+    char sflag[32], spflag[32], ntflag[32], snflag[32], lnflag[32];
+    char ncflag[32], nwflag[32], fkflag[32], jmode[32], biflag[32];
+    char jdflag[32], scsize[32], lsflag[32], tbflag[32], bpflag[64];
+    char poflag[64], perfopts[SQL_MAX_MESSAGE_LENGTH];
 
     if (dbc == SQL_NULL_HDBC) {
 	return SQL_INVALID_HANDLE;
     }
-    d = (DBC *) dbc;
-    if (d->magic != DBC_MAGIC) {
-	return SQL_INVALID_HANDLE;
+    if (drvcompl != SQL_DRIVER_COMPLETE &&
+	drvcompl != SQL_DRIVER_COMPLETE_REQUIRED &&
+	drvcompl != SQL_DRIVER_PROMPT &&
+	drvcompl != SQL_DRIVER_NOPROMPT) {
+	return SQL_NO_DATA;
     }
-    if (d->sqlite != NULL) {
+    d = (DBC *) dbc;
+    if (d->sqlite) {
 	setstatd(d, -1, "connection already established", "08002");
 	return SQL_ERROR;
     }
     buf[0] = '\0';
-    if (dsnLen == SQL_NTS) {
+    if (connInLen == SQL_NTS) {
 	len = sizeof (buf) - 1;
     } else {
-	len = min(sizeof (buf) - 1, dsnLen);
+	len = min(connInLen, sizeof (buf) - 1);
     }
-    if (dsn != NULL) {
-	strncpy(buf, (char *) dsn, len);
+    if (connIn != NULL) {
+	strncpy(buf, (char *) connIn, len);
     }
     buf[len] = '\0';
-    if (buf[0] == '\0') {
-	setstatd(d, -1, "invalid DSN", (*d->ov3) ? "HY090" : "S1090");
+    if (!buf[0]) {
+	setstatd(d, -1, "invalid connect attributes",
+		 (*d->ov3) ? "HY090" : "S1090");
 	return SQL_ERROR;
     }
-#if defined(_WIN32) || defined(_WIN64)
-    /*
-     * When DSN is in UTF it must be converted to ANSI
-     * here for ANSI SQLGetPrivateProfileString()
-     */
-    if (isu) {
-	char *cdsn = utf_to_wmb(buf, len);
+    dsn[0] = '\0';
+    getdsnattr(buf, "DSN", dsn, sizeof (dsn));
+
+    /* special case: connIn is sole DSN value without keywords */
+    if (!dsn[0] && !strchr(buf, ';') && !strchr(buf, '=')) {
+	strncpy(dsn, buf, sizeof (dsn) - 1);
+	dsn[sizeof (dsn) - 1] = '\0';
+    }
 
-	if (!cdsn) {
-	    setstatd(d, -1, "out of memory", (*d->ov3) ? "HY000" : "S1000");
-	    return SQL_ERROR;
-	}
-	strcpy(buf, cdsn);
-	uc_free(cdsn);
+    busy[0] = '\0';
+    getdsnattr(buf, "timeout", busy, sizeof (busy));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !busy[0]) {
+	SQLGetPrivateProfileString(dsn, "timeout", "100000",
+				   busy, sizeof (busy), ODBC_INI);
     }
 #endif
-    busy[0] = '\0';
     dbname[0] = '\0';
-#ifdef WITHOUT_DRIVERMGR
     getdsnattr(buf, "database", dbname, sizeof (dbname));
-    if (dbname[0] == '\0') {
-	strncpy(dbname, buf, sizeof (dbname));
-	dbname[sizeof (dbname) - 1] = '\0';
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !dbname[0]) {
+	SQLGetPrivateProfileString(dsn, "database", "",
+				   dbname, sizeof (dbname), ODBC_INI);
     }
-    getdsnattr(buf, "timeout", busy, sizeof (busy));
+#endif
     sflag[0] = '\0';
     getdsnattr(buf, "stepapi", sflag, sizeof (sflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !sflag[0]) {
+	SQLGetPrivateProfileString(dsn, "stepapi", "",
+				   sflag, sizeof (sflag), ODBC_INI);
+    }
+#endif
     spflag[0] = '\0';
     getdsnattr(buf, "syncpragma", spflag, sizeof (spflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !spflag[0]) {
+	SQLGetPrivateProfileString(dsn, "syncpragma", "NORMAL",
+				   spflag, sizeof (spflag), ODBC_INI);
+    }
+#endif
     ntflag[0] = '\0';
     getdsnattr(buf, "notxn", ntflag, sizeof (ntflag));
-    nwflag[0] = '\0';
-    getdsnattr(buf, "nowchar", nwflag, sizeof (nwflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !ntflag[0]) {
+	SQLGetPrivateProfileString(dsn, "notxn", "",
+				   ntflag, sizeof (ntflag), ODBC_INI);
+    }
+#endif
     snflag[0] = '\0';
     getdsnattr(buf, "shortnames", snflag, sizeof (snflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !snflag[0]) {
+	SQLGetPrivateProfileString(dsn, "shortnames", "",
+				   snflag, sizeof (snflag), ODBC_INI);
+    }
+#endif
     lnflag[0] = '\0';
     getdsnattr(buf, "longnames", lnflag, sizeof (lnflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !lnflag[0]) {
+	SQLGetPrivateProfileString(dsn, "longnames", "",
+				   lnflag, sizeof (lnflag), ODBC_INI);
+    }
+#endif
     ncflag[0] = '\0';
     getdsnattr(buf, "nocreat", ncflag, sizeof (ncflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !ncflag[0]) {
+	SQLGetPrivateProfileString(dsn, "nocreat", "",
+				   ncflag, sizeof (ncflag), ODBC_INI);
+    }
+#endif
+    nwflag[0] = '\0';
+    getdsnattr(buf, "nowchar", nwflag, sizeof (nwflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !nwflag[0]) {
+	SQLGetPrivateProfileString(dsn, "nowchar", "",
+				   nwflag, sizeof (nwflag), ODBC_INI);
+    }
+#endif
     fkflag[0] = '\0';
     getdsnattr(buf, "fksupport", fkflag, sizeof (fkflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !fkflag[0]) {
+	SQLGetPrivateProfileString(dsn, "fksupport", "",
+				   fkflag, sizeof (fkflag), ODBC_INI);
+    }
+#endif
     loadext[0] = '\0';
     getdsnattr(buf, "loadext", loadext, sizeof (loadext));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !loadext[0]) {
+	SQLGetPrivateProfileString(dsn, "loadext", "",
+				   loadext, sizeof (loadext), ODBC_INI);
+    }
+#endif
     jmode[0] = '\0';
     getdsnattr(buf, "journalmode", jmode, sizeof (jmode));
-    jdflag[0] = '\0';
-    getdsnattr(buf, "jdconv", jdflag, sizeof (jdflag));
-#if defined(_WIN32) || defined(_WIN64)
-    oemcp[0] = '\0';
-    getdsnattr(buf, "oemcp", oemcp, sizeof (oemcp));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !jmode[0]) {
+	SQLGetPrivateProfileString(dsn, "journalmode", "",
+				   jmode, sizeof (jmode), ODBC_INI);
+    }
 #endif
     biflag[0] = '\0';
     getdsnattr(buf, "bigint", biflag, sizeof (biflag));
-#else
-    SQLGetPrivateProfileString(buf, "timeout", "100000",
-			       busy, sizeof (busy), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "database", "",
-			       dbname, sizeof (dbname), ODBC_INI);
-#if defined(_WIN32) || defined(_WIN64)
-    /* database name read from registry is not UTF8 !!! */
-    isu = 0;
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !biflag[0]) {
+	SQLGetPrivateProfileString(dsn, "bigint", "",
+				   biflag, sizeof (biflag), ODBC_INI);
+    }
 #endif
-    SQLGetPrivateProfileString(buf, "stepapi", "",
-			       sflag, sizeof (sflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "syncpragma", "NORMAL",
-			       spflag, sizeof (spflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "notxn", "",
-			       ntflag, sizeof (ntflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "nowchar", "",
-			       nwflag, sizeof (nwflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "shortnames", "",
-			       snflag, sizeof (snflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "longnames", "",
-			       lnflag, sizeof (lnflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "nocreat", "",
-			       ncflag, sizeof (ncflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "fksupport", "",
-			       fkflag, sizeof (fkflag), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "loadext", "",
-			       loadext, sizeof (loadext), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "journalmode", "",
-			       jmode, sizeof (jmode), ODBC_INI);
-    SQLGetPrivateProfileString(buf, "jdconv", "",
-			       jdflag, sizeof (jdflag), ODBC_INI);
-#if defined(_WIN32) || defined(_WIN64)
-    SQLGetPrivateProfileString(buf, "oemcp", "1",
-			       oemcp, sizeof (oemcp), ODBC_INI);
+    jdflag[0] = '\0';
+    getdsnattr(buf, "jdconv", jdflag, sizeof (jdflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !jdflag[0]) {
+	SQLGetPrivateProfileString(dsn, "jdconv", "",
+				   jdflag, sizeof (jdflag), ODBC_INI);
+    }
 #endif
-    SQLGetPrivateProfileString(buf, "bigint", "",
-			       biflag, sizeof (biflag), ODBC_INI);
+    scsize[0] = '\0';
+    getdsnattr(buf, "stmtcache", scsize, sizeof (scsize));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !scsize[0]) {
+	SQLGetPrivateProfileString(dsn, "stmtcache", "",
+				   scsize, sizeof (scsize), ODBC_INI);
+    }
+#endif
+    lsflag[0] = '\0';
+    getdsnattr(buf, "lobstream", lsflag, sizeof (lsflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !lsflag[0]) {
+	SQLGetPrivateProfileString(dsn, "lobstream", "",
+				   lsflag, sizeof (lsflag), ODBC_INI);
+    }
+#endif
+    bpflag[0] = '\0';
+    getdsnattr(buf, "busypolicy", bpflag, sizeof (bpflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !bpflag[0]) {
+	SQLGetPrivateProfileString(dsn, "busypolicy", "",
+				   bpflag, sizeof (bpflag), ODBC_INI);
+    }
+#endif
+    poflag[0] = '\0';
+    getdsnattr(buf, "pool", poflag, sizeof (poflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !poflag[0]) {
+	SQLGetPrivateProfileString(dsn, "pool", "",
+				   poflag, sizeof (poflag), ODBC_INI);
+    }
+#endif
+    getperfopts(buf, dsn, perfopts, sizeof (perfopts));
+    pwd[0] = '\0';
+    getdsnattr(buf, "pwd", pwd, sizeof (pwd));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !pwd[0]) {
+	SQLGetPrivateProfileString(dsn, "pwd", "",
+				   pwd, sizeof (pwd), ODBC_INI);
+    }
 #endif
+
+    if (!dbname[0] && !dsn[0]) {
+	strcpy(dsn, "SQLite");
+	strncpy(dbname, buf, sizeof (dbname));
+	dbname[sizeof (dbname) - 1] = '\0';
+    }
     tracef[0] = '\0';
-#ifdef WITHOUT_DRIVERMGR
     getdsnattr(buf, "tracefile", tracef, sizeof (tracef));
-#else
-    SQLGetPrivateProfileString(buf, "tracefile", "",
-			       tracef, sizeof (tracef), ODBC_INI);
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !tracef[0]) {
+	SQLGetPrivateProfileString(dsn, "tracefile", "",
+				   tracef, sizeof (tracef), ODBC_INI);
+    }
 #endif
+    tbflag[0] = '\0';
+    getdsnattr(buf, "tracebinary", tbflag, sizeof (tbflag));
+#ifndef WITHOUT_DRIVERMGR
+    if (dsn[0] && !tbflag[0]) {
+	SQLGetPrivateProfileString(dsn, "tracebinary", "",
+				   tbflag, sizeof (tbflag), ODBC_INI);
+    }
+#endif
+    if (connOut || connOutLen) {
+	int count;
+
+	buf[0] = '\0';
+	count = snprintf(buf, sizeof (buf),
+			 "DSN=%s;Database=%s;StepAPI=%s;Timeout=%s;"
+			 "SyncPragma=%s;NoTXN=%s;ShortNames=%s;LongNames=%s;"
+			 "NoCreat=%s;NoWCHAR=%s;FKSupport=%s;Tracefile=%s;"
+			 "JournalMode=%s;LoadExt=%s;BigInt=%s;JDConv=%s;"
+			 "StmtCache=%s;LobStream=%s;TraceBinary=%s;"
+			 "BusyPolicy=%s;Pool=%s;%sPWD=%s",
+			 dsn, dbname, sflag, busy, spflag, ntflag,
+			 snflag, lnflag, ncflag, nwflag, fkflag, tracef,
+			 jmode, loadext, biflag, jdflag, scsize, lsflag,
+			 tbflag, bpflag, poflag, perfopts, pwd);
+	if (count < 0) {
+	    buf[sizeof (buf) - 1] = '\0';
+	}
+	len = min(connOutMax - 1, strlen(buf));
+	if (connOut) {
+	    strncpy((char *) connOut, buf, len);
+	    connOut[len] = '\0';
+	}
+	if (connOutLen) {
+	    *connOutLen = len;
+	}
+    }
     if (tracef[0] != '\0') {
-	d->trace = fopen(tracef, "a");
+	if (getbool(tbflag)) {
+	    trcopen(d, tracef);
+	} else {
+	    d->trace = fopen(tracef, "a");
+	}
+    }
+    d->shortnames = getbool(snflag);
+    d->longnames = getbool(lnflag);
+    d->nocreat = getbool(ncflag);
+    d->nowchar = getbool(nwflag);
+    d->fksupport = getbool(fkflag);
+    d->dobigint = getbool(biflag);
+    d->jdconv = getbool(jdflag);
+    d->s3cache_max = getint(scsize, 0, 0, 10000);
+    d->lobstream = getint(lsflag, 0, 0, 0x40000000);
+    setbusypolicy(d, bpflag);
+    d->oemcp = 0;
+    d->pwdLen = strlen(pwd);
+    d->pwd = (d->pwdLen > 0) ? pwd : NULL;
+    perfsetup(d, perfopts);
+    poolsetup(d, poflag, dbname, 0, spflag, jmode, loadext);
+    ret = dbopen(d, dbname, 0, dsn, sflag, spflag, ntflag, jmode, busy);
+    memset(pwd, 0, sizeof (pwd));
+    if (ret == SQL_SUCCESS && !d->pooled) {
+	dbloadext(d, loadext);
+    }
+    return ret;
+}
+#endif
+
+/**
+ * Internal free function for HSTMT.
+ * @param stmt statement handle
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+freestmt(SQLHSTMT stmt)
+{
+    STMT *s;
+    DBC *d;
+
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    s3stmt_drop(s);
+    freeresult(s, 1);
+    arena_free(&s->arena);
+    arena_free(&s->dynarena);
+    freep(&s->query);
+    d = (DBC *) s->dbc;
+    if (d && d->magic == DBC_MAGIC) {
+	STMT *p, *n;
+
+	p = NULL;
+	n = d->stmt;
+	while (n) {
+	    if (n == s) {
+		break;
+	    }
+	    p = n;
+	    n = n->next;
+	}
+	if (n) {
+	    if (p) {
+		p->next = s->next;
+	    } else {
+		d->stmt = s->next;
+	    }
+	}
     }
-    d->nowchar = getbool(nwflag);
-    d->shortnames = getbool(snflag);
-    d->longnames = getbool(lnflag);
-    d->nocreat = getbool(ncflag);
-    d->fksupport = getbool(fkflag);
-    d->jdconv = getbool(jdflag);
-#if defined(_WIN32) || defined(_WIN64)
-    d->oemcp = getbool(oemcp);
+    freeparams(s);
+    freep(&s->bindparms);
+    if (s->row_status0 != &s->row_status1) {
+	freep(&s->row_status0);
+	s->rowset_size = 1;
+	s->row_status0 = &s->row_status1;
+    }
+    xfree(s);
+    return SQL_SUCCESS;
+}
+
+/**
+ * Allocate HSTMT given HDBC (driver internal version).
+ * @param dbc database connection handle
+ * @param stmt pointer to statement handle
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+drvallocstmt(SQLHDBC dbc, SQLHSTMT *stmt)
+{
+    DBC *d;
+    STMT *s, *sl, *pl;
+
+    if (dbc == SQL_NULL_HDBC) {
+	return SQL_INVALID_HANDLE;
+    }
+    d = (DBC *) dbc;
+    if (d->magic != DBC_MAGIC || stmt == NULL) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) xmalloc(sizeof (STMT));
+    if (s == NULL) {
+	*stmt = SQL_NULL_HSTMT;
+	return SQL_ERROR;
+    }
+    *stmt = (SQLHSTMT) s;
+    memset(s, 0, sizeof (STMT));
+    s->dbc = dbc;
+    s->ov3 = d->ov3;
+    s->bkmrk = SQL_UB_OFF;
+    s->bkmrkptr = 0;
+    s->oemcp = &d->oemcp;
+    s->jdconv = &d->jdconv;
+    s->nowchar[0] = d->nowchar;
+    s->nowchar[1] = 0;
+    s->dobigint = d->dobigint;
+    s->curtype = d->curtype;
+    s->row_status0 = &s->row_status1;
+    s->rowset_size = 1;
+    s->longnames = d->longnames;
+    s->retr_data = SQL_RD_ON;
+    s->max_rows = 0;
+    s->bind_type = SQL_BIND_BY_COLUMN;
+    s->bind_offs = NULL;
+    s->paramset_size = 1;
+    s->parm_bind_type = SQL_PARAM_BIND_BY_COLUMN;
+    s->one_tbl = -1;
+    s->has_pk = -1;
+    s->has_rowid = -1;
+#ifdef _WIN64
+    sprintf((char *) s->cursorname, "CUR_%I64X", (SQLUBIGINT) *stmt);
 #else
-    d->oemcp = 0;
+    sprintf((char *) s->cursorname, "CUR_%016lX", (long) *stmt);
 #endif
-    d->dobigint = getbool(biflag);
-    d->pwd = pwd;
-    d->pwdLen = 0;
-    if (d->pwd) {
-	d->pwdLen = (pwdLen == SQL_NTS) ? strlen(d->pwd) : pwdLen;
+    sl = d->stmt;
+    pl = NULL;
+    while (sl) {
+	pl = sl;
+	sl = sl->next;
     }
-    ret = dbopen(d, dbname, isu, (char *) dsn, sflag, spflag, ntflag,
-		  jmode, busy);
-    if (ret == SQL_SUCCESS) {
-	dbloadext(d, loadext);
+    if (pl) {
+	pl->next = s;
+    } else {
+	d->stmt = s;
     }
-    return ret;
+    return SQL_SUCCESS;
 }
 
-#ifndef WINTERFACE
 /**
- * Connect to SQLite database.
+ * Allocate HSTMT given HDBC.
  * @param dbc database connection handle
- * @param dsn DSN string
- * @param dsnLen length of DSN string or SQL_NTS
- * @param uid user id string or NULL
- * @param uidLen length of user id string or SQL_NTS
- * @param pwd password string or NULL
- * @param pwdLen length of password string or SQL_NTS
+ * @param stmt pointer to statement handle
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLConnect(SQLHDBC dbc, SQLCHAR *dsn, SQLSMALLINT dsnLen,
-	   SQLCHAR *uid, SQLSMALLINT uidLen,
-	   SQLCHAR *pwd, SQLSMALLINT pwdLen)
+SQLAllocStmt(SQLHDBC dbc, SQLHSTMT *stmt)
 {
     SQLRETURN ret;
 
     HDBC_LOCK(dbc);
-    ret = drvconnect(dbc, dsn, dsnLen, (char *) pwd, pwdLen, 0);
+    ret = drvallocstmt(dbc, stmt);
     HDBC_UNLOCK(dbc);
     return ret;
 }
-#endif
 
-#ifdef WINTERFACE
 /**
- * Connect to SQLite database.
- * @param dbc database connection handle
- * @param dsn DSN string
- * @param dsnLen length of DSN string or SQL_NTS
- * @param uid user id string or NULL
- * @param uidLen length of user id string or SQL_NTS
- * @param pwd password string or NULL
- * @param pwdLen length of password string or SQL_NTS
+ * Internal function to perform certain kinds of free/close on STMT.
+ * @param stmt statement handle
+ * @param opt SQL_RESET_PARAMS, SQL_UNBIND, SQL_CLOSE, or SQL_DROP
  * @result ODBC error code
  */
 
-SQLRETURN SQL_API
-SQLConnectW(SQLHDBC dbc, SQLWCHAR *dsn, SQLSMALLINT dsnLen,
-	    SQLWCHAR *uid, SQLSMALLINT uidLen,
-	    SQLWCHAR *pwd, SQLSMALLINT pwdLen)
+static SQLRETURN
+drvfreestmt(SQLHSTMT stmt, SQLUSMALLINT opt)
 {
-    char *dsna = NULL;
-    char *pwda = NULL;
-    SQLRETURN ret;
-
-    HDBC_LOCK(dbc);
-    if (dsn) {
-	dsna = uc_to_utf_c(dsn, dsnLen);
-	if (!dsna) {
-	    DBC *d = (DBC *) dbc;
+    STMT *s;
+    SQLRETURN ret = SQL_SUCCESS;
+    SQLHDBC dbc;
 
-	    setstatd(d, -1, "out of memory", (*d->ov3) ? "HY000" : "S1000");
-	    ret = SQL_ERROR;
-	    goto done;
-	}
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
     }
-    if (pwd) {
-	pwda = uc_to_utf_c(pwd, pwdLen);
-	if (!pwda) {
-	    DBC *d = (DBC *) dbc;
-
-	    setstatd(d, -1, "out of memory", (*d->ov3) ? "HY000" : "S1000");
-	    ret = SQL_ERROR;
-	    goto done;
-	}
+    HSTMT_LOCK(stmt);
+    s = (STMT *) stmt;
+    dbc = s->dbc;
+    switch (opt) {
+    case SQL_RESET_PARAMS:
+	freeparams(s);
+	break;
+    case SQL_UNBIND:
+	unbindcols(s);
+	break;
+    case SQL_CLOSE:
+	s3stmt_end_if(s);
+	freeresult(s, 0);
+	break;
+    case SQL_DROP:
+	s3stmt_end_if(s);
+	ret = freestmt(stmt);
+	break;
+    default:
+	setstat(s, -1, "unsupported option", (*s->ov3) ? "HYC00" : "S1C00");
+	ret = SQL_ERROR;
+	break;
     }
-    ret = drvconnect(dbc, (SQLCHAR *) dsna, SQL_NTS, pwda, SQL_NTS, 1);
-done:
     HDBC_UNLOCK(dbc);
-    uc_free(dsna);
-    uc_free(pwda);
     return ret;
 }
-#endif
 
 /**
- * Internal disconnect given HDBC.
- * @param dbc database connection handle
+ * Free HSTMT.
+ * @param stmt statement handle
+ * @param opt SQL_RESET_PARAMS, SQL_UNBIND, SQL_CLOSE, or SQL_DROP
  * @result ODBC error code
  */
 
-static SQLRETURN
-drvdisconnect(SQLHDBC dbc)
+SQLRETURN SQL_API
+SQLFreeStmt(SQLHSTMT stmt, SQLUSMALLINT opt)
 {
-    DBC *d;
-    int rc;
+    return drvfreestmt(stmt, opt);
+}
 
-    if (dbc == SQL_NULL_HDBC) {
-	return SQL_INVALID_HANDLE;
-    }
-    d = (DBC *) dbc;
-    if (d->magic != DBC_MAGIC) {
-	return SQL_INVALID_HANDLE;
-    }
-    if (d->intrans) {
-	setstatd(d, -1, "incomplete transaction", "25000");
-	return SQL_ERROR;
-    }
-    if (d->cur_s3stmt) {
-	s3stmt_end(d->cur_s3stmt);
-    }
-    if (d->sqlite) {
-	if (d->trace) {
-	    fprintf(d->trace, "-- sqlite3_close: '%s'\n",
-		    d->dbname);
-	    fflush(d->trace);
+/**
+ * Cancel HSTMT closing cursor.
+ * @param stmt statement handle
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLCancel(SQLHSTMT stmt)
+{
+    if (stmt != SQL_NULL_HSTMT) {
+	DBC *d = (DBC *) ((STMT *) stmt)->dbc;
+#if defined(_WIN32) || defined(_WIN64)
+	/* interrupt when other thread owns critical section */
+	if (d->magic == DBC_MAGIC && d->owner != GetCurrentThreadId() &&
+	    d->owner != 0) {
+	    d->busyint = 1;
+	    sqlite3_interrupt(d->sqlite);
+	    return SQL_SUCCESS;
 	}
-	rc = sqlite3_close(d->sqlite);
-	if (rc == SQLITE_BUSY) {
-	    setstatd(d, -1, "unfinished statements", "25000");
-	    return SQL_ERROR;
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+	/* interrupt when other thread owns mutex */
+	if (d->magic == DBC_MAGIC && d->nlock > 0 &&
+	    !pthread_equal(d->owner, pthread_self())) {
+	    d->busyint = 1;
+	    sqlite3_interrupt(d->sqlite);
+	    return SQL_SUCCESS;
 	}
-	d->sqlite = NULL;
-    }
-    freep(&d->dbname);
-    freep(&d->dsn);
-    return SQL_SUCCESS;
+#else
+	if (d->magic == DBC_MAGIC) {
+	    d->busyint = 1;
+	    sqlite3_interrupt(d->sqlite);
+	}
+#endif
+    }
+    return drvfreestmt(stmt, SQL_CLOSE);
 }
 
 /**
- * Disconnect given HDBC.
- * @param dbc database connection handle
+ * Internal function to get cursor name of STMT.
+ * @param stmt statement handle
+ * @param cursor output buffer
+ * @param buflen length of output buffer
+ * @param lenp output length
  * @result ODBC error code
  */
 
-SQLRETURN SQL_API
-SQLDisconnect(SQLHDBC dbc)
+static SQLRETURN
+drvgetcursorname(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT buflen,
+		 SQLSMALLINT *lenp)
 {
-    SQLRETURN ret;
+    STMT *s;
 
-    HDBC_LOCK(dbc);
-    ret = drvdisconnect(dbc);
-    HDBC_UNLOCK(dbc);
-    return ret;
+    if (stmt == SQL_NULL_HSTMT) {
+	return SQL_INVALID_HANDLE;
+    }
+    s = (STMT *) stmt;
+    if (lenp && !cursor) {
+	*lenp = strlen((char *) s->cursorname);
+	return SQL_SUCCESS;
+    }
+    if (cursor) {
+	if (buflen > 0) {
+	    strncpy((char *) cursor, (char *) s->cursorname, buflen - 1);
+	    cursor[buflen - 1] = '\0';
+	}
+	if (lenp) {
+	    *lenp = min(strlen((char *) s->cursorname), buflen - 1);
+	}
+    }
+    return SQL_SUCCESS;
 }
 
-#if defined(WITHOUT_DRIVERMGR) || (!defined(_WIN32) && !defined(_WIN64))
-
+#ifndef WINTERFACE
 /**
- * Internal standalone (w/o driver manager) database connect.
- * @param dbc database connection handle
- * @param hwnd dummy window handle or NULL
- * @param connIn driver connect input string
- * @param connInLen length of driver connect input string or SQL_NTS
- * @param connOut driver connect output string
- * @param connOutMax length of driver connect output string
- * @param connOutLen output length of driver connect output string
- * @param drvcompl completion type
+ * Get cursor name of STMT.
+ * @param stmt statement handle
+ * @param cursor output buffer
+ * @param buflen length of output buffer
+ * @param lenp output length
  * @result ODBC error code
  */
 
-static SQLRETURN
-drvdriverconnect(SQLHDBC dbc, SQLHWND hwnd,
-		 SQLCHAR *connIn, SQLSMALLINT connInLen,
-		 SQLCHAR *connOut, SQLSMALLINT connOutMax,
-		 SQLSMALLINT *connOutLen, SQLUSMALLINT drvcompl)
+SQLRETURN SQL_API
+SQLGetCursorName(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT buflen,
+		 SQLSMALLINT *lenp)
 {
-    DBC *d;
-    int len;
     SQLRETURN ret;
-    char buf[SQL_MAX_MESSAGE_LENGTH * 8], dbname[SQL_MAX_MESSAGE_LENGTH];
-    char dsn[SQL_MAX_MESSAGE_LENGTH], busy[SQL_MAX_MESSAGE_LENGTH / 4];
-    char tracef[SQL_MAX_MESSAGE_LENGTH], loadext[SQL_MAX_MESSAGE_LENGTH];
-    char pwd[SQL_MAX_MESSAGE_LENGTH];
-    char sflag[32], spflag[32], ntflag[32], snflag[32], lnflag[32];
-    char ncflag[32], nwflag[32], fkflag[32], jmode[32], biflag[32];
-    char jdflag[32];
-
-    if (dbc == SQL_NULL_HDBC) {
-	return SQL_INVALID_HANDLE;
-    }
-    if (drvcompl != SQL_DRIVER_COMPLETE &&
-	drvcompl != SQL_DRIVER_COMPLETE_REQUIRED &&
-	drvcompl != SQL_DRIVER_PROMPT &&
-	drvcompl != SQL_DRIVER_NOPROMPT) {
-	return SQL_NO_DATA;
-    }
-    d = (DBC *) dbc;
-    if (d->sqlite) {
-	setstatd(d, -1, "connection already established", "08002");
-	return SQL_ERROR;
-    }
-    buf[0] = '\0';
-    if (connInLen == SQL_NTS) {
-	len = sizeof (buf) - 1;
-    } else {
-	len = min(connInLen, sizeof (buf) - 1);
-    }
-    if (connIn != NULL) {
-	strncpy(buf, (char *) connIn, len);
-    }
-    buf[len] = '\0';
-    if (!buf[0]) {
-	setstatd(d, -1, "invalid connect attributes",
-		 (*d->ov3) ? "HY090" : "S1090");
-	return SQL_ERROR;
-    }
-    dsn[0] = '\0';
-    getdsnattr(buf, "DSN", dsn, sizeof (dsn));
-
-    /* special case: connIn is sole DSN value without keywords */
-    if (!dsn[0] && !strchr(buf, ';') && !strchr(buf, '=')) {
-	strncpy(dsn, buf, sizeof (dsn) - 1);
-	dsn[sizeof (dsn) - 1] = '\0';
-    }
-
-    busy[0] = '\0';
-    getdsnattr(buf, "timeout", busy, sizeof (busy));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !busy[0]) {
-	SQLGetPrivateProfileString(dsn, "timeout", "100000",
-				   busy, sizeof (busy), ODBC_INI);
-    }
-#endif
-    dbname[0] = '\0';
-    getdsnattr(buf, "database", dbname, sizeof (dbname));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !dbname[0]) {
-	SQLGetPrivateProfileString(dsn, "database", "",
-				   dbname, sizeof (dbname), ODBC_INI);
-    }
-#endif
-    sflag[0] = '\0';
-    getdsnattr(buf, "stepapi", sflag, sizeof (sflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !sflag[0]) {
-	SQLGetPrivateProfileString(dsn, "stepapi", "",
-				   sflag, sizeof (sflag), ODBC_INI);
-    }
-#endif
-    spflag[0] = '\0';
-    getdsnattr(buf, "syncpragma", spflag, sizeof (spflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !spflag[0]) {
-	SQLGetPrivateProfileString(dsn, "syncpragma", "NORMAL",
-				   spflag, sizeof (spflag), ODBC_INI);
-    }
-#endif
-    ntflag[0] = '\0';
-    getdsnattr(buf, "notxn", ntflag, sizeof (ntflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !ntflag[0]) {
-	SQLGetPrivateProfileString(dsn, "notxn", "",
-				   ntflag, sizeof (ntflag), ODBC_INI);
-    }
-#endif
-    snflag[0] = '\0';
-    getdsnattr(buf, "shortnames", snflag, sizeof (snflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !snflag[0]) {
-	SQLGetPrivateProfileString(dsn, "shortnames", "",
-				   snflag, sizeof (snflag), ODBC_INI);
-    }
-#endif
-    lnflag[0] = '\0';
-    getdsnattr(buf, "longnames", lnflag, sizeof (lnflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !lnflag[0]) {
-	SQLGetPrivateProfileString(dsn, "longnames", "",
-				   lnflag, sizeof (lnflag), ODBC_INI);
-    }
-#endif
-    ncflag[0] = '\0';
-    getdsnattr(buf, "nocreat", ncflag, sizeof (ncflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !ncflag[0]) {
-	SQLGetPrivateProfileString(dsn, "nocreat", "",
-				   ncflag, sizeof (ncflag), ODBC_INI);
-    }
-#endif
-    nwflag[0] = '\0';
-    getdsnattr(buf, "nowchar", nwflag, sizeof (nwflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !nwflag[0]) {
-	SQLGetPrivateProfileString(dsn, "nowchar", "",
-				   nwflag, sizeof (nwflag), ODBC_INI);
-    }
-#endif
-    fkflag[0] = '\0';
-    getdsnattr(buf, "fksupport", fkflag, sizeof (fkflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !fkflag[0]) {
-	SQLGetPrivateProfileString(dsn, "fksupport", "",
-				   fkflag, sizeof (fkflag), ODBC_INI);
-    }
-#endif
-    loadext[0] = '\0';
-    getdsnattr(buf, "loadext", loadext, sizeof (loadext));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !loadext[0]) {
-	SQLGetPrivateProfileString(dsn, "loadext", "",
-				   loadext, sizeof (loadext), ODBC_INI);
-    }
-#endif
-    jmode[0] = '\0';
-    getdsnattr(buf, "journalmode", jmode, sizeof (jmode));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !jmode[0]) {
-	SQLGetPrivateProfileString(dsn, "journalmode", "",
-				   jmode, sizeof (jmode), ODBC_INI);
-    }
-#endif
-    biflag[0] = '\0';
-    getdsnattr(buf, "bigint", biflag, sizeof (biflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !biflag[0]) {
-	SQLGetPrivateProfileString(dsn, "bigint", "",
-				   biflag, sizeof (biflag), ODBC_INI);
-    }
-#endif
-    jdflag[0] = '\0';
-    getdsnattr(buf, "jdconv", jdflag, sizeof (jdflag));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !jdflag[0]) {
-	SQLGetPrivateProfileString(dsn, "jdconv", "",
-				   jdflag, sizeof (jdflag), ODBC_INI);
-    }
-#endif
-    pwd[0] = '\0';
-    getdsnattr(buf, "pwd", pwd, sizeof (pwd));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !pwd[0]) {
-	SQLGetPrivateProfileString(dsn, "pwd", "",
-				   pwd, sizeof (pwd), ODBC_INI);
-    }
+#if defined(_WIN32) || defined(_WIN64)
+    SQLSMALLINT len = 0;
 #endif
 
-    if (!dbname[0] && !dsn[0]) {
-	strcpy(dsn, "SQLite");
-	strncpy(dbname, buf, sizeof (dbname));
-	dbname[sizeof (dbname) - 1] = '\0';
+    HSTMT_LOCK(stmt);
+#if defined(_WIN32) || defined(_WIN64)
+    if (!((STMT *) stmt)->oemcp[0]) {
+	ret = drvgetcursorname(stmt, cursor, buflen, lenp);
+	goto done;
     }
-    tracef[0] = '\0';
-    getdsnattr(buf, "tracefile", tracef, sizeof (tracef));
-#ifndef WITHOUT_DRIVERMGR
-    if (dsn[0] && !tracef[0]) {
-	SQLGetPrivateProfileString(dsn, "tracefile", "",
-				   tracef, sizeof (tracef), ODBC_INI);
+    ret = drvgetcursorname(stmt, cursor, buflen, &len);
+    if (ret == SQL_SUCCESS) {
+	char *c = NULL;
+
+	if (cursor) {
+	    c = utf_to_wmb((char *) cursor, len);
+	    if (!c) {
+		ret = nomem((STMT *) stmt);
+		goto done;
+	    }
+	    c[len] = 0;
+	    len = strlen(c);
+	    if (buflen > 0) {
+		strncpy((char *) cursor, c, buflen - 1);
+		cursor[buflen - 1] = 0;
+	    }
+	    uc_free(c);
+	}
+	if (lenp) {
+	    *lenp = min(len, buflen - 1);
+	}
     }
+done:
+    ;
+#else
+    ret = drvgetcursorname(stmt, cursor, buflen, lenp);
+#endif
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
 #endif
-    if (connOut || connOutLen) {
-	int count;
 
-	buf[0] = '\0';
-	count = snprintf(buf, sizeof (buf),
-			 "DSN=%s;Database=%s;StepAPI=%s;Timeout=%s;"
-			 "SyncPragma=%s;NoTXN=%s;ShortNames=%s;LongNames=%s;"
-			 "NoCreat=%s;NoWCHAR=%s;FKSupport=%s;Tracefile=%s;"
-			 "JournalMode=%s;LoadExt=%s;BigInt=%s;JDConv=%s;"
-			 "PWD=%s",
-			 dsn, dbname, sflag, busy, spflag, ntflag,
-			 snflag, lnflag, ncflag, nwflag, fkflag, tracef,
-			 jmode, loadext, biflag, jdflag, pwd);
-	if (count < 0) {
-	    buf[sizeof (buf) - 1] = '\0';
-	}
-	len = min(connOutMax - 1, strlen(buf));
-	if (connOut) {
-	    strncpy((char *) connOut, buf, len);
-	    connOut[len] = '\0';
+#ifdef WINTERFACE
+/**
+ * Get cursor name of STMT (UNICODE version).
+ * @param stmt statement handle
+ * @param cursor output buffer
+ * @param buflen length of output buffer
+ * @param lenp output length
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLGetCursorNameW(SQLHSTMT stmt, SQLWCHAR *cursor, SQLSMALLINT buflen,
+		  SQLSMALLINT *lenp)
+{
+    SQLRETURN ret;
+    SQLSMALLINT len = 0;
+
+    HSTMT_LOCK(stmt);
+    ret = drvgetcursorname(stmt, (SQLCHAR *) cursor, buflen, &len);
+    if (ret == SQL_SUCCESS) {
+	SQLWCHAR *c = NULL;
+
+	if (cursor) {
+	    c = uc_from_utf((SQLCHAR *) cursor, len);
+	    if (!c) {
+		ret = nomem((STMT *) stmt);
+		goto done;
+	    }
+	    c[len] = 0;
+	    len = uc_strlen(c);
+	    if (buflen > 0) {
+		uc_strncpy(cursor, c, buflen - 1);
+		cursor[buflen - 1] = 0;
+	    }
+	    uc_free(c);
 	}
-	if (connOutLen) {
-	    *connOutLen = len;
+	if (lenp) {
+	    *lenp = min(len, buflen - 1);
 	}
     }
-    if (tracef[0] != '\0') {
-	d->trace = fopen(tracef, "a");
-    }
-    d->shortnames = getbool(snflag);
-    d->longnames = getbool(lnflag);
-    d->nocreat = getbool(ncflag);
-    d->nowchar = getbool(nwflag);
-    d->fksupport = getbool(fkflag);
-    d->dobigint = getbool(biflag);
-    d->jdconv = getbool(jdflag);
-    d->oemcp = 0;
-    d->pwdLen = strlen(pwd);
-    d->pwd = (d->pwdLen > 0) ? pwd : NULL;
-    ret = dbopen(d, dbname, 0, dsn, sflag, spflag, ntflag, jmode, busy);
-    memset(pwd, 0, sizeof (pwd));
-    if (ret == SQL_SUCCESS) {
-	dbloadext(d, loadext);
-    }
+done:
+    HSTMT_UNLOCK(stmt);
     return ret;
 }
 #endif
 
 /**
- * Internal free function for HSTMT.
+ * Internal function to set cursor name on STMT.
  * @param stmt statement handle
+ * @param cursor new cursor name
+ * @param len length of cursor name or SQL_NTS
  * @result ODBC error code
  */
 
 static SQLRETURN
-freestmt(SQLHSTMT stmt)
+drvsetcursorname(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT len)
 {
     STMT *s;
-    DBC *d;
 
     if (stmt == SQL_NULL_HSTMT) {
 	return SQL_INVALID_HANDLE;
     }
     s = (STMT *) stmt;
-    s3stmt_drop(s);
-    freeresult(s, 1);
-    freep(&s->query);
-    d = (DBC *) s->dbc;
-    if (d && d->magic == DBC_MAGIC) {
-	STMT *p, *n;
-
-	p = NULL;
-	n = d->stmt;
-	while (n) {
-	    if (n == s) {
-		break;
-	    }
-	    p = n;
-	    n = n->next;
-	}
-	if (n) {
-	    if (p) {
-		p->next = s->next;
-	    } else {
-		d->stmt = s->next;
-	    }
-	}
+    if (!cursor ||
+	!((cursor[0] >= 'A' && cursor[0] <= 'Z') ||
+	  (cursor[0] >= 'a' && cursor[0] <= 'z'))) {
+	setstat(s, -1, "invalid cursor name", (*s->ov3) ? "HYC00" : "S1C00");
+	return SQL_ERROR;
     }
-    freeparams(s);
-    freep(&s->bindparms);
-    if (s->row_status0 != &s->row_status1) {
-	freep(&s->row_status0);
-	s->rowset_size = 1;
-	s->row_status0 = &s->row_status1;
+    if (len == SQL_NTS) {
+	len = sizeof (s->cursorname) - 1;
+    } else {
+	len = min(sizeof (s->cursorname) - 1, len);
     }
-    xfree(s);
+    strncpy((char *) s->cursorname, (char *) cursor, len);
+    s->cursorname[len] = '\0';
     return SQL_SUCCESS;
 }
 
+#ifndef WINTERFACE
 /**
- * Allocate HSTMT given HDBC (driver internal version).
- * @param dbc database connection handle
- * @param stmt pointer to statement handle
+ * Set cursor name on STMT.
+ * @param stmt statement handle
+ * @param cursor new cursor name
+ * @param len length of cursor name or SQL_NTS
  * @result ODBC error code
  */
 
-static SQLRETURN
-drvallocstmt(SQLHDBC dbc, SQLHSTMT *stmt)
+SQLRETURN SQL_API
+SQLSetCursorName(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT len)
 {
-    DBC *d;
-    STMT *s, *sl, *pl;
+#if defined(_WIN32) || defined(_WIN64)
+    char *c = NULL;
+#endif
+    SQLRETURN ret;
 
-    if (dbc == SQL_NULL_HDBC) {
-	return SQL_INVALID_HANDLE;
-    }
-    d = (DBC *) dbc;
-    if (d->magic != DBC_MAGIC || stmt == NULL) {
-	return SQL_INVALID_HANDLE;
+    HSTMT_LOCK(stmt);
+#if defined(_WIN32) || defined(_WIN64)
+    if (!((STMT *) stmt)->oemcp[0]) {
+	ret = drvsetcursorname(stmt, cursor, len);
+	goto done2;
     }
-    s = (STMT *) xmalloc(sizeof (STMT));
-    if (s == NULL) {
-	*stmt = SQL_NULL_HSTMT;
-	return SQL_ERROR;
+    if (cursor) {
+	c = wmb_to_utf_c((char *) cursor, len);
+	if (!c) {
+	    ret = nomem((STMT *) stmt);
+	    goto done;
+	}
     }
-    *stmt = (SQLHSTMT) s;
-    memset(s, 0, sizeof (STMT));
-    s->dbc = dbc;
-    s->ov3 = d->ov3;
-    s->bkmrk = SQL_UB_OFF;
-    s->bkmrkptr = 0;
-    s->oemcp = &d->oemcp;
-    s->jdconv = &d->jdconv;
-    s->nowchar[0] = d->nowchar;
-    s->nowchar[1] = 0;
-    s->dobigint = d->dobigint;
-    s->curtype = d->curtype;
-    s->row_status0 = &s->row_status1;
-    s->rowset_size = 1;
-    s->longnames = d->longnames;
-    s->retr_data = SQL_RD_ON;
-    s->max_rows = 0;
-    s->bind_type = SQL_BIND_BY_COLUMN;
-    s->bind_offs = NULL;
-    s->paramset_size = 1;
-    s->parm_bind_type = SQL_PARAM_BIND_BY_COLUMN;
-    s->one_tbl = -1;
-    s->has_pk = -1;
-    s->has_rowid = -1;
-#ifdef _WIN64
-    sprintf((char *) s->cursorname, "CUR_%I64X", (SQLUBIGINT) *stmt);
+    ret = drvsetcursorname(stmt, (SQLCHAR *) c, SQL_NTS);
 #else
-    sprintf((char *) s->cursorname, "CUR_%016lX", (long) *stmt);
+    ret = drvsetcursorname(stmt, cursor, len);
 #endif
-    sl = d->stmt;
-    pl = NULL;
-    while (sl) {
-	pl = sl;
-	sl = sl->next;
-    }
-    if (pl) {
-	pl->next = s;
-    } else {
-	d->stmt = s;
+#if defined(_WIN32) || defined(_WIN64)
+done:
+    uc_free(c);
+done2:
+    ;
+#endif
+    HSTMT_UNLOCK(stmt);
+    return ret;
+}
+#endif
+
+#ifdef WINTERFACE
+/**
+ * Set cursor name on STMT (UNICODE version).
+ * @param stmt statement handle
+ * @param cursor new cursor name
+ * @param len length of cursor name or SQL_NTS
+ * @result ODBC error code
+ */
+
+SQLRETURN SQL_API
+SQLSetCursorNameW(SQLHSTMT stmt, SQLWCHAR *cursor, SQLSMALLINT len)
+{
+    char *c = NULL;
+    SQLRETURN ret;
+
+    HSTMT_LOCK(stmt);
+    if (cursor) {
+	c = uc_to_utf_c(cursor, len);
+	if (!c) {
+	    ret = nomem((STMT *) stmt);
+	    goto done;
+	}
     }
-    return SQL_SUCCESS;
+    ret = drvsetcursorname(stmt, (SQLCHAR *) c, SQL_NTS);
+done:
+    uc_free(c);
+    HSTMT_UNLOCK(stmt);
+    return ret;
 }
+#endif
 
 /**
- * Allocate HSTMT given HDBC.
- * @param dbc database connection handle
- * @param stmt pointer to statement handle
- * @result ODBC error code
+ * Close open cursor.
+ * @param stmt statement handle
+ * @return ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLAllocStmt(SQLHDBC dbc, SQLHSTMT *stmt)
+SQLCloseCursor(SQLHSTMT stmt)
 {
-    SQLRETURN ret;
-
-    HDBC_LOCK(dbc);
-    ret = drvallocstmt(dbc, stmt);
-    HDBC_UNLOCK(dbc);
-    return ret;
+    return drvfreestmt(stmt, SQL_CLOSE);
 }
 
 /**
- * Internal function to perform certain kinds of free/close on STMT.
- * @param stmt statement handle
- * @param opt SQL_RESET_PARAMS, SQL_UNBIND, SQL_CLOSE, or SQL_DROP
+ * Allocate a HENV, HDBC, or HSTMT handle.
+ * @param type handle type
+ * @param input input handle (HENV, HDBC)
+ * @param output pointer to output handle (HENV, HDBC, HSTMT)
  * @result ODBC error code
  */
 
-static SQLRETURN
-drvfreestmt(SQLHSTMT stmt, SQLUSMALLINT opt)
+SQLRETURN SQL_API
+SQLAllocHandle(SQLSMALLINT type, SQLHANDLE input, SQLHANDLE *output)
 {
-    STMT *s;
-    SQLRETURN ret = SQL_SUCCESS;
-    SQLHDBC dbc;
+    SQLRETURN ret;
 
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
-    }
-    HSTMT_LOCK(stmt);
-    s = (STMT *) stmt;
-    dbc = s->dbc;
-    switch (opt) {
-    case SQL_RESET_PARAMS:
-	freeparams(s);
-	break;
-    case SQL_UNBIND:
-	unbindcols(s);
-	break;
-    case SQL_CLOSE:
-	s3stmt_end_if(s);
-	freeresult(s, 0);
-	break;
-    case SQL_DROP:
-	s3stmt_end_if(s);
-	ret = freestmt(stmt);
-	break;
-    default:
-	setstat(s, -1, "unsupported option", (*s->ov3) ? "HYC00" : "S1C00");
-	ret = SQL_ERROR;
-	break;
+    switch (type) {
+    case SQL_HANDLE_ENV:
+	ret = drvallocenv((SQLHENV *) output);
+	if (ret == SQL_SUCCESS) {
+	    ENV *e = (ENV *) *output;
+
+	    if (e && e->magic == ENV_MAGIC) {
+		e->ov3 = 1;
+	    }
+	}
+	return ret;
+    case SQL_HANDLE_DBC:
+	return drvallocconnect((SQLHENV) input, (SQLHDBC *) output);
+    case SQL_HANDLE_STMT:
+	HDBC_LOCK((SQLHDBC) input);
+	ret = drvallocstmt((SQLHDBC) input, (SQLHSTMT *) output);
+	HDBC_UNLOCK((SQLHDBC) input);
+	return ret;
     }
-    HDBC_UNLOCK(dbc);
-    return ret;
+    return SQL_ERROR;
 }
 
 /**
- * Free HSTMT.
- * @param stmt statement handle
- * @param opt SQL_RESET_PARAMS, SQL_UNBIND, SQL_CLOSE, or SQL_DROP
+ * Free a HENV, HDBC, or HSTMT handle.
+ * @param type handle type
+ * @param h handle (HENV, HDBC, or HSTMT)
  * @result ODBC error code
  */
 
 SQLRETURN SQL_API
-SQLFreeStmt(SQLHSTMT stmt, SQLUSMALLINT opt)
+SQLFreeHandle(SQLSMALLINT type, SQLHANDLE h)
 {
-    return drvfreestmt(stmt, opt);
+    switch (type) {
+    case SQL_HANDLE_ENV:
+	return drvfreeenv((SQLHENV) h);
+    case SQL_HANDLE_DBC:
+	return drvfreeconnect((SQLHDBC) h);
+    case SQL_HANDLE_STMT:
+	return drvfreestmt((SQLHSTMT) h, SQL_DROP);
+    }
+    return SQL_ERROR;
 }
 
 /**
- * Cancel HSTMT closing cursor.
- * @param stmt statement handle
- * @result ODBC error code
+ * Free dynamically allocated column descriptions of STMT.
+ * @param s statement pointer
  */
 
-SQLRETURN SQL_API
-SQLCancel(SQLHSTMT stmt)
+static void
+freedyncols(STMT *s)
 {
-    if (stmt != SQL_NULL_HSTMT) {
-	DBC *d = (DBC *) ((STMT *) stmt)->dbc;
-#if defined(_WIN32) || defined(_WIN64)
-	/* interrupt when other thread owns critical section */
-	if (d->magic == DBC_MAGIC && d->owner != GetCurrentThreadId() &&
-	    d->owner != 0) {
-	    d->busyint = 1;
-	    sqlite3_interrupt(d->sqlite);
-	    return SQL_SUCCESS;
-	}
-#else
-	if (d->magic == DBC_MAGIC) {
-	    d->busyint = 1;
-	    sqlite3_interrupt(d->sqlite);
+    if (s->dyncols) {
+	if (s->cols == s->dyncols) {
+	    s->cols = NULL;
+	    s->ncols = 0;
 	}
-#endif
+	s->dyncols = NULL;
     }
-    return drvfreestmt(stmt, SQL_CLOSE);
+    arena_reset(&s->dynarena);
+    s->dcols = 0;
+    s->dynmeta = 0;
+    s->lobmin = 0;
+    s->lobcols = NULL;
 }
 
 /**
- * Internal function to get cursor name of STMT.
- * @param stmt statement handle
- * @param cursor output buffer
- * @param buflen length of output buffer
- * @param lenp output length
- * @result ODBC error code
+ * Free statement's result.
+ * @param s statement pointer
+ * @param clrcols flag to clear column information
+ *
+ * The result rows are free'd using the rowfree function pointer.
+ * If clrcols is greater than zero, then column bindings and dynamic column
+ * descriptions are free'd.
+ * If clrcols is less than zero, then dynamic column descriptions are free'd.
  */
 
-static SQLRETURN
-drvgetcursorname(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT buflen,
-		 SQLSMALLINT *lenp)
+static void
+freeresult(STMT *s, int clrcols)
 {
-    STMT *s;
-
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
+#ifdef USE_LOBSTREAM
+    lobend(s, 0);
+#endif
+    freep(&s->bincache);
+    s->bincell = NULL;
+    s->binlen = 0;
+    if (s->rows) {
+	if (s->rowfree) {
+	    s->rowfree(s->rows);
+	    s->rowfree = NULL;
+	}
+	s->rows = NULL;
     }
-    s = (STMT *) stmt;
-    if (lenp && !cursor) {
-	*lenp = strlen((char *) s->cursorname);
-	return SQL_SUCCESS;
+    if (s->cells) {
+	xfree(s->cells);
+	s->cells = NULL;
     }
-    if (cursor) {
-	if (buflen > 0) {
-	    strncpy((char *) cursor, (char *) s->cursorname, buflen - 1);
-	    cursor[buflen - 1] = '\0';
-	}
-	if (lenp) {
-	    *lenp = min(strlen((char *) s->cursorname), buflen - 1);
-	}
+    s->cellstride = 0;
+    s->s3stmt_rowlazy = 0;
+    arena_reset(&s->arena);
+    s->nrows = -1;
+    if (clrcols > 0) {
+	freep(&s->bindcols);
+	s->nbindcols = 0;
+    }
+    if (clrcols) {
+	freedyncols(s);
+	s->cols = NULL;
+	s->ncols = 0;
+	s->nowchar[1] = 0;
+	s->one_tbl = -1;
+	s->has_pk = -1;
+	s->has_rowid = -1;
     }
-    return SQL_SUCCESS;
 }
 
-#ifndef WINTERFACE
 /**
- * Get cursor name of STMT.
- * @param stmt statement handle
- * @param cursor output buffer
- * @param buflen length of output buffer
- * @param lenp output length
- * @result ODBC error code
+ * Reset bound columns to unbound state.
+ * @param s statement pointer
  */
 
-SQLRETURN SQL_API
-SQLGetCursorName(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT buflen,
-		 SQLSMALLINT *lenp)
+static void
+unbindcols(STMT *s)
 {
-    SQLRETURN ret;
-#if defined(_WIN32) || defined(_WIN64)
-    SQLSMALLINT len = 0;
-#endif
+    int i;
 
-    HSTMT_LOCK(stmt);
-#if defined(_WIN32) || defined(_WIN64)
-    if (!((STMT *) stmt)->oemcp[0]) {
-	ret = drvgetcursorname(stmt, cursor, buflen, lenp);
-	goto done;
+    for (i = 0; s->bindcols && i < s->nbindcols; i++) {
+	s->bindcols[i].type = SQL_UNKNOWN_TYPE;
+	s->bindcols[i].max = 0;
+	s->bindcols[i].lenp = NULL;
+	s->bindcols[i].valp = NULL;
+	s->bindcols[i].index = i;
+	s->bindcols[i].offs = 0;
+	s->bindcols[i].ctype = SQL_UNKNOWN_TYPE;
+	s->bindcols[i].conv = NULL;
     }
-    ret = drvgetcursorname(stmt, cursor, buflen, &len);
-    if (ret == SQL_SUCCESS) {
-	char *c = NULL;
+}
 
-	if (cursor) {
-	    c = utf_to_wmb((char *) cursor, len);
-	    if (!c) {
-		ret = nomem((STMT *) stmt);
-		goto done;
+/**
+ * Reallocate space for bound columns.
+ * @param s statement pointer
+ * @param ncols number of columns
+ * @result ODBC error code
+ */
+
+static SQLRETURN
+mkbindcols(STMT *s, int ncols)
+{
+    if (s->bindcols) {
+	if (s->nbindcols < ncols) {
+	    int i;
+	    BINDCOL *bindcols =
+		xrealloc(s->bindcols, ncols * sizeof (BINDCOL));
+
+	    if (!bindcols) {
+		return nomem(s);
 	    }
-	    c[len] = 0;
-	    len = strlen(c);
-	    if (buflen > 0) {
-		strncpy((char *) cursor, c, buflen - 1);
-		cursor[buflen - 1] = 0;
+	    for (i = s->nbindcols; i < ncols; i++) {
+		bindcols[i].type = SQL_UNKNOWN_TYPE;
+		bindcols[i].max = 0;
+		bindcols[i].lenp = NULL;
+		bindcols[i].valp = NULL;
+		bindcols[i].index = i;
+		bindcols[i].offs = 0;
+		bindcols[i].ctype = SQL_UNKNOWN_TYPE;
+		bindcols[i].conv = NULL;
 	    }
-	    uc_free(c);
+	    s->bindcols = bindcols;
+	    s->nbindcols = ncols;
 	}
-	if (lenp) {
-	    *lenp = min(len, buflen - 1);
+    } else if (ncols > 0) {
+	s->bindcols = (BINDCOL *) xmalloc(ncols * sizeof (BINDCOL));
+	if (!s->bindcols) {
+	    return nomem(s);
 	}
+	s->nbindcols = ncols;
+	unbindcols(s);
     }
-done:
-    ;
-#else
-    ret = drvgetcursorname(stmt, cursor, buflen, lenp);
-#endif
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    if (s->bindcols) {
+	int i;
+
+	/* result set may have changed, renew converters */
+	for (i = 0; i < s->nbindcols; i++) {
+	    mkbindconv(s, i);
+	}
+    }
+    return SQL_SUCCESS;
 }
-#endif
 
-#ifdef WINTERFACE
 /**
- * Get cursor name of STMT (UNICODE version).
- * @param stmt statement handle
- * @param cursor output buffer
- * @param buflen length of output buffer
+ * Store numeric cell value directly into numeric output buffer.
+ * @param c cell pointer
+ * @param type output (C) data type
+ * @param val output buffer
  * @param lenp output length
- * @result ODBC error code
+ * @result true when value was stored, false when string
+ * conversion is needed
  */
 
-SQLRETURN SQL_API
-SQLGetCursorNameW(SQLHSTMT stmt, SQLWCHAR *cursor, SQLSMALLINT buflen,
-		  SQLSMALLINT *lenp)
-{
-    SQLRETURN ret;
-    SQLSMALLINT len = 0;
-
-    HSTMT_LOCK(stmt);
-    ret = drvgetcursorname(stmt, (SQLCHAR *) cursor, buflen, &len);
-    if (ret == SQL_SUCCESS) {
-	SQLWCHAR *c = NULL;
-
-	if (cursor) {
-	    c = uc_from_utf((SQLCHAR *) cursor, len);
-	    if (!c) {
-		ret = nomem((STMT *) stmt);
-		goto done;
-	    }
-	    c[len] = 0;
-	    len = uc_strlen(c);
-	    if (buflen > 0) {
-		uc_strncpy(cursor, c, buflen - 1);
-		cursor[buflen - 1] = 0;
-	    }
-	    uc_free(c);
-	}
-	if (lenp) {
-	    *lenp = min(len, buflen - 1);
+static int
+cell2num(CELL *c, int type, SQLPOINTER val, SQLLEN *lenp)
+{
+    sqlite_int64 i;
+    double f;
+
+    if (c->type == SQLITE_INTEGER) {
+	i = c->v.i;
+	f = (double) i;
+    } else if (c->type == SQLITE_FLOAT) {
+	f = c->v.f;
+	if (f >= 9223372036854775807.0) {
+	    i = (sqlite_int64) (~((sqlite_uint64) 0) >> 1);
+	} else if (f <= -9223372036854775808.0) {
+	    i = -(sqlite_int64) (~((sqlite_uint64) 0) >> 1) - 1;
+	} else if (f != f) {
+	    i = 0;
+	} else {
+	    i = (sqlite_int64) f;
 	}
+    } else {
+	return 0;
     }
-done:
-    HSTMT_UNLOCK(stmt);
-    return ret;
-}
+    switch (type) {
+    case SQL_C_UTINYINT:
+    case SQL_C_TINYINT:
+    case SQL_C_STINYINT:
+	*((SQLCHAR *) val) = (SQLCHAR) i;
+	*lenp = sizeof (SQLCHAR);
+	return 1;
+    case SQL_C_USHORT:
+    case SQL_C_SHORT:
+    case SQL_C_SSHORT:
+	*((SQLSMALLINT *) val) = (SQLSMALLINT) i;
+	*lenp = sizeof (SQLSMALLINT);
+	return 1;
+    case SQL_C_ULONG:
+    case SQL_C_LONG:
+    case SQL_C_SLONG:
+	*((SQLINTEGER *) val) = (SQLINTEGER) i;
+	*lenp = sizeof (SQLINTEGER);
+	return 1;
+#ifdef SQL_BIGINT
+    case SQL_C_UBIGINT:
+	*((SQLUBIGINT *) val) = (SQLUBIGINT) i;
+	*lenp = sizeof (SQLUBIGINT);
+	return 1;
+    case SQL_C_SBIGINT:
+	*((SQLBIGINT *) val) = (SQLBIGINT) i;
+	*lenp = sizeof (SQLBIGINT);
+	return 1;
 #endif
+    case SQL_C_FLOAT:
+	*((float *) val) = (float) f;
+	*lenp = sizeof (float);
+	return 1;
+    case SQL_C_DOUBLE:
+	*((double *) val) = f;
+	*lenp = sizeof (double);
+	return 1;
+    }
+    return 0;
+}
 
 /**
- * Internal function to set cursor name on STMT.
- * @param stmt statement handle
- * @param cursor new cursor name
- * @param len length of cursor name or SQL_NTS
- * @result ODBC error code
+ * Truncate fraction of timestamp to column precision.
+ * @param tss TIMESTAMP_STRUCT to be fixed up
+ * @param prec precision (digits of fraction) of column
  */
 
-static SQLRETURN
-drvsetcursorname(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT len)
+static void
+fixfraction(TIMESTAMP_STRUCT *tss, int prec)
 {
-    STMT *s;
-
-    if (stmt == SQL_NULL_HSTMT) {
-	return SQL_INVALID_HANDLE;
-    }
-    s = (STMT *) stmt;
-    if (!cursor ||
-	!((cursor[0] >= 'A' && cursor[0] <= 'Z') ||
-	  (cursor[0] >= 'a' && cursor[0] <= 'z'))) {
-	setstat(s, -1, "invalid cursor name", (*s->ov3) ? "HYC00" : "S1C00");
-	return SQL_ERROR;
-    }
-    if (len == SQL_NTS) {
-	len = sizeof (s->cursorname) - 1;
-    } else {
-	len = min(sizeof (s->cursorname) - 1, len);
+    switch (prec) {
+    case 0:
+	tss->fraction = 0;
+	break;
+    case 1:
+	tss->fraction /= 100000000;
+	tss->fraction *= 100000000;
+	break;
+    case 2:
+	tss->fraction /= 10000000;
+	tss->fraction *= 10000000;
+	break;
     }
-    strncpy((char *) s->cursorname, (char *) cursor, len);
-    s->cursorname[len] = '\0';
-    return SQL_SUCCESS;
 }
 
-#ifndef WINTERFACE
 /**
- * Set cursor name on STMT.
- * @param stmt statement handle
- * @param cursor new cursor name
- * @param len length of cursor name or SQL_NTS
- * @result ODBC error code
+ * Store numeric cell value directly into date/time output buffer.
+ * @param c cell pointer
+ * @param type output (C) data type
+ * @param jdconv when true, REAL values are julian days
+ * @param val output buffer
+ * @param lenp output length
+ * @result true when value was stored, false when string
+ * conversion is needed
+ *
+ * REAL values are converted like str2date() et.al. would do it
+ * on their text representation but without formatting and parsing
+ * a string. INTEGER values are taken as seconds since 1970-01-01
+ * 00:00:00 UTC for TIMESTAMP output when the resulting year is
+ * in the range 1..9999, otherwise (e.g. 'YYYYMMDDhhmmss' numbers)
+ * the string conversion is used.
  */
 
-SQLRETURN SQL_API
-SQLSetCursorName(SQLHSTMT stmt, SQLCHAR *cursor, SQLSMALLINT len)
+static int
+cell2dt(CELL *c, int type, int jdconv, SQLPOINTER val, SQLLEN *lenp)
 {
-#if defined(_WIN32) || defined(_WIN64)
-    char *c = NULL;
-#endif
-    SQLRETURN ret;
+    DATE_STRUCT ds;
+    TIME_STRUCT ts;
+    int n;
 
-    HSTMT_LOCK(stmt);
-#if defined(_WIN32) || defined(_WIN64)
-    if (!((STMT *) stmt)->oemcp[0]) {
-	ret = drvsetcursorname(stmt, cursor, len);
-	goto done2;
-    }
-    if (cursor) {
-	c = wmb_to_utf_c((char *) cursor, len);
-	if (!c) {
-	    ret = nomem((STMT *) stmt);
-	    goto done;
+    if (c->type == SQLITE_FLOAT) {
+	/* other values are left to the string conversion */
+	if (!jdconv || !(c->v.f >= 0.0 && c->v.f < 5373484.5)) {
+	    return 0;
 	}
-    }
-    ret = drvsetcursorname(stmt, (SQLCHAR *) c, SQL_NTS);
-#else
-    ret = drvsetcursorname(stmt, cursor, len);
+	switch (type) {
+#ifdef SQL_C_TYPE_DATE
+	case SQL_C_TYPE_DATE:
 #endif
-#if defined(_WIN32) || defined(_WIN64)
-done:
-    uc_free(c);
-done2:
-    ;
+	case SQL_C_DATE:
+	    convJD2YMD(c->v.f, (DATE_STRUCT *) val);
+	    *lenp = sizeof (DATE_STRUCT);
+	    return 1;
+#ifdef SQL_C_TYPE_TIME
+	case SQL_C_TYPE_TIME:
 #endif
-    HSTMT_UNLOCK(stmt);
-    return ret;
-}
+	case SQL_C_TIME:
+	    convJD2HMS(c->v.f, (TIME_STRUCT *) val, 0);
+	    *lenp = sizeof (TIME_STRUCT);
+	    return 1;
+#ifdef SQL_C_TYPE_TIMESTAMP
+	case SQL_C_TYPE_TIMESTAMP:
 #endif
+	case SQL_C_TIMESTAMP:
+	    convJD2YMD(c->v.f, &ds);
+	    convJD2HMS(c->v.f, &ts, &n);
+	    break;
+	default:
+	    return 0;
+	}
+    } else if (c->type == SQLITE_INTEGER) {
+	sqlite_int64 days, z, era, doe, yoe, doy, mp, y;
+	int sod;
+
+	switch (type) {
+#ifdef SQL_C_TYPE_TIMESTAMP
+	case SQL_C_TYPE_TIMESTAMP:
+#endif
+	case SQL_C_TIMESTAMP:
+	    break;
+	default:
+	    return 0;
+	}
+	days = c->v.i / 86400;
+	sod = (int) (c->v.i % 86400);
+	if (sod < 0) {
+	    sod += 86400;
+	    days -= 1;
+	}
+	/* proleptic gregorian calendar from days since 1970-01-01 */
+	z = days + 719468;
+	era = ((z >= 0) ? z : (z - 146096)) / 146097;
+	doe = z - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	y = yoe + era * 400;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	ds.day = (SQLUSMALLINT) (doy - (153 * mp + 2) / 5 + 1);
+	ds.month = (SQLUSMALLINT) ((mp < 10) ? (mp + 3) : (mp - 9));
+	if (ds.month <= 2) {
+	    ++y;
+	}
+	if (y < 1 || y > 9999) {
+	    return 0;
+	}
+	ds.year = (SQLSMALLINT) y;
+	ts.hour = sod / 3600;
+	ts.minute = (sod / 60) % 60;
+	ts.second = sod % 60;
+	n = 0;
+    } else {
+	return 0;
+    }
+    ((TIMESTAMP_STRUCT *) val)->year = ds.year;
+    ((TIMESTAMP_STRUCT *) val)->month = ds.month;
+    ((TIMESTAMP_STRUCT *) val)->day = ds.day;
+    ((TIMESTAMP_STRUCT *) val)->hour = ts.hour;
+    ((TIMESTAMP_STRUCT *) val)->minute = ts.minute;
+    ((TIMESTAMP_STRUCT *) val)->second = ts.second;
+    ((TIMESTAMP_STRUCT *) val)->fraction = n;
+    *lenp = sizeof (TIMESTAMP_STRUCT);
+    return 1;
+}
 
-#ifdef WINTERFACE
 /**
- * Set cursor name on STMT (UNICODE version).
- * @param stmt statement handle
- * @param cursor new cursor name
- * @param len length of cursor name or SQL_NTS
- * @result ODBC error code
+ * Cell to bound column converters, selected by mkbindconv().
+ * @param c cell pointer
+ * @param b bound column
+ * @param val output buffer
+ * @param lenp output length
+ * @result true when value was stored, false when getrowdata()
+ * must do the conversion
  */
 
-SQLRETURN SQL_API
-SQLSetCursorNameW(SQLHSTMT stmt, SQLWCHAR *cursor, SQLSMALLINT len)
+static int
+conv_none(CELL *c, BINDCOL *b, SQLPOINTER val, SQLLEN *lenp)
 {
-    char *c = NULL;
-    SQLRETURN ret;
+    return 0;
+}
 
-    HSTMT_LOCK(stmt);
-    if (cursor) {
-	c = uc_to_utf_c(cursor, len);
-	if (!c) {
-	    ret = nomem((STMT *) stmt);
-	    goto done;
-	}
+static int
+conv_slong(CELL *c, BINDCOL *b, SQLPOINTER val, SQLLEN *lenp)
+{
+    switch (c->type) {
+    case SQLITE_INTEGER:
+	*((SQLINTEGER *) val) = (SQLINTEGER) c->v.i;
+	*lenp = sizeof (SQLINTEGER);
+	return 1;
+    case SQLITE_NULL:
+	*((SQLINTEGER *) val) = 0;
+	*lenp = SQL_NULL_DATA;
+	return 1;
+    case SQLITE_TEXT: {
+	char *endp = NULL;
+
+	*((SQLINTEGER *) val) = ln_strtol(c->v.p, &endp);
+	*lenp = (endp == c->v.p) ? SQL_NULL_DATA : sizeof (SQLINTEGER);
+	return 1;
     }
-    ret = drvsetcursorname(stmt, (SQLCHAR *) c, SQL_NTS);
-done:
-    uc_free(c);
-    HSTMT_UNLOCK(stmt);
-    return ret;
+    }
+    return cell2num(c, SQL_C_SLONG, val, lenp);
 }
-#endif
 
-/**
- * Close open cursor.
- * @param stmt statement handle
- * @return ODBC error code
- */
+static int
+conv_double(CELL *c, BINDCOL *b, SQLPOINTER val, SQLLEN *lenp)
+{
+    switch (c->type) {
+    case SQLITE_FLOAT:
+	*((double *) val) = c->v.f;
+	*lenp = sizeof (double);
+	return 1;
+    case SQLITE_INTEGER:
+	*((double *) val) = (double) c->v.i;
+	*lenp = sizeof (double);
+	return 1;
+    case SQLITE_NULL:
+	*((double *) val) = 0;
+	*lenp = SQL_NULL_DATA;
+	return 1;
+    case SQLITE_TEXT: {
+	char *endp = NULL;
+
+	*((double *) val) = ln_strtod(c->v.p, &endp);
+	*lenp = (endp == c->v.p) ? SQL_NULL_DATA : sizeof (double);
+	return 1;
+    }
+    }
+    return 0;
+}
 
-SQLRETURN SQL_API
-SQLCloseCursor(SQLHSTMT stmt)
+static int
+conv_num(CELL *c, BINDCOL *b, SQLPOINTER val, SQLLEN *lenp)
 {
-    return drvfreestmt(stmt, SQL_CLOSE);
-}
+    if (c->type == SQLITE_NULL) {
+	CELL zero;
 
-/**
- * Allocate a HENV, HDBC, or HSTMT handle.
- * @param type handle type
- * @param input input handle (HENV, HDBC)
- * @param output pointer to output handle (HENV, HDBC, HSTMT)
- * @result ODBC error code
- */
+	zero.type = SQLITE_INTEGER;
+	zero.v.i = 0;
+	if (cell2num(&zero, b->ctype, val, lenp)) {
+	    *lenp = SQL_NULL_DATA;
+	    return 1;
+	}
+	return 0;
+    }
+    return cell2num(c, b->ctype, val, lenp);
+}
 
-SQLRETURN SQL_API
-SQLAllocHandle(SQLSMALLINT type, SQLHANDLE input, SQLHANDLE *output)
+static int
+conv_char(CELL *c, BINDCOL *b, SQLPOINTER val, SQLLEN *lenp)
 {
-    SQLRETURN ret;
-
-    switch (type) {
-    case SQL_HANDLE_ENV:
-	ret = drvallocenv((SQLHENV *) output);
-	if (ret == SQL_SUCCESS) {
-	    ENV *e = (ENV *) *output;
+    char *data, numbuf[64];
+    int dlen;
 
-	    if (e && e->magic == ENV_MAGIC) {
-		e->ov3 = 1;
-	    }
+    switch (c->type) {
+    case SQLITE_NULL:
+	if (b->max > 0) {
+	    *((SQLCHAR *) val) = '\0';
 	}
-	return ret;
-    case SQL_HANDLE_DBC:
-	return drvallocconnect((SQLHENV) input, (SQLHDBC *) output);
-    case SQL_HANDLE_STMT:
-	HDBC_LOCK((SQLHDBC) input);
-	ret = drvallocstmt((SQLHDBC) input, (SQLHSTMT *) output);
-	HDBC_UNLOCK((SQLHDBC) input);
-	return ret;
+	*lenp = SQL_NULL_DATA;
+	return 1;
+    case SQLITE_TEXT:
+	data = c->v.p;
+	break;
+    case SQLITE_INTEGER:
+    case SQLITE_FLOAT:
+	data = cell2str(c, numbuf, sizeof (numbuf));
+	break;
+    default:
+	return 0;
     }
-    return SQL_ERROR;
+    dlen = strlen(data);
+    if (dlen >= b->max) {
+	/* truncation is reported by getrowdata() */
+	return 0;
+    }
+    memcpy(val, data, dlen + 1);
+    *lenp = dlen;
+    return 1;
 }
 
-/**
- * Free a HENV, HDBC, or HSTMT handle.
- * @param type handle type
- * @param h handle (HENV, HDBC, or HSTMT)
- * @result ODBC error code
- */
+#ifdef WCHARSUPPORT
 
-SQLRETURN SQL_API
-SQLFreeHandle(SQLSMALLINT type, SQLHANDLE h)
+static int
+conv_wchar(CELL *c, BINDCOL *b, SQLPOINTER val, SQLLEN *lenp)
 {
-    switch (type) {
-    case SQL_HANDLE_ENV:
-	return drvfreeenv((SQLHENV) h);
-    case SQL_HANDLE_DBC:
-	return drvfreeconnect((SQLHDBC) h);
-    case SQL_HANDLE_STMT:
-	return drvfreestmt((SQLHSTMT) h, SQL_DROP);
+    char *data, numbuf[64];
+    int dlen, n, used;
+
+    switch (c->type) {
+    case SQLITE_NULL:
+	if (b->max > 0) {
+	    *((SQLWCHAR *) val) = 0;
+	}
+	*lenp = SQL_NULL_DATA;
+	return 1;
+    case SQLITE_TEXT:
+	data = c->v.p;
+	dlen = c->len;
+	break;
+    case SQLITE_INTEGER:
+    case SQLITE_FLOAT:
+	data = cell2str(c, numbuf, sizeof (numbuf));
+	dlen = strlen(data);
+	break;
+    default:
+	return 0;
     }
-    return SQL_ERROR;
+    if (b->max < (int) (2 * sizeof (SQLWCHAR))) {
+	return 0;
+    }
+    n = uc_from_utf_len((unsigned char *) data, dlen, (SQLWCHAR *) val,
+			b->max / sizeof (SQLWCHAR) - 1, &used);
+    if (used < dlen && data[used]) {
+	/* truncation is reported by getrowdata() */
+	return 0;
+    }
+    ((SQLWCHAR *) val)[n] = 0;
+    *lenp = n * sizeof (SQLWCHAR);
+    return 1;
 }
 
+#endif
+
 /**
- * Free dynamically allocated column descriptions of STMT.
+ * Select converter for bound column, called when binding
+ * changes or a new result set is produced.
  * @param s statement pointer
+ * @param col column number, 0 based
  */
 
 static void
-freedyncols(STMT *s)
+mkbindconv(STMT *s, int col)
 {
-    if (s->dyncols) {
-	int i;
+    BINDCOL *b = &s->bindcols[col];
+    int type;
 
-	for (i = 0; i < s->dcols; i++) {
-	    freep(&s->dyncols[i].typename);
-	}
-	if (s->cols == s->dyncols) {
-	    s->cols = NULL;
-	    s->ncols = 0;
+    if (b->type == SQL_UNKNOWN_TYPE || !s->cols || col >= s->ncols) {
+	/* set up on first fetch */
+	b->ctype = SQL_UNKNOWN_TYPE;
+	b->conv = NULL;
+	return;
+    }
+    type = mapdeftype(b->type, s->cols[col].type,
+		      s->cols[col].nosign ? 1 : 0, s->nowchar[0]);
+#if (defined(_WIN32) || defined(_WIN64)) && defined(WINTERFACE)
+    /* MS Access hack part 3 (map SQL_C_DEFAULT to SQL_C_CHAR) */
+    if (type == SQL_C_WCHAR && b->type == SQL_C_DEFAULT) {
+	type = SQL_C_CHAR;
+    }
+#endif
+    b->ctype = type;
+    switch (type) {
+    case SQL_C_ULONG:
+    case SQL_C_LONG:
+    case SQL_C_SLONG:
+	b->conv = conv_slong;
+	break;
+    case SQL_C_DOUBLE:
+	b->conv = conv_double;
+	break;
+    case SQL_C_UTINYINT:
+    case SQL_C_TINYINT:
+    case SQL_C_STINYINT:
+    case SQL_C_USHORT:
+    case SQL_C_SHORT:
+    case SQL_C_SSHORT:
+#ifdef SQL_BIGINT
+    case SQL_C_UBIGINT:
+    case SQL_C_SBIGINT:
+#endif
+    case SQL_C_FLOAT:
+	b->conv = conv_num;
+	break;
+    case SQL_C_CHAR:
+	b->conv = conv_char;
+#if defined(_WIN32) || defined(_WIN64)
+	if (*s->oemcp) {
+	    b->conv = conv_none;
 	}
-	freep(&s->dyncols);
+#endif
+	break;
+#ifdef WCHARSUPPORT
+    case SQL_C_WCHAR:
+	b->conv = conv_wchar;
+	break;
+#endif
+    default:
+	b->conv = conv_none;
+	break;
     }
-    s->dcols = 0;
 }
 
 /**
- * Free statement's result.
+ * Fill cell from column of current row of stepped sqlite statement,
+ * without copying text or blob data.
  * @param s statement pointer
- * @param clrcols flag to clear column information
- *
- * The result rows are free'd using the rowfree function pointer.
- * If clrcols is greater than zero, then column bindings and dynamic column
- * descriptions are free'd.
- * If clrcols is less than zero, then dynamic column descriptions are free'd.
+ * @param col column number, 0 based
+ * @param c cell pointer
  */
 
 static void
-freeresult(STMT *s, int clrcols)
+s3stmt_cell(STMT *s, int col, CELL *c)
 {
-    freep(&s->bincache);
-    s->bincell = NULL;
-    s->binlen = 0;
-    if (s->rows) {
-	if (s->rowfree) {
-	    s->rowfree(s->rows);
-	    s->rowfree = NULL;
+    sqlite3_stmt *stmt = s->s3stmt;
+
+    c->type = sqlite3_column_type(stmt, col);
+    c->len = 0;
+    switch (c->type) {
+    case SQLITE_INTEGER:
+	c->v.i = sqlite3_column_int64(stmt, col);
+	break;
+    case SQLITE_FLOAT:
+	c->v.f = sqlite3_column_double(stmt, col);
+	break;
+    case SQLITE_NULL:
+	c->v.p = NULL;
+	break;
+    case SQLITE_TEXT:
+	c->v.p = (char *) sqlite3_column_text(stmt, col);
+	if (c->v.p) {
+	    c->len = sqlite3_column_bytes(stmt, col);
+	    break;
 	}
-	s->rows = NULL;
-    }
-    s->nrows = -1;
-    if (clrcols > 0) {
-	freep(&s->bindcols);
-	s->nbindcols = 0;
-    }
-    if (clrcols) {
-	freedyncols(s);
-	s->cols = NULL;
-	s->ncols = 0;
-	s->nowchar[1] = 0;
-	s->one_tbl = -1;
-	s->has_pk = -1;
-	s->has_rowid = -1;
+	/* fall through */
+    default:
+	/* left to getrowdata() */
+	c->type = SQLITE_BLOB;
+	c->v.p = NULL;
+	break;
     }
 }
 
 /**
- * Reset bound columns to unbound state.
+ * Return X'..' hex literal of blob cell, cached in the statement.
  * @param s statement pointer
+ * @param c blob cell pointer
+ * @result pointer to hex literal or NULL on memory error
  */
 
-static void
-unbindcols(STMT *s)
+static char *
+blob2hex(STMT *s, CELL *c)
 {
-    int i;
+    char *qp;
+    unsigned char *bp;
+    int k;
 
-    for (i = 0; s->bindcols && i < s->nbindcols; i++) {
-	s->bindcols[i].type = SQL_UNKNOWN_TYPE;
-	s->bindcols[i].max = 0;
-	s->bindcols[i].lenp = NULL;
-	s->bindcols[i].valp = NULL;
-	s->bindcols[i].index = i;
-	s->bindcols[i].offs = 0;
+    if (s->bincache && s->bincell == c->v.p) {
+	return s->bincache;
+    }
+    freep(&s->bincache);
+    s->bincell = NULL;
+    s->binlen = 0;
+    qp = xmalloc(c->len * 2 + 4);
+    if (!qp) {
+	return NULL;
     }
+    s->bincache = qp;
+    s->bincell = c->v.p;
+    s->binlen = c->len * 2 + 3;
+    bp = (unsigned char *) c->v.p;
+    *qp++ = 'X';
+    *qp++ = '\'';
+    for (k = 0; k < c->len; k++) {
+	*qp++ = xdigits[(bp[k] >> 4)];
+	*qp++ = xdigits[(bp[k] & 0xF)];
+    }
+    *qp++ = '\'';
+    *qp = '\0';
+    return s->bincache;
 }
 
 /**
- * Reallocate space for bound columns.
+ * Retrieve ROWID column value of result set row.
  * @param s statement pointer
- * @param ncols number of columns
- * @result ODBC error code
+ * @param rowp row index
+ * @result ROWID value
  */
 
-static SQLRETURN
-mkbindcols(STMT *s, int ncols)
+static sqlite_int64
+getrowid(STMT *s, int rowp)
 {
-    if (s->bindcols) {
-	if (s->nbindcols < ncols) {
-	    int i;
-	    BINDCOL *bindcols =
-		xrealloc(s->bindcols, ncols * sizeof (BINDCOL));
+    char *data, *endp = 0;
 
-	    if (!bindcols) {
-		return nomem(s);
-	    }
-	    for (i = s->nbindcols; i < ncols; i++) {
-		bindcols[i].type = SQL_UNKNOWN_TYPE;
-		bindcols[i].max = 0;
-		bindcols[i].lenp = NULL;
-		bindcols[i].valp = NULL;
-		bindcols[i].index = i;
-		bindcols[i].offs = 0;
-	    }
-	    s->bindcols = bindcols;
-	    s->nbindcols = ncols;
-	}
-    } else if (ncols > 0) {
-	s->bindcols = (BINDCOL *) xmalloc(ncols * sizeof (BINDCOL));
-	if (!s->bindcols) {
-	    return nomem(s);
+    if (s->s3stmt_rowlazy && s3stmt_rowcells(s, s->ncols) != SQLITE_OK) {
+	return 0;
+    }
+    if (s->cells) {
+	CELL *c = &s->cells[s->has_rowid * s->cellstride + rowp];
+
+	switch (c->type) {
+	case SQLITE_INTEGER:
+	    return c->v.i;
+	case SQLITE_FLOAT:
+	    return (sqlite_int64) c->v.f;
+	case SQLITE_NULL:
+	    return 0;
 	}
-	s->nbindcols = ncols;
-	unbindcols(s);
+	data = c->v.p;
+    } else {
+	data = s->rows[s->ncols + (rowp * s->ncols) + s->has_rowid];
     }
-    return SQL_SUCCESS;
+    if (!data) {
+	return 0;
+    }
+    return ln_strtoll(data, &endp);
 }
 
 /**
@@ -13921,7 +18417,9 @@ static SQLRETURN
 getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	   SQLPOINTER val, SQLINTEGER len, SQLLEN *lenp, int partial)
 {
-    char **data, valdummy[16];
+    char *data, valdummy[16], numbuf[64];
+    char *blob = NULL;
+    int bloblen = 0, lob = 0;
     SQLLEN dummy;
     SQLINTEGER *ilenp = NULL;
     int valnull = 0;
@@ -13943,7 +18441,10 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
     if (s->retr_data != SQL_RD_ON) {
 	return SQL_SUCCESS;
     }
-    if (!s->rows) {
+    if (s->s3stmt_rowlazy && s3stmt_rowcells(s, s->ncols) != SQLITE_OK) {
+	return nomem(s);
+    }
+    if (!s->rows && !s->cells) {
 	*lenp = SQL_NULL_DATA;
 	goto done;
     }
@@ -13959,12 +18460,50 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	type = SQL_C_CHAR;
     }
 #endif
-    data = s->rows + s->ncols + (s->rowp * s->ncols) + col;
     if (!val) {
 	valnull = 1;
 	val = (SQLPOINTER) valdummy;
     }
-    if (*data == NULL) {
+    if (s->cells) {
+	CELL *c = &s->cells[col * s->cellstride + s->rowp];
+
+#ifdef USE_LOBSTREAM
+	if (LOBCELL(c)) {
+	    if (type == SQL_C_BINARY && !valnull) {
+		/* deferred blob, read piecewise below */
+		lob = 1;
+	    } else if (lobload(s, col, s->rowp) != SQL_SUCCESS) {
+		return SQL_ERROR;
+	    }
+	}
+#endif
+	if (cell2num(c, type, val, lenp)) {
+	    sret = SQL_SUCCESS;
+	    goto done;
+	}
+	if (cell2dt(c, type, *s->jdconv, val, lenp)) {
+	    if (*lenp == sizeof (TIMESTAMP_STRUCT)) {
+		fixfraction((TIMESTAMP_STRUCT *) val, s->cols[col].prec);
+	    }
+	    sret = SQL_SUCCESS;
+	    goto done;
+	}
+	if (c->type != SQLITE_BLOB) {
+	    data = cell2str(c, numbuf, sizeof (numbuf));
+	} else if (type == SQL_C_BINARY && !valnull) {
+	    /* raw blob data is copied as-is, no hex round trip */
+	    data = blob = lob ? valdummy : c->v.p;
+	    bloblen = c->len;
+	} else {
+	    data = blob2hex(s, c);
+	    if (!data) {
+		return nomem(s);
+	    }
+	}
+    } else {
+	data = s->rows[s->ncols + (s->rowp * s->ncols) + col];
+    }
+    if (data == NULL) {
 	*lenp = SQL_NULL_DATA;
 	switch (type) {
 	case SQL_C_UTINYINT:
@@ -14043,8 +18582,8 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	case SQL_C_UTINYINT:
 	case SQL_C_TINYINT:
 	case SQL_C_STINYINT:
-	    *((SQLCHAR *) val) = strtol(*data, &endp, 0);
-	    if (endp && endp == *data) {
+	    *((SQLCHAR *) val) = ln_strtol(data, &endp);
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLCHAR);
@@ -14052,15 +18591,15 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	    break;
 #ifdef SQL_BIT
 	case SQL_C_BIT:
-	    *((SQLCHAR *) val) = getbool(*data);
+	    *((SQLCHAR *) val) = getbool(data);
 	    *lenp = sizeof (SQLCHAR);
 	    break;
 #endif
 	case SQL_C_USHORT:
 	case SQL_C_SHORT:
 	case SQL_C_SSHORT:
-	    *((SQLSMALLINT *) val) = strtol(*data, &endp, 0);
-	    if (endp && endp == *data) {
+	    *((SQLSMALLINT *) val) = ln_strtol(data, &endp);
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLSMALLINT);
@@ -14069,8 +18608,8 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	case SQL_C_ULONG:
 	case SQL_C_LONG:
 	case SQL_C_SLONG:
-	    *((SQLINTEGER *) val) = strtol(*data, &endp, 0);
-	    if (endp && endp == *data) {
+	    *((SQLINTEGER *) val) = ln_strtol(data, &endp);
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLINTEGER);
@@ -14079,18 +18618,18 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 #ifdef SQL_BIGINT
 	case SQL_C_UBIGINT:
 #if defined(_WIN32) || defined(_WIN64)
-	    if (sscanf(*data, "%I64u%c", (SQLUBIGINT *) val, &endc) != 1) {
+	    if (sscanf(data, "%I64u%c", (SQLUBIGINT *) val, &endc) != 1) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLUBIGINT);
 	    }
 #else
 #ifdef __osf__
-	    *((SQLUBIGINT *) val) = strtoul(*data, &endp, 0);
+	    *((SQLUBIGINT *) val) = strtoul(data, &endp, 0);
 #else
-	    *((SQLUBIGINT *) val) = strtoull(*data, &endp, 0);
+	    *((SQLUBIGINT *) val) = strtoull(data, &endp, 0);
 #endif
-	    if (endp && endp == *data) {
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLUBIGINT);
@@ -14099,18 +18638,17 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	    break;
 	case SQL_C_SBIGINT:
 #if defined(_WIN32) || defined(_WIN64)
-	    if (sscanf(*data, "%I64d%c", (SQLBIGINT *) val, &endc) != 1) {
+	    if (ln_fastatoi(data, &endp, (sqlite_int64 *) val) && !*endp) {
+		*lenp = sizeof (SQLBIGINT);
+	    } else if (sscanf(data, "%I64d%c", (SQLBIGINT *) val,
+			      &endc) != 1) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLBIGINT);
 	    }
 #else
-#ifdef __osf__
-	    *((SQLBIGINT *) val) = strtol(*data, &endp, 0);
-#else
-	    *((SQLBIGINT *) val) = strtoll(*data, &endp, 0);
-#endif
-	    if (endp && endp == *data) {
+	    *((SQLBIGINT *) val) = ln_strtoll(data, &endp);
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (SQLBIGINT);
@@ -14119,16 +18657,16 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	    break;
 #endif
 	case SQL_C_FLOAT:
-	    *((float *) val) = ln_strtod(*data, &endp);
-	    if (endp && endp == *data) {
+	    *((float *) val) = ln_strtod(data, &endp);
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (float);
 	    }
 	    break;
 	case SQL_C_DOUBLE:
-	    *((double *) val) = ln_strtod(*data, &endp);
-	    if (endp && endp == *data) {
+	    *((double *) val) = ln_strtod(data, &endp);
+	    if (endp && endp == data) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (double);
@@ -14139,11 +18677,17 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 	    char *bin;
 
 	    if (valnull) {
-		freep(&s->bincache);
-		s->binlen = 0;
+		/* data may be the hex literal cached by blob2hex() */
+		if (data != s->bincache) {
+		    freep(&s->bincache);
+		    s->binlen = 0;
+		}
 		goto doCHAR;
 	    }
-	    if (*data == s->bincell) {
+	    if (blob) {
+		bin = blob;
+		dlen = bloblen;
+	    } else if (data == s->bincell) {
 		if (s->bincache) {
 		    bin = s->bincache;
 		    dlen = s->binlen;
@@ -14155,7 +18699,7 @@ getrowdata(STMT *s, SQLUSMALLINT col, SQLSMALLINT otype,
 		int i;
 
 		freep(&s->bincache);
-		dp = *data;
+		dp = data;
 		dlen = strlen(dp);
 		s->bincell = dp;
 		s->binlen = 0;
@@ -14213,6 +18757,14 @@ converr:
 		dlen -= offs;
 	    }
 	    if (val && len) {
+#ifdef USE_LOBSTREAM
+		if (lob) {
+		    if (lobread(s, col, s->rowp, offs, val,
+				min(len, dlen)) != SQL_SUCCESS) {
+			return SQL_ERROR;
+		    }
+		} else
+#endif
 		memcpy(val, bin + offs, min(len, dlen));
 	    }
 	    if (len < 1) {
@@ -14250,11 +18802,12 @@ converr:
 #endif
 	case SQL_C_CHAR: {
 	    int doz, zlen = len - 1;
-	    int dlen = strlen(*data);
+	    int dlen = strlen(data);
 	    int offs = 0;
 #ifdef WCHARSUPPORT
 	    SQLWCHAR *ucdata = NULL;
-	    SQLCHAR *cdata = (SQLCHAR *) *data;
+	    SQLCHAR *cdata = (SQLCHAR *) data;
+	    int direct = 0;
 #endif
 
 #if (defined(_WIN32) || defined(_WIN64)) && defined(WINTERFACE)
@@ -14263,7 +18816,7 @@ converr:
 		(s->cols == statSpec2P || s->cols == statSpec3P) &&
 		type == SQL_C_WCHAR) {
 		if (len > 0 && len <= sizeof (SQLWCHAR)) {
-		    ((char *) val)[0] = data[0][0];
+		    ((char *) val)[0] = data[0];
 		    memset((char *) val + 1, 0, len - 1);
 		    *lenp = 1;
 		    sret = SQL_SUCCESS;
@@ -14285,11 +18838,25 @@ converr:
 		break;
 	    }
 	    if (type == SQL_C_WCHAR) {
-		ucdata = uc_from_utf(cdata, dlen);
-		if (!ucdata) {
-		    return nomem(s);
+		if (!valnull && len >= (int) (2 * sizeof (SQLWCHAR)) &&
+		    !(partial && s->bindcols && s->bindcols[col].offs)) {
+		    int n, used;
+
+		    /* try to convert right into the caller's buffer */
+		    n = uc_from_utf_len(cdata, dlen, (SQLWCHAR *) val,
+					len / sizeof (SQLWCHAR) - 1, &used);
+		    if (used >= dlen) {
+			direct = 1;
+			dlen = n * sizeof (SQLWCHAR);
+		    }
+		}
+		if (!direct) {
+		    ucdata = uc_from_utf(cdata, dlen);
+		    if (!ucdata) {
+			return nomem(s);
+		    }
+		    dlen = uc_strlen(ucdata) * sizeof (SQLWCHAR);
 		}
-		dlen = uc_strlen(ucdata) * sizeof (SQLWCHAR);
 	    }
 #if defined(_WIN32) || defined(_WIN64)
 	    else if (*s->oemcp && type == SQL_C_CHAR) {
@@ -14335,14 +18902,16 @@ converr:
 	    }
 	    if (val && !valnull && len) {
 #ifdef WCHARSUPPORT
-		if (type == SQL_C_WCHAR) {
+		if (direct) {
+		    /* already in place */
+		} else if (type == SQL_C_WCHAR) {
 		    uc_strncpy(val, ucdata + offs / sizeof (SQLWCHAR),
 			       (len - doz) / sizeof (SQLWCHAR));
 		} else {
 		    strncpy(val, (char *) cdata + offs, len - doz);
 		}
 #else
-		strncpy(val, *data + offs, len - doz);
+		strncpy(val, data + offs, len - doz);
 #endif
 	    }
 	    if (valnull || len < 1) {
@@ -14394,7 +18963,7 @@ converr:
 	case SQL_C_TYPE_DATE:
 #endif
 	case SQL_C_DATE:
-	    if (str2date(*s->jdconv, *data, (DATE_STRUCT *) val) < 0) {
+	    if (str2date(*s->jdconv, data, (DATE_STRUCT *) val) < 0) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (DATE_STRUCT);
@@ -14404,7 +18973,7 @@ converr:
 	case SQL_C_TYPE_TIME:
 #endif
 	case SQL_C_TIME:
-	    if (str2time(*s->jdconv, *data, (TIME_STRUCT *) val) < 0) {
+	    if (str2time(*s->jdconv, data, (TIME_STRUCT *) val) < 0) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (TIME_STRUCT);
@@ -14414,25 +18983,13 @@ converr:
 	case SQL_C_TYPE_TIMESTAMP:
 #endif
 	case SQL_C_TIMESTAMP:
-	    if (str2timestamp(*s->jdconv, *data,
+	    if (str2timestamp(*s->jdconv, data,
 			      (TIMESTAMP_STRUCT *) val) < 0) {
 		*lenp = SQL_NULL_DATA;
 	    } else {
 		*lenp = sizeof (TIMESTAMP_STRUCT);
 	    }
-	    switch (s->cols[col].prec) {
-	    case 0:
-		((TIMESTAMP_STRUCT *) val)->fraction = 0;
-		break;
-	    case 1:
-		((TIMESTAMP_STRUCT *) val)->fraction /= 100000000;
-		((TIMESTAMP_STRUCT *) val)->fraction *= 100000000;
-		break;
-	    case 2:
-		((TIMESTAMP_STRUCT *) val)->fraction /= 10000000;
-		((TIMESTAMP_STRUCT *) val)->fraction *= 10000000;
-		break;
-	    }
+	    fixfraction((TIMESTAMP_STRUCT *) val, s->cols[col].prec);
 	    break;
 	default:
 	    return SQL_ERROR;
@@ -14584,6 +19141,8 @@ drvbindcol(SQLHSTMT stmt, SQLUSMALLINT col, SQLSMALLINT type,
 	s->bindcols[col].lenp = NULL;
 	s->bindcols[col].valp = NULL;
 	s->bindcols[col].offs = 0;
+	s->bindcols[col].ctype = SQL_UNKNOWN_TYPE;
+	s->bindcols[col].conv = NULL;
     } else {
 	if (sz == 0 && max < 0) {
 	    setstat(s, -1, "invalid length", "HY090");
@@ -14594,6 +19153,7 @@ drvbindcol(SQLHSTMT stmt, SQLUSMALLINT col, SQLSMALLINT type,
 	s->bindcols[col].lenp = lenp;
 	s->bindcols[col].valp = val;
 	s->bindcols[col].offs = 0;
+	mkbindconv(s, col);
 	if (lenp) {
 	    *lenp = 0;
 	}
@@ -15125,8 +19685,8 @@ drvcolumns(SQLHSTMT stmt,
 	sqlite3_free(sql);
 	return sret;
     }
-    dbtraceapi(d, "sqlite3_get_table", sql);
-    ret = sqlite3_get_table(d->sqlite, sql, &trows, &tnrows, &tncols, &errp);
+    sccache_check(d);
+    ret = sccache_get_table(d, sql, &trows, &tnrows, &tncols, &errp);
     sqlite3_free(sql);
     if (ret != SQLITE_OK) {
 	setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -15143,18 +19703,17 @@ drvcolumns(SQLHSTMT stmt,
     }
     /* pass 1: compute number of rows of result set */
     if (tncols * tnrows <= 0) {
-	sqlite3_free_table(trows);
+	sccache_free_table(d, trows);
 	return SQL_SUCCESS;
     }
     size = 0;
     for (i = 1; i <= tnrows; i++) {
 	sql = sqlite3_mprintf("PRAGMA table_info(%Q)", trows[i]);
 	if (!sql) {
-	    sqlite3_free_table(trows);
+	    sccache_free_table(d, trows);
 	    return nomem(s);
 	}
-	dbtraceapi(d, "sqlite3_get_table", sql);
-	ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, &errp);
+	ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
 	sqlite3_free(sql);
 	if (ret != SQLITE_OK) {
 	    setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -15163,7 +19722,7 @@ drvcolumns(SQLHSTMT stmt,
 		sqlite3_free(errp);
 		errp = NULL;
 	    }
-	    sqlite3_free_table(trows);
+	    sccache_free_table(d, trows);
 	    return SQL_ERROR;
 	}
 	if (errp) {
@@ -15190,11 +19749,11 @@ drvcolumns(SQLHSTMT stmt,
 		size += nrows;
 	    }
 	}
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
     }
     /* pass 2: fill result set */
     if (size <= 0) {
-	sqlite3_free_table(trows);
+	sccache_free_table(d, trows);
 	return SQL_SUCCESS;
     }
     s->nrows = size;
@@ -15202,7 +19761,7 @@ drvcolumns(SQLHSTMT stmt,
     s->rows = xmalloc((size + 1) * sizeof (char *));
     if (!s->rows) {
 	s->nrows = 0;
-	sqlite3_free_table(trows);
+	sccache_free_table(d, trows);
 	return nomem(s);
     }
     s->rows[0] = (char *) size;
@@ -15213,11 +19772,10 @@ drvcolumns(SQLHSTMT stmt,
     for (i = 1; i <= tnrows; i++) {
 	sql = sqlite3_mprintf("PRAGMA table_info(%Q)", trows[i]);
 	if (!sql) {
-	    sqlite3_free_table(trows);
+	    sccache_free_table(d, trows);
 	    return nomem(s);
 	}
-	dbtraceapi(d, "sqlite3_get_table", sql);
-	ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, &errp);
+	ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
 	sqlite3_free(sql);
 	if (ret != SQLITE_OK) {
 	    setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -15226,7 +19784,7 @@ drvcolumns(SQLHSTMT stmt,
 		sqlite3_free(errp);
 		errp = NULL;
 	    }
-	    sqlite3_free_table(trows);
+	    sccache_free_table(d, trows);
 	    return SQL_ERROR;
 	}
 	if (errp) {
@@ -15316,7 +19874,7 @@ drvcolumns(SQLHSTMT stmt,
 		    }
 		} else if (strcmp(rowp[k], "dflt_value") == 0) {
 		    for (mr = 0, m = 1; m <= nrows; m++) {
-			char *dflt = unquote(rowp[m * ncols + k]);
+			char *dflt = rowp[m * ncols + k];
 			int ir;
 
 			if (cname[0] &&
@@ -15324,7 +19882,8 @@ drvcolumns(SQLHSTMT stmt,
 			    continue;
 			}
 			ir = asize * (roffs + mr);
-			s->rows[ir + 12] = xstrdup(dflt ? dflt : "NULL");
+			s->rows[ir + 12] =
+			    dflt ? unquote(xstrdup(dflt)) : xstrdup("NULL");
 			++mr;
 		    }
 		} else if (strcmp(rowp[k], "type") == 0) {
@@ -15370,9 +19929,9 @@ drvcolumns(SQLHSTMT stmt,
 	    }
 	    roffs += nr;
 	}
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
     }
-    sqlite3_free_table(trows);
+    sccache_free_table(d, trows);
     return SQL_SUCCESS;
 }
 
@@ -16057,6 +20616,7 @@ drvstatistics(SQLHSTMT stmt, SQLCHAR *cat, SQLSMALLINT catLen,
     if (sret != SQL_SUCCESS) {
 	return sret;
     }
+    sccache_check(d);
     /*
      * Try integer primary key (autoincrement) first
      */
@@ -16065,9 +20625,7 @@ drvstatistics(SQLHSTMT stmt, SQLCHAR *cat, SQLSMALLINT catLen,
 	ret = SQLITE_ERROR;
 	sql = sqlite3_mprintf("PRAGMA table_info(%Q)", tname);
 	if (sql) {
-	    dbtraceapi(d, "sqlite3_get_table", sql);
-	    ret = sqlite3_get_table(d->sqlite, sql, &rowp,
-				    &nrows, &ncols, NULL);
+	    ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, NULL);
 	    sqlite3_free(sql);
 	}
 	if (ret == SQLITE_OK) {
@@ -16095,14 +20653,13 @@ drvstatistics(SQLHSTMT stmt, SQLCHAR *cat, SQLSMALLINT catLen,
 	    }
 	}
 noipk:
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
     }
     sql = sqlite3_mprintf("PRAGMA index_list(%Q)", tname);
     if (!sql) {
 	return nomem(s);
     }
-    dbtraceapi(d, "sqlite3_get_table", sql);
-    ret = sqlite3_get_table(d->sqlite, sql, &rowp, &nrows, &ncols, &errp);
+    ret = sccache_get_table(d, sql, &rowp, &nrows, &ncols, &errp);
     sqlite3_free(sql);
     if (ret != SQLITE_OK) {
 	setstat(s, ret, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
@@ -16134,14 +20691,13 @@ noipk:
 	    sql = sqlite3_mprintf("PRAGMA index_info(%Q)",
 				  rowp[i * ncols + namec]);
 	    if (sql) {
-		dbtraceapi(d, "sqlite3_get_table", sql);
-		ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+		ret = sccache_get_table(d, sql, &rowpp,
 					&nnrows, &nncols, NULL);
 		sqlite3_free(sql);
 	    }
 	    if (ret == SQLITE_OK) {
 		size += nnrows;
-		sqlite3_free_table(rowpp);
+		sccache_free_table(d, rowpp);
 	    }
 	}
     }
@@ -16150,7 +20706,7 @@ nodata:
 	size++;
     }
     if (size == 0) {
-	sqlite3_free_table(rowp);
+	sccache_free_table(d, rowp);
 	return SQL_SUCCESS;
     }
     s->nrows = size;
@@ -16158,6 +20714,7 @@ nodata:
     s->rows = xmalloc((size + 1) * sizeof (char *));
     if (!s->rows) {
 	s->nrows = 0;
+	sccache_free_table(d, rowp);
 	return nomem(s);
     }
     s->rows[0] = (char *) size;
@@ -16171,9 +20728,7 @@ nodata:
 
 	sql = sqlite3_mprintf("PRAGMA table_info(%Q)", tname);
 	if (sql) {
-	    dbtraceapi(d, "sqlite3_get_table", sql);
-	    ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
-				    &nrows2, &ncols2, NULL);
+	    ret = sccache_get_table(d, sql, &rowpp, &nrows2, &ncols2, NULL);
 	    sqlite3_free(sql);
 	}
 	if (ret == SQLITE_OK) {
@@ -16218,7 +20773,7 @@ nodata:
 	    s->rows[roffs + 9] = xstrdup("A");
 	}
 nodata2:
-	sqlite3_free_table(rowpp);
+	sccache_free_table(d, rowpp);
     }
     for (i = 1; i <= nrows; i++) {
 	int nnrows, nncols;
@@ -16231,8 +20786,7 @@ nodata2:
 	    sql = sqlite3_mprintf("PRAGMA index_info(%Q)",
 				  rowp[i * ncols + namec]);
 	    if (sql) {
-		dbtraceapi(d, "sqlite3_get_table", sql);
-		ret = sqlite3_get_table(d->sqlite, sql, &rowpp,
+		ret = sccache_get_table(d, sql, &rowpp,
 					&nnrows, &nncols, NULL);
 		sqlite3_free(sql);
 	    }
@@ -16277,10 +20831,10 @@ nodata2:
 		}
 	    }
 	    offs += nnrows;
-	    sqlite3_free_table(rowpp);
+	    sccache_free_table(d, rowpp);
 	}
     }
-    sqlite3_free_table(rowp);
+    sccache_free_table(d, rowp);
     return SQL_SUCCESS;
 }
 
@@ -16414,6 +20968,37 @@ done:
 }
 #endif
 
+/**
+ * Account character/binary data stored into application buffer.
+ * @param d DBC pointer
+ * @param type output (C) data type
+ * @param lenp output length or NULL
+ * @param max size of output buffer
+ */
+
+static void
+statconv(DBC *d, SQLSMALLINT type, SQLLEN *lenp, SQLLEN max)
+{
+    SQLLEN n;
+
+    if (!lenp || *lenp <= 0) {
+	return;
+    }
+    switch (type) {
+    case SQL_C_CHAR:
+#ifdef WCHARSUPPORT
+    case SQL_C_WCHAR:
+#endif
+    case SQL_C_BINARY:
+	n = *lenp;
+	if (max > 0 && n > max) {
+	    n = max;
+	}
+	d->stats.convbytes += n;
+	break;
+    }
+}
+
 /**
  * Retrieve row data after fetch.
  * @param stmt statement handle
@@ -16430,7 +21015,9 @@ SQLGetData(SQLHSTMT stmt, SQLUSMALLINT col, SQLSMALLINT type,
 	   SQLPOINTER val, SQLLEN len, SQLLEN *lenp)
 {
     STMT *s;
+    DBC *d;
     SQLRETURN ret = SQL_ERROR;
+    sqlite_int64 t0;
 
     HSTMT_LOCK(stmt);
     if (stmt == SQL_NULL_HSTMT) {
@@ -16446,16 +21033,9 @@ SQLGetData(SQLHSTMT stmt, SQLUSMALLINT col, SQLSMALLINT type,
 	    ret = SQL_SUCCESS;
 	    goto done;
 	} else if (s->bkmrk == SQL_UB_VARIABLE && type == SQL_C_VARBOOKMARK) {
+	    getdynmeta(s, -1);
 	    if (s->has_rowid >= 0) {
-		char **data, *endp = 0;
-
-		data = s->rows + s->ncols + (s->rowp * s->ncols)
-		     + s->has_rowid;
-#ifdef __osf__
-		*((sqlite_int64 *) val) = strtol(*data, &endp, 0);
-#else
-		*((sqlite_int64 *) val) = strtoll(*data, &endp, 0);
-#endif
+		*((sqlite_int64 *) val) = getrowid(s, s->rowp);
 	    } else {
 		*((sqlite_int64 *) val) = s->rowp;
 	    }
@@ -16471,7 +21051,15 @@ SQLGetData(SQLHSTMT stmt, SQLUSMALLINT col, SQLSMALLINT type,
 	goto done;
     }
     --col;
+    d = (DBC *) s->dbc;
+    t0 = d->stats_timing ? getusec() : 0;
     ret = getrowdata(s, col, type, val, len, lenp, 1);
+    if (SQL_SUCCEEDED(ret)) {
+	statconv(d, type, lenp, len);
+    }
+    if (d->stats_timing) {
+	d->stats.getrowdata += getusec() - t0;
+    }
 done:
     HSTMT_UNLOCK(stmt);
     return ret;
@@ -16487,7 +21075,10 @@ done:
 static SQLRETURN
 dofetchbind(STMT *s, int rsi)
 {
+    DBC *d = (DBC *) s->dbc;
     int ret, i, withinfo = 0;
+    SQLLEN dummy;
+    sqlite_int64 t0 = d->stats_timing ? getusec() : 0;
 
     s->row_status0[rsi] = SQL_ROW_SUCCESS;
     if (s->bkmrk != SQL_UB_OFF && s->bkmrkcol.valp) {
@@ -16506,16 +21097,9 @@ dofetchbind(STMT *s, int rsi)
 	    if (s->bind_offs) {
 		val = (SQLPOINTER) ((char *) val + *s->bind_offs);
 	    }
+	    getdynmeta(s, -1);
 	    if (s->has_rowid >= 0) {
-		char **data, *endp = 0;
-
-		data = s->rows + s->ncols + (s->rowp * s->ncols)
-		     + s->has_rowid;
-#ifdef __osf__
-		*(sqlite_int64 *) val = strtol(*data, &endp, 0);
-#else
-		*(sqlite_int64 *) val = strtoll(*data, &endp, 0);
-#endif
+		*(sqlite_int64 *) val = getrowid(s, s->rowp);
 	    } else {
 		*(sqlite_int64 *) val = s->rowp;
 	    }
@@ -16577,11 +21161,31 @@ dofetchbind(STMT *s, int rsi)
 	    }
 	}
 	if (dp || lp) {
+	    if (!b->conv) {
+		mkbindconv(s, i);
+	    }
+	    if (dp && b->conv && b->conv != conv_none &&
+		s->retr_data == SQL_RD_ON &&
+		(!lp || ((SQLINTEGER *) lp) + 1 != (SQLINTEGER *) dp)) {
+		CELL *c = NULL, cell;
+
+		if (s->s3stmt_rowlazy) {
+		    s3stmt_cell(s, i, &cell);
+		    c = &cell;
+		} else if (s->cells && s->rowp >= 0 && s->rowp < s->nrows) {
+		    c = &s->cells[i * s->cellstride + s->rowp];
+		}
+		if (c && b->conv(c, b, dp, lp ? lp : &dummy)) {
+		    statconv(d, b->type, lp, b->max);
+		    continue;
+		}
+	    }
 	    ret = getrowdata(s, (SQLUSMALLINT) i, b->type, dp, b->max, lp, 0);
 	    if (!SQL_SUCCEEDED(ret)) {
 		s->row_status0[rsi] = SQL_ROW_ERROR;
 		break;
 	    }
+	    statconv(d, b->type, lp, b->max);
 	    if (ret != SQL_SUCCESS) {
 		withinfo = 1;
 #ifdef SQL_ROW_SUCCESS_WITH_INFO
@@ -16593,6 +21197,9 @@ dofetchbind(STMT *s, int rsi)
     if (SQL_SUCCEEDED(ret)) {
 	ret = withinfo ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
     }
+    if (d->stats_timing) {
+	d->stats.getrowdata += getusec() - t0;
+    }
     return ret;
 }
 
@@ -16648,14 +21255,14 @@ drvfetchscroll(SQLHSTMT stmt, SQLSMALLINT orient, SQLINTEGER offset)
     }
     ret = SQL_SUCCESS;
     i = 0;
-    if (((DBC *) (s->dbc))->cur_s3stmt == s && s->s3stmt) {
+    if (s->s3stmt_stream && s->s3stmt) {
 	s->rowp = s->rowprs = 0;
 	for (; i < s->rowset_size; i++) {
 	    if (s->max_rows && s->s3stmt_rownum + 1 >= s->max_rows) {
 		ret = (i == 0) ? SQL_NO_DATA : SQL_SUCCESS;
 		break;
 	    }
-	    ret = s3stmt_step(s);
+	    ret = s3stmt_step(s, 1);
 	    if (ret != SQL_SUCCESS) {
 		s->row_status0[i] = SQL_ROW_ERROR;
 		break;
@@ -16670,7 +21277,7 @@ drvfetchscroll(SQLHSTMT stmt, SQLSMALLINT orient, SQLINTEGER offset)
 		withinfo = 1;
 	    }
 	}
-    } else if (s->rows) {
+    } else if (s->rows || s->cells) {
 	switch (orient) {
 	case SQL_FETCH_NEXT:
 	    if (s->nrows < 1) {
@@ -16754,20 +21361,13 @@ drvfetchscroll(SQLHSTMT stmt, SQLSMALLINT orient, SQLINTEGER offset)
 		int rowp;
 
 		if (s->bkmrk == SQL_UB_VARIABLE) {
+		    getdynmeta(s, -1);
 		    if (s->has_rowid >= 0) {
 			sqlite_int64 bkmrk, rowid;
 
 			bkmrk = *(sqlite_int64 *) s->bkmrkptr;
 			for (rowp = 0; rowp < s->nrows; rowp++) {
-			    char **data, *endp = 0;
-
-			    data = s->rows + s->ncols + (rowp * s->ncols)
-				 + s->has_rowid;
-#ifdef __osf__
-			    rowid = strtol(*data, &endp, 0);
-#else
-			    rowid = strtoll(*data, &endp, 0);
-#endif
+			    rowid = getrowid(s, rowp);
 			    if (rowid == bkmrk) {
 				break;
 			    }
@@ -17372,6 +21972,7 @@ checkLen:
 	*valLen = sizeof (int);
 	return SQL_SUCCESS;
     case SQL_COLUMN_AUTO_INCREMENT:
+	getdynmeta(s, col - 1);
 	if (val2) {
 	    *val2 = c->autoinc;
 	}
@@ -17386,6 +21987,7 @@ checkLen:
 	return SQL_SUCCESS;
     case SQL_COLUMN_NULLABLE:
     case SQL_DESC_NULLABLE:
+	getdynmeta(s, col - 1);
 	if (val2) {
 	    *val2 = c->notnull;
 	}
@@ -17959,9 +22561,11 @@ checkLen:
 	v = SQL_FALSE;
 	break;
     case SQL_COLUMN_AUTO_INCREMENT:
+	getdynmeta(s, col - 1);
 	v = c->autoinc;
 	break;
     case SQL_DESC_NULLABLE:
+	getdynmeta(s, col - 1);
 	v = c->notnull;
 	break;
 #ifdef SQL_DESC_NUM_PREC_RADIX
@@ -18420,9 +23024,9 @@ setupdyncols(STMT *s, sqlite3_stmt *s3stmt, int *ncolsp)
 	    size += 2 + (p ? strlen(p) : 0);
 	}
 #endif
-	dyncols = xmalloc(ncols * sizeof (COL) + size);
+	freedyncols(s);
+	dyncols = arena_alloc(&s->dynarena, ncols * sizeof (COL) + size);
 	if (!dyncols) {
-	    freedyncols(s);
 	    *ncolsp = 0;
 	    ret = SQL_ERROR;
 	} else {
@@ -18515,15 +23119,24 @@ setupdyncols(STMT *s, sqlite3_stmt *s3stmt, int *ncolsp)
 		dyncols[i].notnull = SQL_NULLABLE;
 		dyncols[i].ispk = -1;
 		dyncols[i].isrowid = -1;
-#ifdef FULL_METADATA
-		s3stmt_addmeta(s3stmt, i, d, &dyncols[i]);
+		dyncols[i].origin = NULL;
+#if defined(HAVE_SQLITE3COLUMNORIGINNAME) && (HAVE_SQLITE3COLUMNORIGINNAME)
+		q = (char *) sqlite3_column_origin_name(s3stmt, i);
+		if (q) {
+		    dyncols[i].origin = arena_strdup(&s->dynarena, q);
+		}
 #endif
-		dyncols[i].typename = xstrdup(typename);
+		dyncols[i].typename = arena_strdup(&s->dynarena, typename);
 	    }
-	    freedyncols(s);
 	    s->dyncols = s->cols = dyncols;
 	    s->dcols = ncols;
 	    fixupdyncols(s, d);
+#ifndef FULL_METADATA
+	    if (guessed_types) {
+		/* need declared types of table columns right now */
+		getdynmeta(s, -1);
+	    }
+#endif
 	    s->guessed_types = guessed_types;
 	}
     }
@@ -18582,6 +23195,10 @@ noconn:
 	const char *rest;
 	sqlite3_stmt *s3stmt = NULL;
 
+	s3stmt = s3cache_get(d, (char *) s->query);
+	if (s3stmt) {
+	    goto gotstmt;
+	}
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	dbtraceapi(d, "sqlite3_prepare_v2", (char *) s->query);
 #else
@@ -18589,6 +23206,7 @@ noconn:
 #endif
 	do {
 	    s3stmt = NULL;
+	    d->stats.prepares++;
 #if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
 	    ret = sqlite3_prepare_v2(d->sqlite, (char *) s->query, -1,
 				     &s3stmt, &rest);
@@ -18613,6 +23231,7 @@ noconn:
 		    sqlite3_errmsg(d->sqlite), ret);
 	    return SQL_ERROR;
 	}
+gotstmt:
 	if (sqlite3_bind_parameter_count(s3stmt) != s->nparams) {
 	    dbtraceapi(d, "sqlite3_finalize", 0);
 	    sqlite3_finalize(s3stmt);
@@ -18631,6 +23250,281 @@ noconn:
     return SQL_SUCCESS;
 }
 
+/**
+ * Point bound parameters to given row of parameter arrays.
+ * @param s statement pointer
+ * @param row row number in parameter arrays
+ * @result true when a parameter of that row needs data-at-execution
+ */
+
+static int
+paramrow(STMT *s, SQLULEN row)
+{
+    int i, dae = 0;
+
+    for (i = 0; i < s->nparams; i++) {
+	BINDPARM *p = &s->bindparms[i];
+
+	if (p->param == p->parbuf) {
+	    p->param = NULL;
+	}
+	freep(&p->parbuf);
+	if (p->lenp0 &&
+	    s->parm_bind_type != SQL_PARAM_BIND_BY_COLUMN) {
+	    p->lenp = (SQLLEN *) ((char *) p->lenp0 +
+				  row * s->parm_bind_type);
+	} else if (p->lenp0 && p->inc > 0) {
+	    p->lenp = p->lenp0 + row;
+	}
+	if (!p->lenp || (*p->lenp > SQL_LEN_DATA_AT_EXEC_OFFSET &&
+			 *p->lenp != SQL_DATA_AT_EXEC)) {
+	    if (p->param0 &&
+		s->parm_bind_type != SQL_PARAM_BIND_BY_COLUMN) {
+		p->param = (char *) p->param0 + row * s->parm_bind_type;
+	    } else if (p->param0 && p->inc > 0) {
+		p->param = (char *) p->param0 + row * p->inc;
+	    }
+	} else if (p->lenp && (*p->lenp <= SQL_LEN_DATA_AT_EXEC_OFFSET ||
+			       *p->lenp == SQL_DATA_AT_EXEC)) {
+	    p->need = 1;
+	    p->offs = 0;
+	    p->len = 0;
+	    dae = 1;
+	}
+    }
+    return dae;
+}
+
+/**
+ * Execute simple statement with a closing COMMIT/ROLLBACK handling
+ * busy conditions, used for implicit transactions.
+ * @param d database connection pointer
+ * @param sql SQL text to execute
+ * @result SQLite error code
+ */
+
+static int
+bulktran(DBC *d, char *sql)
+{
+    int rc, busy_count = 0;
+    char *errp = NULL;
+
+again:
+    rc = sqlite3_exec(d->sqlite, sql, NULL, NULL, &errp);
+    dbtracerc(d, rc, errp);
+    if (errp) {
+	sqlite3_free(errp);
+	errp = NULL;
+    }
+    if (rc == SQLITE_BUSY && busy_handler((void *) d, ++busy_count)) {
+	goto again;
+    }
+    if (rc == SQLITE_OK) {
+	switch (sql[0]) {
+	case 'B':
+	    d->stats.begins++;
+	    break;
+	case 'C':
+	    d->stats.commits++;
+	    break;
+	case 'R':
+	    d->stats.rollbacks++;
+	    break;
+	}
+    }
+    return rc;
+}
+
+/**
+ * Array execution of INSERT/UPDATE/DELETE statement, i.e.
+ * SQL_ATTR_PARAMSET_SIZE greater than one. The statement is
+ * prepared once and re-bound and stepped for each row of the
+ * parameter arrays. In autocommit mode the entire parameter set
+ * runs in one implicit transaction.
+ * @param s statement pointer
+ * @param retp pointer to ODBC result code
+ * @result true when the parameter set has been processed,
+ * false when the statement is not eligible and the generic
+ * code path in drvexecute() must be used
+ */
+
+static int
+drvexecbulk(STMT *s, SQLRETURN *retp)
+{
+    DBC *d = (DBC *) s->dbc;
+    sqlite3_stmt *s3stmt;
+    const char *rest = NULL;
+    SQLULEN row;
+    int i, rc, implicit = 0, busy_count;
+    SQLLEN nrows = 0;
+
+    if (s->paramset_size <= 1 || s->isselect != 0 || s->nparams <= 0 ||
+	s->s3stmt) {
+	return 0;
+    }
+    for (row = 0; row < s->paramset_size; row++) {
+	for (i = 0; i < s->nparams; i++) {
+	    BINDPARM *p = &s->bindparms[i];
+	    SQLLEN *lenp = p->lenp0;
+
+	    if (!lenp) {
+		continue;
+	    }
+	    if (s->parm_bind_type != SQL_PARAM_BIND_BY_COLUMN) {
+		lenp = (SQLLEN *) ((char *) lenp + row * s->parm_bind_type);
+	    } else if (p->inc > 0) {
+		lenp += row;
+	    }
+	    if (*lenp <= SQL_LEN_DATA_AT_EXEC_OFFSET ||
+		*lenp == SQL_DATA_AT_EXEC) {
+		/* data-at-execution needs generic code path */
+		return 0;
+	    }
+	}
+    }
+    s3stmt = s3cache_get(d, (char *) s->query);
+    if (!s3stmt) {
+	d->stats.prepares++;
+#if defined(HAVE_SQLITE3PREPAREV2) && (HAVE_SQLITE3PREPAREV2)
+	dbtraceapi(d, "sqlite3_prepare_v2", (char *) s->query);
+	rc = sqlite3_prepare_v2(d->sqlite, (char *) s->query, -1,
+				&s3stmt, &rest);
+#else
+	dbtraceapi(d, "sqlite3_prepare", (char *) s->query);
+	rc = sqlite3_prepare(d->sqlite, (char *) s->query, -1,
+			     &s3stmt, &rest);
+#endif
+	dbtracerc(d, rc, NULL);
+	if (rc != SQLITE_OK || !s3stmt) {
+	    if (s3stmt) {
+		sqlite3_finalize(s3stmt);
+	    }
+	    return 0;
+	}
+	while (rest && ISSPACE(*rest)) {
+	    rest++;
+	}
+	if ((rest && *rest) ||
+	    sqlite3_bind_parameter_count(s3stmt) != s->nparams) {
+	    /* multiple statements or errors are left to generic code */
+	    dbtraceapi(d, "sqlite3_finalize", 0);
+	    sqlite3_finalize(s3stmt);
+	    return 0;
+	}
+    }
+    s3stmt_end(s);
+    freeresult(s, 0);
+    if (d->autocommit && sqlite3_get_autocommit(d->sqlite)) {
+	rc = bulktran(d, "BEGIN TRANSACTION");
+	if (rc != SQLITE_OK) {
+	    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		    sqlite3_errmsg(d->sqlite), rc);
+	    goto error;
+	}
+	implicit = 1;
+    }
+    for (row = 0; row < s->paramset_size; row++) {
+#ifdef SQL_PARAM_IGNORE
+	if (s->parm_oper && s->parm_oper[row] == SQL_PARAM_IGNORE) {
+	    if (s->parm_status) {
+		s->parm_status[row] = SQL_PARAM_UNUSED;
+	    }
+	    continue;
+	}
+#endif
+	paramrow(s, row);
+	for (i = 0; i < s->nparams; i++) {
+	    *retp = setupparam(s, (char *) s->query, i);
+	    if (*retp != SQL_SUCCESS) {
+		goto rowerror;
+	    }
+	}
+	s3bind(d, s3stmt, s->nparams, s->bindparms, 0);
+	busy_count = 0;
+stepagain:
+	d->stats.steps++;
+	rc = sqlite3_step(s3stmt);
+	if (rc == SQLITE_ROW) {
+	    /* RETURNING clause or the like, drain it */
+	    do {
+		d->stats.steps++;
+	    } while ((rc = sqlite3_step(s3stmt)) == SQLITE_ROW);
+	}
+	if (rc != SQLITE_DONE) {
+	    rc = sqlite3_reset(s3stmt);
+	    if (rc == SQLITE_BUSY &&
+		busy_handler((void *) d, ++busy_count)) {
+		goto stepagain;
+	    }
+	    dbtracerc(d, rc, NULL);
+	    setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+		    sqlite3_errmsg(d->sqlite), rc);
+	    *retp = SQL_ERROR;
+	    goto rowerror;
+	}
+	sqlite3_reset(s3stmt);
+	nrows += sqlite3_changes(d->sqlite);
+	if (s->parm_status) {
+	    s->parm_status[row] = SQL_PARAM_SUCCESS;
+	}
+    }
+    if (s->parm_proc) {
+	*s->parm_proc = s->paramset_size;
+    }
+    *retp = SQL_SUCCESS;
+    goto done;
+rowerror:
+    if (s->parm_status) {
+	SQLULEN n;
+
+	s->parm_status[row] = SQL_PARAM_ERROR;
+	for (n = row + 1; n < s->paramset_size; n++) {
+	    s->parm_status[n] = SQL_PARAM_UNUSED;
+	}
+    }
+    if (s->parm_proc) {
+	*s->parm_proc = row + 1;
+    }
+done:
+    if (implicit) {
+	/* keep rows done so far as autocommit would have */
+	rc = bulktran(d, "COMMIT TRANSACTION");
+	if (rc != SQLITE_OK) {
+	    if (*retp != SQL_ERROR) {
+		setstat(s, rc, "%s (%d)", (*s->ov3) ? "HY000" : "S1000",
+			sqlite3_errmsg(d->sqlite), rc);
+	    }
+	    bulktran(d, "ROLLBACK TRANSACTION");
+	    *retp = SQL_ERROR;
+	}
+    }
+    for (i = 0; i < s->nparams; i++) {
+	BINDPARM *p = &s->bindparms[i];
+
+	if (p->param == p->parbuf) {
+	    p->param = NULL;
+	}
+	freep(&p->parbuf);
+	p->param = p->param0;
+	p->lenp = p->lenp0;
+    }
+    s3cache_put(d, (char *) s->query, s3stmt);
+    freeresult(s, -1);
+    mkbindcols(s, s->ncols);
+    s->rowp = s->rowprs = -1;
+    s->nrows = nrows;
+    s->paramset_count = 0;
+    s->paramset_nrows = 0;
+    if (*s->ov3 && *retp == SQL_SUCCESS && nrows == 0) {
+	*retp = SQL_NO_DATA;
+    }
+    return 1;
+error:
+    s3cache_put(d, (char *) s->query, s3stmt);
+    *retp = SQL_ERROR;
+    return 1;
+}
+
 /**
  * Internal query execution used by SQLExecute() and SQLExecDirect().
  * @param stmt statement handle
@@ -18646,6 +23540,7 @@ drvexecute(SQLHSTMT stmt, int initial)
     char *errp = NULL;
     int rc, i, ncols = 0, nrows = 0, busy_count;
     SQLRETURN ret;
+    sqlite_int64 t0;
 
     if (stmt == SQL_NULL_HSTMT) {
 	return SQL_INVALID_HANDLE;
@@ -18696,6 +23591,9 @@ unbound:
     if (ret != SQL_SUCCESS) {
 	goto cleanup;
     }
+    if (initial && drvexecbulk(s, &ret)) {
+	return ret;
+    }
     busy_count = 0;
 again:
     s3stmt_end(s);
@@ -18727,17 +23625,27 @@ again:
 	}
     }
     freeresult(s, 0);
-    if (s->isselect == 1 && !d->intrans &&
-	s->curtype == SQL_CURSOR_FORWARD_ONLY &&
-	d->step_enable && s->nparams == 0 && d->cur_s3stmt == NULL) {
+    if (s->isselect == 2 && checkddl((char *) s->query) == 1) {
+	/* schema change, drop cached prepared statements and schema */
+	if (d->s3cache_n > 0) {
+	    s3cache_flush(d);
+	}
+	sccache_flush(d);
+    }
+    if (s->isselect == 1 && s->curtype == SQL_CURSOR_FORWARD_ONLY &&
+	d->step_enable && (s->nparams == 0 || s->paramset_size <= 1)) {
 	s->nrows = -1;
 	ret = s3stmt_start(s);
 	if (ret == SQL_SUCCESS) {
 	    goto done2;
 	}
     }
-    rc = drvgettable(s, s->s3stmt ? NULL : (char *) s->query, &s->rows,
-		     &s->nrows, &ncols, &errp, s->nparams, s->bindparms);
+    t0 = d->stats_timing ? getusec() : 0;
+    rc = drvgettable(s, s->s3stmt ? NULL : (char *) s->query, &s->nrows,
+		     &ncols, &errp, s->nparams, s->bindparms);
+    if (d->stats_timing) {
+	d->stats.gettable += getusec() - t0;
+    }
     dbtracerc(d, rc, errp);
     if (rc == SQLITE_BUSY) {
 	if (busy_handler((void *) d, ++busy_count)) {
@@ -18776,7 +23684,6 @@ again:
 	sqlite3_free(errp);
 	errp = NULL;
     }
-    s->rowfree = freerows;
     if (s->isselect <= 0 || s->isselect > 1) {
 	/*
 	 * INSERT/UPDATE/DELETE or DDL results are immediately released.
@@ -18800,43 +23707,27 @@ done:
 done2:
     ret = SQL_SUCCESS;
     s->rowp = s->rowprs = -1;
+    if (s->parm_status) {
+	s->parm_status[s->paramset_count] = SQL_PARAM_SUCCESS;
+    }
     s->paramset_count++;
     s->paramset_nrows = s->nrows;
     if (s->paramset_count < s->paramset_size) {
-	for (i = 0; i < s->nparams; i++) {
-	    BINDPARM *p = &s->bindparms[i];
+	paramrow(s, s->paramset_count);
+	goto again;
+    }
+cleanup:
+    if (ret == SQL_ERROR && s->paramset_count < s->paramset_size) {
+	if (s->parm_status) {
+	    SQLULEN row;
 
-	    if (p->param == p->parbuf) {
-		p->param = NULL;
-	    }
-	    freep(&p->parbuf);
-	    if (p->lenp0 &&
-		s->parm_bind_type != SQL_PARAM_BIND_BY_COLUMN) {
-		p->lenp = (SQLLEN *) ((char *) p->lenp0 +
-				      s->paramset_count * s->parm_bind_type);
-	    } else if (p->lenp0 && p->inc > 0) {
-		p->lenp = p->lenp0 + s->paramset_count;
-	    }
-	    if (!p->lenp || (*p->lenp > SQL_LEN_DATA_AT_EXEC_OFFSET &&
-			     *p->lenp != SQL_DATA_AT_EXEC)) {
-		if (p->param0 &&
-		    s->parm_bind_type != SQL_PARAM_BIND_BY_COLUMN) {
-		    p->param = (char *) p->param0 +
-			s->paramset_count * s->parm_bind_type;
-		} else if (p->param0 && p->inc > 0) {
-		    p->param = (char *) p->param0 +
-			s->paramset_count * p->inc;
-		}
-	    } else if (p->lenp && (*p->lenp <= SQL_LEN_DATA_AT_EXEC_OFFSET ||
-				   *p->lenp == SQL_DATA_AT_EXEC)) {
-		p->need = 1;
-		p->offs = 0;
-		p->len = 0;
+	    s->parm_status[s->paramset_count] = SQL_PARAM_ERROR;
+	    for (row = s->paramset_count + 1; row < s->paramset_size; row++) {
+		s->parm_status[row] = SQL_PARAM_UNUSED;
 	    }
 	}
-	goto again;
+	s->paramset_count++;
     }
-cleanup:
     if (ret != SQL_NEED_DATA) {
 	for (i = 0; i < s->nparams; i++) {
 	    BINDPARM *p = &s->bindparms[i];
@@ -19074,7 +23965,11 @@ done:
 #define KEY_BIGINT             16
 #define KEY_PASSWD             17
 #define KEY_JDCONV             18
-#define NUMOFKEYS	       19
+#define KEY_STMTCACHE          19
+#define KEY_LOBSTREAM          20
+#define KEY_BUSYPOLICY         21
+#define KEY_POOL               22
+#define NUMOFKEYS	       23
 
 typedef struct {
     BOOL supplied;
@@ -19114,6 +24009,10 @@ static struct {
     { "BigInt", KEY_BIGINT },
     { "PWD", KEY_PASSWD },
     { "JDConv", KEY_JDCONV },
+    { "StmtCache", KEY_STMTCACHE },
+    { "LobStream", KEY_LOBSTREAM },
+    { "BusyPolicy", KEY_BUSYPOLICY },
+    { "Pool", KEY_POOL },
     { NULL, 0 }
 };
 
@@ -19266,6 +24165,26 @@ SetDSNAttributes(HWND parent, SETUPDLG *setupdlg)
 				     setupdlg->attr[KEY_JDCONV].attr,
 				     ODBC_INI);
     }
+    if (parent || setupdlg->attr[KEY_STMTCACHE].supplied) {
+	SQLWritePrivateProfileString(dsn, "StmtCache",
+				     setupdlg->attr[KEY_STMTCACHE].attr,
+				     ODBC_INI);
+    }
+    if (parent || setupdlg->attr[KEY_LOBSTREAM].supplied) {
+	SQLWritePrivateProfileString(dsn, "LobStream",
+				     setupdlg->attr[KEY_LOBSTREAM].attr,
+				     ODBC_INI);
+    }
+    if (parent || setupdlg->attr[KEY_BUSYPOLICY].supplied) {
+	SQLWritePrivateProfileString(dsn, "BusyPolicy",
+				     setupdlg->attr[KEY_BUSYPOLICY].attr,
+				     ODBC_INI);
+    }
+    if (parent || setupdlg->attr[KEY_POOL].supplied) {
+	SQLWritePrivateProfileString(dsn, "Pool",
+				     setupdlg->attr[KEY_POOL].attr,
+				     ODBC_INI);
+    }
     if (parent || setupdlg->attr[KEY_PASSWD].supplied) {
 	SQLWritePrivateProfileString(dsn, "PWD",
 				     setupdlg->attr[KEY_PASSWD].attr,
@@ -19390,6 +24309,30 @@ GetAttributes(SETUPDLG *setupdlg)
 				   sizeof (setupdlg->attr[KEY_JDCONV].attr),
 				   ODBC_INI);
     }
+    if (!setupdlg->attr[KEY_STMTCACHE].supplied) {
+	SQLGetPrivateProfileString(dsn, "StmtCache", "",
+				   setupdlg->attr[KEY_STMTCACHE].attr,
+				   sizeof (setupdlg->attr[KEY_STMTCACHE].attr),
+				   ODBC_INI);
+    }
+    if (!setupdlg->attr[KEY_LOBSTREAM].supplied) {
+	SQLGetPrivateProfileString(dsn, "LobStream", "",
+				   setupdlg->attr[KEY_LOBSTREAM].attr,
+				   sizeof (setupdlg->attr[KEY_LOBSTREAM].attr),
+				   ODBC_INI);
+    }
+    if (!setupdlg->attr[KEY_BUSYPOLICY].supplied) {
+	SQLGetPrivateProfileString(dsn, "BusyPolicy", "",
+				   setupdlg->attr[KEY_BUSYPOLICY].attr,
+				   sizeof (setupdlg->attr[KEY_BUSYPOLICY].attr),
+				   ODBC_INI);
+    }
+    if (!setupdlg->attr[KEY_POOL].supplied) {
+	SQLGetPrivateProfileString(dsn, "Pool", "",
+				   setupdlg->attr[KEY_POOL].attr,
+				   sizeof (setupdlg->attr[KEY_POOL].attr),
+				   ODBC_INI);
+    }
 }
 
 /**
@@ -19827,6 +24770,7 @@ drvdriverconnect(SQLHDBC dbc, SQLHWND hwnd,
     SETUPDLG *setupdlg;
     SQLRETURN ret;
     char *dsn = NULL, *driver = NULL, *dbname = NULL;
+    char perfopts[SQL_MAX_MESSAGE_LENGTH];
 
     if (dbc == SQL_NULL_HDBC) {
 	return SQL_INVALID_HANDLE;
@@ -19877,6 +24821,18 @@ retry:
     dsn = setupdlg->attr[KEY_DSN].attr;
     driver = setupdlg->attr[KEY_DRIVER].attr;
     dbname = setupdlg->attr[KEY_DBNAME].attr;
+    {
+	char cbuf[SQL_MAX_MESSAGE_LENGTH * 8];
+	int len = 0;
+
+	if (connIn) {
+	    len = (connInLen == SQL_NTS) ? strlen((char *) connIn) : connInLen;
+	    len = min(len, sizeof (cbuf) - 1);
+	    strncpy(cbuf, (char *) connIn, len);
+	}
+	cbuf[len] = '\0';
+	getperfopts(cbuf, dsn, perfopts, sizeof (perfopts));
+    }
     if (connOut || connOutLen) {
 	char buf[SQL_MAX_MESSAGE_LENGTH * 8];
 	int len, count;
@@ -19890,7 +24846,8 @@ retry:
 			 "ShortNames=%s;LongNames=%s;"
 			 "NoCreat=%s;NoWCHAR=%s;"
 			 "FKSupport=%s;JournalMode=%s;OEMCP=%s;LoadExt=%s;"
-			 "BigInt=%s;JDConv=%s;PWD=%s",
+			 "BigInt=%s;JDConv=%s;StmtCache=%s;LobStream=%s;"
+			 "BusyPolicy=%s;Pool=%s;%sPWD=%s",
 			 dsn_0 ? "DSN=" : "",
 			 dsn_0 ? dsn : "",
 			 dsn_0 ? ";" : "",
@@ -19912,6 +24869,11 @@ retry:
 			 setupdlg->attr[KEY_LOADEXT].attr,
 			 setupdlg->attr[KEY_BIGINT].attr,
 			 setupdlg->attr[KEY_JDCONV].attr,
+			 setupdlg->attr[KEY_STMTCACHE].attr,
+			 setupdlg->attr[KEY_LOBSTREAM].attr,
+			 setupdlg->attr[KEY_BUSYPOLICY].attr,
+			 setupdlg->attr[KEY_POOL].attr,
+			 perfopts,
 			 setupdlg->attr[KEY_PASSWD].attr);
 	if (count < 0) {
 	    buf[sizeof (buf) - 1] = '\0';
@@ -19926,14 +24888,21 @@ retry:
 	}
     }
     if (dsn[0]) {
-	char tracef[SQL_MAX_MESSAGE_LENGTH];
+	char tracef[SQL_MAX_MESSAGE_LENGTH], tbflag[32];
 
 	tracef[0] = '\0';
 	SQLGetPrivateProfileString(setupdlg->attr[KEY_DSN].attr,
 				   "tracefile", "", tracef,
 				   sizeof (tracef), ODBC_INI);
+	SQLGetPrivateProfileString(setupdlg->attr[KEY_DSN].attr,
+				   "tracebinary", "", tbflag,
+				   sizeof (tbflag), ODBC_INI);
 	if (tracef[0] != '\0') {
-	    d->trace = fopen(tracef, "a");
+	    if (getbool(tbflag)) {
+		trcopen(d, tracef);
+	    } else {
+		d->trace = fopen(tracef, "a");
+	    }
 	}
     }
     d->nowchar = getbool(setupdlg->attr[KEY_NOWCHAR].attr);
@@ -19944,8 +24913,16 @@ retry:
     d->oemcp = getbool(setupdlg->attr[KEY_OEMCP].attr);
     d->dobigint = getbool(setupdlg->attr[KEY_BIGINT].attr);
     d->jdconv = getbool(setupdlg->attr[KEY_JDCONV].attr);
+    d->s3cache_max = getint(setupdlg->attr[KEY_STMTCACHE].attr, 0, 0, 10000);
+    d->lobstream = getint(setupdlg->attr[KEY_LOBSTREAM].attr, 0, 0,
+			  0x40000000);
+    setbusypolicy(d, setupdlg->attr[KEY_BUSYPOLICY].attr);
     d->pwdLen = strlen(setupdlg->attr[KEY_PASSWD].attr);
     d->pwd = (d->pwdLen > 0) ? setupdlg->attr[KEY_PASSWD].attr : NULL;
+    perfsetup(d, perfopts);
+    poolsetup(d, setupdlg->attr[KEY_POOL].attr, dbname ? dbname : "", 0,
+	      setupdlg->attr[KEY_SYNCP].attr, setupdlg->attr[KEY_JMODE].attr,
+	      setupdlg->attr[KEY_LOADEXT].attr);
     ret = dbopen(d, dbname ? dbname : "", 0,
 		 dsn ? dsn : "",
 		 setupdlg->attr[KEY_STEPAPI].attr,
@@ -19961,7 +24938,7 @@ retry:
     }
     memset(setupdlg->attr[KEY_PASSWD].attr, 0,
 	   sizeof (setupdlg->attr[KEY_PASSWD].attr));
-    if (ret == SQL_SUCCESS) {
+    if (ret == SQL_SUCCESS && !d->pooled) {
 	dbloadext(d, setupdlg->attr[KEY_LOADEXT].attr);
     }
     xfree(setupdlg);
@@ -20691,6 +25668,12 @@ static struct {
     DLS_ENT(bind_null, dls_error),
     DLS_ENT(bind_parameter_count, dls_0),
     DLS_ENT(bind_text, dls_error),
+    DLS_ENT(bind_zeroblob, dls_error),
+    DLS_ENT(blob_bytes, dls_0),
+    DLS_ENT(blob_close, dls_error),
+    DLS_ENT(blob_open, dls_error),
+    DLS_ENT(blob_read, dls_error),
+    DLS_ENT(blob_write, dls_error),
     DLS_ENT(busy_handler, dls_error),
     DLS_ENT(changes, dls_0),
     DLS_ENT(close, dls_error),
@@ -20700,12 +25683,15 @@ static struct {
     DLS_ENT(column_database_name, dls_empty),
     DLS_ENT(column_decltype, dls_empty),
     DLS_ENT(column_double, dls_00),
+    DLS_ENT(column_int64, dls_0LL),
     DLS_ENT(column_name, dls_empty),
     DLS_ENT(column_origin_name, dls_null),
     DLS_ENT(column_table_name, dls_null),
     DLS_ENT(column_text, dls_null),
     DLS_ENT(column_type, dls_snull),
     DLS_ENT(create_function, dls_error),
+    DLS_ENT(create_module_v2, dls_error),
+    DLS_ENT(declare_vtab, dls_error),
     DLS_ENT(enable_load_extension, dls_error),
     DLS_ENT(errcode, dls_error),
     DLS_ENT(errmsg, dls_empty),
@@ -20713,6 +25699,7 @@ static struct {
     DLS_ENT(finalize, dls_error),
     DLS_ENT(free, free),
     DLS_ENT(free_table, dls_void),
+    DLS_ENT(get_autocommit, dls_0),
     DLS_ENT(get_table, dls_error),
     DLS_ENT(interrupt, dls_void),
     DLS_ENT(key, dls_error),
@@ -20733,8 +25720,11 @@ static struct {
     DLS_ENT(result_blob, dls_void),
     DLS_ENT(result_error, dls_void),
     DLS_ENT(result_int, dls_void),
+    DLS_ENT(result_int64, dls_void),
     DLS_ENT(result_null, dls_void),
+    DLS_ENT(result_text, dls_void),
     DLS_ENT(step, dls_error),
+    DLS_ENT3(snprintf, xsnprintf, dls_null),
 #if defined(_WIN32) || defined(_WIN64)
     DLS_ENT3(strnicmp, xstrnicmp, _strnicmp),
 #else
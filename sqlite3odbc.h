@@ -34,6 +34,9 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#if defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+#include <pthread.h>
+#endif
 #endif
 #include <stdlib.h>
 #if defined(HAVE_LOCALECONV) || defined(_WIN32) || defined(_WIN64)
@@ -41,6 +44,7 @@
 #endif
 #include <stdarg.h>
 #include <stddef.h>
+#include <float.h>
 #include <string.h>
 #include <sql.h>
 #include <sqlext.h>
@@ -84,9 +88,101 @@
 #define SQLROWSETSIZE SQLULEN
 #endif
 
+/*
+ * Driver specific statement attributes (read-only, SQLULEN),
+ * allocator statistics in bytes of the statement's result set
+ * and column description memory.
+ */
+
+#ifndef SQL_DRIVER_STMT_ATTR_BASE
+#define SQL_DRIVER_STMT_ATTR_BASE	0x00004000
+#endif
+
+#define SQL_ATTR_SQLITE_ARENA_RESERVED	(SQL_DRIVER_STMT_ATTR_BASE + 0x100)
+#define SQL_ATTR_SQLITE_ARENA_INUSE	(SQL_DRIVER_STMT_ATTR_BASE + 0x101)
+#define SQL_ATTR_SQLITE_ARENA_HIGHWATER	(SQL_DRIVER_STMT_ATTR_BASE + 0x102)
+
+/*
+ * Driver specific connection attributes (read-only, SQLULEN),
+ * counters of the prepared statement cache.
+ */
+
+#ifndef SQL_DRIVER_CONN_ATTR_BASE
+#define SQL_DRIVER_CONN_ATTR_BASE	0x00004000
+#endif
+
+#define SQL_ATTR_SQLITE_STMTCACHE_SIZE	(SQL_DRIVER_CONN_ATTR_BASE + 0x100)
+#define SQL_ATTR_SQLITE_STMTCACHE_HITS	(SQL_DRIVER_CONN_ATTR_BASE + 0x101)
+#define SQL_ATTR_SQLITE_STMTCACHE_MISSES (SQL_DRIVER_CONN_ATTR_BASE + 0x102)
+
+/*
+ * Driver specific connection attributes (read-only, SQLULEN),
+ * runtime performance counters, see DBCSTATS. The same values
+ * are returned by the "odbc_stats" virtual table.
+ */
+
+#define SQL_ATTR_SQLITE_STATS_PREPARES	(SQL_DRIVER_CONN_ATTR_BASE + 0x103)
+#define SQL_ATTR_SQLITE_STATS_STEPS	(SQL_DRIVER_CONN_ATTR_BASE + 0x104)
+#define SQL_ATTR_SQLITE_STATS_ROWS	(SQL_DRIVER_CONN_ATTR_BASE + 0x105)
+#define SQL_ATTR_SQLITE_STATS_CONVBYTES	(SQL_DRIVER_CONN_ATTR_BASE + 0x106)
+#define SQL_ATTR_SQLITE_STATS_BUSYRETRIES (SQL_DRIVER_CONN_ATTR_BASE + 0x107)
+#define SQL_ATTR_SQLITE_STATS_BUSYSLEEP	(SQL_DRIVER_CONN_ATTR_BASE + 0x108)
+#define SQL_ATTR_SQLITE_STATS_BEGINS	(SQL_DRIVER_CONN_ATTR_BASE + 0x109)
+#define SQL_ATTR_SQLITE_STATS_COMMITS	(SQL_DRIVER_CONN_ATTR_BASE + 0x10A)
+#define SQL_ATTR_SQLITE_STATS_ROLLBACKS	(SQL_DRIVER_CONN_ATTR_BASE + 0x10B)
+#define SQL_ATTR_SQLITE_STATS_GETTABLE	(SQL_DRIVER_CONN_ATTR_BASE + 0x10C)
+#define SQL_ATTR_SQLITE_STATS_GETROWDATA (SQL_DRIVER_CONN_ATTR_BASE + 0x10D)
+
+/*
+ * Driver specific connection attributes (read-write, SQLUINTEGER):
+ * SQL_ATTR_SQLITE_STATS_TIMING enables the time counters,
+ * setting SQL_ATTR_SQLITE_STATS_RESET clears all counters.
+ */
+
+#define SQL_ATTR_SQLITE_STATS_TIMING	(SQL_DRIVER_CONN_ATTR_BASE + 0x10E)
+#define SQL_ATTR_SQLITE_STATS_RESET	(SQL_DRIVER_CONN_ATTR_BASE + 0x10F)
+
+/*
+ * Driver specific connection attributes (read-only, SQLULEN),
+ * lock wait counters: number of waits for a busy database and
+ * longest single wait in microseconds.
+ */
+
+#define SQL_ATTR_SQLITE_STATS_BUSYWAITS	(SQL_DRIVER_CONN_ATTR_BASE + 0x110)
+#define SQL_ATTR_SQLITE_STATS_BUSYWAITMAX (SQL_DRIVER_CONN_ATTR_BASE + 0x111)
+
+/*
+ * Driver specific connection attributes (read-only, SQLULEN),
+ * counters of the connection pool of the environment, see POOLENT.
+ */
+
+#define SQL_ATTR_SQLITE_POOL_HITS	(SQL_DRIVER_CONN_ATTR_BASE + 0x112)
+#define SQL_ATTR_SQLITE_POOL_MISSES	(SQL_DRIVER_CONN_ATTR_BASE + 0x113)
+#define SQL_ATTR_SQLITE_POOL_EXPIRED	(SQL_DRIVER_CONN_ATTR_BASE + 0x114)
+#define SQL_ATTR_SQLITE_POOL_IDLE	(SQL_DRIVER_CONN_ATTR_BASE + 0x115)
+
 struct dbc;
 struct stmt;
 
+/**
+ * @typedef POOLENT
+ * @struct poolent
+ * Idle SQLite database handle in the connection pool of ENV.
+ */
+
+typedef struct poolent {
+    struct poolent *next;	/**< Next idle handle */
+    sqlite3 *sqlite;		/**< SQLite database handle */
+    char *key;			/**< Normalized connect options, key */
+    struct dbc **dbref;		/**< Owner cell of handle or NULL */
+    sqlite_int64 born;		/**< Time of open, microseconds */
+    sqlite_int64 expires;	/**< End of idle or max. age, microseconds */
+} POOLENT;
+
+#define POOL_MAX	8	/**< Default max. idle handles */
+#define POOL_IDLE	60	/**< Default max. idle time, seconds */
+#define POOL_AGE	600	/**< Default max. age of handle, seconds */
+
 /**
  * @typedef ENV
  * @struct ENV
@@ -99,10 +195,116 @@ typedef struct {
     int pool;			/**< True for SQL_CP_ONE_PER_DRIVER */
 #if defined(_WIN32) || defined(_WIN64)
     CRITICAL_SECTION cs;	/**< For serializing most APIs */
+    CRITICAL_SECTION poolcs;	/**< For poolents, taken last */
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_t mutex;	/**< For serializing most APIs */
+    pthread_mutex_t poolmutex;	/**< For poolents, taken last */
 #endif
     struct dbc *dbcs;		/**< Pointer to first DBC */
+    POOLENT *poolents;		/**< Idle pooled handles, most recent first */
+    SQLULEN pooln;		/**< Number of entries in poolents */
+    SQLULEN poolhits;		/**< Connects served from pool */
+    SQLULEN poolmisses;		/**< Pooled connects which opened the file */
+    SQLULEN poolexpired;	/**< Pooled handles closed after idle/age */
 } ENV;
 
+/**
+ * @typedef S3CENT
+ * @struct S3CENT
+ * Entry of prepared statement cache of DBC.
+ */
+
+typedef struct {
+    char *sql;			/**< SQL text (after fixupsql()), key */
+    unsigned int hash;		/**< Hash value of SQL text */
+    unsigned long used;		/**< LRU stamp */
+    sqlite3_stmt *stmt;		/**< Prepared statement, reset */
+} S3CENT;
+
+/**
+ * @typedef SCCENT
+ * @struct SCCENT
+ * Entry of schema cache of DBC, result of a PRAGMA like table_info.
+ */
+
+typedef struct {
+    char *sql;			/**< SQL text, key, NULL when flushed */
+    unsigned int hash;		/**< Hash value of SQL text */
+    unsigned long used;		/**< LRU stamp */
+    int refs;			/**< Number of users of rows */
+    char **rows;		/**< Result of sqlite3_get_table() */
+    int nrows;			/**< Number of rows in rows */
+    int ncols;			/**< Number of columns in rows */
+} SCCENT;
+
+/**
+ * @typedef TRCREC
+ * @struct TRCREC
+ * Fixed size record of the binary trace file (TraceBinary DSN option),
+ * in host byte order. A TRC_TEXT record is followed by its text in
+ * (name + sizeof (TRCREC) - 1) / sizeof (TRCREC) raw records, later
+ * records refer to the text by its hash. See tccex/trcdec.c.
+ */
+
+typedef struct {
+    sqlite_uint64 time;		/**< Time stamp, microseconds */
+    sqlite_uint64 handle;	/**< DBC pointer */
+    unsigned int dur;		/**< Duration (microseconds) or size */
+    unsigned int hash;		/**< Hash of SQL or other text, 0 if none */
+    unsigned int name;		/**< Hash of API name, number, or length */
+    short event;		/**< Event code, TRC_* */
+    short rc;			/**< SQLite result code or type */
+} TRCREC;
+
+#define TRC_START	0	/**< Start, hash TRC_VERSION, name time() */
+#define TRC_TEXT	1	/**< Text, hash and length, text follows */
+#define TRC_SQL		2	/**< SQL executed, hash and duration */
+#define TRC_API		3	/**< SQLite API call, name and SQL hash */
+#define TRC_RC		4	/**< SQLite error, rc and message hash */
+#define TRC_PARAM	5	/**< Parameter bound, number, type, size */
+#define TRC_OPEN	6	/**< Database opened, hash of name */
+#define TRC_CLOSE	7	/**< Database closed, hash of name */
+
+#define TRC_VERSION	0x53335431	/**< Magic/version, "S3T1" */
+#define TRC_NREC	1024	/**< Records in trace buffer */
+#define TRC_NSEEN	256	/**< Entries of cache of written texts */
+
+/**
+ * @typedef DBCSTATS
+ * @struct DBCSTATS
+ * Runtime performance counters of a connection, including
+ * the counts of all its statements.
+ */
+
+typedef struct {
+    SQLULEN prepares;		/**< sqlite3_prepare() calls */
+    SQLULEN steps;		/**< sqlite3_step() calls */
+    SQLULEN rows;		/**< Result rows read from SQLite */
+    SQLULEN convbytes;		/**< Character/binary bytes to application */
+    SQLULEN busyretries;	/**< Retries of the busy handler */
+    SQLULEN busysleep;		/**< Busy handler sleep time, microseconds */
+    SQLULEN busywaits;		/**< Waits for a busy database */
+    SQLULEN busywaitmax;	/**< Longest wait, microseconds */
+    SQLULEN begins;		/**< Transactions begun */
+    SQLULEN commits;		/**< Transactions committed */
+    SQLULEN rollbacks;		/**< Transactions rolled back */
+    SQLULEN gettable;		/**< Time in drvgettable(), microseconds */
+    SQLULEN getrowdata;		/**< Time in column conversion, microseconds */
+} DBCSTATS;
+
+/*
+ * Busy handler policies (BusyPolicy DSN option) and defaults
+ * of the "backoff" policy, times in microseconds.
+ */
+
+#define BUSY_FIXED	0	/**< Sleep 10 ms per retry */
+#define BUSY_BACKOFF	1	/**< Spin, then exponential backoff */
+
+#define BUSY_SPIN	2	/**< Retries without sleeping */
+#define BUSY_MIN	50	/**< First sleep after spinning */
+#define BUSY_MAX	10000	/**< Max. sleep */
+#define BUSY_WALMAX	2000	/**< Max. sleep in WAL mode */
+
 /**
  * @typedef DBC
  * @struct dbc
@@ -118,8 +320,14 @@ typedef struct dbc {
     char *dbname;		/**< SQLITE database name */
     char *dsn;			/**< ODBC data source name */
     int timeout;		/**< Lock timeout value */
-    long t0;			/**< Start time for SQLITE busy handler */
-    int busyint;		/**< Interrupt busy handler from SQLCancel() */
+    sqlite_int64 t0;		/**< Start time for SQLITE busy handler */
+    volatile int busyint;	/**< Interrupt busy handler from SQLCancel() */
+    int busypolicy;		/**< Busy handler policy, BUSY_* */
+    int busyspin;		/**< Retries without sleeping */
+    int busymin;		/**< First backoff sleep, microseconds */
+    int busymax;		/**< Max. backoff sleep, microseconds */
+    int busywal;		/**< True when journal mode is WAL */
+    unsigned int busyseed;	/**< Random state for backoff jitter */
     int *ov3;			/**< True for SQL_OV_ODBC3 */
     int ov3val;			/**< True for SQL_OV_ODBC3 */
     int autocommit;		/**< Auto commit state */
@@ -139,11 +347,37 @@ typedef struct dbc {
     int trans_disable;		/**< True for no transaction support */
     int oemcp;			/**< True for Win32 OEM CP translation */
     int jdconv;			/**< True for julian day conversion */
-    struct stmt *cur_s3stmt;	/**< Current STMT executing sqlite statement */
-    int s3stmt_needmeta;	/**< True to get meta data in s3stmt_step(). */
+    int s3stmt_nstream;		/**< Number of STMTs stepping sqlite statement */
+    S3CENT *s3cache;		/**< Prepared statement cache or NULL */
+    int s3cache_max;		/**< Max. entries in s3cache, 0 = disabled */
+    int s3cache_n;		/**< Number of entries in s3cache */
+    unsigned long s3cache_clock;	/**< LRU clock of s3cache */
+    SQLULEN s3cache_hits;	/**< Number of s3cache hits */
+    SQLULEN s3cache_misses;	/**< Number of s3cache misses */
+    int lobstream;		/**< Min. blob size for incremental I/O, 0 = off */
+    SCCENT *sccache;		/**< Schema cache or NULL */
+    int sccache_n;		/**< Number of entries in sccache */
+    unsigned long sccache_clock;	/**< LRU clock of sccache */
+    int sccache_schema;		/**< PRAGMA schema_version of sccache */
+    sqlite3_stmt *sccache_vstmt;	/**< Statement for schema_version */
+    DBCSTATS stats;		/**< Runtime performance counters */
+    int stats_timing;		/**< True when time counters are enabled */
     FILE *trace;		/**< sqlite3_trace() file pointer or NULL */
+    FILE *trcfile;		/**< Binary trace file pointer or NULL */
+    TRCREC *trcbuf;		/**< Binary trace buffer or NULL */
+    int trcn;			/**< Number of records in trcbuf */
+    unsigned int *trcseen;	/**< Hashes of texts written to trcfile */
     char *pwd;			/**< Password or NULL */
     int pwdLen;			/**< Length of password */
+    char *poolkey;		/**< Pool key of connection or NULL */
+    int pooled;			/**< True when sqlite was taken from pool */
+    int poolmax;		/**< Max. idle handles in pool */
+    int poolidle;		/**< Max. idle time in pool, seconds */
+    int poolage;		/**< Max. age of pooled handle, seconds */
+    sqlite_int64 poolborn;	/**< Time of open of sqlite, microseconds */
+    struct dbc **dbref;		/**< Cell pointing to this DBC, odbc_stats */
+    char *perfsql;		/**< PRAGMAs of performance DSN options */
+    int sharedcache;		/**< True for SQLITE_OPEN_SHAREDCACHE */
 #ifdef USE_DLOPEN_FOR_GPPS
     void *instlib;
     int (*gpps)();
@@ -152,6 +386,10 @@ typedef struct dbc {
     CRITICAL_SECTION cs;	/**< For serializing most APIs */
     DWORD owner;		/**< Current owner of CS or 0 */
     int xcelqrx;
+#elif defined(HAVE_PTHREAD) && (HAVE_PTHREAD)
+    pthread_mutex_t mutex;	/**< For serializing most APIs (recursive) */
+    pthread_t owner;		/**< Current owner of mutex if nlock > 0 */
+    volatile int nlock;		/**< Lock count of owner, 0 when unowned */
 #endif
 } DBC;
 
@@ -177,21 +415,51 @@ typedef struct {
     int isrowid;		/**< Flag for ROWID column (> 0) */
     char *typename;		/**< Column type name or NULL */
     char *label;		/**< Column label or NULL */
+    char *origin;		/**< Column name in table or NULL */
 } COL;
 
+/**
+ * @typedef CELL
+ * @struct CELL
+ * Internal structure for a typed value of a result set.
+ */
+
+typedef struct {
+    int type;		/**< SQLite type, SQLITE_NULL, SQLITE_INTEGER ... */
+    int len;		/**< Length of text/blob data */
+    union {
+	sqlite_int64 i;	/**< SQLITE_INTEGER value */
+	double f;	/**< SQLITE_FLOAT value */
+	char *p;	/**< SQLITE_TEXT/SQLITE_BLOB data */
+    } v;
+} CELL;
+
+struct bindcol;
+
+/**
+ * @typedef BINDCONV
+ * Converter of a cell into the buffer of a bound column,
+ * returns false when the generic getrowdata() must be used.
+ */
+
+typedef int (*BINDCONV)(CELL *c, struct bindcol *b,
+			SQLPOINTER val, SQLLEN *lenp);
+
 /**
  * @typedef BINDCOL
  * @struct BINDCOL
  * Internal structure for bound column (SQLBindCol).
  */
 
-typedef struct {
+typedef struct bindcol {
     SQLSMALLINT type;	/**< ODBC type */
     SQLINTEGER max;	/**< Max. size of value buffer */
     SQLLEN *lenp;	/**< Value return, actual size of value buffer */
     SQLPOINTER valp;	/**< Value buffer */
     int index;		/**< Index of column in result */
     int offs;		/**< Byte offset for SQLGetData() */
+    int ctype;		/**< Effective C type for conv */
+    BINDCONV conv;	/**< Converter or NULL when to be set up */
 } BINDCOL;
 
 /**
@@ -220,8 +488,36 @@ typedef struct {
     int s3ival;		/**< SQLite3 integer value */
     sqlite_int64 s3lival;	/**< SQLite3 64bit integer value */
     double s3dval;	/**< SQLite3 float value */
+    int lobzero;	/**< True to bind zeroblob of size s3size */
 } BINDPARM;
 
+/**
+ * @typedef ARENABLK
+ * @struct arenablk
+ * Internal structure for a memory block of an ARENA.
+ */
+
+typedef struct arenablk {
+    struct arenablk *next;	/**< Next (older) block */
+    int size;			/**< Size of data area */
+    int used;			/**< Used bytes of data area */
+    double data[1];		/**< Data area, aligned */
+} ARENABLK;
+
+/**
+ * @typedef ARENA
+ * @struct ARENA
+ * Internal structure for a bump allocator, memory is released
+ * all at once using arena_reset() or arena_free().
+ */
+
+typedef struct {
+    ARENABLK *blk;		/**< Current block, chained to older ones */
+    size_t reserved;		/**< Bytes held in blocks */
+    size_t inuse;		/**< Bytes handed out since last reset */
+    size_t hiwater;		/**< High-water mark of inuse */
+} ARENA;
+
 /**
  * @typedef STMT
  * @struct stmt
@@ -239,7 +535,7 @@ typedef struct stmt {
     int isselect;		/**< > 0 if query is a SELECT statement */
     int ncols;			/**< Number of result columns */
     COL *cols;			/**< Result column array */
-    COL *dyncols;		/**< Column array, but malloc()ed */
+    COL *dyncols;		/**< Column array, in dynarena */
     int dcols;			/**< Number of entries in dyncols */
     int bkmrk;			/**< True when bookmarks used */
     SQLINTEGER *bkmrkptr;	/**< SQL_ATTR_FETCH_BOOKMARK_PTR */
@@ -255,6 +551,10 @@ typedef struct stmt {
     int rowprs;			/**< Current start row of rowset */
     char **rows;		/**< 2-dim array, result set */
     void (*rowfree)();		/**< Free function for rows */
+    CELL *cells;		/**< Typed result set, column major or NULL */
+    int cellstride;		/**< Rows allocated per column in cells */
+    ARENA arena;		/**< Text/blob data of cells */
+    ARENA dynarena;		/**< Memory of dyncols */
     int naterr;			/**< Native error code */
     char sqlstate[6];		/**< SQL state for SQLError() */
     SQLCHAR logmsg[1024];	/**< Message for SQLError() */
@@ -284,6 +584,9 @@ typedef struct stmt {
     sqlite3_stmt *s3stmt;	/**< SQLite statement handle or NULL */
     int s3stmt_noreset;		/**< False when sqlite3_reset() needed. */
     int s3stmt_rownum;		/**< Current row number */
+    int s3stmt_stream;		/**< True while rows are stepped from s3stmt */
+    int s3stmt_rowlazy;		/**< True when current row not yet in cells */
+    int s3stmt_needmeta;	/**< True to get meta data in s3stmt_step(). */
     char *bincell;		/**< Cache for blob data */
     char *bincache;		/**< Cache for blob data */
     int binlen;			/**< Length of blob data */
@@ -291,6 +594,13 @@ typedef struct stmt {
     int one_tbl;		/**< Flag for single table (> 0) */
     int has_pk;			/**< Flag for primary key (> 0) */
     int has_rowid;		/**< Flag for ROWID (>= 0 or -1) */
+    int dynmeta;		/**< True when getdynmeta() is pending */
+    int lobmin;			/**< Min. size of deferred blobs, 0 unknown */
+    char **lobcols;		/**< Origin column names, in dynarena */
+    sqlite3_blob *lobh;		/**< Incremental blob handle or NULL */
+    int lobhcol;		/**< Column of lobh, < 0 for parameter */
+    sqlite_int64 lobhrow;	/**< ROWID of lobh */
+    char *lobname;		/**< Database/table/column of written lobh */
 } STMT;
 
 #endif
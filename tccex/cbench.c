@@ -0,0 +1,142 @@
+/*
+ *  Connect benchmark: rate of SQLDriverConnect()/SQLDisconnect()
+ *  cycles, each running one short query, with and without the
+ *  connection pool of the driver (DSN option Pool=... or -cp for
+ *  SQL_CP_ONE_PER_DRIVER on the environment). Prints the pool
+ *  counters of the driver when available.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+
+/* must match sqlite3odbc.h */
+
+#ifndef SQL_DRIVER_CONN_ATTR_BASE
+#define SQL_DRIVER_CONN_ATTR_BASE	0x00004000
+#endif
+#define SQL_ATTR_SQLITE_POOL_HITS	(SQL_DRIVER_CONN_ATTR_BASE + 0x112)
+#define SQL_ATTR_SQLITE_POOL_MISSES	(SQL_DRIVER_CONN_ATTR_BASE + 0x113)
+
+static char *dsn = NULL;
+static char *query = "SELECT count(*) FROM sqlite_master";
+static int nconnects = 10000;
+static int cpool = 0;
+
+static HENV env = SQL_NULL_HENV;
+
+static double now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static void error(HDBC dbc, HSTMT stmt, char *what, int rc)
+{
+    SQLCHAR msg[512], state[16];
+    SQLINTEGER nerr = 0;
+    SQLSMALLINT len = 0;
+
+    msg[0] = '\0';
+    state[0] = '\0';
+    SQLError(env, dbc, stmt, state, &nerr, msg, sizeof (msg), &len);
+    fprintf(stderr, "%s failed rc=%d: %s %s\n", what, rc, state, msg);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    HDBC dbc;
+    HSTMT stmt;
+    SQLULEN hits = 0, misses = 0;
+    SQLINTEGER val;
+    SQLLEN ind;
+    double t0, t1;
+    int i, rc, pooled = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dsn") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		dsn = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-n") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nconnects = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-query") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		query = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-cp") == 0) {
+	    cpool = 1;
+	}
+    }
+    if (dsn == NULL || nconnects < 1) {
+        fprintf(stderr, "usage: %s -dsn DSN [-cp] [-n n] [-query sql]\n\n",
+		argv[0]);
+        fprintf(stderr, "-cp       set SQL_CP_ONE_PER_DRIVER on the "
+		"environment\n");
+        fprintf(stderr, "-n        number of connects\n");
+        fprintf(stderr, "-query    SQL run once per connect\n");
+	exit(1);
+    }
+    SQLAllocEnv(&env);
+    if (cpool) {
+        SQLSetEnvAttr(env, SQL_ATTR_CONNECTION_POOLING,
+		      (SQLPOINTER) SQL_CP_ONE_PER_DRIVER, 0);
+    }
+    t0 = now();
+    for (i = 0; i < nconnects; i++) {
+        SQLAllocConnect(env, &dbc);
+	rc = SQLDriverConnect(dbc, NULL, (SQLCHAR *) dsn, SQL_NTS, NULL, 0,
+			      NULL, SQL_DRIVER_NOPROMPT);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(dbc, SQL_NULL_HSTMT, "SQLDriverConnect", rc);
+	}
+	SQLAllocStmt(dbc, &stmt);
+	rc = SQLExecDirect(stmt, (SQLCHAR *) query, SQL_NTS);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(dbc, stmt, query, rc);
+	}
+	while (SQL_SUCCEEDED(SQLFetch(stmt))) {
+	    SQLGetData(stmt, 1, SQL_C_SLONG, &val, sizeof (val), &ind);
+	}
+	SQLFreeStmt(stmt, SQL_DROP);
+	if (i == nconnects - 1 &&
+	    SQL_SUCCEEDED(SQLGetConnectAttr(dbc, SQL_ATTR_SQLITE_POOL_HITS,
+					    &hits, sizeof (hits), NULL)) &&
+	    SQL_SUCCEEDED(SQLGetConnectAttr(dbc, SQL_ATTR_SQLITE_POOL_MISSES,
+					    &misses, sizeof (misses), NULL))) {
+	    pooled = 1;
+	}
+	SQLDisconnect(dbc);
+	SQLFreeConnect(dbc);
+    }
+    t1 = now();
+    fprintf(stdout, "%d connects: %.3f s, %.1f connects/s, %.1f us/connect\n",
+	    nconnects, t1 - t0, (t1 > t0) ? nconnects / (t1 - t0) : 0.0,
+	    (t1 - t0) * 1e6 / nconnects);
+    if (pooled) {
+        fprintf(stdout, "pool hits %lu, misses %lu\n",
+		(unsigned long) hits, (unsigned long) misses);
+    }
+    SQLFreeEnv(env);
+    return 0;
+}
@@ -0,0 +1,350 @@
+/*
+ *  Fetch micro benchmark: per cell cost of SQLFetch() into
+ *  bound columns for the common type combinations
+ *  INTEGER -> SQL_C_SLONG, REAL -> SQL_C_DOUBLE, TEXT -> SQL_C_CHAR
+ *  and the number conversions REAL -> SQL_C_CHAR, TEXT -> SQL_C_DOUBLE,
+ *  and the date/time conversions TEXT -> SQL_C_TIMESTAMP (ISO layout)
+ *  and INTEGER -> SQL_C_TIMESTAMP (unix epoch), plus a check of
+ *  random blobs fetched by SQLGetData() as SQL_C_BINARY after a
+ *  length probe with NULL target pointer, at once and in pieces.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+
+static char *dsn = NULL;
+static int nrows = 1000000;
+static int rowset = 1;
+static int ncheck = 0;
+static int verbose = 0;
+
+static HENV env = SQL_NULL_HENV;
+static HDBC dbc = SQL_NULL_HDBC;
+
+static double now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static void error(HSTMT stmt, char *what, int rc)
+{
+    SQLCHAR msg[512], state[16];
+    SQLINTEGER nerr = 0;
+    SQLSMALLINT len = 0;
+
+    msg[0] = '\0';
+    state[0] = '\0';
+    if (stmt != SQL_NULL_HSTMT) {
+        SQLError(env, dbc, stmt, state, &nerr, msg, sizeof (msg), &len);
+    } else {
+        SQLError(env, dbc, SQL_NULL_HSTMT, state, &nerr, msg,
+		 sizeof (msg), &len);
+    }
+    fprintf(stderr, "%s failed rc=%d: %s %s\n", what, rc, state, msg);
+    exit(2);
+}
+
+static void execDirect(char *sql)
+{
+    HSTMT stmt;
+    int rc;
+
+    rc = SQLAllocStmt(dbc, &stmt);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(SQL_NULL_HSTMT, "SQLAllocStmt", rc);
+    }
+    rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(rc) && rc != SQL_NO_DATA) {
+        error(stmt, sql, rc);
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+}
+
+static void createTable(void)
+{
+    HSTMT stmt;
+    SQLINTEGER *ival;
+    double *dval;
+    char (*tval)[16], (*nval)[24];
+    SQLLEN *tlen, *nlen;
+    int i, k, rc, chunk = 1000;
+
+    execDirect("DROP TABLE IF EXISTS fbench");
+    execDirect("CREATE TABLE fbench (i INTEGER, r REAL, t VARCHAR(15), "
+		"n VARCHAR(23))");
+    ival = malloc(chunk * sizeof (SQLINTEGER));
+    dval = malloc(chunk * sizeof (double));
+    tval = malloc(chunk * sizeof (tval[0]));
+    tlen = malloc(chunk * sizeof (SQLLEN));
+    nval = malloc(chunk * sizeof (nval[0]));
+    nlen = malloc(chunk * sizeof (SQLLEN));
+    if (!ival || !dval || !tval || !tlen || !nval || !nlen) {
+        fprintf(stderr, "malloc failed\n");
+	exit(2);
+    }
+    SQLAllocStmt(dbc, &stmt);
+    rc = SQLPrepare(stmt, (SQLCHAR *) "INSERT INTO fbench VALUES (?, ?, ?, ?)",
+		    SQL_NTS);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(stmt, "SQLPrepare", rc);
+    }
+    SQLSetStmtAttr(stmt, SQL_ATTR_PARAMSET_SIZE,
+		   (SQLPOINTER) (SQLULEN) chunk, 0);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER,
+		     0, 0, ival, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_DOUBLE,
+		     0, 0, dval, 0, NULL);
+    SQLBindParameter(stmt, 3, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+		     15, 0, tval, sizeof (tval[0]), tlen);
+    SQLBindParameter(stmt, 4, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+		     23, 0, nval, sizeof (nval[0]), nlen);
+    for (k = 0; k < nrows; k += chunk) {
+        for (i = 0; i < chunk; i++) {
+	    ival[i] = k + i;
+	    dval[i] = (k + i) * 1.1;
+	    sprintf(tval[i], "row%d", k + i);
+	    tlen[i] = SQL_NTS;
+	    sprintf(nval[i], "%d.%03d", k + i, (k + i) % 1000);
+	    nlen[i] = SQL_NTS;
+	}
+	rc = SQLExecute(stmt);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(stmt, "SQLExecute", rc);
+	}
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    free(ival);
+    free(dval);
+    free(tval);
+    free(tlen);
+    free(nval);
+    free(nlen);
+}
+
+static void runFetch(char *title, char *sql, int ctype, int size)
+{
+    HSTMT stmt;
+    char *buf;
+    SQLLEN *ind;
+    SQLULEN nfetched = 0;
+    double t0, t1;
+    long count = 0;
+    int rc;
+
+    buf = malloc(rowset * size);
+    ind = malloc(rowset * sizeof (SQLLEN));
+    if (!buf || !ind) {
+        fprintf(stderr, "malloc failed\n");
+	exit(2);
+    }
+    SQLAllocStmt(dbc, &stmt);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE,
+		   (SQLPOINTER) (SQLULEN) rowset, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &nfetched, 0);
+    SQLBindCol(stmt, 1, (SQLSMALLINT) ctype, buf, size, ind);
+    t0 = now();
+    rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(stmt, sql, rc);
+    }
+    while (SQL_SUCCEEDED(rc = SQLFetch(stmt))) {
+        count += nfetched;
+    }
+    t1 = now();
+    SQLFreeStmt(stmt, SQL_DROP);
+    free(buf);
+    free(ind);
+    fprintf(stdout, "%-24s %8ld cells %8.3f s %8.1f ns/cell\n", title,
+	    count, t1 - t0, count ? (t1 - t0) * 1e9 / count : 0.0);
+    fflush(stdout);
+}
+
+static void runCheck(void)
+{
+    HSTMT stmt;
+    static unsigned char blob[5000], out[5000], piece[7];
+    static char sql[4 * sizeof (blob) + 32];
+    SQLLEN blen, len;
+    unsigned long seed = 1;
+    int i, k, n, rc, bad = 0;
+    char *p, *q;
+
+    SQLAllocStmt(dbc, &stmt);
+    for (k = 0; k < ncheck; k++) {
+        seed = seed * 1103515245 + 12345;
+	blen = (seed >> 8) % sizeof (blob);
+	/* same blob twice as X'..' literal */
+	strcpy(sql, "SELECT X'");
+	p = sql + strlen(sql);
+	q = p + 2 * blen + 5;
+	for (i = 0; i < blen; i++) {
+	    seed = seed * 1103515245 + 12345;
+	    blob[i] = (unsigned char) (seed >> 16);
+	    sprintf(p + 2 * i, "%02X", blob[i]);
+	    sprintf(q + 2 * i, "%02X", blob[i]);
+	}
+	memcpy(p + 2 * blen, "', X'", 5);
+	strcpy(q + 2 * blen, "'");
+	rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(stmt, "SQLExecDirect", rc);
+	}
+	rc = SQLFetch(stmt);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(stmt, "SQLFetch", rc);
+	}
+	/* length probe, then the data */
+	len = 0;
+	rc = SQLGetData(stmt, 1, SQL_C_BINARY, NULL, 0, &len);
+	if (!SQL_SUCCEEDED(rc) || len < blen) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: length probe rc=%d len=%ld\n", k, rc,
+			(long) len);
+	    }
+	}
+	rc = SQLGetData(stmt, 1, SQL_C_BINARY, out, sizeof (out), &len);
+	if (!SQL_SUCCEEDED(rc) || len != blen ||
+	    memcmp(blob, out, blen) != 0) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: SQL_C_BINARY mismatch\n", k);
+	    }
+	}
+	/* length probe, then the data in pieces */
+	rc = SQLGetData(stmt, 2, SQL_C_BINARY, NULL, 0, &len);
+	if (!SQL_SUCCEEDED(rc) || len < blen) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: length probe rc=%d len=%ld\n", k, rc,
+			(long) len);
+	    }
+	}
+	n = 0;
+	while (SQL_SUCCEEDED(rc = SQLGetData(stmt, 2, SQL_C_BINARY, piece,
+					     sizeof (piece), &len))) {
+	    int m = sizeof (piece);
+
+	    if (len != SQL_NO_TOTAL && len < m) {
+	        m = len;
+	    }
+	    if (n + m > (int) sizeof (out)) {
+	        break;
+	    }
+	    memcpy(out + n, piece, m);
+	    n += m;
+	    if (rc == SQL_SUCCESS) {
+	        break;
+	    }
+	}
+	if (n != blen || memcmp(blob, out, blen) != 0) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: SQLGetData() pieces mismatch\n", k);
+	    }
+	}
+	SQLFreeStmt(stmt, SQL_CLOSE);
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    fprintf(stdout, "Blob check: %d blobs, %d mismatches\n", ncheck, bad);
+    fflush(stdout);
+    if (bad) {
+        exit(3);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int init_db = 0, i, rc;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dsn") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		dsn = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-rows") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nrows = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-rowset") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		rowset = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-check") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		ncheck = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-init") == 0) {
+            init_db = 1;
+        } else if (strcmp(argv[i], "-v") == 0) {
+	    verbose++;
+	}
+    }
+    if (dsn == NULL || nrows < 1 || rowset < 1 || ncheck < 0) {
+        fprintf(stderr, "usage: %s -dsn DSN [-v] [-init] "
+		"[-rows n] [-rowset n] [-check n]\n\n", argv[0]);
+        fprintf(stderr, "-v        verbose messages\n");
+        fprintf(stderr, "-init     (re)create the table\n");
+        fprintf(stderr, "-rows     number of rows for -init\n");
+        fprintf(stderr, "-rowset   SQL_ATTR_ROW_ARRAY_SIZE for fetch\n");
+        fprintf(stderr, "-check    number of random blobs to check\n");
+	exit(1);
+    }
+    SQLAllocEnv(&env);
+    SQLAllocConnect(env, &dbc);
+    rc = SQLDriverConnect(dbc, NULL, (SQLCHAR *) dsn, SQL_NTS, NULL, 0, NULL,
+			  SQL_DRIVER_NOPROMPT);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(SQL_NULL_HSTMT, "SQLDriverConnect", rc);
+    }
+    if (ncheck) {
+        runCheck();
+    }
+    if (init_db) {
+        if (verbose) {
+	    fprintf(stdout, "Initializing %d rows...\n", nrows);
+	    fflush(stdout);
+	}
+	createTable();
+    }
+    fprintf(stdout, "Rowset size: %d\n", rowset);
+    runFetch("INTEGER -> SQL_C_SLONG", "SELECT i FROM fbench",
+	     SQL_C_SLONG, sizeof (SQLINTEGER));
+    runFetch("REAL -> SQL_C_DOUBLE", "SELECT r FROM fbench",
+	     SQL_C_DOUBLE, sizeof (double));
+    runFetch("TEXT -> SQL_C_CHAR", "SELECT t FROM fbench",
+	     SQL_C_CHAR, 16);
+    runFetch("REAL -> SQL_C_CHAR", "SELECT r FROM fbench",
+	     SQL_C_CHAR, 32);
+    runFetch("TEXT -> SQL_C_DOUBLE", "SELECT n FROM fbench",
+	     SQL_C_DOUBLE, sizeof (double));
+    runFetch("TEXT -> SQL_C_TIMESTAMP",
+	     "SELECT strftime('%Y-%m-%d %H:%M:%f', i, 'unixepoch') FROM fbench",
+	     SQL_C_TIMESTAMP, sizeof (TIMESTAMP_STRUCT));
+    runFetch("INTEGER -> SQL_C_TIMESTAMP", "SELECT i FROM fbench",
+	     SQL_C_TIMESTAMP, sizeof (TIMESTAMP_STRUCT));
+    SQLDisconnect(dbc);
+    SQLFreeConnect(dbc);
+    SQLFreeEnv(env);
+    return 0;
+}
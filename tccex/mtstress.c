@@ -0,0 +1,359 @@
+/*
+ *  Multi-threaded stress test: many threads share one ENV, each
+ *  repeatedly connects, inserts rows in a transaction, verifies
+ *  the row count, and disconnects. Odd numbered threads also run a
+ *  long query which a separate thread tries to stop with SQLCancel(),
+ *  while the main thread commits all connections of the ENV.
+ *  A "%d" in the DSN is replaced by the thread number, e.g. to give
+ *  each thread its own database file.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+
+#define MAXTHREADS 256
+
+static char *dsn = NULL;
+static int nthreads = 32;
+static int nloops = 20;
+static int nrows = 100;
+static int verbose = 0;
+static volatile int running = 0;
+
+static HENV env = SQL_NULL_HENV;
+
+/* statements running a long query, for the cancel thread */
+static HSTMT longstmt[MAXTHREADS];
+
+static int nerrors = 0, nmismatch = 0, ncancel = 0;
+
+#ifdef _WIN32
+static CRITICAL_SECTION mutex;
+#define LOCK()   EnterCriticalSection(&mutex)
+#define UNLOCK() LeaveCriticalSection(&mutex)
+#else
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK()   pthread_mutex_lock(&mutex)
+#define UNLOCK() pthread_mutex_unlock(&mutex)
+#endif
+
+static double now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static void pause_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+static void error(int n, HDBC dbc, HSTMT stmt, char *what, int rc)
+{
+    SQLCHAR msg[512], state[16];
+    SQLINTEGER nerr = 0;
+    SQLSMALLINT len = 0;
+
+    LOCK();
+    nerrors++;
+    UNLOCK();
+    if (verbose) {
+        msg[0] = '\0';
+	state[0] = '\0';
+	SQLError(SQL_NULL_HENV, dbc, stmt, state, &nerr, msg,
+		 sizeof (msg), &len);
+	fprintf(stderr, "thread %d: %s failed rc=%d: %s %s\n",
+		n, what, rc, state, msg);
+    }
+}
+
+static int execDirect(int n, HDBC dbc, char *sql)
+{
+    HSTMT stmt;
+    int rc;
+
+    rc = SQLAllocStmt(dbc, &stmt);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(n, dbc, SQL_NULL_HSTMT, "SQLAllocStmt", rc);
+	return rc;
+    }
+    rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(rc) && rc != SQL_NO_DATA) {
+        error(n, dbc, stmt, sql, rc);
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    return rc;
+}
+
+static void longQuery(int n, HDBC dbc)
+{
+    HSTMT stmt;
+    int rc;
+
+    rc = SQLAllocStmt(dbc, &stmt);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(n, dbc, SQL_NULL_HSTMT, "SQLAllocStmt", rc);
+	return;
+    }
+    LOCK();
+    longstmt[n] = stmt;
+    UNLOCK();
+    rc = SQLExecDirect(stmt, (SQLCHAR *)
+		       "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL "
+		       "SELECT x + 1 FROM c LIMIT 20000000) "
+		       "SELECT count(*) FROM c", SQL_NTS);
+    LOCK();
+    longstmt[n] = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(rc)) {
+        ncancel++;
+    }
+    UNLOCK();
+    SQLFreeStmt(stmt, SQL_DROP);
+}
+
+static void runLoop(int n, int loop, long *total)
+{
+    HDBC dbc;
+    HSTMT stmt;
+    SQLINTEGER val;
+    SQLLEN count = 0;
+    char buf[1024], sql[128];
+    int i, rc;
+
+    rc = SQLAllocConnect(env, &dbc);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(n, SQL_NULL_HDBC, SQL_NULL_HSTMT, "SQLAllocConnect", rc);
+	return;
+    }
+    sprintf(buf, dsn, n);
+    rc = SQLDriverConnect(dbc, NULL, (SQLCHAR *) buf, SQL_NTS, NULL, 0,
+			  NULL, SQL_DRIVER_NOPROMPT);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(n, dbc, SQL_NULL_HSTMT, "SQLDriverConnect", rc);
+	SQLFreeConnect(dbc);
+	return;
+    }
+    if (loop == 0) {
+        sprintf(sql, "DROP TABLE IF EXISTS mt%d", n);
+	execDirect(n, dbc, sql);
+    }
+    sprintf(sql, "CREATE TABLE IF NOT EXISTS mt%d (i INTEGER)", n);
+    execDirect(n, dbc, sql);
+    SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT,
+		      (SQLPOINTER) SQL_AUTOCOMMIT_OFF, 0);
+    SQLAllocStmt(dbc, &stmt);
+    sprintf(sql, "INSERT INTO mt%d VALUES (?)", n);
+    rc = SQLPrepare(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(n, dbc, stmt, "SQLPrepare", rc);
+    }
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER,
+		     0, 0, &val, 0, NULL);
+    for (i = 0; i < nrows; i++) {
+        val = i;
+	rc = SQLExecute(stmt);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(n, dbc, stmt, "SQLExecute", rc);
+	    break;
+	}
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    if (i == nrows) {
+        rc = SQLEndTran(SQL_HANDLE_DBC, dbc, SQL_COMMIT);
+	if (SQL_SUCCEEDED(rc)) {
+	    *total += nrows;
+	} else {
+	    error(n, dbc, SQL_NULL_HSTMT, "SQLEndTran", rc);
+	}
+    } else {
+        SQLEndTran(SQL_HANDLE_DBC, dbc, SQL_ROLLBACK);
+    }
+    SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT,
+		      (SQLPOINTER) SQL_AUTOCOMMIT_ON, 0);
+    if (n % 2) {
+        longQuery(n, dbc);
+    }
+    SQLAllocStmt(dbc, &stmt);
+    sprintf(sql, "SELECT count(*) FROM mt%d", n);
+    rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (SQL_SUCCEEDED(rc)) {
+        rc = SQLFetch(stmt);
+    }
+    if (SQL_SUCCEEDED(rc)) {
+        rc = SQLGetData(stmt, 1, SQL_C_SLONG, &val, sizeof (val), &count);
+    }
+    if (!SQL_SUCCEEDED(rc)) {
+        error(n, dbc, stmt, "SELECT count(*)", rc);
+    } else if (val != *total) {
+        LOCK();
+        nmismatch++;
+	UNLOCK();
+	if (verbose) {
+	    fprintf(stderr, "thread %d: %ld rows expected, %ld found\n",
+		    n, *total, (long) val);
+	}
+	*total = val;
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    SQLDisconnect(dbc);
+    SQLFreeConnect(dbc);
+}
+
+#ifdef _WIN32
+static unsigned __stdcall runThread(void *arg)
+#else
+static void *runThread(void *arg)
+#endif
+{
+    int n = (int) (size_t) arg, loop;
+    long total = 0;
+
+    for (loop = 0; loop < nloops; loop++) {
+        runLoop(n, loop, &total);
+    }
+    return 0;
+}
+
+#ifdef _WIN32
+static unsigned __stdcall cancelThread(void *arg)
+#else
+static void *cancelThread(void *arg)
+#endif
+{
+    int i;
+
+    while (running) {
+        pause_ms(5);
+	LOCK();
+	for (i = 0; i < nthreads; i++) {
+	    if (longstmt[i] != SQL_NULL_HSTMT) {
+	        SQLCancel(longstmt[i]);
+	    }
+	}
+	UNLOCK();
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int i, rc;
+    double t0, t1;
+#ifdef _WIN32
+    HANDLE tids[MAXTHREADS + 1];
+#else
+    pthread_t tids[MAXTHREADS + 1];
+#endif
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dsn") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		dsn = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-threads") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nthreads = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-loops") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nloops = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-rows") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nrows = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-v") == 0) {
+	    verbose++;
+	}
+    }
+    if (dsn == NULL || nthreads < 1 || nthreads > MAXTHREADS ||
+	nloops < 1 || nrows < 1) {
+        fprintf(stderr, "usage: %s -dsn DSN [-v] [-threads n] "
+		"[-loops n] [-rows n]\n\n", argv[0]);
+        fprintf(stderr, "-v        verbose error messages\n");
+        fprintf(stderr, "-threads  number of threads, max %d\n",
+		MAXTHREADS);
+        fprintf(stderr, "-loops    connects per thread\n");
+        fprintf(stderr, "-rows     rows inserted per connect\n");
+	exit(1);
+    }
+#ifdef _WIN32
+    InitializeCriticalSection(&mutex);
+#endif
+    rc = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+    if (!SQL_SUCCEEDED(rc)) {
+        fprintf(stderr, "SQLAllocHandle failed\n");
+	exit(2);
+    }
+    SQLSetEnvAttr(env, SQL_ATTR_ODBC_VERSION, (SQLPOINTER) SQL_OV_ODBC3, 0);
+    running = 1;
+    t0 = now();
+    for (i = 0; i <= nthreads; i++) {
+#ifdef _WIN32
+        unsigned tid;
+
+        tids[i] = (HANDLE) _beginthreadex(NULL, 0,
+					  (i < nthreads) ? runThread :
+					  cancelThread,
+					  (void *) (size_t) i, 0, &tid);
+#else
+        pthread_create(&tids[i], NULL,
+		       (i < nthreads) ? runThread : cancelThread,
+		       (void *) (size_t) i);
+#endif
+    }
+    for (i = 0; i < nthreads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(tids[i], INFINITE);
+	CloseHandle(tids[i]);
+#else
+        pthread_join(tids[i], NULL);
+#endif
+	/* commit whatever the remaining threads have pending */
+	SQLEndTran(SQL_HANDLE_ENV, env, SQL_COMMIT);
+    }
+    running = 0;
+#ifdef _WIN32
+    WaitForSingleObject(tids[nthreads], INFINITE);
+    CloseHandle(tids[nthreads]);
+#else
+    pthread_join(tids[nthreads], NULL);
+#endif
+    t1 = now();
+    rc = SQLFreeHandle(SQL_HANDLE_ENV, env);
+    if (!SQL_SUCCEEDED(rc)) {
+        fprintf(stderr, "SQLFreeHandle(ENV) failed, connections left\n");
+	nerrors++;
+    }
+    fprintf(stdout, "%d threads, %d connects, %d rows each: %.3f s\n",
+	    nthreads, nthreads * nloops, nrows, t1 - t0);
+    fprintf(stdout, "%d errors, %d count mismatches, %d queries "
+	    "cancelled\n", nerrors, nmismatch, ncancel);
+    return (nerrors || nmismatch) ? 1 : 0;
+}
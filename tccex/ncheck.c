@@ -0,0 +1,287 @@
+/*
+ *  Number conversion check: compares the driver's locale neutral
+ *  parsers ln_fastatof(), ln_strtod(), ln_strtol() and ln_strtoll()
+ *  bit for bit and including the end pointer against the C library's
+ *  strtod(), strtol() and strtoll(), and round trips the output of
+ *  ln_dtoa() through strtod(), for a table of edge cases (subnormals,
+ *  19 and 20 digit mantissas, signed zeros, inf/nan strings, exponent
+ *  overflow, hex and octal integers) and n random inputs.
+ *
+ *  The functions are static in the driver, thus its source is
+ *  included here and must be compiled with the driver's flags.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#include <float.h>
+#include "sqlite3odbc.c"
+
+static int ncheck = 1000000;
+static int verbose = 0;
+
+static sqlite_uint64 seed = 88172645463325252ULL;
+
+static double now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static sqlite_uint64 rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static const char *edges[] = {
+    /* zeros and signs */
+    "0", "-0", "+0", "0.0", "-0.0", "-.0", "0e10", "-0e-10", "000",
+    "0e99999", "-0.0e-99999",
+    /* syntax corners */
+    "", " ", "-", "+", ".", "-.", "+.e1", ".5", "5.", "1.e1", "1e",
+    "1e+", "1e-", "1e-5x", "1ee5", "1,5", "1.5.5", " 12", "\t-3.25e3",
+    "\n\v\f\r7", "  +7", "abc", "e5", "--1", "+-1", "2.5e010",
+    "00000000000000000000001.5", "0.000000000000000000000000001",
+    /* subnormals and the normal range limits */
+    "4.9e-324", "5e-324", "2.4703282292062327e-324",
+    "2.4703282292062328e-324", "1e-320", "-1e-310",
+    "2.2250738585072011e-308", "2.2250738585072014e-308",
+    "2.2250738585072012e-308", "1.7976931348623157e308",
+    "1.7976931348623158e308", "1.7976931348623159e308",
+    /* 19 and 20 digit mantissas */
+    "1234567890123456789", "12345678901234567890", "9999999999999999999",
+    "99999999999999999999", "0.1234567890123456789",
+    "0.12345678901234567890", "1234567890123456789e-5",
+    "12345678901234567890e-25", "1.234567890123456789e22",
+    "9007199254740992", "9007199254740993", "9007199254740994",
+    "9007199254740993.0", "900719925474099.3e1",
+    "999999999999999999", "9223372036854775807", "9223372036854775808",
+    "-9223372036854775808", "-9223372036854775809",
+    "18446744073709551615", "18446744073709551616",
+    "2147483647", "2147483648", "-2147483648", "-2147483649",
+    "4294967295", "4294967296",
+    /* exact power of ten limits of the fast path */
+    "1e22", "1e23", "1e-22", "1e-23", "1.5e-22", "123456e17",
+    "123456e-27", "0.1", "0.2", "0.3", "3.14159265358979",
+    /* inf and nan */
+    "inf", "-inf", "+inf", "INF", "Inf", "infinity", "-Infinity",
+    "infinit", "nan", "-nan", "NaN", "nan(123)", "nanx",
+    /* exponent overflow */
+    "1e99999", "1e-99999", "-1e99999", "1e400", "-1e400", "1e-400",
+    "1e309", "1e308", "1e2147483647", "1e2147483648", "1e-2147483649",
+    "1e99999999999999999999", "0.0000001e99999",
+    "1000000000000000000000e-99999",
+    /* hex and octal */
+    "0x10", "0X1f", "-0x10", "0x", "0x1p3", "0x1.8p1", "0xg", "010",
+    "-010", "08", "0", "00", "0x7fffffffffffffff", "0xffffffffffffffff",
+    "01777777777777777777777", "0x10000000000000000"
+};
+
+static int checkParse(const char *s)
+{
+    char *e1, *e2;
+    double a, b;
+    long l1, l2;
+    sqlite_int64 i1, i2;
+    int bad = 0;
+
+    a = strtod(s, &e1);
+    e2 = NULL;
+    if (ln_fastatof(s, &e2, &b) && (memcmp(&a, &b, sizeof (a)) != 0 ||
+				     e1 != e2)) {
+	bad++;
+	if (verbose) {
+	    fprintf(stderr, "ln_fastatof(\"%s\"): %.17g/%d vs. %.17g/%d\n",
+		    s, b, (int) (e2 - s), a, (int) (e1 - s));
+	}
+    }
+    b = ln_strtod(s, &e2);
+    if (memcmp(&a, &b, sizeof (a)) != 0 || e1 != e2) {
+	bad++;
+	if (verbose) {
+	    fprintf(stderr, "ln_strtod(\"%s\"): %.17g/%d vs. %.17g/%d\n",
+		    s, b, (int) (e2 - s), a, (int) (e1 - s));
+	}
+    }
+    l1 = strtol(s, &e1, 0);
+    l2 = ln_strtol(s, &e2);
+    if (l1 != l2 || e1 != e2) {
+	bad++;
+	if (verbose) {
+	    fprintf(stderr, "ln_strtol(\"%s\"): %ld/%d vs. %ld/%d\n",
+		    s, l2, (int) (e2 - s), l1, (int) (e1 - s));
+	}
+    }
+    i1 = strtoll(s, &e1, 0);
+    i2 = ln_strtoll(s, &e2);
+    if (i1 != i2 || e1 != e2) {
+	bad++;
+	if (verbose) {
+	    fprintf(stderr, "ln_strtoll(\"%s\"): %lld/%d vs. %lld/%d\n",
+		    s, (long long) i2, (int) (e2 - s), (long long) i1,
+		    (int) (e1 - s));
+	}
+    }
+    return bad;
+}
+
+/* count of significant digits in ln_dtoa() output */
+
+static int ndigits(const char *s)
+{
+    char dig[64];
+    int n = 0, k = 0;
+
+    for (; *s && *s != 'e' && n < (int) sizeof (dig); s++) {
+	if (*s >= '0' && *s <= '9') {
+	    dig[n++] = *s;
+	}
+    }
+    while (k < n - 1 && dig[k] == '0') {
+	++k;
+    }
+    while (n > k + 1 && dig[n - 1] == '0') {
+	--n;
+    }
+    return n - k;
+}
+
+static int checkDtoa(double v, int *longer)
+{
+    char buf[64], tmp[64], *end;
+    double r;
+    int p;
+
+    ln_dtoa(v, buf);
+    r = strtod(buf, &end);
+    if (r != v || *end || !strchr(buf, '.')) {
+	if (verbose) {
+	    fprintf(stderr, "ln_dtoa(%.17g): \"%s\"\n", v, buf);
+	}
+	return 1;
+    }
+    /* shortest round trip length using %.*e */
+    for (p = 1; p < 17; p++) {
+	sprintf(tmp, "%.*e", p - 1, v);
+	if (strtod(tmp, NULL) == v) {
+	    break;
+	}
+    }
+    if (ndigits(buf) > p) {
+	(*longer)++;
+	if (verbose > 1) {
+	    fprintf(stderr, "ln_dtoa(%.17g): \"%s\" not shortest\n", v, buf);
+	}
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const double dedges[] = {
+	0.0, 0.1, 0.2, 0.3, 0.1 + 0.2, 1.0 / 3, 2.0 / 3, 1e15, 1e16, 1e17,
+	123456789012345.0, 1e-5, 1e-4, 1e-3, 4.9e-324, 1e-320,
+	2.2250738585072009e-308, 2.2250738585072014e-308, DBL_MAX,
+	1, 10, 100, 123.0, 0.5, 1e21, 1e22, 1e23, 9007199254740993.0,
+	0.000123, 5e-7, 123456789.125, 18446744073709551616.0
+    };
+    char buf[64];
+    double t0, t1, v;
+    sqlite_uint64 u;
+    int i, bad = 0, fast = 0, longer = 0, nparse = 0, ndtoa = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		ncheck = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-v") == 0) {
+	    verbose++;
+	} else {
+	    ncheck = -1;
+	    break;
+	}
+    }
+    if (ncheck < 0) {
+        fprintf(stderr, "usage: %s [-v] [-n n]\n\n", argv[0]);
+        fprintf(stderr, "-n        number of random inputs, "
+		"default 1000000\n");
+        fprintf(stderr, "-v        print mismatches, twice for "
+		"non-shortest output\n");
+	exit(1);
+    }
+    t0 = now();
+    for (i = 0; i < (int) array_size(edges); i++) {
+	bad += checkParse(edges[i]);
+	nparse++;
+    }
+    for (i = 0; i < (int) array_size(dedges); i++) {
+	bad += checkDtoa(dedges[i], &longer);
+	bad += checkDtoa(-dedges[i], &longer);
+	ndtoa += 2;
+    }
+    for (i = 0; i < ncheck; i++) {
+	u = rnd();
+	switch (i % 5) {
+	case 0:
+	    /* random bits, output of ln_dtoa() */
+	    memcpy(&v, &u, sizeof (v));
+	    if (v != v || v - v != 0) {
+		continue;
+	    }
+	    bad += checkDtoa(v, &longer);
+	    ndtoa++;
+	    ln_dtoa(v, buf);
+	    break;
+	case 1:
+	    /* 1 to 20 digits, mostly in fast path range */
+	    sprintf(buf, "%.*g", (int) (u % 20) + 1,
+		    (double) (u >> 11) / (double) ((sqlite_uint64) 1 <<
+						   (u % 60)));
+	    break;
+	case 2:
+	    /* money like decimals */
+	    sprintf(buf, "%lld.%02d", (long long) (u % 100000000) - 50000000,
+		    (int) ((u >> 40) % 100));
+	    break;
+	case 3:
+	    /* integers of any magnitude */
+	    sprintf(buf, "%lld", (long long) (u >> (u % 64)) *
+		    ((u & 1) ? -1 : 1));
+	    break;
+	default:
+	    /* mantissa of up to 20 digits with exponent */
+	    sprintf(buf, "%llu%se%d", (unsigned long long) (u >> (u % 64)),
+		    (u & 2) ? ".5" : "", (int) ((u >> 8) % 700) - 350);
+	    break;
+	}
+	if (ln_fastatof(buf, NULL, &v)) {
+	    fast++;
+	}
+	bad += checkParse(buf);
+	nparse++;
+    }
+    t1 = now();
+    fprintf(stdout, "Parse check: %d strings, %d via fast path\n",
+	    nparse, fast);
+    fprintf(stdout, "Format check: %d doubles, %d not shortest\n",
+	    ndtoa, longer);
+    fprintf(stdout, "%d mismatches, %.3f s\n", bad, t1 - t0);
+    fflush(stdout);
+    if (bad) {
+	exit(3);
+    }
+    return 0;
+}
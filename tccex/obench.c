@@ -32,8 +32,12 @@ static char *dsn = NULL;
 #define BRANCH 1
 #define ACCOUNT 2
 
+/* latency histogram: 8 buckets per power of two microseconds */
+#define NLATENCY 256
+
 static int *failed_transactions = NULL;
 static int *transaction_count = NULL;
+static int *latency = NULL;
 static int n_clients = 10;
 static int n_txn_per_client = 10;
 
@@ -46,7 +50,7 @@ static int transactions = 0;
 static int verbose = 0;
 
 #ifdef _WIN32
-static int shm[200];
+static int shm[2 + NLATENCY];
 #else
 static int shmid;
 static int *shm = NULL;
@@ -66,6 +70,68 @@ static void incrementFailedTransactionCount()
     }
 }
 
+static long nowUsec()
+{
+#ifdef _WIN32
+    return GetTickCount() * 1000L;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000L + tv.tv_usec;
+#endif
+}
+
+static void addLatency(long us)
+{
+    int b = 0;
+
+    if (!latency) {
+        return;
+    }
+    if (us >= 16) {
+        while (us >= 16) {
+	    us >>= 1;
+	    b += 8;
+	}
+	b += us;
+    } else if (us > 0) {
+        b = us;
+    }
+    if (b >= NLATENCY) {
+        b = NLATENCY - 1;
+    }
+    latency[b]++;
+}
+
+static double getLatency(double pct)
+{
+    long total = 0, n = 0, rank;
+    int b;
+
+    for (b = 0; b < NLATENCY; b++) {
+        total += latency[b];
+    }
+    rank = (long) (total * pct / 100.0 + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (b = 0; b < NLATENCY; b++) {
+        n += latency[b];
+	if (n >= rank) {
+	    break;
+	}
+    }
+    if (b >= NLATENCY) {
+        return 0.0;
+    }
+    if (b < 16) {
+        return b / 1000.0;
+    }
+    /* upper bound of bucket */
+    return (double) ((b % 8 + 9) << (b / 8 - 1)) / 1000.0;
+}
+
 static int getRandomInt(int lo, int hi)
 {
     int ret = 0;
@@ -137,9 +203,13 @@ static void reportDone()
 	    *failed_transactions, *transaction_count);
     rate = (*transaction_count - *failed_transactions) / completion_time;
     fprintf(stdout, "Transaction rate: %g txn/sec.\n", rate);
+    fprintf(stdout, "Transaction latency: p50 %g ms, p99 %g ms, "
+	    "max %g ms.\n", getLatency(50.0), getLatency(99.0),
+	    getLatency(100.0));
     fflush(stdout);
     *transaction_count = 0;
     *failed_transactions = 0;
+    memset(latency, 0, NLATENCY * sizeof (int));
 }
 
 static void createDatabase()
@@ -472,7 +542,9 @@ static int runClientThread(void *args)
 	int branch  = getRandomID(BRANCH);
 	int teller  = getRandomID(TELLER);
 	int delta   = getRandomInt(0,1000);
+	long t0     = nowUsec();
 	doOne(dbc, branch, teller, account, delta);
+	addLatency(nowUsec() - t0);
 	if (transactions < -1 && ntrans > 0 && ntrans % 100 == 0) {
 	    rc = SQLTransact(NULL, dbc, SQL_COMMIT);
 	    if (!SQL_SUCCEEDED(rc)) {
@@ -563,13 +635,16 @@ int main(int argc, char **argv)
 	fflush(stdout);
     }
 #ifndef _WIN32
-    shmid = shmget(IPC_PRIVATE, 2 * sizeof (int), IPC_CREAT | 0666);
+    shmid = shmget(IPC_PRIVATE, (2 + NLATENCY) * sizeof (int),
+		   IPC_CREAT | 0666);
     shm = shmat(shmid, NULL, 0);
 #endif
     transaction_count = &shm[0];
     failed_transactions = &shm[1];
+    latency = &shm[2];
     *transaction_count = 0;
     *failed_transactions = 0;
+    memset(latency, 0, NLATENCY * sizeof (int));
 
 #ifdef _WIN32
     pids = malloc(n_clients * sizeof (HANDLE));
@@ -0,0 +1,309 @@
+/*
+ *  Decoder for binary trace files written by the SQLite ODBC driver
+ *  when the DSN options TraceFile=... and TraceBinary=1 are given.
+ *  Prints the records as text lines or JSON objects, or with -top n
+ *  the n SQL statements taking the most total time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* must match TRCREC in sqlite3odbc.h */
+
+typedef struct {
+    unsigned long long time;
+    unsigned long long handle;
+    unsigned int dur;
+    unsigned int hash;
+    unsigned int name;
+    short event;
+    short rc;
+} TRCREC;
+
+#define TRC_START	0
+#define TRC_TEXT	1
+#define TRC_SQL		2
+#define TRC_API		3
+#define TRC_RC		4
+#define TRC_PARAM	5
+#define TRC_OPEN	6
+#define TRC_CLOSE	7
+
+#define TRC_VERSION	0x53335431
+
+static char *evnames[] = {
+    "start", "text", "sql", "api", "rc", "param", "open", "close"
+};
+
+static char *typenames[] = {
+    "?", "INTEGER", "FLOAT", "TEXT", "BLOB", "NULL"
+};
+
+typedef struct text {
+    struct text *next;
+    unsigned int hash;
+    char *str;
+} TEXT;
+
+typedef struct sqlsum {
+    unsigned int hash;
+    unsigned long count;
+    unsigned long long total;
+    unsigned int max;
+} SQLSUM;
+
+#define NBUCKETS 4096
+
+static TEXT *texts[NBUCKETS];
+static SQLSUM *sums = NULL;
+static int nsums = 0, maxsums = 0;
+static int json = 0;
+static int top = 0;
+
+static char *lookup(unsigned int hash)
+{
+    TEXT *t;
+
+    for (t = texts[hash % NBUCKETS]; t; t = t->next) {
+	if (t->hash == hash) {
+	    return t->str;
+	}
+    }
+    return NULL;
+}
+
+static void addtext(unsigned int hash, char *str)
+{
+    TEXT *t;
+
+    if (lookup(hash)) {
+	free(str);
+	return;
+    }
+    t = malloc(sizeof (TEXT));
+    if (!t) {
+	fprintf(stderr, "malloc failed\n");
+	exit(2);
+    }
+    t->hash = hash;
+    t->str = str;
+    t->next = texts[hash % NBUCKETS];
+    texts[hash % NBUCKETS] = t;
+}
+
+static void addsum(unsigned int hash, unsigned int dur)
+{
+    int i;
+
+    for (i = 0; i < nsums; i++) {
+	if (sums[i].hash == hash) {
+	    break;
+	}
+    }
+    if (i >= nsums) {
+	if (nsums >= maxsums) {
+	    maxsums = maxsums ? maxsums * 2 : 256;
+	    sums = realloc(sums, maxsums * sizeof (SQLSUM));
+	    if (!sums) {
+		fprintf(stderr, "malloc failed\n");
+		exit(2);
+	    }
+	}
+	memset(&sums[i], 0, sizeof (SQLSUM));
+	sums[i].hash = hash;
+	nsums++;
+    }
+    sums[i].count++;
+    sums[i].total += dur;
+    if (dur > sums[i].max) {
+	sums[i].max = dur;
+    }
+}
+
+static int cmpsum(const void *a, const void *b)
+{
+    const SQLSUM *sa = a, *sb = b;
+
+    if (sa->total == sb->total) {
+	return 0;
+    }
+    return (sa->total < sb->total) ? 1 : -1;
+}
+
+static void putstr(char *str)
+{
+    if (!str) {
+	fputs(json ? "null" : "?", stdout);
+	return;
+    }
+    if (!json) {
+	fputs(str, stdout);
+	return;
+    }
+    putchar('"');
+    for (; *str; str++) {
+	unsigned char c = *str;
+
+	if (c == '"' || c == '\\') {
+	    printf("\\%c", c);
+	} else if (c < 0x20) {
+	    printf("\\u%04x", c);
+	} else {
+	    putchar(c);
+	}
+    }
+    putchar('"');
+}
+
+static void printrec(TRCREC *r)
+{
+    char *ev = (r->event >= 0 && r->event <= TRC_CLOSE) ?
+	evnames[r->event] : "?";
+
+    if (json) {
+	printf("{\"time\":%llu,\"handle\":\"0x%llx\",\"event\":\"%s\"",
+	       r->time, r->handle, ev);
+    } else {
+	printf("%llu.%06llu 0x%llx %-6s", r->time / 1000000,
+	       r->time % 1000000, r->handle, ev);
+    }
+    switch (r->event) {
+    case TRC_START:
+	printf(json ? ",\"started\":%u" : " started=%u", r->name);
+	break;
+    case TRC_SQL:
+	printf(json ? ",\"dur\":%u,\"sql\":" : " %uus ", r->dur);
+	putstr(lookup(r->hash));
+	break;
+    case TRC_API:
+	fputs(json ? ",\"api\":" : " ", stdout);
+	putstr(lookup(r->name));
+	if (r->hash) {
+	    fputs(json ? ",\"sql\":" : " ", stdout);
+	    putstr(lookup(r->hash));
+	}
+	break;
+    case TRC_RC:
+	printf(json ? ",\"rc\":%d,\"msg\":" : " rc=%d ", r->rc);
+	putstr(r->hash ? lookup(r->hash) : "");
+	break;
+    case TRC_PARAM:
+	printf(json ? ",\"param\":%u,\"type\":\"%s\",\"size\":%u" :
+	       " #%u %s size=%u", r->name,
+	       (r->rc > 0 && r->rc <= 5) ? typenames[r->rc] : "?", r->dur);
+	break;
+    case TRC_OPEN:
+    case TRC_CLOSE:
+	fputs(json ? ",\"db\":" : " ", stdout);
+	putstr(lookup(r->hash));
+	break;
+    }
+    fputs(json ? "}\n" : "\n", stdout);
+}
+
+static int decode(FILE *f)
+{
+    TRCREC r;
+    long nrec = 0;
+
+    while (fread(&r, sizeof (r), 1, f) == 1) {
+	if (nrec++ == 0 &&
+	    (r.event != TRC_START || r.hash != TRC_VERSION)) {
+	    fprintf(stderr, "not a binary trace file\n");
+	    return 1;
+	}
+	if (r.event == TRC_TEXT) {
+	    int n = (r.name + sizeof (r) - 1) / sizeof (r);
+	    char *str = malloc(n * sizeof (r) + 1);
+
+	    if (!str) {
+		fprintf(stderr, "malloc failed\n");
+		exit(2);
+	    }
+	    if (n > 0 && fread(str, sizeof (r), n, f) != (size_t) n) {
+		fprintf(stderr, "truncated trace file\n");
+		free(str);
+		return 1;
+	    }
+	    str[r.name] = '\0';
+	    addtext(r.hash, str);
+	    continue;
+	}
+	if (top) {
+	    if (r.event == TRC_SQL) {
+		addsum(r.hash, r.dur);
+	    }
+	} else {
+	    printrec(&r);
+	}
+    }
+    return 0;
+}
+
+static void report(void)
+{
+    int i;
+
+    qsort(sums, nsums, sizeof (SQLSUM), cmpsum);
+    for (i = 0; i < nsums && i < top; i++) {
+	if (json) {
+	    printf("{\"count\":%lu,\"total\":%llu,\"max\":%u,\"sql\":",
+		   sums[i].count, sums[i].total, sums[i].max);
+	    putstr(lookup(sums[i].hash));
+	    fputs("}\n", stdout);
+	} else {
+	    printf("%8lu %12llu us %10u us max  ", sums[i].count,
+		   sums[i].total, sums[i].max);
+	    putstr(lookup(sums[i].hash));
+	    putchar('\n');
+	}
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int i, nfiles = 0, ret = 0;
+    FILE *f;
+
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "-json") == 0) {
+	    json = 1;
+	} else if (strcmp(argv[i], "-top") == 0) {
+	    if (i + 1 < argc) {
+		i++;
+		top = strtol(argv[i], NULL, 0);
+	    }
+	} else {
+	    nfiles++;
+	}
+    }
+    if (nfiles == 0 || top < 0) {
+	fprintf(stderr, "usage: %s [-json] [-top n] tracefile ...\n\n",
+		argv[0]);
+	fprintf(stderr, "-json     print JSON objects, one per line\n");
+	fprintf(stderr, "-top n    print n SQL statements with most "
+		"total time\n");
+	exit(1);
+    }
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "-json") == 0) {
+	    continue;
+	} else if (strcmp(argv[i], "-top") == 0) {
+	    i++;
+	    continue;
+	}
+	f = fopen(argv[i], "rb");
+	if (!f) {
+	    perror(argv[i]);
+	    ret = 1;
+	    continue;
+	}
+	ret |= decode(f);
+	fclose(f);
+    }
+    if (top) {
+	report();
+    }
+    return ret;
+}
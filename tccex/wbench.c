@@ -0,0 +1,385 @@
+/*
+ *  WCHAR micro benchmark: per cell cost of SQLFetch() into
+ *  SQL_C_WCHAR vs. SQL_C_CHAR bound columns for ASCII and
+ *  mixed non-ASCII text, plus a round trip check of random
+ *  strings through SQL_C_WCHAR parameters and result columns.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+
+static char *dsn = NULL;
+static int nrows = 100000;
+static int rowset = 1;
+static int ncheck = 0;
+static int verbose = 0;
+
+static HENV env = SQL_NULL_HENV;
+static HDBC dbc = SQL_NULL_HDBC;
+
+static unsigned long seed = 1;
+
+static double now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static unsigned long rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) & 0xffffff;
+}
+
+static void error(HSTMT stmt, char *what, int rc)
+{
+    SQLCHAR msg[512], state[16];
+    SQLINTEGER nerr = 0;
+    SQLSMALLINT len = 0;
+
+    msg[0] = '\0';
+    state[0] = '\0';
+    if (stmt != SQL_NULL_HSTMT) {
+        SQLError(env, dbc, stmt, state, &nerr, msg, sizeof (msg), &len);
+    } else {
+        SQLError(env, dbc, SQL_NULL_HSTMT, state, &nerr, msg,
+		 sizeof (msg), &len);
+    }
+    fprintf(stderr, "%s failed rc=%d: %s %s\n", what, rc, state, msg);
+    exit(2);
+}
+
+static void execDirect(char *sql)
+{
+    HSTMT stmt;
+    int rc;
+
+    rc = SQLAllocStmt(dbc, &stmt);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(SQL_NULL_HSTMT, "SQLAllocStmt", rc);
+    }
+    rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(rc) && rc != SQL_NO_DATA) {
+        error(stmt, sql, rc);
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+}
+
+/* random code point, mostly ASCII, never NUL or a surrogate */
+
+static unsigned long rndchar(int ascii)
+{
+    unsigned long c;
+    int k = rnd() % 16;
+
+    if (ascii || k < 10) {
+        return 0x20 + rnd() % 0x5f;
+    }
+    if (k < 12) {
+        return 0x80 + rnd() % 0x780;
+    }
+    if (k < 15) {
+        do {
+	    c = 0x800 + rnd() % 0xf800;
+	} while (c >= 0xd800 && c <= 0xdfff);
+	return c;
+    }
+    return 0x10000 + rnd() % 0x100000;
+}
+
+static int pututf8(unsigned long c, char *p)
+{
+    if (c < 0x80) {
+        p[0] = c;
+	return 1;
+    }
+    if (c < 0x800) {
+        p[0] = 0xc0 | (c >> 6);
+	p[1] = 0x80 | (c & 0x3f);
+	return 2;
+    }
+    if (c < 0x10000) {
+        p[0] = 0xe0 | (c >> 12);
+	p[1] = 0x80 | ((c >> 6) & 0x3f);
+	p[2] = 0x80 | (c & 0x3f);
+	return 3;
+    }
+    p[0] = 0xf0 | (c >> 18);
+    p[1] = 0x80 | ((c >> 12) & 0x3f);
+    p[2] = 0x80 | ((c >> 6) & 0x3f);
+    p[3] = 0x80 | (c & 0x3f);
+    return 4;
+}
+
+static int putucs(unsigned long c, SQLWCHAR *p)
+{
+    if (sizeof (SQLWCHAR) == 2 && c >= 0x10000) {
+        c -= 0x10000;
+	p[0] = 0xd800 | (c >> 10);
+	p[1] = 0xdc00 | (c & 0x3ff);
+	return 2;
+    }
+    p[0] = c;
+    return 1;
+}
+
+/* make random string as UTF-8 and SQLWCHAR, return SQLWCHAR length */
+
+static int mkstring(int nchars, int ascii, char *u8, SQLWCHAR *w)
+{
+    int i, n8 = 0, nw = 0;
+
+    for (i = 0; i < nchars; i++) {
+        unsigned long c = rndchar(ascii);
+
+	n8 += pututf8(c, u8 + n8);
+	nw += putucs(c, w + nw);
+    }
+    u8[n8] = '\0';
+    w[nw] = 0;
+    return nw;
+}
+
+static void createTable(void)
+{
+    HSTMT stmt;
+    char a[64], u[256];
+    SQLWCHAR w[128];
+    SQLLEN alen, ulen;
+    int i, rc;
+
+    execDirect("DROP TABLE IF EXISTS wbench");
+    execDirect("CREATE TABLE wbench (a VARCHAR(63), u VARCHAR(63))");
+    execDirect("BEGIN TRANSACTION");
+    SQLAllocStmt(dbc, &stmt);
+    rc = SQLPrepare(stmt, (SQLCHAR *) "INSERT INTO wbench VALUES (?, ?)",
+		    SQL_NTS);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(stmt, "SQLPrepare", rc);
+    }
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+		     63, 0, a, sizeof (a), &alen);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+		     63, 0, u, sizeof (u), &ulen);
+    for (i = 0; i < nrows; i++) {
+        mkstring(8 + rnd() % 24, 1, a, w);
+	mkstring(8 + rnd() % 24, 0, u, w);
+	alen = ulen = SQL_NTS;
+	rc = SQLExecute(stmt);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(stmt, "SQLExecute", rc);
+	}
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    execDirect("COMMIT TRANSACTION");
+}
+
+static void runFetch(char *title, char *sql, int ctype, int size)
+{
+    HSTMT stmt;
+    char *buf;
+    SQLLEN *ind;
+    SQLULEN nfetched = 0;
+    double t0, t1;
+    long count = 0;
+    int rc;
+
+    buf = malloc(rowset * size);
+    ind = malloc(rowset * sizeof (SQLLEN));
+    if (!buf || !ind) {
+        fprintf(stderr, "malloc failed\n");
+	exit(2);
+    }
+    SQLAllocStmt(dbc, &stmt);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE,
+		   (SQLPOINTER) (SQLULEN) rowset, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &nfetched, 0);
+    SQLBindCol(stmt, 1, (SQLSMALLINT) ctype, buf, size, ind);
+    t0 = now();
+    rc = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(stmt, sql, rc);
+    }
+    while (SQL_SUCCEEDED(rc = SQLFetch(stmt))) {
+        count += nfetched;
+    }
+    t1 = now();
+    SQLFreeStmt(stmt, SQL_DROP);
+    free(buf);
+    free(ind);
+    fprintf(stdout, "%-24s %8ld cells %8.3f s %8.1f ns/cell\n", title,
+	    count, t1 - t0, count ? (t1 - t0) * 1e9 / count : 0.0);
+    fflush(stdout);
+}
+
+/*
+ * Round trip of random strings: SQL_C_WCHAR parameter, fetched
+ * into a bound SQL_C_WCHAR column, into a bound SQL_C_CHAR column,
+ * and piecewise by SQLGetData() with a small SQL_C_WCHAR buffer.
+ */
+
+static void runCheck(void)
+{
+    HSTMT stmt;
+    static char u8[4096], c8[4096];
+    static SQLWCHAR w[1024], wout[1024], piece[8], wget[1024];
+    SQLLEN wlen, woutlen, c8len, plen;
+    int i, k, n, nw, rc, bad = 0;
+
+    SQLAllocStmt(dbc, &stmt);
+    rc = SQLPrepare(stmt, (SQLCHAR *) "SELECT ?, ?, ?", SQL_NTS);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(stmt, "SQLPrepare", rc);
+    }
+    for (i = 1; i <= 3; i++) {
+        SQLBindParameter(stmt, (SQLUSMALLINT) i, SQL_PARAM_INPUT,
+			 SQL_C_WCHAR, SQL_WVARCHAR, 500, 0, w, sizeof (w),
+			 &wlen);
+    }
+    SQLBindCol(stmt, 1, SQL_C_WCHAR, wout, sizeof (wout), &woutlen);
+    SQLBindCol(stmt, 2, SQL_C_CHAR, c8, sizeof (c8), &c8len);
+    for (k = 0; k < ncheck; k++) {
+        nw = mkstring(rnd() % 300, 0, u8, w);
+	wlen = nw * sizeof (SQLWCHAR);
+	rc = SQLExecute(stmt);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(stmt, "SQLExecute", rc);
+	}
+	rc = SQLFetch(stmt);
+	if (!SQL_SUCCEEDED(rc)) {
+	    error(stmt, "SQLFetch", rc);
+	}
+	if (woutlen != wlen || memcmp(w, wout, wlen) != 0) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: WCHAR column mismatch\n", k);
+	    }
+	}
+	if (c8len != (SQLLEN) strlen(u8) || strcmp(c8, u8) != 0) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: CHAR column mismatch\n", k);
+	    }
+	}
+	n = 0;
+	while (SQL_SUCCEEDED(rc = SQLGetData(stmt, 3, SQL_C_WCHAR, piece,
+					     sizeof (piece), &plen))) {
+	    int m = sizeof (piece) / sizeof (SQLWCHAR) - 1;
+
+	    if (plen != SQL_NO_TOTAL &&
+		plen / (int) sizeof (SQLWCHAR) < m) {
+	        m = plen / sizeof (SQLWCHAR);
+	    }
+	    if (n + m > 1023) {
+	        break;
+	    }
+	    memcpy(wget + n, piece, m * sizeof (SQLWCHAR));
+	    n += m;
+	    if (rc == SQL_SUCCESS) {
+	        break;
+	    }
+	}
+	if (n != nw || memcmp(w, wget, wlen) != 0) {
+	    bad++;
+	    if (verbose) {
+	        fprintf(stderr, "#%d: SQLGetData() mismatch\n", k);
+	    }
+	}
+	SQLFreeStmt(stmt, SQL_CLOSE);
+    }
+    SQLFreeStmt(stmt, SQL_DROP);
+    fprintf(stdout, "Round trip check: %d strings, %d mismatches\n",
+	    ncheck, bad);
+    fflush(stdout);
+    if (bad) {
+        exit(3);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int init_db = 0, i, rc;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dsn") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		dsn = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-rows") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nrows = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-rowset") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		rowset = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-check") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		ncheck = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-init") == 0) {
+            init_db = 1;
+        } else if (strcmp(argv[i], "-v") == 0) {
+	    verbose++;
+	}
+    }
+    if (dsn == NULL || nrows < 1 || rowset < 1 || ncheck < 0) {
+        fprintf(stderr, "usage: %s -dsn DSN [-v] [-init] "
+		"[-rows n] [-rowset n] [-check n]\n\n", argv[0]);
+        fprintf(stderr, "-v        verbose messages\n");
+        fprintf(stderr, "-init     (re)create the table\n");
+        fprintf(stderr, "-rows     number of rows for -init\n");
+        fprintf(stderr, "-rowset   SQL_ATTR_ROW_ARRAY_SIZE for fetch\n");
+        fprintf(stderr, "-check    number of random round trip strings\n");
+	exit(1);
+    }
+    SQLAllocEnv(&env);
+    SQLAllocConnect(env, &dbc);
+    rc = SQLDriverConnect(dbc, NULL, (SQLCHAR *) dsn, SQL_NTS, NULL, 0, NULL,
+			  SQL_DRIVER_NOPROMPT);
+    if (!SQL_SUCCEEDED(rc)) {
+        error(SQL_NULL_HSTMT, "SQLDriverConnect", rc);
+    }
+    if (ncheck) {
+        runCheck();
+    }
+    if (init_db) {
+        if (verbose) {
+	    fprintf(stdout, "Initializing %d rows...\n", nrows);
+	    fflush(stdout);
+	}
+	createTable();
+    }
+    fprintf(stdout, "Rowset size: %d\n", rowset);
+    runFetch("ASCII -> SQL_C_CHAR", "SELECT a FROM wbench",
+	     SQL_C_CHAR, 64);
+    runFetch("ASCII -> SQL_C_WCHAR", "SELECT a FROM wbench",
+	     SQL_C_WCHAR, 64 * sizeof (SQLWCHAR));
+    runFetch("mixed -> SQL_C_CHAR", "SELECT u FROM wbench",
+	     SQL_C_CHAR, 256);
+    runFetch("mixed -> SQL_C_WCHAR", "SELECT u FROM wbench",
+	     SQL_C_WCHAR, 128 * sizeof (SQLWCHAR));
+    SQLDisconnect(dbc);
+    SQLFreeConnect(dbc);
+    SQLFreeEnv(env);
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ *  Export benchmark: writes one table of n rows as CSV, XML, SQL
+ *  and JSON using the C functions of the impexp extension and
+ *  reports time and throughput per format. JSON is written once
+ *  through impexp_export_json() with fputc() and once through
+ *  impexp_export_json_write() with fwrite().
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+#include "impexp.h"
+
+static char *dbname = NULL;
+static char *outname = "xbench";
+static int nrows = 10000000;
+static int init = 0;
+static int verbose = 0;
+
+static double now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static double fsize(char *name)
+{
+    struct stat st;
+
+    if (stat(name, &st) != 0) {
+        return 0.0;
+    }
+    return (double) st.st_size;
+}
+
+static void exec(sqlite3 *db, char *sql)
+{
+    char *err = NULL;
+
+    if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "%s failed: %s\n", sql, err ? err : "?");
+	exit(2);
+    }
+}
+
+static int wfile(const char *data, int len, void *arg)
+{
+    return (fwrite(data, 1, len, (FILE *) arg) == (size_t) len) ? len : -1;
+}
+
+static void report(char *what, char *name, double t0, double t1)
+{
+    double size = fsize(name);
+
+    fprintf(stdout, "%-12s %.3f s, %.1f rows/s, %.1f MB, %.1f MB/s\n",
+	    what, t1 - t0, (t1 > t0) ? nrows / (t1 - t0) : 0.0,
+	    size / 1e6, (t1 > t0) ? size / 1e6 / (t1 - t0) : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    sqlite3 *db;
+    FILE *out;
+    char name[1024], sql[512];
+    double t0, t1;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dbname") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		dbname = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-out") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		outname = argv[i];
+	    }
+        } else if (strcmp(argv[i], "-rows") == 0) {
+	    if (i + 1 < argc) {
+	        i++;
+		nrows = strtol(argv[i], NULL, 0);
+	    }
+        } else if (strcmp(argv[i], "-init") == 0) {
+	    init = 1;
+        } else if (strcmp(argv[i], "-v") == 0) {
+	    verbose = 1;
+	}
+    }
+    if (dbname == NULL || nrows < 1 || strlen(outname) > 1000) {
+        fprintf(stderr, "usage: %s -dbname file [-init] [-rows n] "
+		"[-out prefix] [-v]\n\n", argv[0]);
+        fprintf(stderr, "-init     (re)create table with n rows\n");
+        fprintf(stderr, "-rows     number of rows, default 10000000\n");
+        fprintf(stderr, "-out      prefix of output files\n");
+	exit(1);
+    }
+    if (sqlite3_open(dbname, &db) != SQLITE_OK) {
+        fprintf(stderr, "cannot open %s\n", dbname);
+	exit(2);
+    }
+    impexp_init(db);
+    if (init) {
+        t0 = now();
+	exec(db, "DROP TABLE IF EXISTS xbench");
+	exec(db, "CREATE TABLE xbench(id INTEGER PRIMARY KEY, b BLOB,"
+	     " n INTEGER, r REAL, t TEXT)");
+	sprintf(sql, "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL"
+		" SELECT x + 1 FROM c WHERE x < %d)"
+		" INSERT INTO xbench SELECT x, randomblob(8),"
+		" (x * 7919) %% 1000003 - 500000, x / 7.0,"
+		" 'row \"' || x || '\" <' || (x %% 97) || '>' FROM c", nrows);
+	exec(db, "BEGIN TRANSACTION");
+	exec(db, sql);
+	exec(db, "COMMIT TRANSACTION");
+	t1 = now();
+	if (verbose) {
+	    fprintf(stdout, "init %d rows: %.3f s\n", nrows, t1 - t0);
+	}
+    }
+    sprintf(sql, "SELECT * FROM xbench LIMIT %d", nrows);
+
+    sprintf(name, "%s.csv", outname);
+    t0 = now();
+    impexp_export_csv(db, name, 1, NULL, "xbench", NULL, NULL, NULL, NULL);
+    t1 = now();
+    report("csv", name, t0, t1);
+
+    sprintf(name, "%s.xml", outname);
+    t0 = now();
+    impexp_export_xml(db, name, 0, 0, "xbench", "row", "xbench", NULL);
+    t1 = now();
+    report("xml", name, t0, t1);
+
+    sprintf(name, "%s.sql", outname);
+    t0 = now();
+    impexp_export_sql(db, name, 1, "xbench", NULL);
+    t1 = now();
+    report("sql", name, t0, t1);
+
+    sprintf(name, "%s.json", outname);
+    out = fopen(name, "w");
+    if (out) {
+        t0 = now();
+	impexp_export_json(db, sql, (impexp_putc) fputc, out);
+	fclose(out);
+	t1 = now();
+	report("json putc", name, t0, t1);
+    }
+
+    out = fopen(name, "w");
+    if (out) {
+        t0 = now();
+	impexp_export_json_write(db, sql, wfile, out);
+	fclose(out);
+	t1 = now();
+	report("json write", name, t0, t1);
+    }
+    sqlite3_close(db);
+    return 0;
+}